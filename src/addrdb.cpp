@@ -31,12 +31,12 @@ class DbNotFoundError : public std::exception
 template <typename Stream, typename Data>
 bool SerializeDB(Stream& stream, const Data& data)
 {
-    // Write and commit header, data
+    // Write and commit header, data. The data is serialized only once and
+    // hashed on the way to the file.
     try {
-        CHashWriter hasher(stream.GetType(), stream.GetVersion());
-        stream << Params().MessageStart() << data;
-        hasher << Params().MessageStart() << data;
-        stream << hasher.GetHash();
+        HashedSourceWriter hashwriter{stream};
+        hashwriter << Params().MessageStart() << data;
+        stream << hashwriter.GetHash();
     } catch (const std::exception& e) {
         return error("%s: Serialize or I/O error - %s", __func__, e.what());
     }
@@ -18,8 +18,12 @@
 #include <tinyformat.h>
 #include <uint256.h>
 #include <util/check.h>
+#include <util/time.h>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <numeric>
 #include <optional>
 
 /** Over how many buckets entries with tried addresses from a single group (/16 for IPv4) are spread */
@@ -42,6 +46,10 @@ static constexpr int64_t ADDRMAN_REPLACEMENT_HOURS{4};
 static constexpr size_t ADDRMAN_SET_TRIED_COLLISION_SIZE{10};
 /** The maximum time we'll spend trying to resolve a tried table collision, in seconds */
 static constexpr int64_t ADDRMAN_TEST_WINDOW{40*60}; // 40 minutes
+/** Maximum age of the GetAddr snapshot once addrman has changed */
+static constexpr auto ADDRMAN_GETADDR_SNAPSHOT_INTERVAL{1min};
+/** Number of addresses Add() processes before briefly releasing the lock for other users */
+static constexpr size_t ADDRMAN_ADD_BATCH_SIZE{64};
 
 int AddrInfo::GetTriedBucket(const uint256& nKey, const std::vector<bool>& asmap) const
 {
@@ -122,11 +130,92 @@ AddrManImpl::~AddrManImpl()
     nKey.SetNull();
 }
 
+namespace {
+//! Map a signed value onto an unsigned one so that small magnitudes of either
+//! sign get a short VARINT encoding.
+uint64_t ZigZagEncode(int64_t n) { return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63); }
+int64_t ZigZagDecode(uint64_t n) { return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1); }
+
+/**
+ * Write `entries` in the order given by `order` using the compact (V5) layout:
+ * runs of entries sharing a source address, with the source written once per
+ * run. Within a run, entries are sorted by time and the time is delta-coded.
+ */
 template <typename Stream>
-void AddrManImpl::Serialize(Stream& s_) const
+void SerializeCompactEntries(Stream& s, const std::vector<AddrInfo>& entries, const std::vector<int>& order)
 {
-    LOCK(cs);
+    uint64_t num_runs{0};
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || entries[order[i]].source != entries[order[i - 1]].source) ++num_runs;
+    }
+    s << VARINT(num_runs);
+    for (size_t begin = 0; begin < order.size();) {
+        const CNetAddr& source{entries[order[begin]].source};
+        size_t end{begin + 1};
+        while (end < order.size() && entries[order[end]].source == source) ++end;
+        s << source << VARINT(uint64_t{end - begin});
+        uint32_t last_time{0};
+        for (size_t i = begin; i < end; ++i) {
+            const AddrInfo& info{entries[order[i]]};
+            // The subtraction is done on unsigned values, which wrap instead of overflowing.
+            const uint64_t last_success{static_cast<uint64_t>(info.nLastSuccess) - info.nTime};
+            s << VARINT(uint32_t{info.nTime - last_time});
+            s << VARINT(static_cast<uint64_t>(info.nServices));
+            s << static_cast<const CService&>(info);
+            s << VARINT(info.nLastSuccess == 0 ? uint64_t{0} : ZigZagEncode(static_cast<int64_t>(last_success)) + 1);
+            s << VARINT(ZigZagEncode(info.nAttempts));
+            last_time = info.nTime;
+        }
+        begin = end;
+    }
+}
+
+/** Read `count` entries written by SerializeCompactEntries(). */
+template <typename Stream>
+std::vector<AddrInfo> UnserializeCompactEntries(Stream& s, int count)
+{
+    std::vector<AddrInfo> entries;
+    entries.reserve(count);
+    uint64_t num_runs;
+    s >> VARINT(num_runs);
+    uint64_t remaining{static_cast<uint64_t>(count)};
+    for (uint64_t run = 0; run < num_runs; ++run) {
+        CNetAddr source;
+        uint64_t run_size;
+        s >> source >> VARINT(run_size);
+        if (run_size == 0 || run_size > remaining) {
+            throw std::ios_base::failure(strprintf("Corrupt AddrMan serialization: run of %u entries, %u expected at most", run_size, remaining));
+        }
+        remaining -= run_size;
+        uint32_t time{0};
+        for (uint64_t i = 0; i < run_size; ++i) {
+            AddrInfo info;
+            info.source = source;
+            uint32_t time_delta;
+            uint64_t services, last_success, attempts;
+            s >> VARINT(time_delta) >> VARINT(services);
+            s >> static_cast<CService&>(info);
+            s >> VARINT(last_success) >> VARINT(attempts);
+            time += time_delta;
+            info.nTime = time;
+            info.nServices = static_cast<ServiceFlags>(services);
+            if (last_success != 0) {
+                info.nLastSuccess = static_cast<int64_t>(static_cast<uint64_t>(ZigZagDecode(last_success - 1)) + info.nTime);
+            }
+            info.nAttempts = static_cast<int>(ZigZagDecode(attempts));
+            entries.push_back(std::move(info));
+        }
+    }
+    if (remaining != 0) {
+        throw std::ios_base::failure(strprintf("Corrupt AddrMan serialization: %u entries missing", remaining));
+    }
+    return entries;
+}
+} // namespace
 
+template <typename Stream>
+void AddrManImpl::Serialize(Stream& s_) const
+{
     /**
      * Serialized format.
      * * format version byte (@see `Format`)
@@ -151,6 +240,9 @@ void AddrManImpl::Serialize(Stream& s_) const
      *   * for each element: index in the serialized "all new addresses"
      * * asmap checksum
      *
+     * Since format=5 the addresses are written as runs sharing a source address
+     * (@see SerializeCompactEntries), and bucket sizes and indices are VARINTs.
+     *
      * 2**30 is xorred with the number of buckets to make addrman deserializer v0 detect it
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
@@ -165,6 +257,58 @@ void AddrManImpl::Serialize(Stream& s_) const
      * very little in common.
      */
 
+    // Copy the table contents under the lock and encode them afterwards, so
+    // that writing peers.dat does not hold up the network threads.
+    uint256 key;
+    std::vector<AddrInfo> new_entries;
+    std::vector<AddrInfo> tried_entries;
+    std::vector<std::vector<int>> new_buckets(ADDRMAN_NEW_BUCKET_COUNT);
+    {
+        READ_LOCK(cs);
+        key = nKey;
+        new_entries.reserve(nNew);
+        tried_entries.reserve(nTried);
+        std::unordered_map<int, int> new_index;
+        new_index.reserve(nNew);
+        for (const auto& [id, info] : mapInfo) {
+            if (info.nRefCount) {
+                assert(new_entries.size() != size_t(nNew)); // this means nNew was wrong, oh ow
+                new_index.emplace(id, new_entries.size());
+                new_entries.push_back(info);
+            }
+            if (info.fInTried) {
+                assert(tried_entries.size() != size_t(nTried)); // this means nTried was wrong, oh ow
+                tried_entries.push_back(info);
+            }
+        }
+        for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvNew[bucket][i] != -1) {
+                    new_buckets[bucket].push_back(new_index.at(vvNew[bucket][i]));
+                }
+            }
+        }
+    }
+
+    const auto by_source_and_time{[](const std::vector<AddrInfo>& entries) {
+        std::vector<int> order(entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            const AddrInfo& lhs{entries[a]};
+            const AddrInfo& rhs{entries[b]};
+            if (lhs.source != rhs.source) return lhs.source < rhs.source;
+            return lhs.nTime < rhs.nTime;
+        });
+        return order;
+    }};
+    const std::vector<int> new_order{by_source_and_time(new_entries)};
+    const std::vector<int> tried_order{by_source_and_time(tried_entries)};
+    // Position of each new entry in the serialized order, for the bucket lists.
+    std::vector<int> new_position(new_entries.size());
+    for (size_t i = 0; i < new_order.size(); ++i) {
+        new_position[new_order[i]] = i;
+    }
+
     // Always serialize in the latest version (FILE_FORMAT).
 
     OverrideStream<Stream> s(&s_, s_.GetType(), s_.GetVersion() | ADDRV2_FORMAT);
@@ -173,47 +317,21 @@ void AddrManImpl::Serialize(Stream& s_) const
 
     // Increment `lowest_compatible` iff a newly introduced format is incompatible with
     // the previous one.
-    static constexpr uint8_t lowest_compatible = Format::V4_MULTIPORT;
+    static constexpr uint8_t lowest_compatible = Format::V5_COMPACT;
     s << static_cast<uint8_t>(INCOMPATIBILITY_BASE + lowest_compatible);
 
-    s << nKey;
-    s << nNew;
-    s << nTried;
+    s << key;
+    s << static_cast<int>(new_entries.size());
+    s << static_cast<int>(tried_entries.size());
 
     int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
     s << nUBuckets;
-    std::unordered_map<int, int> mapUnkIds;
-    int nIds = 0;
-    for (const auto& entry : mapInfo) {
-        mapUnkIds[entry.first] = nIds;
-        const AddrInfo& info = entry.second;
-        if (info.nRefCount) {
-            assert(nIds != nNew); // this means nNew was wrong, oh ow
-            s << info;
-            nIds++;
-        }
-    }
-    nIds = 0;
-    for (const auto& entry : mapInfo) {
-        const AddrInfo& info = entry.second;
-        if (info.fInTried) {
-            assert(nIds != nTried); // this means nTried was wrong, oh ow
-            s << info;
-            nIds++;
-        }
-    }
-    for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-        int nSize = 0;
-        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
-            if (vvNew[bucket][i] != -1)
-                nSize++;
-        }
-        s << nSize;
-        for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
-            if (vvNew[bucket][i] != -1) {
-                int nIndex = mapUnkIds[vvNew[bucket][i]];
-                s << nIndex;
-            }
+    SerializeCompactEntries(s, new_entries, new_order);
+    SerializeCompactEntries(s, tried_entries, tried_order);
+    for (const std::vector<int>& bucket : new_buckets) {
+        s << VARINT(uint64_t{bucket.size()});
+        for (const int index : bucket) {
+            s << VARINT(uint64_t(new_position[index]));
         }
     }
     // Store asmap checksum after bucket entries so that it
@@ -228,7 +346,8 @@ void AddrManImpl::Serialize(Stream& s_) const
 template <typename Stream>
 void AddrManImpl::Unserialize(Stream& s_)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
+    ++m_version;
 
     assert(vRandom.empty());
 
@@ -283,21 +402,21 @@ void AddrManImpl::Unserialize(Stream& s_)
                     ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE));
     }
 
-    // Deserialize entries from the new table.
-    for (int n = 0; n < nNew; n++) {
-        AddrInfo& info = mapInfo[n];
-        s >> info;
-        mapAddr[info] = n;
+    mapInfo.reserve(nNew + nTried);
+    mapAddr.reserve(nNew + nTried);
+    vRandom.reserve(nNew + nTried);
+
+    // Entries from the new table get consecutive ids, starting at 0.
+    const auto add_new{[&](AddrInfo&& info) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        const int n{nIdCount++};
         info.nRandomPos = vRandom.size();
         vRandom.push_back(n);
-    }
-    nIdCount = nNew;
+        mapAddr[info] = n;
+        mapInfo[n] = std::move(info);
+    }};
 
-    // Deserialize entries from the tried table.
     int nLost = 0;
-    for (int n = 0; n < nTried; n++) {
-        AddrInfo info;
-        s >> info;
+    const auto add_tried{[&](AddrInfo&& info) EXCLUSIVE_LOCKS_REQUIRED(cs) {
         int nKBucket = info.GetTriedBucket(nKey, m_asmap);
         int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
         if (info.IsValid()
@@ -305,13 +424,30 @@ void AddrManImpl::Unserialize(Stream& s_)
             info.nRandomPos = vRandom.size();
             info.fInTried = true;
             vRandom.push_back(nIdCount);
-            mapInfo[nIdCount] = info;
             mapAddr[info] = nIdCount;
+            mapInfo[nIdCount] = std::move(info);
             vvTried[nKBucket][nKBucketPos] = nIdCount;
             nIdCount++;
         } else {
             nLost++;
         }
+    }};
+
+    // Deserialize entries from the new table, then from the tried table.
+    if (format >= Format::V5_COMPACT) {
+        for (AddrInfo& info : UnserializeCompactEntries(s, nNew)) add_new(std::move(info));
+        for (AddrInfo& info : UnserializeCompactEntries(s, nTried)) add_tried(std::move(info));
+    } else {
+        for (int n = 0; n < nNew; n++) {
+            AddrInfo info;
+            s >> info;
+            add_new(std::move(info));
+        }
+        for (int n = 0; n < nTried; n++) {
+            AddrInfo info;
+            s >> info;
+            add_tried(std::move(info));
+        }
     }
     nTried -= nLost;
 
@@ -321,11 +457,27 @@ void AddrManImpl::Unserialize(Stream& s_)
     std::vector<std::pair<int, int>> bucket_entries;
 
     for (int bucket = 0; bucket < nUBuckets; ++bucket) {
-        int num_entries{0};
-        s >> num_entries;
-        for (int n = 0; n < num_entries; ++n) {
-            int entry_index{0};
-            s >> entry_index;
+        int64_t num_entries{0};
+        if (format >= Format::V5_COMPACT) {
+            uint64_t size;
+            s >> VARINT(size);
+            num_entries = std::min<uint64_t>(size, std::numeric_limits<int64_t>::max());
+        } else {
+            int size{0};
+            s >> size;
+            num_entries = size;
+        }
+        for (int64_t n = 0; n < num_entries; ++n) {
+            int64_t entry_index{0};
+            if (format >= Format::V5_COMPACT) {
+                uint64_t index;
+                s >> VARINT(index);
+                entry_index = std::min<uint64_t>(index, std::numeric_limits<int64_t>::max());
+            } else {
+                int index{0};
+                s >> index;
+                entry_index = index;
+            }
             if (entry_index >= 0 && entry_index < nNew) {
                 bucket_entries.emplace_back(bucket, entry_index);
             }
@@ -432,7 +584,7 @@ AddrInfo* AddrManImpl::Create(const CAddress& addr, const CNetAddr& addrSource,
     return &mapInfo[nId];
 }
 
-void AddrManImpl::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2) const
+void AddrManImpl::SwapRandom(unsigned int nRndPos1, unsigned int nRndPos2)
 {
     AssertLockHeld(cs);
 
@@ -586,7 +738,7 @@ bool AddrManImpl::AddSingle(const CAddress& addr, const CNetAddr& source, int64_
         int nFactor = 1;
         for (int n = 0; n < pinfo->nRefCount; n++)
             nFactor *= 2;
-        if (nFactor > 1 && (insecure_rand.randrange(nFactor) != 0))
+        if (nFactor > 1 && (WITH_LOCK(m_rand_mutex, return insecure_rand.randrange(nFactor)) != 0))
             return false;
     } else {
         pinfo = Create(addr, source, &nId);
@@ -714,15 +866,18 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
 
     if (newOnly && nNew == 0) return {};
 
+    // m_rand_mutex is only taken for each random draw, so that concurrent
+    // readers don't serialize on it for the whole search.
     // Use a 50% chance for choosing between tried and new table entries.
     if (!newOnly &&
-       (nTried > 0 && (nNew == 0 || insecure_rand.randbool() == 0))) {
+       (nTried > 0 && (nNew == 0 || WITH_LOCK(m_rand_mutex, return insecure_rand.randbool()) == 0))) {
         // use a tried node
         double fChanceFactor = 1.0;
         while (1) {
             // Pick a tried bucket, and an initial position in that bucket.
-            int nKBucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
+            const auto [nKBucket, nKBucketPos] = WITH_LOCK(m_rand_mutex,
+                const int bucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
+                return std::make_pair(bucket, int(insecure_rand.randrange(ADDRMAN_BUCKET_SIZE))));
             // Iterate over the positions of that bucket, starting at the initial one,
             // and looping around.
             int i;
@@ -737,7 +892,7 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
             assert(it_found != mapInfo.end());
             const AddrInfo& info{it_found->second};
             // With probability GetChance() * fChanceFactor, return the entry.
-            if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30)) {
+            if (WITH_LOCK(m_rand_mutex, return insecure_rand.randbits(30)) < fChanceFactor * info.GetChance() * (1 << 30)) {
                 LogPrint(BCLog::ADDRMAN, "Selected %s from tried\n", info.ToString());
                 return {info, info.nLastTry};
             }
@@ -749,8 +904,9 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
         double fChanceFactor = 1.0;
         while (1) {
             // Pick a new bucket, and an initial position in that bucket.
-            int nUBucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
+            const auto [nUBucket, nUBucketPos] = WITH_LOCK(m_rand_mutex,
+                const int bucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
+                return std::make_pair(bucket, int(insecure_rand.randrange(ADDRMAN_BUCKET_SIZE))));
             // Iterate over the positions of that bucket, starting at the initial one,
             // and looping around.
             int i;
@@ -765,7 +921,7 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
             assert(it_found != mapInfo.end());
             const AddrInfo& info{it_found->second};
             // With probability GetChance() * fChanceFactor, return the entry.
-            if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30)) {
+            if (WITH_LOCK(m_rand_mutex, return insecure_rand.randbits(30)) < fChanceFactor * info.GetChance() * (1 << 30)) {
                 LogPrint(BCLog::ADDRMAN, "Selected %s from new\n", info.ToString());
                 return {info, info.nLastTry};
             }
@@ -775,11 +931,42 @@ std::pair<CAddress, int64_t> AddrManImpl::Select_(bool newOnly) const
     }
 }
 
-std::vector<CAddress> AddrManImpl::GetAddr_(size_t max_addresses, size_t max_pct, std::optional<Network> network) const
+std::shared_ptr<const AddrManImpl::GetAddrSnapshot> AddrManImpl::GetSnapshot() const
 {
-    AssertLockHeld(cs);
+    LOCK(m_snapshot_mutex);
+    const auto now{GetTime<std::chrono::seconds>()};
+    if (m_getaddr_snapshot && m_getaddr_snapshot->version == m_version) return m_getaddr_snapshot;
+
+    auto snapshot{std::make_shared<GetAddrSnapshot>()};
+    snapshot->time = now;
+    {
+        READ_LOCK(cs);
+        if (m_getaddr_snapshot && now < m_getaddr_snapshot->time + ADDRMAN_GETADDR_SNAPSHOT_INTERVAL &&
+            vRandom.size() == m_getaddr_snapshot->total) {
+            return m_getaddr_snapshot;
+        }
+        snapshot->version = m_version;
+        snapshot->total = vRandom.size();
+        snapshot->addresses.reserve(vRandom.size());
+        const int64_t adjusted_now{GetAdjustedTime()};
+        for (const int id : vRandom) {
+            const auto it{mapInfo.find(id)};
+            assert(it != mapInfo.end());
+            // Filter for quality
+            if (!it->second.IsTerrible(adjusted_now)) snapshot->addresses.push_back(it->second);
+        }
+    }
+    {
+        LOCK(m_rand_mutex);
+        Shuffle(snapshot->addresses.begin(), snapshot->addresses.end(), insecure_rand);
+    }
+    m_getaddr_snapshot = std::move(snapshot);
+    return m_getaddr_snapshot;
+}
 
-    size_t nNodes = vRandom.size();
+std::vector<CAddress> AddrManImpl::GetAddr_(const GetAddrSnapshot& snapshot, size_t max_addresses, size_t max_pct, std::optional<Network> network) const
+{
+    size_t nNodes = snapshot.total;
     if (max_pct != 0) {
         nNodes = max_pct * nNodes / 100;
     }
@@ -787,27 +974,19 @@ std::vector<CAddress> AddrManImpl::GetAddr_(size_t max_addresses, size_t max_pct
         nNodes = std::min(nNodes, max_addresses);
     }
 
-    // gather a list of random nodes, skipping those of low quality
-    const int64_t now{GetAdjustedTime()};
+    // The snapshot is already shuffled; start at a random position so that
+    // repeated calls do not return the same addresses.
     std::vector<CAddress> addresses;
-    for (unsigned int n = 0; n < vRandom.size(); n++) {
-        if (addresses.size() >= nNodes)
-            break;
-
-        int nRndPos = insecure_rand.randrange(vRandom.size() - n) + n;
-        SwapRandom(n, nRndPos);
-        const auto it{mapInfo.find(vRandom[n])};
-        assert(it != mapInfo.end());
-
-        const AddrInfo& ai{it->second};
+    const size_t count{snapshot.addresses.size()};
+    if (count == 0) return addresses;
+    const size_t start{WITH_LOCK(m_rand_mutex, return insecure_rand.randrange(count))};
+    for (size_t n = 0; n < count && addresses.size() < nNodes; ++n) {
+        const CAddress& addr{snapshot.addresses[(start + n) % count]};
 
         // Filter by network (optional)
-        if (network != std::nullopt && ai.GetNetClass() != network) continue;
+        if (network != std::nullopt && addr.GetNetClass() != network) continue;
 
-        // Filter for quality
-        if (ai.IsTerrible(now)) continue;
-
-        addresses.push_back(ai);
+        addresses.push_back(addr);
     }
     LogPrint(BCLog::ADDRMAN, "GetAddr returned %d random addresses\n", addresses.size());
     return addresses;
@@ -917,7 +1096,7 @@ std::pair<CAddress, int64_t> AddrManImpl::SelectTriedCollision_()
     std::set<int>::iterator it = m_tried_collisions.begin();
 
     // Selects a random element from m_tried_collisions
-    std::advance(it, insecure_rand.randrange(m_tried_collisions.size()));
+    std::advance(it, WITH_LOCK(m_rand_mutex, return insecure_rand.randrange(m_tried_collisions.size())));
     int id_new = *it;
 
     // If id_new not found in mapInfo remove it from m_tried_collisions
@@ -965,7 +1144,7 @@ void AddrManImpl::Check() const
 
     // Run consistency checks 1 in m_consistency_check_ratio times if enabled
     if (m_consistency_check_ratio == 0) return;
-    if (insecure_rand.randrange(m_consistency_check_ratio) >= 1) return;
+    if (WITH_LOCK(m_rand_mutex, return insecure_rand.randrange(m_consistency_check_ratio)) >= 1) return;
 
     const int err{CheckAddrman()};
     if (err) {
@@ -1064,47 +1243,60 @@ int AddrManImpl::CheckAddrman() const
 
 size_t AddrManImpl::size() const
 {
-    LOCK(cs); // TODO: Cache this in an atomic to avoid this overhead
+    READ_LOCK(cs); // TODO: Cache this in an atomic to avoid this overhead
     return vRandom.size();
 }
 
 bool AddrManImpl::Add(const std::vector<CAddress>& vAddr, const CNetAddr& source, int64_t nTimePenalty)
 {
-    LOCK(cs);
-    Check();
-    auto ret = Add_(vAddr, source, nTimePenalty);
-    Check();
+    // Large addr messages are processed in batches, so that Select() and
+    // other users do not have to wait for the whole message.
+    bool ret{false};
+    for (size_t begin = 0; begin < vAddr.size(); begin += ADDRMAN_ADD_BATCH_SIZE) {
+        const size_t end{std::min(vAddr.size(), begin + ADDRMAN_ADD_BATCH_SIZE)};
+        const std::vector<CAddress> batch(vAddr.begin() + begin, vAddr.begin() + end);
+        WRITE_LOCK(cs);
+        Check();
+        if (Add_(batch, source, nTimePenalty)) {
+            ret = true;
+            ++m_version;
+        }
+        Check();
+    }
     return ret;
 }
 
 bool AddrManImpl::Good(const CService& addr, int64_t nTime)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     auto ret = Good_(addr, /*test_before_evict=*/true, nTime);
+    ++m_version;
     Check();
     return ret;
 }
 
 void AddrManImpl::Attempt(const CService& addr, bool fCountFailure, int64_t nTime)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     Attempt_(addr, fCountFailure, nTime);
+    ++m_version;
     Check();
 }
 
 void AddrManImpl::ResolveCollisions()
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     ResolveCollisions_();
+    ++m_version;
     Check();
 }
 
 std::pair<CAddress, int64_t> AddrManImpl::SelectTriedCollision()
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     const auto ret = SelectTriedCollision_();
     Check();
@@ -1113,7 +1305,7 @@ std::pair<CAddress, int64_t> AddrManImpl::SelectTriedCollision()
 
 std::pair<CAddress, int64_t> AddrManImpl::Select(bool newOnly) const
 {
-    LOCK(cs);
+    READ_LOCK(cs);
     Check();
     const auto addrRet = Select_(newOnly);
     Check();
@@ -1122,32 +1314,31 @@ std::pair<CAddress, int64_t> AddrManImpl::Select(bool newOnly) const
 
 std::vector<CAddress> AddrManImpl::GetAddr(size_t max_addresses, size_t max_pct, std::optional<Network> network) const
 {
-    LOCK(cs);
-    Check();
-    const auto addresses = GetAddr_(max_addresses, max_pct, network);
-    Check();
-    return addresses;
+    const auto snapshot{GetSnapshot()};
+    return GetAddr_(*snapshot, max_addresses, max_pct, network);
 }
 
 void AddrManImpl::Connected(const CService& addr, int64_t nTime)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     Connected_(addr, nTime);
+    ++m_version;
     Check();
 }
 
 void AddrManImpl::SetServices(const CService& addr, ServiceFlags nServices)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     SetServices_(addr, nServices);
+    ++m_version;
     Check();
 }
 
 std::optional<AddressPosition> AddrManImpl::FindAddressEntry(const CAddress& addr)
 {
-    LOCK(cs);
+    WRITE_LOCK(cs);
     Check();
     auto entry = FindAddressEntry_(addr);
     Check();
@@ -1179,6 +1370,7 @@ void AddrMan::Unserialize(Stream& s_)
 // explicit instantiation
 template void AddrMan::Serialize(CHashWriter& s) const;
 template void AddrMan::Serialize(CAutoFile& s) const;
+template void AddrMan::Serialize(HashedSourceWriter<CAutoFile>& s) const;
 template void AddrMan::Serialize(CDataStream& s) const;
 template void AddrMan::Unserialize(CAutoFile& s);
 template void AddrMan::Unserialize(CHashVerifier<CAutoFile>& s);
@@ -13,7 +13,10 @@
 #include <sync.h>
 #include <uint256.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <set>
 #include <unordered_map>
@@ -145,11 +148,20 @@ public:
     friend class AddrManDeterministic;
 
 private:
-    //! A mutex to protect the inner data structures.
-    mutable Mutex cs;
+    //! A mutex to protect the inner data structures. Select() and the other
+    //! read-only operations share it; anything modifying the tables takes it
+    //! exclusively.
+    //!
+    //! Lock order: m_snapshot_mutex, then cs, then m_rand_mutex. Nothing else
+    //! is acquired while holding any of them.
+    mutable SharedMutex cs;
+
+    //! Protects insecure_rand, which readers holding cs in shared mode also use.
+    //! Only held for single random draws.
+    mutable Mutex m_rand_mutex;
 
     //! Source of random numbers for randomization in inner loops
-    mutable FastRandomContext insecure_rand GUARDED_BY(cs);
+    mutable FastRandomContext insecure_rand GUARDED_BY(m_rand_mutex);
 
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -161,6 +173,7 @@ private:
         V2_ASMAP = 2,         //!< for files including asmap version
         V3_BIP155 = 3,        //!< same as V2_ASMAP plus addresses are in BIP155 format
         V4_MULTIPORT = 4,     //!< adds support for multiple ports per IP
+        V5_COMPACT = 5,       //!< addresses grouped by source, delta-coded times and VARINT fields
     };
 
     //! The maximum format this software knows it can unserialize. Also, we always serialize
@@ -168,7 +181,7 @@ private:
     //! The format (first byte in the serialized stream) can be higher than this and
     //! still this software may be able to unserialize the file - if the second byte
     //! (see `lowest_compatible` in `Unserialize()`) is less or equal to this.
-    static constexpr Format FILE_FORMAT = Format::V4_MULTIPORT;
+    static constexpr Format FILE_FORMAT = Format::V5_COMPACT;
 
     //! The initial value of a field that is incremented every time an incompatible format
     //! change is made (such that old software versions would not be able to parse and
@@ -187,9 +200,7 @@ private:
     std::unordered_map<CService, int, CServiceHash> mapAddr GUARDED_BY(cs);
 
     //! randomly-ordered vector of all nIds
-    //! This is mutable because it is unobservable outside the class, so any
-    //! changes to it (even in const methods) are also unobservable.
-    mutable std::vector<int> vRandom GUARDED_BY(cs);
+    std::vector<int> vRandom GUARDED_BY(cs);
 
     // number of "tried" entries
     int nTried GUARDED_BY(cs){0};
@@ -228,6 +239,31 @@ private:
     // would be re-bucketed accordingly.
     const std::vector<bool> m_asmap;
 
+    //! Incremented on every change that may affect GetAddr() results.
+    std::atomic<uint64_t> m_version{0};
+
+    /** Immutable view of the addresses GetAddr() may return. */
+    struct GetAddrSnapshot {
+        //! Non-terrible addresses, in random order.
+        std::vector<CAddress> addresses;
+        //! Number of addresses in addrman (used for max_pct).
+        size_t total;
+        //! m_version the snapshot was taken at.
+        uint64_t version;
+        std::chrono::seconds time;
+    };
+
+    /**
+     * GetAddr() responses are served from this snapshot instead of walking
+     * the tables under cs. It is rebuilt when addresses were added or
+     * removed, or when it is older than ADDRMAN_GETADDR_SNAPSHOT_INTERVAL and
+     * anything changed.
+     */
+    mutable Mutex m_snapshot_mutex;
+    mutable std::shared_ptr<const GetAddrSnapshot> m_getaddr_snapshot GUARDED_BY(m_snapshot_mutex);
+
+    std::shared_ptr<const GetAddrSnapshot> GetSnapshot() const EXCLUSIVE_LOCKS_REQUIRED(!cs, !m_snapshot_mutex);
+
     //! Find an entry.
     AddrInfo* Find(const CService& addr, int* pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -235,7 +271,7 @@ private:
     AddrInfo* Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     //! Swap two elements in vRandom.
-    void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     //! Delete an entry. It must not be in tried, and have refcount 0.
     void Delete(int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -248,7 +284,7 @@ private:
 
     /** Attempt to add a single address to addrman's new table.
      *  @see AddrMan::Add() for parameters. */
-    bool AddSingle(const CAddress& addr, const CNetAddr& source, int64_t nTimePenalty) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    bool AddSingle(const CAddress& addr, const CNetAddr& source, int64_t nTimePenalty) EXCLUSIVE_LOCKS_REQUIRED(cs, !m_rand_mutex);
 
     bool Good_(const CService& addr, bool test_before_evict, int64_t time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -256,9 +292,9 @@ private:
 
     void Attempt_(const CService& addr, bool fCountFailure, int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
-    std::pair<CAddress, int64_t> Select_(bool newOnly) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    std::pair<CAddress, int64_t> Select_(bool newOnly) const SHARED_LOCKS_REQUIRED(cs) EXCLUSIVE_LOCKS_REQUIRED(!m_rand_mutex);
 
-    std::vector<CAddress> GetAddr_(size_t max_addresses, size_t max_pct, std::optional<Network> network) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    std::vector<CAddress> GetAddr_(const GetAddrSnapshot& snapshot, size_t max_addresses, size_t max_pct, std::optional<Network> network) const EXCLUSIVE_LOCKS_REQUIRED(!m_rand_mutex);
 
     void Connected_(const CService& addr, int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -266,17 +302,17 @@ private:
 
     void ResolveCollisions_() EXCLUSIVE_LOCKS_REQUIRED(cs);
 
-    std::pair<CAddress, int64_t> SelectTriedCollision_() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    std::pair<CAddress, int64_t> SelectTriedCollision_() EXCLUSIVE_LOCKS_REQUIRED(cs, !m_rand_mutex);
 
     std::optional<AddressPosition> FindAddressEntry_(const CAddress& addr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     //! Consistency check, taking into account m_consistency_check_ratio.
     //! Will std::abort if an inconsistency is detected.
-    void Check() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void Check() const SHARED_LOCKS_REQUIRED(cs) EXCLUSIVE_LOCKS_REQUIRED(!m_rand_mutex);
 
     //! Perform consistency check, regardless of m_consistency_check_ratio.
     //! @returns an error code or zero.
-    int CheckAddrman() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    int CheckAddrman() const SHARED_LOCKS_REQUIRED(cs);
 };
 
 #endif // BITCOIN_ADDRMAN_IMPL_H
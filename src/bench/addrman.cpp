@@ -4,11 +4,15 @@
 
 #include <addrman.h>
 #include <bench/bench.h>
+#include <clientversion.h>
 #include <random.h>
+#include <streams.h>
 #include <util/check.h>
 #include <util/time.h>
 
+#include <atomic>
 #include <optional>
+#include <thread>
 #include <vector>
 
 /* A "source" is a source address from which we have received a bunch of other addresses. */
@@ -132,7 +136,87 @@ static void AddrManAddThenGood(benchmark::Bench& bench)
     });
 }
 
+static void AddrManSelectWhileAdding(benchmark::Bench& bench)
+{
+    AddrMan addrman{EMPTY_ASMAP, /*deterministic=*/false, ADDRMAN_CONSISTENCY_CHECK_RATIO};
+
+    FillAddrMan(addrman);
+
+    // Keep a thread busy relaying addresses, like addr messages from many peers.
+    std::atomic<bool> stop{false};
+    std::thread adder{[&] {
+        while (!stop) AddAddressesToAddrMan(addrman);
+    }};
+
+    bench.run([&] {
+        const auto& address = addrman.Select();
+        assert(address.first.GetPort() > 0);
+    });
+
+    stop = true;
+    adder.join();
+}
+
+static void AddrManConcurrentReads(benchmark::Bench& bench)
+{
+    AddrMan addrman{EMPTY_ASMAP, /*deterministic=*/false, ADDRMAN_CONSISTENCY_CHECK_RATIO};
+
+    FillAddrMan(addrman);
+
+    constexpr int THREADS{4};
+    constexpr int CALLS{50};
+    bench.batch(THREADS * CALLS).unit("call").run([&] {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < THREADS; ++i) {
+            threads.emplace_back([&, i] {
+                for (int j = 0; j < CALLS; ++j) {
+                    if (i % 2 == 0) {
+                        assert(addrman.Select().first.GetPort() > 0);
+                    } else {
+                        assert(!addrman.GetAddr(/*max_addresses=*/1000, /*max_pct=*/23, /*network=*/std::nullopt).empty());
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    });
+}
+
+static void AddrManSerialize(benchmark::Bench& bench)
+{
+    AddrMan addrman{EMPTY_ASMAP, /*deterministic=*/false, ADDRMAN_CONSISTENCY_CHECK_RATIO};
+
+    FillAddrMan(addrman);
+
+    bench.run([&] {
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << addrman;
+        assert(!stream.empty());
+    });
+}
+
+static void AddrManDeserialize(benchmark::Bench& bench)
+{
+    AddrMan addrman{EMPTY_ASMAP, /*deterministic=*/false, ADDRMAN_CONSISTENCY_CHECK_RATIO};
+
+    FillAddrMan(addrman);
+
+    CDataStream serialized(SER_DISK, CLIENT_VERSION);
+    serialized << addrman;
+
+    bench.run([&] {
+        CDataStream stream{serialized};
+        AddrMan loaded{EMPTY_ASMAP, /*deterministic=*/false, ADDRMAN_CONSISTENCY_CHECK_RATIO};
+        stream >> loaded;
+        assert(loaded.size() == addrman.size());
+    });
+}
+
 BENCHMARK(AddrManAdd);
 BENCHMARK(AddrManSelect);
 BENCHMARK(AddrManGetAddr);
 BENCHMARK(AddrManAddThenGood);
+BENCHMARK(AddrManSelectWhileAdding);
+BENCHMARK(AddrManConcurrentReads);
+BENCHMARK(AddrManSerialize);
+BENCHMARK(AddrManDeserialize);
@@ -3,16 +3,22 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <chainparams.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <names/main.h>
+#include <node/miner.h>
+#include <script/names.h>
 #include <test/util/mining.h>
 #include <test/util/script.h>
 #include <test/util/setup_common.h>
 #include <test/util/wallet.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 
+#include <string>
 #include <vector>
 
 static void AssembleBlock(benchmark::Bench& bench)
@@ -47,4 +53,173 @@ static void AssembleBlock(benchmark::Bench& bench)
     });
 }
 
+/** Builds a name_new for the given name and salt, spending the given input.  */
+static CTransactionRef NameNewTx(const CTxIn& in, const valtype& name, const valtype& rand)
+{
+    CMutableTransaction tx;
+    tx.SetNamecoin();
+    tx.vin.push_back(in);
+    tx.vin.back().scriptWitness.stack.push_back(WITNESS_STACK_ELEM_OP_TRUE);
+    tx.vout.emplace_back(COIN, CNameScript::buildNameNew(P2WSH_OP_TRUE, name, rand));
+    return MakeTransactionRef(tx);
+}
+
+/** Builds a name_firstupdate spending the given name_new tx.  */
+static CTransactionRef NameFirstUpdateTx(const CTransaction& name_new, const valtype& name, const valtype& rand)
+{
+    CMutableTransaction tx;
+    tx.SetNamecoin();
+    tx.vin.emplace_back(COutPoint(name_new.GetHash(), 0));
+    tx.vin.back().scriptWitness.stack.push_back(WITNESS_STACK_ELEM_OP_TRUE);
+    const valtype value(10, 'x');
+    tx.vout.emplace_back(NAME_LOCKED_AMOUNT, CNameScript::buildNameFirstupdate(P2WSH_OP_TRUE, name, value, rand));
+    return MakeTransactionRef(tx);
+}
+
+static void AssembleBlockNames(benchmark::Bench& bench)
+{
+    const auto test_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    // Mine enough blocks to have mature coinbases for all name_new's
+    constexpr size_t NUM_NAMES{100};
+    std::vector<CTxIn> coinbases;
+    for (size_t b{0}; b < NUM_NAMES + COINBASE_MATURITY; ++b) {
+        coinbases.push_back(MineBlock(test_setup->m_node, P2WSH_OP_TRUE));
+    }
+
+    std::vector<valtype> names, rands;
+    std::vector<CTransactionRef> name_news;
+    for (size_t i{0}; i < NUM_NAMES; ++i) {
+        const std::string name = "d/bench-" + std::to_string(i);
+        names.emplace_back(name.begin(), name.end());
+        rands.emplace_back(20, static_cast<unsigned char>(i));
+        name_news.push_back(NameNewTx(coinbases.at(i), names.back(), rands.back()));
+    }
+
+    const auto process = [&](const CTransactionRef& tx) {
+        LOCK(::cs_main);
+        const MempoolAcceptResult res = test_setup->m_node.chainman->ProcessTransaction(tx);
+        assert(res.m_result_type == MempoolAcceptResult::ResultType::VALID);
+    };
+
+    // Half of the name_new's get confirmed and half of those matured
+    for (size_t i{0}; i < NUM_NAMES / 2; ++i) {
+        process(name_news[i]);
+        if (i == NUM_NAMES / 4) {
+            for (unsigned b{0}; b < MIN_FIRSTUPDATE_DEPTH; ++b) {
+                MineBlock(test_setup->m_node, P2WSH_OP_TRUE);
+            }
+        }
+    }
+    MineBlock(test_setup->m_node, P2WSH_OP_TRUE);
+
+    // The other half stays unconfirmed, and all names get a pending
+    // registration in the mempool that the assembler has to filter
+    for (size_t i{NUM_NAMES / 2}; i < NUM_NAMES; ++i) {
+        process(name_news[i]);
+    }
+    for (size_t i{0}; i < NUM_NAMES; ++i) {
+        process(NameFirstUpdateTx(*name_news[i], names[i], rands[i]));
+    }
+
+    bench.run([&] {
+        PrepareBlock(test_setup->m_node, P2WSH_OP_TRUE);
+    });
+}
+
+/**
+ * Builds templates while new transactions keep arriving in a mempool that
+ * already holds a few thousand transactions, either with a full package
+ * selection each time or with the incremental template builder.
+ */
+static void AssembleBlockChurn(benchmark::Bench& bench, bool incremental)
+{
+    const auto test_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    CScriptWitness witness;
+    witness.stack.push_back(WITNESS_STACK_ELEM_OP_TRUE);
+
+    constexpr size_t NUM_FANOUTS{5};
+    constexpr size_t OUTPUTS_PER_FANOUT{1000};
+    constexpr size_t NUM_PREFILL{2000};
+
+    // Split a few mature coinbases into many small outputs
+    std::vector<CTxIn> coinbases;
+    for (size_t b{0}; b < NUM_FANOUTS + COINBASE_MATURITY; ++b) {
+        coinbases.push_back(MineBlock(test_setup->m_node, P2WSH_OP_TRUE));
+    }
+    std::vector<CTransactionRef> fanouts;
+    for (size_t i{0}; i < NUM_FANOUTS; ++i) {
+        CMutableTransaction tx;
+        tx.vin.push_back(coinbases.at(i));
+        tx.vin.back().scriptWitness = witness;
+        for (size_t o{0}; o < OUTPUTS_PER_FANOUT; ++o) {
+            tx.vout.emplace_back(COIN / 100, P2WSH_OP_TRUE);
+        }
+        fanouts.push_back(MakeTransactionRef(tx));
+        LOCK(::cs_main);
+        const MempoolAcceptResult res = test_setup->m_node.chainman->ProcessTransaction(fanouts.back());
+        assert(res.m_result_type == MempoolAcceptResult::ResultType::VALID);
+    }
+    MineBlock(test_setup->m_node, P2WSH_OP_TRUE);
+
+    // Spends with varying feerates, some of which prefill the mempool
+    std::vector<CTransactionRef> spends;
+    for (const auto& fanout : fanouts) {
+        for (size_t o{0}; o < OUTPUTS_PER_FANOUT; ++o) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(COutPoint(fanout->GetHash(), o));
+            tx.vin.back().scriptWitness = witness;
+            tx.vout.emplace_back(COIN / 100 - 1000 - 10 * static_cast<CAmount>(spends.size() % 997), P2WSH_OP_TRUE);
+            spends.push_back(MakeTransactionRef(tx));
+        }
+    }
+    const auto process = [&](const CTransactionRef& tx) {
+        LOCK(::cs_main);
+        const MempoolAcceptResult res = test_setup->m_node.chainman->ProcessTransaction(tx);
+        assert(res.m_result_type == MempoolAcceptResult::ResultType::VALID);
+    };
+    for (size_t i{0}; i < NUM_PREFILL; ++i) {
+        process(spends[i]);
+    }
+
+    node::BlockTemplateBuilder builder(*test_setup->m_node.chainman, *test_setup->m_node.mempool);
+    RegisterValidationInterface(&builder);
+    const CScript coinbase_script = CScript() << OP_TRUE;
+    const auto create_template = [&] {
+        if (incremental) {
+            builder.CreateNewBlock(coinbase_script);
+        } else {
+            node::BlockAssembler(test_setup->m_node.chainman->ActiveChainstate(), *test_setup->m_node.mempool, Params())
+                .CreateNewBlock(coinbase_script);
+        }
+    };
+    create_template();
+
+    size_t next{NUM_PREFILL};
+    bench.run([&] {
+        // A few new transactions arrive between two template requests
+        for (size_t i{0}; i < 3 && next < spends.size(); ++i) {
+            process(spends[next++]);
+        }
+        SyncWithValidationInterfaceQueue();
+        create_template();
+    });
+
+    UnregisterValidationInterface(&builder);
+}
+
+static void AssembleBlockChurnFull(benchmark::Bench& bench)
+{
+    AssembleBlockChurn(bench, /*incremental=*/false);
+}
+
+static void AssembleBlockChurnIncremental(benchmark::Bench& bench)
+{
+    AssembleBlockChurn(bench, /*incremental=*/true);
+}
+
 BENCHMARK(AssembleBlock);
+BENCHMARK(AssembleBlockNames);
+BENCHMARK(AssembleBlockChurnFull);
+BENCHMARK(AssembleBlockChurnIncremental);
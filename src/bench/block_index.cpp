@@ -0,0 +1,68 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <node/blockmap.h>
+#include <primitives/block.h>
+#include <random.h>
+
+#include <vector>
+
+namespace {
+
+/** Number of headers, about the size of the Namecoin block tree */
+constexpr int CHAIN_LENGTH{700'000};
+
+/** A chain of CHAIN_LENGTH headers stored in a BlockMap */
+struct BlockTree {
+    node::BlockMap map;
+    std::vector<CBlockIndex*> by_height;
+
+    BlockTree()
+    {
+        FastRandomContext rng{/*fDeterministic=*/true};
+        map.reserve(CHAIN_LENGTH);
+        by_height.reserve(CHAIN_LENGTH);
+        CBlockIndex* prev{nullptr};
+        for (int height = 0; height < CHAIN_LENGTH; ++height) {
+            const auto [it, inserted]{map.try_emplace(rng.rand256())};
+            CBlockIndex* pindex{&it->second};
+            pindex->phashBlock = &it->first;
+            pindex->pprev = prev;
+            pindex->nHeight = height;
+            pindex->BuildSkip();
+            by_height.push_back(pindex);
+            prev = pindex;
+        }
+    }
+};
+
+} // namespace
+
+static void BlockIndexGetAncestor(benchmark::Bench& bench)
+{
+    const BlockTree tree;
+    const CBlockIndex* tip{tree.by_height.back()};
+    FastRandomContext rng{/*fDeterministic=*/true};
+    bench.run([&] {
+        const CBlockIndex* ancestor{tip->GetAncestor(rng.randrange(CHAIN_LENGTH))};
+        ankerl::nanobench::doNotOptimizeAway(ancestor);
+    });
+}
+
+static void BlockIndexLocator(benchmark::Bench& bench)
+{
+    const BlockTree tree;
+    // As during header sync, the best header is ahead of the active chain.
+    CChain chain;
+    chain.SetTip(tree.by_height[CHAIN_LENGTH - 2001]);
+    bench.run([&] {
+        const CBlockLocator locator{chain.GetLocator(tree.by_height.back())};
+        ankerl::nanobench::doNotOptimizeAway(locator);
+    });
+}
+
+BENCHMARK(BlockIndexGetAncestor);
+BENCHMARK(BlockIndexLocator);
@@ -0,0 +1,76 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <blockencodings.h>
+#include <consensus/amount.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <vector>
+
+static CTransactionRef MakeUniqueTx(FastRandomContext& rng)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint{rng.rand256(), 0};
+    tx.vin[0].scriptWitness.stack.push_back({1});
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[0].nValue = COIN;
+    return MakeTransactionRef(tx);
+}
+
+// Reconstruct a compact block of 2500 transactions against a synthetic mempool
+// of 50000 transactions, 100 extra transactions and 25 missing transactions.
+static void BlockEncodingsInitData(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    constexpr size_t MEMPOOL_TXS{50000};
+    constexpr size_t BLOCK_TXS{2500};
+    constexpr size_t EXTRA_TXS{100};
+    constexpr size_t MISSING_TXS{25};
+
+    FastRandomContext rng{/*fDeterministic=*/true};
+    CTxMemPool pool;
+    std::vector<CTransactionRef> mempool_txs;
+    {
+        TestMemPoolEntryHelper entry;
+        LOCK2(cs_main, pool.cs);
+        for (size_t i = 0; i < MEMPOOL_TXS; ++i) {
+            mempool_txs.push_back(MakeUniqueTx(rng));
+            pool.addUnchecked(entry.FromTx(mempool_txs.back()));
+        }
+    }
+
+    CBlock block;
+    block.nBits = 0x207fffff;
+    block.vtx.push_back(MakeUniqueTx(rng));
+    // Distinct transactions, as a duplicate short ID makes InitData fail early.
+    std::vector<CTransactionRef> shuffled{mempool_txs};
+    Shuffle(shuffled.begin(), shuffled.end(), rng);
+    block.vtx.insert(block.vtx.end(), shuffled.begin(), shuffled.begin() + BLOCK_TXS);
+    std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+    for (size_t i = 0; i < EXTRA_TXS; ++i) {
+        const CTransactionRef tx{MakeUniqueTx(rng)};
+        extra_txn.emplace_back(tx->GetWitnessHash(), tx);
+        if (i % 4 == 0) block.vtx.push_back(tx);
+    }
+    for (size_t i = 0; i < MISSING_TXS; ++i) {
+        block.vtx.push_back(MakeUniqueTx(rng));
+    }
+    const CBlockHeaderAndShortTxIDs cmpctblock{block, /*fUseWTXID=*/true};
+
+    bench.run([&] {
+        PartiallyDownloadedBlock partial_block{&pool};
+        const ReadStatus status{partial_block.InitData(cmpctblock, extra_txn)};
+        assert(status == READ_STATUS_OK);
+    });
+}
+
+BENCHMARK(BlockEncodingsInitData);
@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
+#include <random.h>
 #include <wallet/coinselection.h>
 #include <wallet/spend.h>
 #include <wallet/wallet.h>
@@ -20,8 +21,10 @@ using wallet::CWalletTx;
 using wallet::CoinEligibilityFilter;
 using wallet::CoinSelectionParams;
 using wallet::CreateDummyWalletDatabase;
+using wallet::KnapsackSolver;
 using wallet::OutputGroup;
 using wallet::SelectCoinsBnB;
+using wallet::SelectCoinsSRD;
 using wallet::TxStateInactive;
 
 static void addCoin(const CAmount& nValue, const CWallet& wallet, std::vector<std::unique_ptr<CWalletTx>>& wtxs)
@@ -74,6 +77,38 @@ static void CoinSelection(benchmark::Bench& bench)
     });
 }
 
+// Coin selection in a wallet with 100k UTXOs of random values, paying at a
+// feerate so that effective values and waste matter.
+static void CoinSelectionLargeWallet(benchmark::Bench& bench)
+{
+    NodeContext node;
+    auto chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), "", gArgs, CreateDummyWalletDatabase());
+    std::vector<std::unique_ptr<CWalletTx>> wtxs;
+    LOCK(wallet.cs_wallet);
+
+    FastRandomContext rand{/*fDeterministic=*/true};
+    for (int i = 0; i < 100000; ++i) {
+        addCoin(COIN / 1000 + rand.randrange(COIN), wallet, wtxs);
+    }
+
+    std::vector<COutput> coins;
+    for (const auto& wtx : wtxs) {
+        coins.emplace_back(wallet, *wtx, 0 /* iIn */, 6 * 24 /* nDepthIn */, true /* spendable */, true /* solvable */, true /* safe */);
+        coins.back().nInputBytes = 68;
+    }
+
+    const CoinEligibilityFilter filter_standard(1, 6, 0);
+    const CoinSelectionParams coin_selection_params(/* change_output_size= */ 31,
+                                                    /* change_spend_size= */ 68, /* effective_feerate= */ CFeeRate(10000),
+                                                    /* long_term_feerate= */ CFeeRate(5000), /* discard_feerate= */ CFeeRate(3000),
+                                                    /* tx_noinputs_size= */ 72, /* avoid_partial= */ false);
+    bench.run([&] {
+        auto result = AttemptSelection(wallet, 10 * COIN, filter_standard, coins, coin_selection_params);
+        assert(result);
+    });
+}
+
 typedef std::set<CInputCoin> CoinSet;
 
 // Copied from src/wallet/test/coinselector_tests.cpp
@@ -114,5 +149,46 @@ static void BnBExhaustion(benchmark::Bench& bench)
     });
 }
 
+// 100k single-coin groups of random values, as coin selection sees them
+static std::vector<OutputGroup> make_large_pool()
+{
+    std::vector<OutputGroup> utxo_pool;
+    FastRandomContext rand{/*fDeterministic=*/true};
+    for (int i = 0; i < 100000; ++i) {
+        add_coin(COIN / 1000 + rand.randrange(COIN), i % 4, utxo_pool);
+    }
+    return utxo_pool;
+}
+
+static void BnBLargePool(benchmark::Bench& bench)
+{
+    const std::vector<OutputGroup> utxo_pool{make_large_pool()};
+    bench.run([&] {
+        SelectCoinsBnB(utxo_pool, 10 * COIN, COIN / 10000);
+    });
+}
+
+static void KnapsackLargePool(benchmark::Bench& bench)
+{
+    const std::vector<OutputGroup> utxo_pool{make_large_pool()};
+    bench.run([&] {
+        auto result = KnapsackSolver(utxo_pool, 10 * COIN);
+        assert(result);
+    });
+}
+
+static void SRDLargePool(benchmark::Bench& bench)
+{
+    const std::vector<OutputGroup> utxo_pool{make_large_pool()};
+    bench.run([&] {
+        auto result = SelectCoinsSRD(utxo_pool, 10 * COIN);
+        assert(result);
+    });
+}
+
 BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelectionLargeWallet);
 BENCHMARK(BnBExhaustion);
+BENCHMARK(BnBLargePool);
+BENCHMARK(KnapsackLargePool);
+BENCHMARK(SRDLargePool);
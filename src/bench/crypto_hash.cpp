@@ -90,6 +90,22 @@ static void SipHash_32b(benchmark::Bench& bench)
     });
 }
 
+static void SipHash_32b_Batch(benchmark::Bench& bench)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> vals(1024);
+    std::vector<const uint256*> ptrs;
+    for (uint256& val : vals) {
+        val = rng.rand256();
+        ptrs.push_back(&val);
+    }
+    std::vector<uint64_t> out(vals.size());
+    uint64_t k1 = 0;
+    bench.batch(vals.size()).unit("hash").run([&] {
+        SipHashUint256Batch(0, ++k1, ptrs.data(), out.data(), ptrs.size());
+    });
+}
+
 static void FastRandom_32bit(benchmark::Bench& bench)
 {
     FastRandomContext rng(true);
@@ -158,6 +174,7 @@ BENCHMARK(SHA3_256_1M);
 
 BENCHMARK(SHA256_32b);
 BENCHMARK(SipHash_32b);
+BENCHMARK(SipHash_32b_Batch);
 BENCHMARK(SHA256D64_1024);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -6,6 +6,8 @@
 #include <logging.h>
 #include <test/util/setup_common.h>
 
+#include <thread>
+#include <vector>
 
 static void Logging(benchmark::Bench& bench, const std::vector<const char*>& extra_args, const std::function<void()>& log)
 {
@@ -41,8 +43,43 @@ static void LoggingNoFile(benchmark::Bench& bench)
     });
 }
 
+static void LoggingContended(benchmark::Bench& bench, const std::vector<const char*>& extra_args)
+{
+    TestingSetup test_setup{
+        CBaseChainParams::REGTEST,
+        extra_args,
+    };
+
+    constexpr int THREADS{4};
+    constexpr int MESSAGES{100};
+    bench.batch(THREADS * MESSAGES).unit("message").run([&] {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < THREADS; ++i) {
+            threads.emplace_back([] {
+                for (int j = 0; j < MESSAGES; ++j) LogPrint(BCLog::NET, "%s\n", "test");
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    });
+}
+static void LoggingContendedSync(benchmark::Bench& bench)
+{
+    LoggingContended(bench, {"-logthreadnames=0", "-debug=net", "-logasync=0"});
+}
+static void LoggingContendedAsync(benchmark::Bench& bench)
+{
+    LoggingContended(bench, {"-logthreadnames=0", "-debug=net", "-logasync=1"});
+}
+static void LoggingContendedAsyncDrop(benchmark::Bench& bench)
+{
+    LoggingContended(bench, {"-logthreadnames=0", "-debug=net", "-logasync=1", "-logoverflow=drop"});
+}
+
 BENCHMARK(LoggingYoThreadNames);
 BENCHMARK(LoggingNoThreadNames);
 BENCHMARK(LoggingYoCategory);
 BENCHMARK(LoggingNoCategory);
 BENCHMARK(LoggingNoFile);
+BENCHMARK(LoggingContendedSync);
+BENCHMARK(LoggingContendedAsync);
+BENCHMARK(LoggingContendedAsyncDrop);
@@ -79,7 +79,7 @@ static std::vector<CTransactionRef> CreateOrderedCoins(FastRandomContext& det_ra
     return ordered_coins;
 }
 
-static void ComplexMemPool(benchmark::Bench& bench)
+static void RunComplexMemPool(benchmark::Bench& bench, bool cluster_mode)
 {
     FastRandomContext det_rand{true};
     int childTxs = 800;
@@ -88,7 +88,7 @@ static void ComplexMemPool(benchmark::Bench& bench)
     }
     std::vector<CTransactionRef> ordered_coins = CreateOrderedCoins(det_rand, childTxs, /* min_ancestors */ 1);
     const auto testing_setup = MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::MAIN);
-    CTxMemPool pool;
+    CTxMemPool pool(nullptr, 0, cluster_mode);
     LOCK2(cs_main, pool.cs);
     bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
         for (auto& tx : ordered_coins) {
@@ -99,6 +99,16 @@ static void ComplexMemPool(benchmark::Bench& bench)
     });
 }
 
+static void ComplexMemPool(benchmark::Bench& bench)
+{
+    RunComplexMemPool(bench, /*cluster_mode=*/false);
+}
+
+static void ComplexMemPoolClusterMode(benchmark::Bench& bench)
+{
+    RunComplexMemPool(bench, /*cluster_mode=*/true);
+}
+
 static void MempoolCheck(benchmark::Bench& bench)
 {
     FastRandomContext det_rand{true};
@@ -116,4 +126,5 @@ static void MempoolCheck(benchmark::Bench& bench)
 }
 
 BENCHMARK(ComplexMemPool);
+BENCHMARK(ComplexMemPoolClusterMode);
 BENCHMARK(MempoolCheck);
@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <net.h>
+#include <protocol.h>
+#include <span.h>
+#include <test/util/setup_common.h>
+#include <version.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+// Receive block-sized messages through the V1 transport in socket-read sized
+// chunks, handing each buffer back to the pool as message processing does.
+static void RunReceiveBlockMessages(benchmark::Bench& bench, bool pooled)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    constexpr size_t PAYLOAD_SIZE{1000000};
+    constexpr size_t MESSAGES{4};
+    constexpr size_t CHUNK_SIZE{0x10000};
+
+    CSerializedNetMsg msg;
+    msg.m_type = NetMsgType::BLOCK;
+    msg.data.resize(PAYLOAD_SIZE);
+    for (size_t i = 0; i < PAYLOAD_SIZE; ++i) msg.data[i] = i % 251;
+    std::vector<unsigned char> header;
+    V1TransportSerializer{}.prepareForTransport(msg, header);
+    std::vector<uint8_t> wire;
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        wire.insert(wire.end(), header.begin(), header.end());
+        wire.insert(wire.end(), msg.data.begin(), msg.data.end());
+    }
+
+    RecvBufferPool pool;
+    V1TransportDeserializer deserializer{Params(), /*node_id=*/0, SER_NETWORK, INIT_PROTO_VERSION, pooled ? &pool : nullptr};
+    bench.batch(wire.size()).unit("byte").run([&] {
+        for (size_t pos = 0; pos < wire.size(); pos += CHUNK_SIZE) {
+            Span<const uint8_t> chunk{Span{wire}.subspan(pos, std::min(CHUNK_SIZE, wire.size() - pos))};
+            while (!chunk.empty()) {
+                const int ret{deserializer.Read(chunk)};
+                assert(ret >= 0);
+                if (deserializer.Complete()) {
+                    bool reject{false};
+                    CNetMessage received{deserializer.GetMessage(std::chrono::microseconds{0}, reject)};
+                    assert(!reject && received.m_recv.size() == PAYLOAD_SIZE);
+                    if (pooled) pool.Put(std::move(received.m_recv));
+                }
+            }
+        }
+    });
+}
+
+static void P2PReceiveBlockMessages(benchmark::Bench& bench)
+{
+    RunReceiveBlockMessages(bench, /*pooled=*/true);
+}
+
+static void P2PReceiveBlockMessagesUnpooled(benchmark::Bench& bench)
+{
+    RunReceiveBlockMessages(bench, /*pooled=*/false);
+}
+
+BENCHMARK(P2PReceiveBlockMessages);
+BENCHMARK(P2PReceiveBlockMessagesUnpooled);
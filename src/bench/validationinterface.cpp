@@ -0,0 +1,92 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <test/util/setup_common.h>
+#include <validationinterface.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+/** Number of subscribers, e.g. a few wallets, indexes and ZMQ */
+constexpr int SUBSCRIBERS{8};
+/** Number of blocks connected per iteration */
+constexpr int BLOCKS{1000};
+
+struct BlockSubscriber final : public CValidationInterface {
+    size_t m_blocks{0};
+    void BlockConnected(const std::shared_ptr<const CBlock>&, const CBlockIndex*) override { ++m_blocks; }
+};
+
+struct TransactionSubscriber final : public CValidationInterface {
+    size_t m_txs{0};
+    void TransactionAddedToMempool(const CTransactionRef&, uint64_t) override { ++m_txs; }
+};
+
+} // namespace
+
+// Queue and deliver the BlockConnected and UpdatedBlockTip events of connecting
+// BLOCKS blocks, as during initial block download.
+static void ValidationInterfaceBlockConnected(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    std::vector<std::shared_ptr<BlockSubscriber>> subscribers;
+    for (int i = 0; i < SUBSCRIBERS; ++i) {
+        subscribers.push_back(std::make_shared<BlockSubscriber>());
+        RegisterSharedValidationInterface(subscribers.back());
+    }
+
+    const auto block{std::make_shared<const CBlock>()};
+    std::vector<CBlockIndex> indexes(BLOCKS);
+    std::vector<uint256> hashes(BLOCKS);
+    for (int i = 0; i < BLOCKS; ++i) {
+        indexes[i].phashBlock = &hashes[i];
+        indexes[i].nHeight = i;
+        indexes[i].pprev = i > 0 ? &indexes[i - 1] : nullptr;
+    }
+
+    bench.run([&] {
+        for (const CBlockIndex& index : indexes) {
+            GetMainSignals().BlockConnected(block, &index);
+            GetMainSignals().UpdatedBlockTip(&index, index.pprev, /*fInitialDownload=*/true);
+        }
+        SyncWithValidationInterfaceQueue();
+    });
+
+    for (const auto& subscriber : subscribers) {
+        UnregisterSharedValidationInterface(subscriber);
+    }
+}
+
+// Queue and deliver TransactionAddedToMempool events, which are not batched.
+static void ValidationInterfaceTransactionAdded(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    std::vector<std::shared_ptr<TransactionSubscriber>> subscribers;
+    for (int i = 0; i < SUBSCRIBERS; ++i) {
+        subscribers.push_back(std::make_shared<TransactionSubscriber>());
+        RegisterSharedValidationInterface(subscribers.back());
+    }
+
+    const CTransactionRef tx{MakeTransactionRef(CMutableTransaction{})};
+    uint64_t sequence{0};
+    bench.run([&] {
+        for (int i = 0; i < BLOCKS; ++i) {
+            GetMainSignals().TransactionAddedToMempool(tx, ++sequence);
+        }
+        SyncWithValidationInterfaceQueue();
+    });
+
+    for (const auto& subscriber : subscribers) {
+        UnregisterSharedValidationInterface(subscriber);
+    }
+}
+
+BENCHMARK(ValidationInterfaceBlockConnected);
+BENCHMARK(ValidationInterfaceTransactionAdded);
@@ -5,6 +5,8 @@
 #include <bench/bench.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
+#include <random.h>
+#include <script/standard.h>
 #include <test/util/mining.h>
 #include <test/util/setup_common.h>
 #include <test/util/wallet.h>
@@ -13,11 +15,14 @@
 #include <wallet/wallet.h>
 
 #include <optional>
+#include <vector>
 
 using wallet::CWallet;
 using wallet::CreateMockWalletDatabase;
 using wallet::DBErrors;
+using wallet::DescriptorScriptPubKeyMan;
 using wallet::GetBalance;
+using wallet::ISMINE_NO;
 using wallet::WALLET_FLAG_DESCRIPTORS;
 
 static void WalletBalance(benchmark::Bench& bench, const bool set_dirty, const bool add_mine)
@@ -61,3 +66,38 @@ BENCHMARK(WalletBalanceDirty);
 BENCHMARK(WalletBalanceClean);
 BENCHMARK(WalletBalanceMine);
 BENCHMARK(WalletBalanceWatch);
+
+static void WalletIsMine(benchmark::Bench& bench, const bool mine)
+{
+    const auto test_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    CWallet wallet{test_setup->m_node.chain.get(), "", gArgs, CreateMockWalletDatabase()};
+    LOCK(wallet.cs_wallet);
+    wallet.SetWalletFlag(WALLET_FLAG_DESCRIPTORS);
+    wallet.SetupDescriptorScriptPubKeyMans();
+    if (wallet.LoadWallet() != DBErrors::LOAD_OK) assert(false);
+
+    std::vector<CScript> scripts;
+    if (mine) {
+        const auto spk_man = static_cast<DescriptorScriptPubKeyMan*>(wallet.GetScriptPubKeyMan(OutputType::BECH32, /*internal=*/false));
+        scripts = spk_man->GetScriptPubKeys();
+    } else {
+        FastRandomContext rng{/*fDeterministic=*/true};
+        for (int i = 0; i < 1000; ++i) {
+            scripts.push_back(GetScriptForDestination(WitnessV0KeyHash(uint160(rng.randbytes(20)))));
+        }
+    }
+
+    bench.batch(scripts.size()).unit("script").run([&] {
+        for (const CScript& script : scripts) {
+            const bool is_mine{wallet.IsMine(script) != ISMINE_NO};
+            assert(is_mine == mine);
+        }
+    });
+}
+
+static void WalletIsMineOwn(benchmark::Bench& bench) { WalletIsMine(bench, /*mine=*/true); }
+static void WalletIsMineForeign(benchmark::Bench& bench) { WalletIsMine(bench, /*mine=*/false); }
+
+BENCHMARK(WalletIsMineOwn);
+BENCHMARK(WalletIsMineForeign);
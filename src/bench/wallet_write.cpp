@@ -0,0 +1,59 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <fs.h>
+#include <test/util/setup_common.h>
+#include <util/system.h>
+#include <util/translation.h>
+#include <wallet/db.h>
+#include <wallet/walletdb.h>
+
+#include <cassert>
+#include <vector>
+
+using wallet::DatabaseFormat;
+using wallet::DatabaseOptions;
+using wallet::DatabaseStatus;
+using wallet::MakeDatabase;
+
+/** Number of transaction records written between two flushes, like during a rescan */
+static constexpr int RECORDS_PER_FLUSH{100};
+
+static void WalletWriteTxs(benchmark::Bench& bench, const bool lazy_sync)
+{
+    const auto test_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    gArgs.ForceSetArg("-walletlazysync", lazy_sync ? "1" : "0");
+
+    DatabaseOptions options;
+    options.require_create = true;
+    options.require_format = DatabaseFormat::SQLITE;
+    DatabaseStatus status;
+    bilingual_str error;
+    const auto database{MakeDatabase(test_setup->m_path_root / "wallet", options, status, error)};
+    assert(database);
+
+    // A typical transaction record is a few hundred bytes
+    const std::vector<unsigned char> tx_data(300, 0x42);
+    uint64_t n{0};
+
+    bench.batch(RECORDS_PER_FLUSH).unit("record").run([&] {
+        for (int i = 0; i < RECORDS_PER_FLUSH; ++i) {
+            // Like CWallet::AddToWallet, use a new batch for each transaction
+            const auto batch{database->MakeBatch()};
+            const bool ok{batch->WriteNonCritical(std::make_pair(wallet::DBKeys::TX, ArithToUint256(++n)), tx_data)};
+            assert(ok);
+        }
+        database->Flush();
+    });
+
+    gArgs.ForceSetArg("-walletlazysync", "0");
+}
+
+static void WalletWriteTxsSynced(benchmark::Bench& bench) { WalletWriteTxs(bench, /*lazy_sync=*/false); }
+static void WalletWriteTxsLazy(benchmark::Bench& bench) { WalletWriteTxs(bench, /*lazy_sync=*/true); }
+
+BENCHMARK(WalletWriteTxsSynced);
+BENCHMARK(WalletWriteTxsLazy);
@@ -68,7 +68,7 @@ int main(int argc, char* argv[])
     // Gather some entropy once per minute.
     scheduler.scheduleEvery(RandAddPeriodic, std::chrono::minutes{1});
 
-    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    GetMainSignals().StartBackgroundCallbacks();
 
 
     // SETUP: Chainstate
@@ -255,7 +255,7 @@ epilogue:
             }
         }
     }
-    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().DropBackgroundCallbacks();
 
     WITH_LOCK(::cs_main, UnloadBlockIndex(nullptr, chainman));
 
@@ -14,7 +14,9 @@
 #include <validation.h>
 #include <util/system.h>
 
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <limits>
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
@@ -44,6 +46,96 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
 }
 
+void CBlockHeaderAndShortTxIDs::GetShortIDs(const uint256* const* txhashes, uint64_t* out, size_t count) const {
+    SipHashUint256Batch(shorttxidk0, shorttxidk1, txhashes, out, count);
+    for (size_t i = 0; i < count; i++) {
+        out[i] &= 0xffffffffffffL;
+    }
+}
+
+namespace {
+/**
+ * Flat open-addressing (linear probing) map from short ID to position in the
+ * block, sized from the number of short IDs in the block.
+ *
+ * Short IDs are chosen by the sending peer, so slots are picked with a
+ * randomly salted hash of the short ID, and the length of any probe sequence
+ * is bounded by MAX_PROBE.
+ */
+class ShortIdTable
+{
+public:
+    //! Longest probe sequence accepted on insertion. With the load factor kept at
+    //! or below 1/4, honest blocks exceed it with negligible probability.
+    static constexpr size_t MAX_PROBE{64};
+
+    enum class InsertResult { OK, DUPLICATE, OVERFULL };
+
+    explicit ShortIdTable(size_t count) : m_salt{GetRand(std::numeric_limits<uint64_t>::max())}
+    {
+        int bits{2};
+        while ((size_t{1} << bits) < count * 4) bits++;
+        m_slots.resize(size_t{1} << bits);
+        m_shift = 64 - bits;
+    }
+
+    InsertResult Insert(uint64_t shortid, uint16_t index)
+    {
+        size_t pos{Home(shortid)};
+        for (size_t probe = 0; probe <= MAX_PROBE; probe++) {
+            Slot& slot{m_slots[pos]};
+            if (slot.shortid == EMPTY) {
+                slot = {shortid, index};
+                m_max_probe = std::max(m_max_probe, probe);
+                m_size++;
+                return InsertResult::OK;
+            }
+            if (slot.shortid == shortid) return InsertResult::DUPLICATE;
+            pos = (pos + 1) & (m_slots.size() - 1);
+        }
+        return InsertResult::OVERFULL;
+    }
+
+    //! Return the position of the transaction with this short ID, or nullptr.
+    const uint16_t* Find(uint64_t shortid) const
+    {
+        size_t pos{Home(shortid)};
+        for (size_t probe = 0; probe <= m_max_probe; probe++) {
+            const Slot& slot{m_slots[pos]};
+            if (slot.shortid == shortid) return &slot.index;
+            if (slot.shortid == EMPTY) return nullptr;
+            pos = (pos + 1) & (m_slots.size() - 1);
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    //! Short IDs have 48 bits, so this never matches a real one.
+    static constexpr uint64_t EMPTY{std::numeric_limits<uint64_t>::max()};
+
+    struct Slot {
+        uint64_t shortid{EMPTY};
+        uint16_t index{0};
+    };
+
+    std::vector<Slot> m_slots;
+    const uint64_t m_salt;
+    int m_shift;
+    size_t m_max_probe{0};
+    size_t m_size{0};
+
+    size_t Home(uint64_t shortid) const
+    {
+        return ((shortid ^ m_salt) * 0x9E3779B97F4A7C15ULL) >> m_shift;
+    }
+};
+
+//! Number of short IDs computed together when scanning the mempool and extra pool.
+constexpr size_t SHORTID_BATCH_SIZE{64};
+} // namespace
+
 
 
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
@@ -78,88 +170,90 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     // Because well-formed cmpctblock messages will have a (relatively) uniform distribution
     // of short IDs, any highly-uneven distribution of elements can be safely treated as a
     // READ_STATUS_FAILED.
-    std::unordered_map<uint64_t, uint16_t> shorttxids(cmpctblock.shorttxids.size());
+    ShortIdTable shorttxids(cmpctblock.shorttxids.size());
     uint16_t index_offset = 0;
     for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
         while (txn_available[i + index_offset])
             index_offset++;
-        shorttxids[cmpctblock.shorttxids[i]] = i + index_offset;
-        // To determine the chance that the number of entries in a bucket exceeds N,
-        // we use the fact that the number of elements in a single bucket is
-        // binomially distributed (with n = the number of shorttxids S, and p =
-        // 1 / the number of buckets), that in the worst case the number of buckets is
-        // equal to S (due to std::unordered_map having a default load factor of 1.0),
-        // and that the chance for any bucket to exceed N elements is at most
-        // buckets * (the chance that any given bucket is above N elements).
-        // Thus: P(max_elements_per_bucket > N) <= S * (1 - cdf(binomial(n=S,p=1/S), N)).
-        // If we assume blocks of up to 16000, allowing 12 elements per bucket should
-        // only fail once per ~1 million block transfers (per peer and connection).
-        if (shorttxids.bucket_size(shorttxids.bucket(cmpctblock.shorttxids[i])) > 12)
-            return READ_STATUS_FAILED;
+        // TODO: in the shortid-collision case, we should instead request both transactions
+        // which collided. Falling back to full-block-request here is overkill.
+        if (shorttxids.Insert(cmpctblock.shorttxids[i], i + index_offset) != ShortIdTable::InsertResult::OK)
+            return READ_STATUS_FAILED; // Short ID collision or uneven distribution
     }
-    // TODO: in the shortid-collision case, we should instead request both transactions
-    // which collided. Falling back to full-block-request here is overkill.
-    if (shorttxids.size() != cmpctblock.shorttxids.size())
-        return READ_STATUS_FAILED; // Short ID collision
 
     std::vector<bool> have_txn(txn_available.size());
+    std::array<const uint256*, SHORTID_BATCH_SIZE> batch_hashes;
+    std::array<uint64_t, SHORTID_BATCH_SIZE> batch_shortids;
     {
     LOCK(pool->cs);
-    for (size_t i = 0; i < pool->vTxHashes.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(pool->vTxHashes[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = pool->vTxHashes[i].second->GetSharedTx();
-                have_txn[idit->second]  = true;
-                mempool_count++;
-            } else {
-                // If we find two mempool txn that match the short id, just request it.
-                // This should be rare enough that the extra bandwidth doesn't matter,
-                // but eating a round-trip due to FillBlock failure would be annoying
-                if (txn_available[idit->second]) {
-                    txn_available[idit->second].reset();
-                    mempool_count--;
+    for (size_t begin = 0; begin < pool->vTxHashes.size() && mempool_count < shorttxids.size(); begin += SHORTID_BATCH_SIZE) {
+        const size_t batch_size = std::min(SHORTID_BATCH_SIZE, pool->vTxHashes.size() - begin);
+        for (size_t j = 0; j < batch_size; j++) {
+            batch_hashes[j] = &pool->vTxHashes[begin + j].first;
+        }
+        cmpctblock.GetShortIDs(batch_hashes.data(), batch_shortids.data(), batch_size);
+        for (size_t j = 0; j < batch_size; j++) {
+            const uint16_t* idit = shorttxids.Find(batch_shortids[j]);
+            if (idit) {
+                if (!have_txn[*idit]) {
+                    txn_available[*idit] = pool->vTxHashes[begin + j].second->GetSharedTx();
+                    have_txn[*idit]  = true;
+                    mempool_count++;
+                } else {
+                    // If we find two mempool txn that match the short id, just request it.
+                    // This should be rare enough that the extra bandwidth doesn't matter,
+                    // but eating a round-trip due to FillBlock failure would be annoying
+                    if (txn_available[*idit]) {
+                        txn_available[*idit].reset();
+                        mempool_count--;
+                    }
                 }
             }
+            // Though ideally we'd continue scanning for the two-txn-match-shortid case,
+            // the performance win of an early exit here is too good to pass up and worth
+            // the extra risk.
+            if (mempool_count == shorttxids.size())
+                break;
         }
-        // Though ideally we'd continue scanning for the two-txn-match-shortid case,
-        // the performance win of an early exit here is too good to pass up and worth
-        // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
     }
     }
 
-    for (size_t i = 0; i < extra_txn.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(extra_txn[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = extra_txn[i].second;
-                have_txn[idit->second]  = true;
-                mempool_count++;
-                extra_count++;
-            } else {
-                // If we find two mempool/extra txn that match the short id, just
-                // request it.
-                // This should be rare enough that the extra bandwidth doesn't matter,
-                // but eating a round-trip due to FillBlock failure would be annoying
-                // Note that we don't want duplication between extra_txn and mempool to
-                // trigger this case, so we compare witness hashes first
-                if (txn_available[idit->second] &&
-                        txn_available[idit->second]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
-                    txn_available[idit->second].reset();
-                    mempool_count--;
-                    extra_count--;
+    for (size_t begin = 0; begin < extra_txn.size() && mempool_count < shorttxids.size(); begin += SHORTID_BATCH_SIZE) {
+        const size_t batch_size = std::min(SHORTID_BATCH_SIZE, extra_txn.size() - begin);
+        for (size_t j = 0; j < batch_size; j++) {
+            batch_hashes[j] = &extra_txn[begin + j].first;
+        }
+        cmpctblock.GetShortIDs(batch_hashes.data(), batch_shortids.data(), batch_size);
+        for (size_t j = 0; j < batch_size; j++) {
+            const auto& [extra_hash, extra_tx] = extra_txn[begin + j];
+            const uint16_t* idit = shorttxids.Find(batch_shortids[j]);
+            if (idit) {
+                if (!have_txn[*idit]) {
+                    txn_available[*idit] = extra_tx;
+                    have_txn[*idit]  = true;
+                    mempool_count++;
+                    extra_count++;
+                } else {
+                    // If we find two mempool/extra txn that match the short id, just
+                    // request it.
+                    // This should be rare enough that the extra bandwidth doesn't matter,
+                    // but eating a round-trip due to FillBlock failure would be annoying
+                    // Note that we don't want duplication between extra_txn and mempool to
+                    // trigger this case, so we compare witness hashes first
+                    if (txn_available[*idit] &&
+                            txn_available[*idit]->GetWitnessHash() != extra_tx->GetWitnessHash()) {
+                        txn_available[*idit].reset();
+                        mempool_count--;
+                        extra_count--;
+                    }
                 }
             }
+            // Though ideally we'd continue scanning for the two-txn-match-shortid case,
+            // the performance win of an early exit here is too good to pass up and worth
+            // the extra risk.
+            if (mempool_count == shorttxids.size())
+                break;
         }
-        // Though ideally we'd continue scanning for the two-txn-match-shortid case,
-        // the performance win of an early exit here is too good to pass up and worth
-        // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
     }
 
     LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, PROTOCOL_VERSION));
@@ -107,6 +107,8 @@ public:
     CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
 
     uint64_t GetShortID(const uint256& txhash) const;
+    /** Compute out[i] = GetShortID(*txhashes[i]) for i in [0, count). */
+    void GetShortIDs(const uint256* const* txhashes, uint64_t* out, size_t count) const;
 
     size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
 
@@ -11,6 +11,7 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
 template <typename T>
@@ -139,8 +140,8 @@ public:
     {
     }
 
-    //! Create a pool of new worker threads.
-    void StartWorkerThreads(const int threads_num)
+    //! Create a pool of new worker threads, named after thread_name.
+    void StartWorkerThreads(const int threads_num, const std::string& thread_name = "scriptch")
     {
         {
             LOCK(m_mutex);
@@ -150,8 +151,8 @@ public:
         }
         assert(m_worker_threads.empty());
         for (int n = 0; n < threads_num; ++n) {
-            m_worker_threads.emplace_back([this, n]() {
-                util::ThreadRename(strprintf("scriptch.%i", n));
+            m_worker_threads.emplace_back([this, n, thread_name]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
                 SetSyscallSandboxPolicy(SyscallSandboxPolicy::VALIDATION_SCRIPT_CHECK);
                 Loop(false /* worker thread */);
             });
@@ -0,0 +1,115 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <cluster_linearize.h>
+
+#include <cassert>
+#include <optional>
+
+namespace cluster_linearize {
+
+std::vector<uint32_t> Linearize(const std::vector<ClusterTx>& cluster)
+{
+    const size_t n = cluster.size();
+
+    // Find a topological order first (Kahn's algorithm).
+    std::vector<std::vector<uint32_t>> children(n);
+    std::vector<size_t> num_parents(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        for (const uint32_t p : cluster[i].parents) {
+            children[p].push_back(i);
+        }
+        num_parents[i] = cluster[i].parents.size();
+    }
+    std::vector<uint32_t> topo;
+    topo.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (num_parents[i] == 0) topo.push_back(i);
+    }
+    for (size_t k = 0; k < topo.size(); ++k) {
+        for (const uint32_t c : children[topo[k]]) {
+            if (--num_parents[c] == 0) topo.push_back(c);
+        }
+    }
+    assert(topo.size() == n);
+
+    if (n > MAX_CLUSTER_LINEARIZATION_SIZE) return topo;
+
+    // Ancestor sets, built in topological order so that parents are complete.
+    std::vector<std::vector<bool>> ancestors(n, std::vector<bool>(n, false));
+    for (const uint32_t i : topo) {
+        for (const uint32_t p : cluster[i].parents) {
+            ancestors[i][p] = true;
+            for (uint32_t j = 0; j < n; ++j) {
+                if (ancestors[p][j]) ancestors[i][j] = true;
+            }
+        }
+    }
+
+    // Feerate of every transaction together with its not yet linearized
+    // ancestors, and the descendants to update when a transaction is picked.
+    std::vector<std::vector<uint32_t>> descendants(n);
+    std::vector<CAmount> anc_fee(n);
+    std::vector<int64_t> anc_size(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        anc_fee[i] = cluster[i].fee;
+        anc_size[i] = cluster[i].size;
+        for (uint32_t j = 0; j < n; ++j) {
+            if (!ancestors[i][j]) continue;
+            descendants[j].push_back(i);
+            anc_fee[i] += cluster[j].fee;
+            anc_size[i] += cluster[j].size;
+        }
+    }
+
+    std::vector<uint32_t> linearization;
+    linearization.reserve(n);
+    std::vector<bool> done(n, false);
+    while (linearization.size() < n) {
+        std::optional<uint32_t> best;
+        for (const uint32_t i : topo) {
+            if (done[i]) continue;
+            if (!best || FeerateHigher(anc_fee[i], anc_size[i], anc_fee[*best], anc_size[*best])) {
+                best = i;
+            }
+        }
+        assert(best);
+
+        for (const uint32_t i : topo) {
+            if (done[i] || (i != *best && !ancestors[*best][i])) continue;
+            done[i] = true;
+            linearization.push_back(i);
+            for (const uint32_t d : descendants[i]) {
+                if (done[d]) continue;
+                anc_fee[d] -= cluster[i].fee;
+                anc_size[d] -= cluster[i].size;
+            }
+        }
+    }
+
+    return linearization;
+}
+
+std::vector<Chunk> ChunkLinearization(const std::vector<ClusterTx>& cluster, const std::vector<uint32_t>& linearization)
+{
+    std::vector<Chunk> chunks;
+    for (const uint32_t i : linearization) {
+        Chunk chunk;
+        chunk.txs.push_back(i);
+        chunk.fee = cluster[i].fee;
+        chunk.size = cluster[i].size;
+        while (!chunks.empty() && FeerateHigher(chunk.fee, chunk.size, chunks.back().fee, chunks.back().size)) {
+            Chunk& prev = chunks.back();
+            prev.txs.insert(prev.txs.end(), chunk.txs.begin(), chunk.txs.end());
+            prev.fee += chunk.fee;
+            prev.size += chunk.size;
+            chunk = std::move(prev);
+            chunks.pop_back();
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    return chunks;
+}
+
+} // namespace cluster_linearize
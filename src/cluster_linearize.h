@@ -0,0 +1,95 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CLUSTER_LINEARIZE_H
+#define BITCOIN_CLUSTER_LINEARIZE_H
+
+#include <consensus/amount.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Linearization of transaction clusters.
+ *
+ * A cluster is a set of mempool transactions that are connected through
+ * spending relations.  A linearization is a topologically valid order of a
+ * cluster's transactions; splitting it into chunks of decreasing feerate
+ * gives the order in which the cluster should be mined, and its last chunk
+ * is the part that should be evicted first.
+ */
+namespace cluster_linearize {
+
+/** Clusters larger than this are linearized in topological order only */
+static constexpr size_t MAX_CLUSTER_LINEARIZATION_SIZE{1000};
+
+/** A transaction in a cluster, with its parents given as indices into the cluster */
+struct ClusterTx {
+    CAmount fee;
+    int64_t size;
+    std::vector<uint32_t> parents;
+};
+
+/** A set of transactions (indices into the cluster, in linearization order) that are mined or evicted together */
+struct Chunk {
+    std::vector<uint32_t> txs;
+    CAmount fee{0};
+    int64_t size{0};
+};
+
+/** Return whether the feerate fee_a/size_a is strictly higher than fee_b/size_b. Sizes must not be negative. */
+inline bool FeerateHigher(CAmount fee_a, int64_t size_a, CAmount fee_b, int64_t size_b)
+{
+    // Avoid division by rewriting (a/b > c/d) as (a*d > c*b). The products
+    // need 128 bits; rounding them (e.g. to doubles) would break the strict
+    // weak ordering that sorting by feerate relies on.
+#ifdef __SIZEOF_INT128__
+    return static_cast<__int128>(fee_a) * size_b > static_cast<__int128>(fee_b) * size_a;
+#else
+    const bool neg_a{fee_a < 0};
+    const bool neg_b{fee_b < 0};
+    if (neg_a != neg_b) {
+        // One product is negative, the other one non-negative.
+        return neg_b && !((fee_a == 0 || size_b == 0) && size_a == 0);
+    }
+    // Compare the magnitudes |fee_a| * size_b and |fee_b| * size_a, split into
+    // 32-bit halves.
+    const auto mul = [](uint64_t x, uint64_t y) {
+        const uint64_t x_hi = x >> 32;
+        const uint64_t x_lo = x & 0xFFFFFFFF;
+        const uint64_t y_hi = y >> 32;
+        const uint64_t y_lo = y & 0xFFFFFFFF;
+        const uint64_t lo_lo = x_lo * y_lo;
+        const uint64_t lo_hi = x_lo * y_hi;
+        const uint64_t hi_lo = x_hi * y_lo;
+        const uint64_t mid = (lo_lo >> 32) + (lo_hi & 0xFFFFFFFF) + (hi_lo & 0xFFFFFFFF);
+        return std::make_pair(x_hi * y_hi + (lo_hi >> 32) + (hi_lo >> 32) + (mid >> 32), (mid << 32) | (lo_lo & 0xFFFFFFFF));
+    };
+    const auto abs = [](CAmount fee) { return fee < 0 ? uint64_t{0} - static_cast<uint64_t>(fee) : static_cast<uint64_t>(fee); };
+    const auto product_a = mul(abs(fee_a), static_cast<uint64_t>(size_b));
+    const auto product_b = mul(abs(fee_b), static_cast<uint64_t>(size_a));
+    return neg_a ? product_a < product_b : product_a > product_b;
+#endif
+}
+
+/**
+ * Linearize a cluster by repeatedly picking the remaining transaction with the
+ * highest feerate including its not yet picked ancestors, and appending those
+ * ancestors and the transaction itself.  Runs in O(n^2).
+ * Returns the linearization as indices into the cluster.
+ */
+std::vector<uint32_t> Linearize(const std::vector<ClusterTx>& cluster);
+
+/**
+ * Split a linearization into chunks, merging every chunk with its predecessor
+ * as long as that increases the predecessor's feerate.  The resulting chunks
+ * have monotonically decreasing feerates.
+ */
+std::vector<Chunk> ChunkLinearization(const std::vector<ClusterTx>& cluster, const std::vector<uint32_t>& linearization);
+
+} // namespace cluster_linearize
+
+#endif // BITCOIN_CLUSTER_LINEARIZE_H
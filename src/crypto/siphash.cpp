@@ -171,3 +171,63 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace {
+constexpr size_t SIPHASH_LANES{4};
+
+/** SipHash states of SIPHASH_LANES independent computations. */
+struct SipHashLanes {
+    uint64_t v0[SIPHASH_LANES];
+    uint64_t v1[SIPHASH_LANES];
+    uint64_t v2[SIPHASH_LANES];
+    uint64_t v3[SIPHASH_LANES];
+
+    void Round()
+    {
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            uint64_t v0 = this->v0[l], v1 = this->v1[l], v2 = this->v2[l], v3 = this->v3[l];
+            SIPROUND;
+            this->v0[l] = v0; this->v1[l] = v1; this->v2[l] = v2; this->v3[l] = v3;
+        }
+    }
+};
+} // namespace
+
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t count)
+{
+    size_t i = 0;
+    for (; i + SIPHASH_LANES <= count; i += SIPHASH_LANES) {
+        SipHashLanes s;
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            s.v0[l] = 0x736f6d6570736575ULL ^ k0;
+            s.v1[l] = 0x646f72616e646f6dULL ^ k1;
+            s.v2[l] = 0x6c7967656e657261ULL ^ k0;
+            s.v3[l] = 0x7465646279746573ULL ^ k1;
+        }
+        for (int word = 0; word < 4; ++word) {
+            uint64_t d[SIPHASH_LANES];
+            for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+                d[l] = vals[i + l]->GetUint64(word);
+                s.v3[l] ^= d[l];
+            }
+            s.Round();
+            s.Round();
+            for (size_t l = 0; l < SIPHASH_LANES; ++l) s.v0[l] ^= d[l];
+        }
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) s.v3[l] ^= ((uint64_t)4) << 59;
+        s.Round();
+        s.Round();
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) {
+            s.v0[l] ^= ((uint64_t)4) << 59;
+            s.v2[l] ^= 0xFF;
+        }
+        s.Round();
+        s.Round();
+        s.Round();
+        s.Round();
+        for (size_t l = 0; l < SIPHASH_LANES; ++l) out[i + l] = s.v0[l] ^ s.v1[l] ^ s.v2[l] ^ s.v3[l];
+    }
+    for (; i < count; ++i) {
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
+    }
+}
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_CRYPTO_SIPHASH_H
 #define BITCOIN_CRYPTO_SIPHASH_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <uint256.h>
@@ -44,4 +45,11 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Compute out[i] = SipHashUint256(k0, k1, *vals[i]) for i in [0, count).
+ *
+ *  Several hashes are computed in lockstep, so that their independent rounds
+ *  can overlap in the CPU pipeline or be vectorized by the compiler.
+ */
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t count);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
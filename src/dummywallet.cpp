@@ -45,10 +45,12 @@ void DummyWalletInit::AddWalletOptions(ArgsManager& argsman) const
         "-walletbroadcast",
         "-walletdir=<dir>",
         "-walletnotify=<cmd>",
+        "-walletlazysync",
         "-walletrbf",
         "-dblogsize=<n>",
         "-flushwallet",
         "-privdb",
+        "-walletcheckbalance",
         "-walletrejectlongchains",
         "-unsafesqlitesync",
     });
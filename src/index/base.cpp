@@ -240,18 +240,14 @@ bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_ti
     return true;
 }
 
-void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+bool BaseIndex::ConnectsToBestBlock(const CBlockIndex* pindex)
 {
-    if (!m_synced) {
-        return;
-    }
-
     const CBlockIndex* best_block_index = m_best_block_index.load();
     if (!best_block_index) {
         if (pindex->nHeight != 0) {
             FatalError("%s: First block connected is not the genesis block (height=%d)",
                        __func__, pindex->nHeight);
-            return;
+            return false;
         }
     } else {
         // Ensure block connects to an ancestor of the current best block. This should be the case
@@ -264,14 +260,26 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
                       "known best chain (tip=%s); not updating index\n",
                       __func__, pindex->GetBlockHash().ToString(),
                       best_block_index->GetBlockHash().ToString());
-            return;
+            return false;
         }
         if (best_block_index != pindex->pprev && !Rewind(best_block_index, pindex->pprev)) {
             FatalError("%s: Failed to rewind index %s to a previous chain tip",
                        __func__, GetName());
-            return;
+            return false;
         }
     }
+    return true;
+}
+
+void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    if (!ConnectsToBestBlock(pindex)) {
+        return;
+    }
 
     if (WriteBlock(*block, pindex)) {
         m_best_block_index = pindex;
@@ -282,6 +290,42 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
     }
 }
 
+void BaseIndex::BlocksConnected(Span<const ConnectedBlock> blocks)
+{
+    // Only a run of blocks that extend each other can be written at once.
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        if (blocks[i].pindex->pprev != blocks[i - 1].pindex) {
+            CValidationInterface::BlocksConnected(blocks);
+            return;
+        }
+    }
+
+    if (!m_synced) {
+        return;
+    }
+
+    if (!ConnectsToBestBlock(blocks.front().pindex)) {
+        return;
+    }
+
+    if (WriteBlocks(blocks)) {
+        m_best_block_index = blocks.back().pindex;
+    } else {
+        FatalError("%s: Failed to write blocks %s to %s to index",
+                   __func__, blocks.front().pindex->GetBlockHash().ToString(),
+                   blocks.back().pindex->GetBlockHash().ToString());
+        return;
+    }
+}
+
+bool BaseIndex::WriteBlocks(Span<const ConnectedBlock> blocks)
+{
+    for (const ConnectedBlock& connected : blocks) {
+        if (!WriteBlock(*connected.block, connected.pindex)) return false;
+    }
+    return true;
+}
+
 void BaseIndex::ChainStateFlushed(const CBlockLocator& locator)
 {
     if (!m_synced) {
@@ -355,7 +399,7 @@ bool BaseIndex::Start(CChainState& active_chainstate)
     m_chainstate = &active_chainstate;
     // Need to register this ValidationInterface before running Init(), so that
     // callbacks are not missed if Init sets m_synced to true.
-    RegisterValidationInterface(this);
+    RegisterValidationInterface(this, GetName());
     if (!Init()) {
         return false;
     }
@@ -78,8 +78,14 @@ private:
 protected:
     CChainState* m_chainstate{nullptr};
 
+    /// Check that pindex extends the current best block, rewinding the index if it
+    /// extends one of its ancestors instead.
+    bool ConnectsToBestBlock(const CBlockIndex* pindex);
+
     void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
 
+    void BlocksConnected(Span<const ConnectedBlock> blocks) override;
+
     void ChainStateFlushed(const CBlockLocator& locator) override;
 
     const CBlockIndex* CurrentIndex() { return m_best_block_index.load(); };
@@ -90,6 +96,10 @@ protected:
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Write update index entries for a run of newly connected blocks, each
+    /// extending the one before. Defaults to calling WriteBlock for each of them.
+    virtual bool WriteBlocks(Span<const ConnectedBlock> blocks);
+
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
     virtual bool CommitInternal(CDBBatch& batch);
@@ -3,10 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <map>
+#include <optional>
 
 #include <dbwrapper.h>
 #include <index/blockfilterindex.h>
 #include <node/blockstorage.h>
+#include <script/names.h>
 #include <util/system.h>
 
 using node::UndoReadFromDisk;
@@ -25,6 +27,11 @@ using node::UndoReadFromDisk;
  * Keys for the height index have the type [DB_BLOCK_HEIGHT, uint32 (BE)]. The height is represented
  * as big-endian so that sequential reads of filters by height are fast.
  * Keys for the hash index have the type [DB_BLOCK_HASH, uint256].
+ *
+ * The filter only holds full name scripts, but wallets match it against the address scripts inside
+ * them. Entries written by this version therefore also record whether the block creates or spends
+ * any name scripts and, if so, a second filter with the same parameters over the address scripts
+ * of those name scripts. Entries of older indexes lack both and are treated as matching anything.
  */
 constexpr uint8_t DB_BLOCK_HASH{'s'};
 constexpr uint8_t DB_BLOCK_HEIGHT{'t'};
@@ -46,8 +53,35 @@ struct DBVal {
     uint256 hash;
     uint256 header;
     FlatFilePos pos;
+    /** Encoded filter of the address scripts in name scripts, empty if the block has none */
+    std::optional<std::vector<uint8_t>> name_filter;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << hash << header << pos;
+        if (name_filter) {
+            const bool has_name_ops{!name_filter->empty()};
+            s << has_name_ops;
+            if (has_name_ops) s << *name_filter;
+        }
+    }
 
-    SERIALIZE_METHODS(DBVal, obj) { READWRITE(obj.hash, obj.header, obj.pos); }
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> hash >> header >> pos;
+        // Both fields are missing in entries written before they were added
+        name_filter.reset();
+        if (s.empty()) return;
+        bool has_name_ops;
+        s >> has_name_ops;
+        if (!has_name_ops) {
+            name_filter.emplace();
+        } else if (!s.empty()) {
+            s >> name_filter.emplace();
+        }
+    }
 };
 
 struct DBHeightKey {
@@ -89,6 +123,31 @@ struct DBHashKey {
     }
 };
 
+/** The address scripts of all name scripts created or spent in the block. */
+static GCSFilter::ElementSet NameAddressElements(const CBlock& block, const CBlockUndo& block_undo)
+{
+    GCSFilter::ElementSet elements;
+    const auto add_address = [&elements](const CScript& script) {
+        const CNameScript name_op(script);
+        if (!name_op.isNameOp()) return;
+        const CScript& address{name_op.getAddress()};
+        if (address.empty() || address[0] == OP_RETURN) return;
+        elements.emplace(address.begin(), address.end());
+    };
+
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& txout : tx->vout) {
+            add_address(txout.scriptPubKey);
+        }
+    }
+    for (const CTxUndo& tx_undo : block_undo.vtxundo) {
+        for (const Coin& prevout : tx_undo.vprevout) {
+            add_address(prevout.out.scriptPubKey);
+        }
+    }
+    return elements;
+}
+
 }; // namespace
 
 static std::map<BlockFilterType, BlockFilterIndex> g_filter_indexes;
@@ -243,6 +302,11 @@ bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex
     value.second.hash = filter.GetHash();
     value.second.header = filter.ComputeHeader(prev_header);
     value.second.pos = m_next_filter_pos;
+    const GCSFilter::ElementSet name_elements{NameAddressElements(block, block_undo)};
+    value.second.name_filter.emplace();
+    if (!name_elements.empty()) {
+        *value.second.name_filter = GCSFilter(filter.GetFilter().GetParams(), name_elements).GetEncoded();
+    }
 
     if (!m_db->Write(DBHeightKey(pindex->nHeight), value)) {
         return false;
@@ -375,13 +439,33 @@ static bool LookupRange(CDBWrapper& db, const std::string& index_name, int start
 }
 
 bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    std::optional<GCSFilter> name_filter;
+    return LookupFilter(block_index, filter_out, name_filter);
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out,
+                                    std::optional<GCSFilter>& name_filter_out) const
 {
     DBVal entry;
     if (!LookupOne(*m_db, block_index, entry)) {
         return false;
     }
 
-    return ReadFilterFromDisk(entry.pos, filter_out);
+    if (!ReadFilterFromDisk(entry.pos, filter_out)) {
+        return false;
+    }
+
+    name_filter_out.reset();
+    if (entry.name_filter) {
+        const GCSFilter::Params& params{filter_out.GetFilter().GetParams()};
+        try {
+            name_filter_out = entry.name_filter->empty() ? GCSFilter(params) : GCSFilter(params, std::move(*entry.name_filter));
+        } catch (const std::exception& e) {
+            return error("%s: Failed to decode name address filter: %s", __func__, e.what());
+        }
+    }
+    return true;
 }
 
 bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out)
@@ -11,6 +11,8 @@
 #include <index/base.h>
 #include <util/hasher.h>
 
+#include <optional>
+
 /** Interval between compact filter checkpoints. See BIP 157. */
 static constexpr int CFCHECKPT_INTERVAL = 1000;
 
@@ -61,6 +63,14 @@ public:
     /** Get a single filter by block. */
     bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const;
 
+    /**
+     * Get a single filter by block, and a filter with the same parameters over the address scripts
+     * in the name scripts the block creates or spends. The latter is nullopt for filters that were
+     * indexed before it was recorded.
+     */
+    bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out,
+                      std::optional<GCSFilter>& name_filter_out) const;
+
     /** Get a single filter header by block. */
     bool LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out);
 
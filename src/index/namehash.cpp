@@ -52,10 +52,16 @@ NameHashIndex::NameHashIndex (const size_t cache_size, const bool memory,
 
 NameHashIndex::~NameHashIndex () = default;
 
-bool
-NameHashIndex::WriteBlock (const CBlock& block, const CBlockIndex* pindex)
+namespace
+{
+
+/**
+ * Appends the hash and preimage of all names registered in the block.
+ */
+void
+AppendPreimages (const CBlock& block,
+                 std::vector<std::pair<uint256, valtype>>& data)
 {
-  std::vector<std::pair<uint256, valtype>> data;
   for (const auto& tx : block.vtx)
     for (const auto& out : tx->vout)
       {
@@ -67,6 +73,24 @@ NameHashIndex::WriteBlock (const CBlock& block, const CBlockIndex* pindex)
         const uint256 hash = Hash (name);
         data.emplace_back (hash, name);
       }
+}
+
+} // anonymous namespace
+
+bool
+NameHashIndex::WriteBlock (const CBlock& block, const CBlockIndex* pindex)
+{
+  std::vector<std::pair<uint256, valtype>> data;
+  AppendPreimages (block, data);
+  return db->WritePreimages (data);
+}
+
+bool
+NameHashIndex::WriteBlocks (const Span<const ConnectedBlock> blocks)
+{
+  std::vector<std::pair<uint256, valtype>> data;
+  for (const auto& connected : blocks)
+    AppendPreimages (*connected.block, data);
 
   return db->WritePreimages (data);
 }
@@ -41,6 +41,7 @@ private:
 protected:
 
     bool WriteBlock (const CBlock& block, const CBlockIndex* pindex) override;
+    bool WriteBlocks (Span<const ConnectedBlock> blocks) override;
 
     BaseIndex::DB& GetDB () const override;
 
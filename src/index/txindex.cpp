@@ -54,20 +54,43 @@ TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
 
 TxIndex::~TxIndex() {}
 
-bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+/** Append the disk positions of the transactions in a block to vPos. */
+static void AppendTxPositions(const CBlock& block, const CBlockIndex* pindex, std::vector<std::pair<uint256, CDiskTxPos>>& vPos)
 {
     // Exclude genesis block transaction because outputs are not spendable.
-    if (pindex->nHeight == 0) return true;
+    if (pindex->nHeight == 0) return;
 
     CDiskTxPos pos{
         WITH_LOCK(::cs_main, return pindex->GetBlockPos()),
         GetSizeOfCompactSize(block.vtx.size())};
-    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
-    vPos.reserve(block.vtx.size());
     for (const auto& tx : block.vtx) {
         vPos.emplace_back(tx->GetHash(), pos);
         pos.nTxOffset += ::GetSerializeSize(*tx, CLIENT_VERSION);
     }
+}
+
+bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (pindex->nHeight == 0) return true;
+
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    vPos.reserve(block.vtx.size());
+    AppendTxPositions(block, pindex, vPos);
+    return m_db->WriteTxs(vPos);
+}
+
+bool TxIndex::WriteBlocks(Span<const ConnectedBlock> blocks)
+{
+    // Write the positions of all transactions in a single batch.
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    size_t num_txs{0};
+    for (const ConnectedBlock& connected : blocks) {
+        num_txs += connected.block->vtx.size();
+    }
+    vPos.reserve(num_txs);
+    for (const ConnectedBlock& connected : blocks) {
+        AppendTxPositions(*connected.block, connected.pindex, vPos);
+    }
     return m_db->WriteTxs(vPos);
 }
 
@@ -23,6 +23,8 @@ private:
 protected:
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    bool WriteBlocks(Span<const ConnectedBlock> blocks) override;
+
     BaseIndex::DB& GetDB() const override;
 
     const char* GetName() const override { return "txindex"; }
@@ -41,6 +41,7 @@
 #include <node/chainstate.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <node/txprevalidation.h>
 #include <node/ui_interface.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
@@ -76,6 +77,7 @@
 #include <validationinterface.h>
 #include <walletinitinterface.h>
 
+#include <algorithm>
 #include <condition_variable>
 #include <cstdint>
 #include <cstdio>
@@ -102,16 +104,20 @@
 #include <zmq/zmqrpc.h>
 #endif
 
+using node::BlockTemplateBuilder;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::ChainstateLoadVerifyError;
 using node::ChainstateLoadingError;
 using node::CleanupBlockRevFiles;
+using node::DEFAULT_COMPRESS_UNDO;
+using node::DEFAULT_TX_PREVALIDATION_THREADS;
 using node::DEFAULT_PRINTPRIORITY;
 using node::DEFAULT_STOPAFTERBLOCKIMPORT;
 using node::LoadChainstate;
 using node::NodeContext;
 using node::ThreadImport;
+using node::TxPrevalidator;
 using node::VerifyLoadedChainstate;
 using node::fHavePruned;
 using node::fPruneMode;
@@ -231,19 +237,24 @@ void Shutdown(NodeContext& node)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (node.peerman) UnregisterValidationInterface(node.peerman.get());
+    if (node.template_builder) UnregisterValidationInterface(node.template_builder.get());
     if (node.connman) node.connman->Stop();
+    if (node.tx_prevalidator) node.tx_prevalidator->Stop();
 
     StopTorControl();
 
     // After everything has been shut down, but before things get flushed, stop the
     // CScheduler/checkqueue, scheduler and load block thread.
     if (node.scheduler) node.scheduler->stop();
+    GetMainSignals().StopBackgroundWorkers();
     if (node.chainman && node.chainman->m_load_block.joinable()) node.chainman->m_load_block.join();
     StopScriptCheckWorkerThreads();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     node.peerman.reset();
+    node.tx_prevalidator.reset();
+    node.template_builder.reset();
     node.connman.reset();
     node.banman.reset();
     node.addrman.reset();
@@ -299,6 +310,9 @@ void Shutdown(NodeContext& node)
                 chainstate->ResetCoinsViews();
             }
         }
+        // Nothing changes the block index anymore, so snapshot it for a
+        // faster startup
+        node.chainman->m_blockman.WriteBlockIndexSnapshot();
     }
     for (const auto& client : node.chain_clients) {
         client->stop();
@@ -314,7 +328,7 @@ void Shutdown(NodeContext& node)
 
     node.chain_clients.clear();
     UnregisterAllValidationInterfaces();
-    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().DropBackgroundCallbacks();
     init::UnsetGlobals();
     node.mempool.reset();
     node.fee_estimator.reset();
@@ -331,6 +345,7 @@ void Shutdown(NodeContext& node)
 
     node.args = nullptr;
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopAsyncWriter();
 }
 
 /**
@@ -417,6 +432,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless the peer has the 'forcerelay' permission. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-coinstatsindex", strprintf("Maintain coinstats index used by the gettxoutsetinfo RPC (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-compressundo", strprintf("Compress the undo data of new blocks. Undo data written like this cannot be read by older versions (default: %u)", DEFAULT_COMPRESS_UNDO), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-conf=<file>", strprintf("Specify path to read-only configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
@@ -425,6 +441,7 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-mempoolclustermode", strprintf("Evict and mine mempool transactions by chunks of linearized transaction clusters instead of by descendant and ancestor score (default: %u)", DEFAULT_MEMPOOL_CLUSTER_MODE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex(), signetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
@@ -436,6 +453,7 @@ void SetupServerArgs(ArgsManager& argsman)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-schedulerthreads=<n>", strprintf("Number of threads running periodic background tasks (1 to %d, default: %d)", MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-settings=<file>", strprintf("Specify path to dynamic settings data file. Can be disabled with -nosettings. File is written at runtime and not meant to be edited by users (use %s instead for custom settings). Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME, BITCOIN_SETTINGS_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
     argsman.AddArg("-startupnotify=<cmd>", "Execute command on startup.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -446,6 +464,7 @@ void SetupServerArgs(ArgsManager& argsman)
     hidden_args.emplace_back("-sysperms");
 #endif
     argsman.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-txprevalidationthreads=<n>", strprintf("Number of threads checking scripts of received transactions before they are processed, 0 to disable (default: %d)", DEFAULT_TX_PREVALIDATION_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -877,8 +896,6 @@ bool AppInitParameterInteraction(const ArgsManager& args)
             return InitError(_("Prune mode is incompatible with -txindex."));
         if (args.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
             return InitError(_("Prune mode is incompatible with -coinstatsindex."));
-        if (gArgs.GetBoolArg("-namehashindex", DEFAULT_NAMEHASHINDEX))
-            return InitError(_("Prune mode is incompatible with -namehashindex."));
     }
 
     // If -forcednsseed is set to true, ensure -dnsseed has not been set to false
@@ -1186,15 +1203,17 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     assert(!node.scheduler);
     node.scheduler = std::make_unique<CScheduler>();
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads
     node.scheduler->m_service_thread = std::thread(util::TraceThread, "scheduler", [&] { node.scheduler->serviceQueue(); });
+    const int scheduler_threads{static_cast<int>(std::clamp<int64_t>(args.GetIntArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), 1, MAX_SCHEDULER_THREADS))};
+    node.scheduler->StartWorkerThreads(scheduler_threads - 1);
 
     // Gather some entropy once per minute.
     node.scheduler->scheduleEvery([]{
         RandAddPeriodic();
-    }, std::chrono::minutes{1});
+    }, std::chrono::minutes{1}, "randaddperiodic");
 
-    GetMainSignals().RegisterBackgroundSignalScheduler(*node.scheduler);
+    GetMainSignals().StartBackgroundCallbacks();
 
     // Create client interfaces for wallets that are supposed to be loaded
     // according to -wallet and -disablewallet options. This only constructs
@@ -1291,16 +1310,26 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
 
     assert(!node.mempool);
     int check_ratio = std::min<int>(std::max<int>(args.GetIntArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
-    node.mempool = std::make_unique<CTxMemPool>(node.fee_estimator.get(), check_ratio);
+    node.mempool = std::make_unique<CTxMemPool>(node.fee_estimator.get(), check_ratio, args.GetBoolArg("-mempoolclustermode", DEFAULT_MEMPOOL_CLUSTER_MODE));
 
     assert(!node.chainman);
     node.chainman = std::make_unique<ChainstateManager>();
     ChainstateManager& chainman = *node.chainman;
 
     assert(!node.peerman);
+    assert(!node.tx_prevalidator);
+    const int prevalidation_threads{static_cast<int>(std::clamp<int64_t>(args.GetIntArg("-txprevalidationthreads", DEFAULT_TX_PREVALIDATION_THREADS), 0, MAX_SCRIPTCHECK_THREADS))};
+    if (!ignores_incoming_txs && prevalidation_threads > 0) {
+        node.tx_prevalidator = std::make_unique<TxPrevalidator>(chainman, *node.mempool, prevalidation_threads);
+    }
+
     node.peerman = PeerManager::make(chainparams, *node.connman, *node.addrman, node.banman.get(),
-                                     chainman, *node.mempool, ignores_incoming_txs);
-    RegisterValidationInterface(node.peerman.get());
+                                     chainman, *node.mempool, ignores_incoming_txs, node.tx_prevalidator.get());
+    RegisterValidationInterface(node.peerman.get(), "peerman");
+
+    assert(!node.template_builder);
+    node.template_builder = std::make_unique<BlockTemplateBuilder>(chainman, *node.mempool);
+    RegisterValidationInterface(node.template_builder.get(), "blocktemplate");
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1404,7 +1433,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, "zmq");
     }
 #endif
 
@@ -1859,7 +1888,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     BanMan* banman = node.banman.get();
     node.scheduler->scheduleEvery([banman]{
         banman->DumpBanlist();
-    }, DUMP_BANS_INTERVAL);
+    }, DUMP_BANS_INTERVAL, "dumpbanlist");
 
     if (node.peerman) node.peerman->StartScheduledTasks(*node.scheduler);
 
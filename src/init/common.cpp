@@ -18,6 +18,7 @@
 #include <util/time.h>
 #include <util/translation.h>
 
+#include <algorithm>
 #include <memory>
 
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
@@ -65,6 +66,13 @@ void AddLoggingArgs(ArgsManager& argsman)
         "If <category> is not supplied or if <category> = 1, output all debugging information. <category> can be: " + LogInstance().LogCategoriesString() + ". This option can be specified multiple times to output multiple categories.",
         ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-debugexclude=<category>", "Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except the specified category. This option can be specified multiple times to exclude multiple categories.", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+#ifdef HAVE_THREAD_LOCAL
+    argsman.AddArg("-logasync", strprintf("Write debug output from a background thread, so that logging threads do not wait for the console or debug log file. Messages logged just before a crash may be lost (default: %u)", DEFAULT_LOGASYNC), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-logbuffersize=<n>", strprintf("Number of messages each thread may queue for the background writer with -logasync (default: %u)", DEFAULT_LOGBUFFERSIZE), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-logoverflow=<policy>", strprintf("What a thread does when its -logbuffersize queue is full: \"block\" waits for the writer, \"drop\" discards the message. Dropped messages are counted in the debug log (default: %s)", DEFAULT_LOGOVERFLOW), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+#else
+    argsman.AddHiddenArgs({"-logasync", "-logbuffersize", "-logoverflow"});
+#endif
     argsman.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
 #ifdef HAVE_THREAD_LOCAL
@@ -89,6 +97,12 @@ void SetLoggingOptions(const ArgsManager& args)
     LogInstance().m_log_threadnames = args.GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
 #endif
     LogInstance().m_log_sourcelocations = args.GetBoolArg("-logsourcelocations", DEFAULT_LOGSOURCELOCATIONS);
+    LogInstance().m_async = args.GetBoolArg("-logasync", DEFAULT_LOGASYNC);
+    LogInstance().m_buffer_size = std::max<int64_t>(1, args.GetIntArg("-logbuffersize", DEFAULT_LOGBUFFERSIZE));
+    const std::string overflow{args.GetArg("-logoverflow", DEFAULT_LOGOVERFLOW)};
+    if (!GetLogOverflowPolicy(LogInstance().m_overflow_policy, overflow)) {
+        InitWarning(strprintf(_("Unsupported log overflow policy %s=%s."), "-logoverflow", overflow));
+    }
 
     fLogIPs = args.GetBoolArg("-logips", DEFAULT_LOGIPS);
 }
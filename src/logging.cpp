@@ -3,6 +3,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <fs.h>
 #include <logging.h>
 #include <util/threadnames.h>
@@ -11,9 +15,89 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdlib>
 #include <mutex>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
+const char * const DEFAULT_LOGOVERFLOW = "block";
+
+/** How long the background writer collects messages before writing them out */
+static constexpr auto LOG_WRITER_INTERVAL{std::chrono::milliseconds{10}};
+
+namespace BCLog {
+/**
+ * Fixed-size single-producer single-consumer queue of formatted messages.
+ * The owning thread pushes, the background writer pops.
+ */
+class LogRing
+{
+public:
+    struct Entry {
+        std::chrono::steady_clock::time_point time;
+        std::string msg;
+    };
+
+    explicit LogRing(size_t capacity) : m_entries(std::max<size_t>(capacity, 1)) {}
+
+    /** Queue msg, leaving it empty. Returns the number of queued messages, or 0 if the ring was full. */
+    size_t Push(std::string& msg)
+    {
+        const size_t head{m_head.load(std::memory_order_relaxed)};
+        const size_t used{head - m_tail.load(std::memory_order_acquire)};
+        if (used == m_entries.size()) return 0;
+        Entry& entry{m_entries[head % m_entries.size()]};
+        entry.time = std::chrono::steady_clock::now();
+        entry.msg = std::move(msg);
+        // Sequentially consistent, so that either the producer sees the writer
+        // going idle or the writer sees this message.
+        m_head.store(head + 1);
+        return used + 1;
+    }
+
+    void PopAll(std::vector<Entry>& out)
+    {
+        const size_t tail{m_tail.load(std::memory_order_relaxed)};
+        const size_t head{m_head.load(std::memory_order_acquire)};
+        for (size_t i = tail; i != head; ++i) {
+            out.push_back(std::move(m_entries[i % m_entries.size()]));
+        }
+        m_tail.store(head, std::memory_order_release);
+    }
+
+    bool Empty() const { return m_head.load() == m_tail.load(std::memory_order_relaxed); }
+    size_t Capacity() const { return m_entries.size(); }
+
+    //! Set by the producer while it may push; lets StopAsyncWriter wait for in-flight messages.
+    std::atomic_bool m_busy{false};
+    //! Set once the owning thread no longer uses this ring.
+    std::atomic_bool m_abandoned{false};
+    //! Whether the owning thread's last message ended a line. Only used by that thread.
+    bool m_started_new_line{true};
+    std::atomic<uint64_t> m_dropped{0};
+
+private:
+    std::vector<Entry> m_entries;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+} // namespace BCLog
+
+namespace {
+/** The calling thread's log buffer, and the logger it belongs to. */
+struct ThreadRingCache {
+    uint64_t logger_id{0};
+    std::shared_ptr<BCLog::LogRing> ring;
+
+    ~ThreadRingCache()
+    {
+        if (ring) ring->m_abandoned.store(true, std::memory_order_release);
+    }
+};
+#if defined(HAVE_THREAD_LOCAL)
+thread_local ThreadRingCache g_thread_ring;
+#endif
+} // namespace
 
 BCLog::Logger& LogInstance()
 {
@@ -43,6 +127,12 @@ static int FileWriteStr(const std::string &str, FILE *fp)
     return fwrite(str.data(), 1, str.size(), fp);
 }
 
+uint64_t BCLog::Logger::NextLoggerId()
+{
+    static std::atomic<uint64_t> next_id{1};
+    return next_id++;
+}
+
 bool BCLog::Logger::StartLogging()
 {
     StdLockGuard scoped_lock(m_cs);
@@ -79,16 +169,49 @@ bool BCLog::Logger::StartLogging()
     }
     if (m_print_to_console) fflush(stdout);
 
+#if defined(HAVE_THREAD_LOCAL)
+    if (m_async) {
+        m_writer_running = true;
+        m_writer = std::thread(&BCLog::Logger::WriterThread, this);
+    }
+#endif
+
     return true;
 }
 
+void BCLog::Logger::StopAsyncWriter()
+{
+    if (!m_writer.joinable()) return;
+    m_writer_running = false;
+    WakeWriter();
+    m_writer.join();
+
+    // Producers that saw the writer running may still be adding a message;
+    // wait for them and write out whatever they left behind.
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        StdLockGuard scoped_lock(m_rings_mutex);
+        rings = m_rings;
+    }
+    for (const auto& ring : rings) {
+        while (ring->m_busy) std::this_thread::yield();
+    }
+    std::string batch;
+    if (DrainRings(batch)) {
+        StdLockGuard scoped_lock(m_cs);
+        WriteToOutputs(batch);
+    }
+}
+
 void BCLog::Logger::DisconnectTestLogger()
 {
+    StopAsyncWriter();
     StdLockGuard scoped_lock(m_cs);
     m_buffering = true;
     if (m_fileout != nullptr) fclose(m_fileout);
     m_fileout = nullptr;
     m_print_callbacks.clear();
+    m_has_callbacks = false;
 }
 
 void BCLog::Logger::EnableCategory(BCLog::LogFlags flag)
@@ -183,6 +306,19 @@ bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str)
     return false;
 }
 
+bool GetLogOverflowPolicy(BCLog::OverflowPolicy& policy, const std::string& str)
+{
+    if (str == "block") {
+        policy = BCLog::OverflowPolicy::BLOCK;
+        return true;
+    }
+    if (str == "drop") {
+        policy = BCLog::OverflowPolicy::DROP;
+        return true;
+    }
+    return false;
+}
+
 std::vector<LogCategory> BCLog::Logger::LogCategoriesList() const
 {
     // Sort log categories by alphabetical order.
@@ -201,14 +337,14 @@ std::vector<LogCategory> BCLog::Logger::LogCategoriesList() const
     return ret;
 }
 
-std::string BCLog::Logger::LogTimestampStr(const std::string& str)
+std::string BCLog::Logger::LogTimestampStr(const std::string& str, bool started_new_line)
 {
     std::string strStamped;
 
     if (!m_log_timestamps)
         return str;
 
-    if (m_started_new_line) {
+    if (started_new_line) {
         int64_t nTimeMicros = GetTimeMicros();
         strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
         if (m_log_time_micros) {
@@ -248,22 +384,51 @@ namespace BCLog {
     }
 } // namespace BCLog
 
-void BCLog::Logger::LogPrintStr(const std::string& str, const std::string& logging_function, const std::string& source_file, const int source_line)
+std::string BCLog::Logger::FormatLogStr(const std::string& str, const std::string& logging_function, const std::string& source_file, const int source_line, bool started_new_line)
 {
-    StdLockGuard scoped_lock(m_cs);
     std::string str_prefixed = LogEscapeMessage(str);
 
-    if (m_log_sourcelocations && m_started_new_line) {
+    if (m_log_sourcelocations && started_new_line) {
         str_prefixed.insert(0, "[" + RemovePrefix(source_file, "./") + ":" + ToString(source_line) + "] [" + logging_function + "] ");
     }
 
-    if (m_log_threadnames && m_started_new_line) {
+    if (m_log_threadnames && started_new_line) {
         str_prefixed.insert(0, "[" + util::ThreadGetInternalName() + "] ");
     }
 
-    str_prefixed = LogTimestampStr(str_prefixed);
+    return LogTimestampStr(str_prefixed, started_new_line);
+}
+
+void BCLog::Logger::LogPrintStr(const std::string& str, const std::string& logging_function, const std::string& source_file, const int source_line)
+{
+    const bool ends_line{!str.empty() && str[str.size()-1] == '\n'};
+    std::string str_prefixed;
+
+    bool tried_async{false};
+    if (m_writer_running.load(std::memory_order_relaxed)) {
+        // Format without m_cs. Each thread's buffer remembers whether that
+        // thread's last message ended a line.
+        LogRing& ring{ThreadRing()};
+        str_prefixed = FormatLogStr(str, logging_function, source_file, source_line, ring.m_started_new_line);
+        ring.m_started_new_line = ends_line;
+
+        // Callbacks still run synchronously, so that e.g. tests waiting for a
+        // message see it as soon as it is logged.
+        if (m_has_callbacks) {
+            StdLockGuard scoped_lock(m_cs);
+            for (const auto& cb : m_print_callbacks) {
+                cb(str_prefixed);
+            }
+        }
+        if (EnqueueAsync(str_prefixed)) return;
+        tried_async = true;
+    }
 
-    m_started_new_line = !str.empty() && str[str.size()-1] == '\n';
+    StdLockGuard scoped_lock(m_cs);
+    if (!tried_async) {
+        str_prefixed = FormatLogStr(str, logging_function, source_file, source_line, m_started_new_line);
+        m_started_new_line = ends_line;
+    }
 
     if (m_buffering) {
         // buffer if we haven't started logging yet
@@ -271,14 +436,21 @@ void BCLog::Logger::LogPrintStr(const std::string& str, const std::string& loggi
         return;
     }
 
+    if (!tried_async) {
+        for (const auto& cb : m_print_callbacks) {
+            cb(str_prefixed);
+        }
+    }
+    WriteToOutputs(str_prefixed);
+}
+
+void BCLog::Logger::WriteToOutputs(const std::string& str)
+{
     if (m_print_to_console) {
         // print to console
-        fwrite(str_prefixed.data(), 1, str_prefixed.size(), stdout);
+        fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     }
-    for (const auto& cb : m_print_callbacks) {
-        cb(str_prefixed);
-    }
     if (m_print_to_file) {
         assert(m_fileout != nullptr);
 
@@ -292,7 +464,136 @@ void BCLog::Logger::LogPrintStr(const std::string& str, const std::string& loggi
                 m_fileout = new_fileout;
             }
         }
-        FileWriteStr(str_prefixed, m_fileout);
+        FileWriteStr(str, m_fileout);
+    }
+}
+
+BCLog::LogRing& BCLog::Logger::ThreadRing()
+{
+#if defined(HAVE_THREAD_LOCAL)
+    if (g_thread_ring.logger_id != m_id) {
+        if (g_thread_ring.ring) g_thread_ring.ring->m_abandoned.store(true, std::memory_order_release);
+        g_thread_ring.ring = std::make_shared<LogRing>(m_buffer_size);
+        g_thread_ring.logger_id = m_id;
+        StdLockGuard scoped_lock(m_rings_mutex);
+        m_rings.push_back(g_thread_ring.ring);
+    }
+    return *g_thread_ring.ring;
+#else
+    // The writer is never started without thread_local support.
+    assert(false);
+    std::abort();
+#endif
+}
+
+bool BCLog::Logger::EnqueueAsync(std::string& str)
+{
+    LogRing& ring{ThreadRing()};
+    ring.m_busy = true;
+    if (!m_writer_running) {
+        ring.m_busy.store(false, std::memory_order_release);
+        return false;
+    }
+
+    size_t queued;
+    while ((queued = ring.Push(str)) == 0) {
+        if (m_overflow_policy == OverflowPolicy::DROP) {
+            ring.m_dropped.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        WakeWriter();
+        if (!m_writer_running) {
+            // The writer is shutting down and will not make room any more.
+            ring.m_busy.store(false, std::memory_order_release);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    // Wake the writer if it is idle, or early if this buffer is filling up.
+    if ((m_writer_idle.load() && m_writer_idle.exchange(false)) || queued == ring.Capacity() / 2 + 1) {
+        WakeWriter();
+    }
+    ring.m_busy.store(false, std::memory_order_release);
+    return true;
+}
+
+void BCLog::Logger::WakeWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_writer_notified = true;
+    }
+    m_writer_cv.notify_one();
+}
+
+bool BCLog::Logger::DrainRings(std::string& batch)
+{
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        StdLockGuard scoped_lock(m_rings_mutex);
+        // Forget buffers of threads that are gone, once they have been drained.
+        m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const auto& ring) {
+            return ring->m_abandoned.load(std::memory_order_acquire) && ring->Empty() && ring->m_dropped == 0;
+        }), m_rings.end());
+        rings = m_rings;
+    }
+
+    std::vector<LogRing::Entry> entries;
+    uint64_t dropped{0};
+    for (const auto& ring : rings) {
+        ring->PopAll(entries);
+        dropped += ring->m_dropped.exchange(0);
+    }
+    if (entries.empty() && dropped == 0) return false;
+
+    // Messages from different threads are interleaved in the order they were
+    // queued. Each thread's own messages are already in order.
+    std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.time < b.time; });
+    for (const auto& entry : entries) {
+        batch += entry.msg;
+    }
+    if (dropped > 0) {
+        m_dropped += dropped;
+        if (m_log_timestamps) batch += FormatISO8601DateTime(GetTimeMicros() / 1000000) + ' ';
+        batch += strprintf("Dropped %u log messages because a log buffer was full (total %u)\n", dropped, m_dropped.load());
+    }
+    return true;
+}
+
+void BCLog::Logger::WriterThread()
+{
+    util::ThreadRename("logwriter");
+    std::string batch;
+    while (true) {
+        const bool running{m_writer_running};
+        batch.clear();
+        const bool drained{DrainRings(batch)};
+        if (drained) {
+            StdLockGuard scoped_lock(m_cs);
+            WriteToOutputs(batch);
+        }
+        if (!running) {
+            if (drained) continue;
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(m_writer_mutex);
+        const auto wake{[&] { return m_writer_notified || !m_writer_running; }};
+        if (drained) {
+            // Give producers some time to queue more, so that output is written in batches.
+            m_writer_cv.wait_for(lock, LOG_WRITER_INTERVAL, wake);
+        } else {
+            m_writer_idle = true;
+            bool pending{false};
+            {
+                StdLockGuard scoped_lock(m_rings_mutex);
+                for (const auto& ring : m_rings) pending |= !ring->Empty();
+            }
+            if (!pending) m_writer_cv.wait(lock, wake);
+            m_writer_idle = false;
+        }
+        m_writer_notified = false;
     }
 }
 
@@ -12,11 +12,14 @@
 #include <util/string.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
@@ -24,7 +27,11 @@ static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
 static const bool DEFAULT_LOGSOURCELOCATIONS = false;
+static const bool DEFAULT_LOGASYNC = false;
+/** Number of messages each thread may have waiting for the background log writer */
+static const int64_t DEFAULT_LOGBUFFERSIZE = 1024;
 extern const char * const DEFAULT_DEBUGLOGFILE;
+extern const char * const DEFAULT_LOGOVERFLOW;
 
 extern bool fLogIPs;
 
@@ -67,6 +74,14 @@ namespace BCLog {
         ALL         = ~(uint32_t)0,
     };
 
+    /** What a thread does when its buffer for the background log writer is full */
+    enum class OverflowPolicy {
+        BLOCK, //!< Wait for the writer to make room
+        DROP,  //!< Discard the message and count it
+    };
+
+    class LogRing;
+
     class Logger
     {
     private:
@@ -74,23 +89,58 @@ namespace BCLog {
 
         FILE* m_fileout GUARDED_BY(m_cs) = nullptr;
         std::list<std::string> m_msgs_before_open GUARDED_BY(m_cs);
-        bool m_buffering GUARDED_BY(m_cs) = true; //!< Buffer messages before logging can be started.
+        std::atomic_bool m_buffering{true}; //!< Buffer messages before logging can be started. Only changed while holding m_cs.
+        std::atomic_bool m_has_callbacks{false}; //!< Whether m_print_callbacks is non-empty. Only changed while holding m_cs.
+
+        /** Identifies this logger in the per-thread buffer cache. */
+        static uint64_t NextLoggerId();
+        const uint64_t m_id{NextLoggerId()};
+
+        /**
+         * Buffers of formatted messages waiting for the background writer, one
+         * per logging thread. Producers only touch their own buffer, so handing
+         * a message to the writer takes no lock.
+         */
+        StdMutex m_rings_mutex;
+        std::vector<std::shared_ptr<LogRing>> m_rings GUARDED_BY(m_rings_mutex);
+
+        std::thread m_writer;
+        std::mutex m_writer_mutex;
+        std::condition_variable m_writer_cv;
+        bool m_writer_notified{false}; //!< Guarded by m_writer_mutex
+        std::atomic_bool m_writer_running{false};
+        //! Set while the writer sleeps with all buffers empty; the next producer wakes it.
+        std::atomic_bool m_writer_idle{false};
+        std::atomic<uint64_t> m_dropped{0};
 
         /**
          * m_started_new_line is a state variable that will suppress printing of
          * the timestamp when multiple calls are made that don't end in a
-         * newline.
+         * newline. With the background writer running, each thread keeps its
+         * own in its buffer instead.
          */
-        std::atomic_bool m_started_new_line{true};
+        bool m_started_new_line GUARDED_BY(m_cs){true};
 
         /** Log categories bitfield. */
         std::atomic<uint32_t> m_categories{0};
 
-        std::string LogTimestampStr(const std::string& str);
+        std::string LogTimestampStr(const std::string& str, bool started_new_line);
+        std::string FormatLogStr(const std::string& str, const std::string& logging_function, const std::string& source_file, int source_line, bool started_new_line);
 
         /** Slots that connect to the print signal */
         std::list<std::function<void(const std::string&)>> m_print_callbacks GUARDED_BY(m_cs) {};
 
+        /** Write a (possibly multi-message) string to the console and debug log file */
+        void WriteToOutputs(const std::string& str) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+        LogRing& ThreadRing();
+        /** Hand a message to the background writer. Returns false if the writer is not running. */
+        bool EnqueueAsync(std::string& str);
+        void WakeWriter();
+        /** Move all buffered messages, oldest first, into batch. Returns false if there were none. */
+        bool DrainRings(std::string& batch);
+        void WriterThread();
+
     public:
         bool m_print_to_console = false;
         bool m_print_to_file = false;
@@ -100,6 +150,11 @@ namespace BCLog {
         bool m_log_threadnames = DEFAULT_LOGTHREADNAMES;
         bool m_log_sourcelocations = DEFAULT_LOGSOURCELOCATIONS;
 
+        /** Write to the console and debug log file from a background thread (takes effect in StartLogging) */
+        bool m_async = DEFAULT_LOGASYNC;
+        int64_t m_buffer_size = DEFAULT_LOGBUFFERSIZE;
+        OverflowPolicy m_overflow_policy = OverflowPolicy::BLOCK;
+
         fs::path m_file_path;
         std::atomic<bool> m_reopen_file{false};
 
@@ -109,8 +164,7 @@ namespace BCLog {
         /** Returns whether logs will be written to any output */
         bool Enabled() const
         {
-            StdLockGuard scoped_lock(m_cs);
-            return m_buffering || m_print_to_console || m_print_to_file || !m_print_callbacks.empty();
+            return m_buffering || m_print_to_console || m_print_to_file || m_has_callbacks;
         }
 
         /** Connect a slot to the print signal and return the connection */
@@ -118,6 +172,7 @@ namespace BCLog {
         {
             StdLockGuard scoped_lock(m_cs);
             m_print_callbacks.push_back(std::move(fun));
+            m_has_callbacks = true;
             return --m_print_callbacks.end();
         }
 
@@ -126,13 +181,19 @@ namespace BCLog {
         {
             StdLockGuard scoped_lock(m_cs);
             m_print_callbacks.erase(it);
+            m_has_callbacks = !m_print_callbacks.empty();
         }
 
         /** Start logging (and flush all buffered messages) */
         bool StartLogging();
+        /** Write out all pending messages and stop the background writer, if running. Later messages are written synchronously. */
+        void StopAsyncWriter();
         /** Only for testing */
         void DisconnectTestLogger();
 
+        /** Number of messages discarded because a thread's buffer was full */
+        uint64_t GetDroppedMessages() const { return m_dropped.load(); }
+
         void ShrinkDebugFile();
 
         uint32_t GetCategoryMask() const { return m_categories.load(); }
@@ -167,6 +228,9 @@ static inline bool LogAcceptCategory(BCLog::LogFlags category)
 /** Return true if str parses as a log category and set the flag */
 bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str);
 
+/** Return true if str parses as a log buffer overflow policy and set the policy */
+bool GetLogOverflowPolicy(BCLog::OverflowPolicy& policy, const std::string& str);
+
 // Be conservative when using LogPrintf/error or other things which
 // unconditionally log to debug.log! It should not be the case that an inbound
 // peer can fill up a user's disk with debug.log entries.
@@ -291,6 +291,27 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
   return true;
 }
 
+unsigned
+NameFirstUpdateMinHeight (const CTransaction& tx, const CCoinsView& view)
+{
+  for (const auto& txIn : tx.vin)
+    {
+      Coin coin;
+      if (!view.GetCoin (txIn.prevout, coin))
+        continue;
+
+      const CNameScript op(coin.out.scriptPubKey);
+      if (!op.isNameOp () || op.getNameOp () != OP_NAME_NEW)
+        continue;
+
+      if (coin.nHeight == MEMPOOL_HEIGHT)
+        return MEMPOOL_HEIGHT;
+      return coin.nHeight + MIN_FIRSTUPDATE_DEPTH;
+    }
+
+  return MEMPOOL_HEIGHT;
+}
+
 void
 ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
                       CCoinsViewCache& view, CBlockUndo& undo)
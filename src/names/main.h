@@ -92,6 +92,18 @@ bool CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                            const CCoinsView& view,
                            TxValidationState& state, unsigned flags);
 
+/**
+ * Returns the earliest block height at which the given NAME_FIRSTUPDATE
+ * transaction can be mined, based on the confirmation height of its
+ * NAME_NEW input.  If that input is not found in the view or is itself
+ * still unconfirmed, MEMPOOL_HEIGHT is returned.
+ * @param tx The name registration transaction.
+ * @param view The chain state to look up the NAME_NEW coin in.
+ * @return The minimum block height for including the tx.
+ */
+unsigned NameFirstUpdateMinHeight (const CTransaction& tx,
+                                   const CCoinsView& view);
+
 /**
  * Apply the changes of a name transaction to the name database.
  * @param tx The transaction to apply.
@@ -7,6 +7,7 @@
 #include <coins.h>
 #include <logging.h>
 #include <names/encoding.h>
+#include <names/main.h>
 #include <script/names.h>
 #include <txmempool.h>
 #include <util/strencodings.h>
@@ -272,6 +273,10 @@ CNameMemPool::check (const CCoinsViewCache& tip,
           CNameData data;
           if (tip.GetName (name, data))
             assert (data.isExpired (spendheight));
+
+          /* The cached maturity height must match the NAME_NEW input.  */
+          assert (entry.getNameMinHeight ()
+                    == NameFirstUpdateMinHeight (entry.GetTx (), tip));
         }
 
       if (entry.isNameUpdate ())
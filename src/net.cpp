@@ -698,6 +698,7 @@ bool CNode::ReceiveMsgBytes(Span<const uint8_t> msg_bytes, bool& complete)
                 // Message deserialization failed.  Drop the message but don't disconnect the peer.
                 // store the size of the corrupt message
                 mapRecvBytesPerMsgCmd.at(NET_MESSAGE_COMMAND_OTHER) += msg.m_raw_message_size;
+                m_recv_buffers.Put(std::move(msg.m_recv));
                 continue;
             }
 
@@ -720,6 +721,81 @@ bool CNode::ReceiveMsgBytes(Span<const uint8_t> msg_bytes, bool& complete)
     return true;
 }
 
+/** Capacity of the buffers held by all RecvBufferPools */
+static std::atomic<size_t> g_recv_pool_bytes{0};
+
+RecvBufferPool::~RecvBufferPool()
+{
+    g_recv_pool_bytes -= PooledBytes();
+}
+
+size_t RecvBufferPool::TotalPooledBytes()
+{
+    return g_recv_pool_bytes.load();
+}
+
+CDataStream RecvBufferPool::Get(size_t size, int type, int version)
+{
+    std::optional<CDataStream> stream;
+    {
+        LOCK(m_mutex);
+        // Use the smallest pooled buffer that fits the whole message.
+        std::optional<CDataStream>* best{nullptr};
+        for (auto& buffer : m_buffers) {
+            if (buffer && buffer->capacity() >= size && (!best || buffer->capacity() < (*best)->capacity())) {
+                best = &buffer;
+            }
+        }
+        if (best) {
+            stream = std::move(*best);
+            best->reset();
+            g_recv_pool_bytes -= stream->capacity();
+        }
+    }
+    if (!stream) {
+        stream.emplace(type, version);
+        // Give small messages a buffer of the smallest class, so that it can
+        // be pooled afterwards. Larger buffers are only allocated as data
+        // arrives (see readData).
+        if (size <= SIZE_CLASSES.front()) stream->reserve(SIZE_CLASSES.front());
+    }
+    stream->SetType(type);
+    stream->SetVersion(version);
+    return std::move(*stream);
+}
+
+void RecvBufferPool::Put(CDataStream&& stream)
+{
+    stream.clear();
+    const size_t capacity{stream.capacity()};
+    if (capacity < SIZE_CLASSES.front() || capacity > MAX_POOLED_CAPACITY) return;
+    size_t size_class{0};
+    while (size_class + 1 < SIZE_CLASSES.size() && SIZE_CLASSES[size_class + 1] <= capacity) ++size_class;
+    std::optional<CDataStream> replaced{std::move(stream)};
+    {
+        LOCK(m_mutex);
+        std::optional<CDataStream>& slot{m_buffers[size_class]};
+        const size_t freed{slot ? slot->capacity() : 0};
+        size_t total{g_recv_pool_bytes.load()};
+        do {
+            // Keep the buffer only if all pools together stay within the limit.
+            if (capacity > freed && total - freed + capacity > MAX_TOTAL_POOLED_BYTES) return;
+        } while (!g_recv_pool_bytes.compare_exchange_weak(total, total - freed + capacity));
+        std::swap(slot, replaced);
+    }
+    // Any buffer replaced or not kept here is freed (and wiped) outside the lock.
+}
+
+size_t RecvBufferPool::PooledBytes() const
+{
+    LOCK(m_mutex);
+    size_t total{0};
+    for (const auto& buffer : m_buffers) {
+        if (buffer) total += buffer->capacity();
+    }
+    return total;
+}
+
 int V1TransportDeserializer::readHeader(Span<const uint8_t> msg_bytes)
 {
     // copy data to temporary parsing buffer
@@ -757,6 +833,10 @@ int V1TransportDeserializer::readHeader(Span<const uint8_t> msg_bytes)
     // switch state to reading message data
     in_data = true;
 
+    if (m_recv_buffers && vRecv.capacity() < hdr.nMessageSize) {
+        vRecv = m_recv_buffers->Get(hdr.nMessageSize, vRecv.GetType(), vRecv.GetVersion());
+    }
+
     return nCopy;
 }
 
@@ -1652,6 +1732,7 @@ void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
                         // vRecvMsg contains only completed CNetMessage
                         // the single possible partially deserialized message are held by TransportDeserializer
                         nSizeAdded += it->m_raw_message_size;
+                        m_msgproc->MessageReceived(*pnode, *it);
                     }
                     {
                         LOCK(pnode->cs_vProcessMsg);
@@ -2671,7 +2752,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
 
     // Dump network addresses
-    scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL);
+    scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL, "dumpaddresses");
 
     return true;
 }
@@ -3045,7 +3126,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, std::shared_ptr<Sock> s
         LogPrint(BCLog::NET, "Added connection peer=%d\n", id);
     }
 
-    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION));
+    m_deserializer = std::make_unique<V1TransportDeserializer>(V1TransportDeserializer(Params(), id, SER_NETWORK, INIT_PROTO_VERSION, &m_recv_buffers));
     m_serializer = std::make_unique<V1TransportSerializer>(V1TransportSerializer());
 }
 
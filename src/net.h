@@ -27,6 +27,7 @@
 #include <util/check.h>
 #include <util/sock.h>
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
@@ -311,6 +312,47 @@ public:
     }
 };
 
+/**
+ * Per-peer pool of message receive buffers. The buffer of a processed message
+ * is handed back here and reused for a later message of similar size, so that
+ * receiving it does not allocate, grow and wipe a new buffer.
+ *
+ * At most one buffer is kept per size class, and buffers larger than
+ * MAX_POOLED_CAPACITY are freed rather than pooled, so a peer never retains
+ * more than about 3 MB. The rare larger messages get a fresh buffer. The
+ * pools of all peers together keep at most MAX_TOTAL_POOLED_BYTES; beyond
+ * that, handed back buffers are freed.
+ */
+class RecvBufferPool
+{
+public:
+    //! Lower capacity bounds of the size classes.
+    static constexpr std::array<size_t, 4> SIZE_CLASSES{1 << 10, 1 << 14, 1 << 18, 1 << 20};
+    //! Largest buffer capacity that is kept for reuse.
+    static constexpr size_t MAX_POOLED_CAPACITY{3 << 19};
+    //! Limit on the capacity of the pooled buffers of all pools together.
+    static constexpr size_t MAX_TOTAL_POOLED_BYTES{32 << 20};
+
+    RecvBufferPool() = default;
+    RecvBufferPool(const RecvBufferPool&) = delete;
+    RecvBufferPool& operator=(const RecvBufferPool&) = delete;
+    ~RecvBufferPool();
+
+    /** Return an empty stream able to hold a `size` byte message without
+     *  reallocating, if a pooled buffer is large enough. */
+    CDataStream Get(size_t size, int type, int version) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Hand back the buffer of a message that is no longer needed. */
+    void Put(CDataStream&& stream) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Total capacity of the pooled buffers. */
+    size_t PooledBytes() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Total capacity of the pooled buffers of all pools. */
+    static size_t TotalPooledBytes();
+
+private:
+    mutable Mutex m_mutex;
+    std::array<std::optional<CDataStream>, SIZE_CLASSES.size()> m_buffers GUARDED_BY(m_mutex);
+};
+
 /** The TransportDeserializer takes care of holding and deserializing the
  * network receive buffer. It can deserialize the network buffer into a
  * transport protocol agnostic CNetMessage (command & payload)
@@ -333,6 +375,7 @@ class V1TransportDeserializer final : public TransportDeserializer
 private:
     const CChainParams& m_chain_params;
     const NodeId m_node_id; // Only for logging
+    RecvBufferPool* const m_recv_buffers; // Optional source of receive buffers
     mutable CHash256 hasher;
     mutable uint256 data_hash;
     bool in_data;                   // parsing header (false) or data (true)
@@ -358,9 +401,10 @@ private:
     }
 
 public:
-    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn)
+    V1TransportDeserializer(const CChainParams& chain_params, const NodeId node_id, int nTypeIn, int nVersionIn, RecvBufferPool* recv_buffers = nullptr)
         : m_chain_params(chain_params),
           m_node_id(node_id),
+          m_recv_buffers(recv_buffers),
           hdrbuf(nTypeIn, nVersionIn),
           vRecv(nTypeIn, nVersionIn)
     {
@@ -412,6 +456,8 @@ class CNode
     friend struct ConnmanTestMsg;
 
 public:
+    /** Buffers of processed messages, reused to receive later messages from this peer. */
+    RecvBufferPool m_recv_buffers;
     std::unique_ptr<TransportDeserializer> m_deserializer;
     std::unique_ptr<TransportSerializer> m_serializer;
 
@@ -745,6 +791,16 @@ public:
     */
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
 
+    /**
+    * Inspect a complete message right after it was received, before it is
+    * queued for processing.  Called from the socket handler thread, so this
+    * must be cheap and must not take any locks of the message processing.
+    *
+    * @param[in]   node            The node which we have received the message from.
+    * @param[in]   msg             The received message.
+    */
+    virtual void MessageReceived(const CNode& node, const CNetMessage& msg) {}
+
     /**
     * Send queued protocol messages to a given node.
     *
@@ -19,6 +19,7 @@
 #include <netbase.h>
 #include <netmessagemaker.h>
 #include <node/blockstorage.h>
+#include <node/txprevalidation.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -318,7 +319,8 @@ class PeerManagerImpl final : public PeerManager
 public:
     PeerManagerImpl(const CChainParams& chainparams, CConnman& connman, AddrMan& addrman,
                     BanMan* banman, ChainstateManager& chainman,
-                    CTxMemPool& pool, bool ignore_incoming_txs);
+                    CTxMemPool& pool, bool ignore_incoming_txs,
+                    node::TxPrevalidator* tx_prevalidator);
 
     /** Overridden from CValidationInterface. */
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected) override;
@@ -331,6 +333,7 @@ public:
     void InitializeNode(CNode* pnode) override;
     void FinalizeNode(const CNode& node) override;
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
+    void MessageReceived(const CNode& node, const CNetMessage& msg) override;
     bool SendMessages(CNode* pto) override EXCLUSIVE_LOCKS_REQUIRED(pto->cs_sendProcessing);
 
     /** Implement PeerManager */
@@ -451,6 +454,9 @@ private:
     /** Whether this node is running in blocks only mode */
     const bool m_ignore_incoming_txs;
 
+    /** Worker pool checking received transactions ahead of the message handler, if enabled */
+    node::TxPrevalidator* const m_tx_prevalidator;
+
     /** Whether we've completed initial sync yet, for determining when to turn
       * on extra block-relay-only peers. */
     bool m_initial_sync_finished{false};
@@ -1237,7 +1243,7 @@ void PeerManagerImpl::ReattemptInitialBroadcast(CScheduler& scheduler)
     // Schedule next run for 10-15 minutes in the future.
     // We add randomness on every cycle to avoid the possibility of P2P fingerprinting.
     const std::chrono::milliseconds delta = 10min + GetRandMillis(5min);
-    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta);
+    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta, "reattemptbroadcast");
 }
 
 void PeerManagerImpl::FinalizeNode(const CNode& node)
@@ -1513,21 +1519,24 @@ std::optional<std::string> PeerManagerImpl::FetchBlock(NodeId peer_id, const CBl
 
 std::unique_ptr<PeerManager> PeerManager::make(const CChainParams& chainparams, CConnman& connman, AddrMan& addrman,
                                                BanMan* banman, ChainstateManager& chainman,
-                                               CTxMemPool& pool, bool ignore_incoming_txs)
+                                               CTxMemPool& pool, bool ignore_incoming_txs,
+                                               node::TxPrevalidator* tx_prevalidator)
 {
-    return std::make_unique<PeerManagerImpl>(chainparams, connman, addrman, banman, chainman, pool, ignore_incoming_txs);
+    return std::make_unique<PeerManagerImpl>(chainparams, connman, addrman, banman, chainman, pool, ignore_incoming_txs, tx_prevalidator);
 }
 
 PeerManagerImpl::PeerManagerImpl(const CChainParams& chainparams, CConnman& connman, AddrMan& addrman,
                                  BanMan* banman, ChainstateManager& chainman,
-                                 CTxMemPool& pool, bool ignore_incoming_txs)
+                                 CTxMemPool& pool, bool ignore_incoming_txs,
+                                 node::TxPrevalidator* tx_prevalidator)
     : m_chainparams(chainparams),
       m_connman(connman),
       m_addrman(addrman),
       m_banman(banman),
       m_chainman(chainman),
       m_mempool(pool),
-      m_ignore_incoming_txs(ignore_incoming_txs)
+      m_ignore_incoming_txs(ignore_incoming_txs),
+      m_tx_prevalidator(tx_prevalidator)
 {
 }
 
@@ -1538,11 +1547,11 @@ void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery([this] { this->CheckForStaleTipAndEvictPeers(); }, std::chrono::seconds{EXTRA_PEER_CHECK_INTERVAL});
+    scheduler.scheduleEvery([this] { this->CheckForStaleTipAndEvictPeers(); }, std::chrono::seconds{EXTRA_PEER_CHECK_INTERVAL}, "checkstaletip");
 
     // schedule next run for 10-15 minutes in the future
     const std::chrono::milliseconds delta = 10min + GetRandMillis(5min);
-    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta);
+    scheduler.scheduleFromNow([&] { ReattemptInitialBroadcast(scheduler); }, delta, "reattemptbroadcast");
 }
 
 /**
@@ -4184,6 +4193,20 @@ bool PeerManagerImpl::MaybeDiscourageAndDisconnect(CNode& pnode, Peer& peer)
     return true;
 }
 
+void PeerManagerImpl::MessageReceived(const CNode& node, const CNetMessage& msg)
+{
+    if (m_tx_prevalidator == nullptr || msg.m_type != NetMsgType::TX) return;
+
+    // Don't spend any work on transactions that ProcessMessage won't accept
+    // from this peer anyway.
+    if ((m_ignore_incoming_txs && !node.HasPermission(NetPermissionFlags::Relay)) || node.m_tx_relay == nullptr) return;
+    // Nor on peers that already filled their receive queue; their messages
+    // will wait for the message handler for a while anyway.
+    if (node.fPauseRecv) return;
+
+    m_tx_prevalidator->Submit(msg.m_recv);
+}
+
 bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     bool fMoreWork = false;
@@ -4263,6 +4286,8 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
         LogPrint(BCLog::NET, "%s(%s, %u bytes): Unknown exception caught\n", __func__, SanitizeString(msg.m_type), msg.m_message_size);
     }
 
+    pfrom->m_recv_buffers.Put(std::move(msg.m_recv));
+
     return fMoreWork;
 }
 
@@ -0,0 +1,194 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKMAP_H
+#define BITCOIN_NODE_BLOCKMAP_H
+
+#include <chain.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace node {
+
+/**
+ * Map from block hash to CBlockIndex that stores the entries contiguously.
+ *
+ * Entries live in fixed-size chunks in insertion order and are never moved,
+ * so pointers to them stay valid until clear().  Since blocks are mostly
+ * added in height order, predecessors and skip list targets tend to be close
+ * to each other in memory, which makes walking the block tree much cheaper
+ * than with one heap allocation per entry.  A separate open addressing table
+ * maps hashes to positions in the arena.
+ *
+ * The interface is the subset of std::unordered_map used for the block index.
+ * Entries cannot be erased individually, and iteration is in insertion order.
+ */
+class BlockMap
+{
+public:
+    using key_type = uint256;
+    using mapped_type = CBlockIndex;
+    using value_type = std::pair<const uint256, CBlockIndex>;
+    using size_type = size_t;
+
+    template <bool is_const>
+    class Iterator
+    {
+    private:
+        friend class BlockMap;
+        using Map = std::conditional_t<is_const, const BlockMap, BlockMap>;
+
+        Map* m_map{nullptr};
+        size_t m_slot{0};
+
+        Iterator(Map* map, size_t slot) : m_map(map), m_slot(slot) {}
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = BlockMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const value_type*, value_type*>;
+        using reference = std::conditional_t<is_const, const value_type&, value_type&>;
+
+        template <bool>
+        friend class Iterator;
+
+        Iterator() = default;
+        Iterator(const Iterator<false>& other) : m_map(other.m_map), m_slot(other.m_slot) {}
+        Iterator& operator=(const Iterator&) = default;
+
+        reference operator*() const { return m_map->At(m_slot); }
+        pointer operator->() const { return &m_map->At(m_slot); }
+        Iterator& operator++()
+        {
+            ++m_slot;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator ret{*this};
+            ++m_slot;
+            return ret;
+        }
+        bool operator==(const Iterator& other) const { return m_slot == other.m_slot; }
+        bool operator!=(const Iterator& other) const { return m_slot != other.m_slot; }
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    BlockMap() = default;
+    ~BlockMap() { clear(); }
+    BlockMap(const BlockMap&) = delete;
+    BlockMap& operator=(const BlockMap&) = delete;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, m_size}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, m_size}; }
+
+    iterator find(const uint256& hash) { return {this, FindSlot(hash)}; }
+    const_iterator find(const uint256& hash) const { return {this, FindSlot(hash)}; }
+    size_t count(const uint256& hash) const { return FindSlot(hash) == m_size ? 0 : 1; }
+
+    /** Insert an entry constructed from args unless the hash is present already */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const uint256& hash, Args&&... args)
+    {
+        if ((m_size + 1) * 2 > m_table.size()) {
+            Rehash(std::max<size_t>(m_table.size() * 2, MIN_TABLE_SIZE));
+        }
+        size_t pos{Bucket(hash)};
+        for (; m_table[pos] != NO_SLOT; pos = (pos + 1) & (m_table.size() - 1)) {
+            if (At(m_table[pos]).first == hash) return {{this, m_table[pos]}, false};
+        }
+
+        if (m_size == m_chunks.size() * CHUNK_SIZE) {
+            m_chunks.push_back(std::allocator<value_type>{}.allocate(CHUNK_SIZE));
+        }
+        ::new (&m_chunks[m_size / CHUNK_SIZE][m_size % CHUNK_SIZE]) value_type(std::piecewise_construct,
+                                                                                std::forward_as_tuple(hash),
+                                                                                std::forward_as_tuple(std::forward<Args>(args)...));
+        m_table[pos] = m_size;
+        return {{this, m_size++}, true};
+    }
+
+    CBlockIndex& operator[](const uint256& hash) { return try_emplace(hash).first->second; }
+
+    void reserve(size_t count)
+    {
+        m_chunks.reserve((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        size_t table_size{MIN_TABLE_SIZE};
+        while (table_size < count * 2) table_size *= 2;
+        if (table_size > m_table.size()) Rehash(table_size);
+    }
+
+    void clear()
+    {
+        for (size_t slot = 0; slot < m_size; ++slot) {
+            At(slot).~value_type();
+        }
+        for (value_type* chunk : m_chunks) {
+            std::allocator<value_type>{}.deallocate(chunk, CHUNK_SIZE);
+        }
+        m_chunks.clear();
+        m_table.clear();
+        m_size = 0;
+    }
+
+private:
+    /** Number of entries per arena chunk */
+    static constexpr size_t CHUNK_SIZE{4096};
+    static constexpr size_t MIN_TABLE_SIZE{64};
+    static constexpr uint32_t NO_SLOT{std::numeric_limits<uint32_t>::max()};
+
+    std::vector<value_type*> m_chunks;
+    size_t m_size{0};
+    /** Arena positions by hash, with linear probing; a power of two in size
+     *  and at most half full. */
+    std::vector<uint32_t> m_table;
+
+    value_type& At(size_t slot) { return m_chunks[slot / CHUNK_SIZE][slot % CHUNK_SIZE]; }
+    const value_type& At(size_t slot) const { return m_chunks[slot / CHUNK_SIZE][slot % CHUNK_SIZE]; }
+
+    size_t Bucket(const uint256& hash) const { return BlockHasher{}(hash) & (m_table.size() - 1); }
+
+    /** Arena position of the entry for hash, or m_size if there is none */
+    size_t FindSlot(const uint256& hash) const
+    {
+        if (m_table.empty()) return m_size;
+        for (size_t pos{Bucket(hash)}; m_table[pos] != NO_SLOT; pos = (pos + 1) & (m_table.size() - 1)) {
+            if (At(m_table[pos]).first == hash) return m_table[pos];
+        }
+        return m_size;
+    }
+
+    void Rehash(size_t table_size)
+    {
+        m_table.assign(table_size, NO_SLOT);
+        for (size_t slot = 0; slot < m_size; ++slot) {
+            size_t pos{Bucket(At(slot).first)};
+            while (m_table[pos] != NO_SLOT) pos = (pos + 1) & (m_table.size() - 1);
+            m_table[pos] = slot;
+        }
+    }
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_BLOCKMAP_H
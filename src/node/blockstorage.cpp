@@ -4,6 +4,7 @@
 
 #include <node/blockstorage.h>
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <clientversion.h>
@@ -12,15 +13,29 @@
 #include <fs.h>
 #include <hash.h>
 #include <pow.h>
+#include <random.h>
 #include <reverse_iterator.h>
 #include <shutdown.h>
 #include <signet.h>
+#include <span.h>
 #include <streams.h>
 #include <undo.h>
+#include <util/compression.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
+#include <limits>
+#include <unordered_map>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace node {
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
@@ -28,6 +43,67 @@ bool fHavePruned = false;
 bool fPruneMode = false;
 uint64_t nPruneTarget = 0;
 
+/** Version of the block index snapshot format */
+static constexpr uint32_t BLOCK_INDEX_SNAPSHOT_VERSION{1};
+/** Size of one snapshot record: three hashes and eleven 32-bit fields */
+static constexpr size_t BLOCK_INDEX_SNAPSHOT_RECORD_SIZE{3 * 32 + 11 * 4};
+/** Predecessor position of records without pprev */
+static constexpr uint32_t BLOCK_INDEX_SNAPSHOT_NO_PREV{std::numeric_limits<uint32_t>::max()};
+
+static fs::path GetBlockIndexSnapshotPath()
+{
+    return gArgs.GetDataDirNet() / "blocks" / "index.snapshot";
+}
+
+namespace {
+
+/** Read-only view of a whole file, memory mapped where supported. */
+class MappedFile
+{
+private:
+    Span<const unsigned char> m_data;
+    void* m_map{nullptr};
+    std::vector<unsigned char> m_buffer;
+
+public:
+    explicit MappedFile(const fs::path& path)
+    {
+#ifndef WIN32
+        const int fd{::open(path.c_str(), O_RDONLY)};
+        if (fd == -1) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* map{::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+            if (map != MAP_FAILED) {
+                m_map = map;
+                m_data = Span{static_cast<const unsigned char*>(map), static_cast<size_t>(st.st_size)};
+            }
+        }
+        ::close(fd);
+#else
+        CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+        if (file.IsNull()) return;
+        m_buffer.resize(fs::file_size(path));
+        file.read(MakeWritableByteSpan(m_buffer));
+        m_data = m_buffer;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef WIN32
+        if (m_map) ::munmap(m_map, m_data.size());
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    Span<const unsigned char> Data() const { return m_data; }
+};
+
+} // namespace
+
 bool CBlockIndexWorkComparator::operator()(const CBlockIndex* pa, const CBlockIndex* pb) const
 {
     // First sort by most total work, ...
@@ -56,6 +132,11 @@ static FILE* OpenUndoFile(const FlatFilePos& pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
+BlockManager::BlockManager()
+    : m_compress_undo{gArgs.GetBoolArg("-compressundo", DEFAULT_COMPRESS_UNDO)}
+{
+}
+
 std::vector<CBlockIndex*> BlockManager::GetAllBlockIndices()
 {
     AssertLockHeld(cs_main);
@@ -246,20 +327,176 @@ CBlockIndex* BlockManager::InsertBlockIndex(const uint256& hash)
     return pindex;
 }
 
-bool BlockManager::LoadBlockIndex(const Consensus::Params& consensus_params)
+bool BlockManager::LoadBlockIndexSnapshot(std::vector<CBlockIndex*>& sorted_by_height)
+{
+    AssertLockHeld(::cs_main);
+
+    uint256 id;
+    if (!m_block_index.empty() || !m_block_tree_db->ReadBlockIndexSnapshotId(id)) {
+        return false;
+    }
+    // The database may change from now on, so the snapshot must not be used
+    // again whether it can be loaded or not.
+    if (!m_block_tree_db->EraseBlockIndexSnapshotId()) {
+        return false;
+    }
+
+    const fs::path path{GetBlockIndexSnapshotPath()};
+    const int64_t start{GetTimeMicros()};
+    bool ret{false};
+    {
+        const MappedFile file{path};
+        SpanReader reader{SER_DISK, CLIENT_VERSION, file.Data()};
+        try {
+            uint32_t version;
+            uint256 file_id;
+            int last_file;
+            CBlockFileInfo last_info;
+            uint64_t count;
+            reader >> version >> file_id >> last_file >> last_info.nBlocks >> last_info.nSize >> last_info.nUndoSize >> count;
+            if (version != BLOCK_INDEX_SNAPSHOT_VERSION || file_id != id) {
+                throw std::runtime_error("snapshot does not match the block tree database");
+            }
+
+            // Older versions do not know about the snapshot, so at least make
+            // sure that they have not stored any blocks since it was written.
+            int db_last_file{0};
+            CBlockFileInfo db_last_info;
+            m_block_tree_db->ReadLastBlockFile(db_last_file);
+            m_block_tree_db->ReadBlockFileInfo(db_last_file, db_last_info);
+            if (last_file != db_last_file || last_info.nBlocks != db_last_info.nBlocks ||
+                last_info.nSize != db_last_info.nSize || last_info.nUndoSize != db_last_info.nUndoSize) {
+                throw std::runtime_error("block files changed since the snapshot was written");
+            }
+            if (reader.size() / BLOCK_INDEX_SNAPSHOT_RECORD_SIZE != count ||
+                reader.size() % BLOCK_INDEX_SNAPSHOT_RECORD_SIZE != 0) {
+                throw std::runtime_error("unexpected file size");
+            }
+
+            // Records are sorted by height and refer to their predecessor by
+            // position, so neither hashing nor lookups are needed.
+            m_block_index.reserve(count);
+            sorted_by_height.reserve(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                uint256 hash, chain_work;
+                uint32_t prev;
+                reader >> hash;
+                CBlockIndex* pindex{InsertBlockIndex(hash)};
+                if (!pindex || m_block_index.size() != i + 1) {
+                    throw std::runtime_error("invalid block hash");
+                }
+                reader >> pindex->hashMerkleRoot >> chain_work >> prev >> pindex->nHeight;
+                if (prev == BLOCK_INDEX_SNAPSHOT_NO_PREV) {
+                    if (pindex->nHeight != 0) throw std::runtime_error("missing predecessor");
+                } else {
+                    if (prev >= i) throw std::runtime_error("invalid predecessor");
+                    pindex->pprev = sorted_by_height[prev];
+                    if (pindex->nHeight != pindex->pprev->nHeight + 1) throw std::runtime_error("invalid height");
+                }
+                pindex->nChainWork = UintToArith256(chain_work);
+                reader >> pindex->nFile >> pindex->nDataPos >> pindex->nUndoPos;
+                reader >> pindex->nVersion >> pindex->nTime >> pindex->nBits >> pindex->nNonce;
+                reader >> pindex->nStatus >> pindex->nTx;
+                sorted_by_height.push_back(pindex);
+            }
+            ret = true;
+        } catch (const std::exception& e) {
+            LogPrintf("Not using block index snapshot %s: %s\n", fs::PathToString(path), e.what());
+            sorted_by_height.clear();
+            m_block_index.clear();
+        }
+    }
+    fs::remove(path);
+
+    if (ret) {
+        LogPrintf("Loaded %u block index entries from snapshot in %gs\n",
+                  sorted_by_height.size(), (GetTimeMicros() - start) * 0.000001);
+    }
+    return ret;
+}
+
+bool BlockManager::WriteBlockIndexSnapshot()
 {
-    if (!m_block_tree_db->LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); })) {
+    AssertLockHeld(::cs_main);
+
+    if (!m_block_index_loaded || !m_block_tree_db || !m_dirty_blockindex.empty() || !m_dirty_fileinfo.empty()) {
         return false;
     }
 
-    // Calculate nChainWork
-    std::vector<CBlockIndex*> vSortedByHeight{GetAllBlockIndices()};
-    std::sort(vSortedByHeight.begin(), vSortedByHeight.end(),
-              CBlockIndexHeightOnlyComparator());
+    const int64_t start{GetTimeMicros()};
+    std::vector<CBlockIndex*> sorted_by_height{GetAllBlockIndices()};
+    std::sort(sorted_by_height.begin(), sorted_by_height.end(), CBlockIndexHeightOnlyComparator());
+    std::unordered_map<const CBlockIndex*, uint32_t> positions;
+    positions.reserve(sorted_by_height.size());
+    for (const CBlockIndex* pindex : sorted_by_height) {
+        positions.emplace(pindex, positions.size());
+    }
+
+    int last_file{0};
+    CBlockFileInfo last_info;
+    m_block_tree_db->ReadLastBlockFile(last_file);
+    m_block_tree_db->ReadBlockFileInfo(last_file, last_info);
+
+    const uint256 id{GetRandHash()};
+    const fs::path path{GetBlockIndexSnapshotPath()};
+    const fs::path path_new{gArgs.GetDataDirNet() / "blocks" / "index.snapshot.new"};
+    try {
+        CAutoFile file{fsbridge::fopen(path_new, "wb"), SER_DISK, CLIENT_VERSION};
+        if (file.IsNull()) {
+            throw std::runtime_error("cannot open file");
+        }
+
+        file << BLOCK_INDEX_SNAPSHOT_VERSION << id << last_file << last_info.nBlocks << last_info.nSize << last_info.nUndoSize;
+        file << uint64_t{sorted_by_height.size()};
+        for (const CBlockIndex* pindex : sorted_by_height) {
+            const uint32_t prev{pindex->pprev ? positions.at(pindex->pprev) : BLOCK_INDEX_SNAPSHOT_NO_PREV};
+            file << pindex->GetBlockHash() << pindex->hashMerkleRoot << ArithToUint256(pindex->nChainWork) << prev << pindex->nHeight;
+            file << pindex->nFile << pindex->nDataPos << pindex->nUndoPos;
+            file << pindex->nVersion << pindex->nTime << pindex->nBits << pindex->nNonce;
+            file << pindex->nStatus << pindex->nTx;
+        }
+
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        if (!RenameOver(path_new, path)) {
+            throw std::runtime_error("Rename failed");
+        }
+        // Only now that the file is complete may it be used
+        if (!m_block_tree_db->WriteBlockIndexSnapshotId(id)) {
+            throw std::runtime_error("cannot record snapshot in the block tree database");
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to write block index snapshot: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Wrote %u block index entries to snapshot in %gs\n",
+              sorted_by_height.size(), (GetTimeMicros() - start) * 0.000001);
+    return true;
+}
+
+bool BlockManager::LoadBlockIndex(const Consensus::Params& consensus_params)
+{
+    std::vector<CBlockIndex*> vSortedByHeight;
+    const bool from_snapshot{LoadBlockIndexSnapshot(vSortedByHeight)};
+    if (!from_snapshot) {
+        if (!m_block_tree_db->LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); })) {
+            return false;
+        }
+
+        vSortedByHeight = GetAllBlockIndices();
+        std::sort(vSortedByHeight.begin(), vSortedByHeight.end(),
+                  CBlockIndexHeightOnlyComparator());
+    }
 
     for (CBlockIndex* pindex : vSortedByHeight) {
         if (ShutdownRequested()) return false;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        // Calculate nChainWork, unless it was stored in the snapshot
+        if (!from_snapshot) {
+            pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        }
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
 
         // We can link the chain of blocks for which we've received transactions at some point, or
@@ -289,11 +526,13 @@ bool BlockManager::LoadBlockIndex(const Consensus::Params& consensus_params)
             pindexBestHeader = pindex;
     }
 
+    m_block_index_loaded = true;
     return true;
 }
 
 void BlockManager::Unload()
 {
+    m_block_index_loaded = false;
     m_blocks_unlinked.clear();
 
     m_block_index.clear();
@@ -451,7 +690,10 @@ CBlockFileInfo* BlockManager::GetBlockFileInfo(size_t n)
     return &m_blockfile_info.at(n);
 }
 
-static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+/** Flag in the size field of an undo record's header marking compressed data */
+static constexpr uint32_t UNDO_COMPRESSED_FLAG{0x80000000};
+
+static bool UndoWriteToDisk(Span<const unsigned char> undo_data, bool compressed, const uint256& checksum, FlatFilePos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -460,7 +702,8 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
     }
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo, fileout.GetVersion());
+    uint32_t nSize = undo_data.size();
+    if (compressed) nSize |= UNDO_COMPRESSED_FLAG;
     fileout << messageStart << nSize;
 
     // Write undo data
@@ -469,13 +712,10 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
         return error("%s: ftell failed", __func__);
     }
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    fileout.write(AsBytes(undo_data));
 
-    // calculate & write checksum
-    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-    hasher << hashBlock;
-    hasher << blockundo;
-    fileout << hasher.GetHash();
+    // Write checksum
+    fileout << checksum;
 
     return true;
 }
@@ -488,28 +728,54 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
         return error("%s: no undo data available", __func__);
     }
 
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, starting with the size in the header
+    CAutoFile filein(OpenUndoFile(FlatFilePos{pos.nFile, pos.nPos - static_cast<unsigned int>(sizeof(uint32_t))}, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
         return error("%s: OpenUndoFile failed", __func__);
     }
 
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
-        filein >> hashChecksum;
+        uint32_t nSize;
+        filein >> nSize;
+        if (nSize & UNDO_COMPRESSED_FLAG) {
+            std::vector<unsigned char> compressed(nSize & ~UNDO_COMPRESSED_FLAG);
+            if (compressed.size() > MAX_SIZE) {
+                return error("%s: Compressed undo data too large", __func__);
+            }
+            filein.read(MakeWritableByteSpan(compressed));
+            filein >> hashChecksum;
+            const auto undo_data{DecompressBytes(compressed, MAX_SIZE)};
+            if (!undo_data) {
+                return error("%s: Decompression failed", __func__);
+            }
+
+            // Verify checksum
+            CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+            hasher << pindex->pprev->GetBlockHash();
+            hasher.write(MakeByteSpan(*undo_data));
+            if (hashChecksum != hasher.GetHash()) {
+                return error("%s: Checksum mismatch", __func__);
+            }
+
+            CDataStream stream{*undo_data, SER_DISK, CLIENT_VERSION};
+            stream >> blockundo;
+        } else {
+            CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+            verifier << pindex->pprev->GetBlockHash();
+            verifier >> blockundo;
+            filein >> hashChecksum;
+
+            // Verify checksum
+            if (hashChecksum != verifier.GetHash()) {
+                return error("%s: Checksum mismatch", __func__);
+            }
+        }
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
-        return error("%s: Checksum mismatch", __func__);
-    }
-
     return true;
 }
 
@@ -531,6 +797,12 @@ void BlockManager::FlushBlockFile(bool fFinalize, bool finalize_undo)
     // we do not always flush the undo file, as the chain tip may be lagging behind the incoming blocks,
     // e.g. during IBD or a sync after a node going offline
     if (!fFinalize || finalize_undo) FlushUndoFile(m_last_blockfile, finalize_undo);
+    if (!fFinalize) {
+        for (const int undo_file : m_undo_files_to_finalize) {
+            FlushUndoFile(undo_file, /*finalize=*/true);
+        }
+        m_undo_files_to_finalize.clear();
+    }
 }
 
 uint64_t BlockManager::CalculateCurrentUsage()
@@ -685,20 +957,40 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
     AssertLockHeld(::cs_main);
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
+        CDataStream undo_data{SER_DISK, CLIENT_VERSION};
+        undo_data << blockundo;
+        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+        hasher << pindex->pprev->GetBlockHash();
+        hasher.write(MakeByteSpan(undo_data));
+
+        // Name operations repeat names, values and scripts in the spent coins
+        // and the name undo data, so compression often pays off.  Whether a
+        // record is compressed is stored in its header.
+        std::vector<unsigned char> compressed;
+        bool use_compressed{false};
+        if (m_compress_undo) {
+            compressed = CompressBytes(MakeUCharSpan(undo_data));
+            use_compressed = compressed.size() < undo_data.size();
+        }
+        const Span<const unsigned char> payload{use_compressed ? Span<const unsigned char>{compressed} : MakeUCharSpan(undo_data)};
+
         FlatFilePos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, CLIENT_VERSION) + 40)) {
+        if (!FindUndoPos(state, pindex->nFile, _pos, payload.size() + 40)) {
             return error("ConnectBlock(): FindUndoPos failed");
         }
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart())) {
+        if (!UndoWriteToDisk(payload, use_compressed, hasher.GetHash(), _pos, chainparams.MessageStart())) {
             return AbortNode(state, "Failed to write undo data");
         }
         // rev files are written in block height order, whereas blk files are written as blocks come in (often out of order)
-        // we want to flush the rev (undo) file once we've written the last block, which is indicated by the last height
+        // we want to finalize the rev (undo) file once we've written the last block, which is indicated by the last height
         // in the block file info as below; note that this does not catch the case where the undo writes are keeping up
         // with the block writes (usually when a synced up node is getting newly mined blocks) -- this case is caught in
-        // the FindBlockPos function
+        // the FindBlockPos function.  During IBD, many rev files are completed between two flushes of the chainstate,
+        // so they are only marked here and synced together by the next FlushBlockFile, before the block index
+        // referring to them is written.
         if (_pos.nFile < m_last_blockfile && static_cast<uint32_t>(pindex->nHeight) == m_blockfile_info[_pos.nFile].nHeightLast) {
-            FlushUndoFile(_pos.nFile, true);
+            LOCK(cs_LastBlockFile);
+            m_undo_files_to_finalize.insert(_pos.nFile);
         }
 
         // update nUndoPos in block index
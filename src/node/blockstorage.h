@@ -7,6 +7,7 @@
 
 #include <chain.h>
 #include <fs.h>
+#include <node/blockmap.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <sync.h>
 #include <txdb.h>
@@ -36,6 +37,8 @@ struct Params;
 
 namespace node {
 static constexpr bool DEFAULT_STOPAFTERBLOCKIMPORT{false};
+/** Default for -compressundo */
+static constexpr bool DEFAULT_COMPRESS_UNDO{false};
 
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
@@ -54,12 +57,6 @@ extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 
-// Because validation code takes pointers to the map's CBlockIndex objects, if
-// we ever switch to another associative container, we need to either use a
-// container that has stable addressing (true of all std associative
-// containers), or make the key a `std::unique_ptr<CBlockIndex>`
-using BlockMap = std::unordered_map<uint256, CBlockIndex, BlockHasher>;
-
 struct CBlockIndexWorkComparator {
     bool operator()(const CBlockIndex* pa, const CBlockIndex* pb) const;
 };
@@ -122,7 +119,27 @@ private:
     /** Dirty block file entries. */
     std::set<int> m_dirty_fileinfo;
 
+    /** Undo files that have been written completely, but not yet truncated
+     *  and synced to disk.  This is done for all of them at the next flush. */
+    std::set<int> m_undo_files_to_finalize GUARDED_BY(cs_LastBlockFile);
+
+    /** Whether new undo data is compressed (-compressundo) */
+    const bool m_compress_undo;
+
+    /** Whether m_block_index holds everything in the block tree database */
+    bool m_block_index_loaded GUARDED_BY(::cs_main){false};
+
+    /**
+     * Load the block index from the snapshot written by WriteBlockIndexSnapshot,
+     * if it matches the block tree database.  On success the entries are
+     * returned sorted by height with everything but the in-memory-only fields
+     * (except nChainWork) set.
+     */
+    bool LoadBlockIndexSnapshot(std::vector<CBlockIndex*>& sorted_by_height) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
 public:
+    BlockManager();
+
     BlockMap m_block_index GUARDED_BY(cs_main);
 
     std::vector<CBlockIndex*> GetAllBlockIndices() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
@@ -146,6 +163,15 @@ public:
     bool LoadBlockIndex(const Consensus::Params& consensus_params)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Write a snapshot of the whole block index to a flat file for fast
+     * loading on the next startup, and record it in the block tree database.
+     * Must be called after a final flush, when nothing can change the block
+     * index anymore.  The snapshot is used at most once: loading it erases
+     * its record, so that any later change to the database invalidates it.
+     */
+    bool WriteBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     /** Clear all data members. */
     void Unload() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -9,6 +9,8 @@
 #include <interfaces/chain.h>
 #include <net.h>
 #include <net_processing.h>
+#include <node/miner.h>
+#include <node/txprevalidation.h>
 #include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
@@ -8,6 +8,7 @@
 #include <chainparams.h>
 #include <deploymentstatus.h>
 #include <external_signer.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
@@ -397,7 +398,7 @@ public:
     explicit NotificationsHandlerImpl(std::shared_ptr<Chain::Notifications> notifications)
         : m_proxy(std::make_shared<NotificationsProxy>(std::move(notifications)))
     {
-        RegisterSharedValidationInterface(m_proxy);
+        RegisterSharedValidationInterface(m_proxy, "chainclient");
     }
     ~NotificationsHandlerImpl() override { disconnect(); }
     void disconnect() override
@@ -480,6 +481,23 @@ public:
         CBlockIndex* block = active[height];
         return block && ((block->nStatus & BLOCK_HAVE_DATA) != 0) && block->nTx > 0;
     }
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    std::optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) override
+    {
+        const BlockFilterIndex* block_filter_index{GetBlockFilterIndex(filter_type)};
+        if (!block_filter_index) return std::nullopt;
+
+        BlockFilter filter;
+        std::optional<GCSFilter> name_filter;
+        const CBlockIndex* index{WITH_LOCK(::cs_main, return chainman().m_blockman.LookupBlockIndex(block_hash))};
+        if (index == nullptr || !block_filter_index->LookupFilter(index, filter, name_filter)) return std::nullopt;
+        if (filter.GetFilter().MatchAny(filter_set)) return true;
+        // Entries indexed without the name address filter match any block
+        return !name_filter || name_filter->MatchAny(filter_set);
+    }
     CBlockLocator getTipLocator() override
     {
         LOCK(cs_main);
@@ -7,6 +7,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <cluster_linearize.h>
 #include <coins.h>
 #include <consensus/amount.h>
 #include <consensus/consensus.h>
@@ -25,6 +26,7 @@
 #include <validation.h>
 
 #include <algorithm>
+#include <queue>
 #include <utility>
 
 namespace node {
@@ -105,6 +107,11 @@ void BlockAssembler::resetBlock()
 }
 
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+{
+    return CreateNewBlock(scriptPubKeyIn, nullptr);
+}
+
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const TemplateSelection* incremental, bool* used_incremental)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -144,7 +151,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    const bool incremental_ok{incremental != nullptr && addIncrementalTxs(*incremental, nPackagesSelected)};
+    if (used_incremental) *used_incremental = incremental_ok;
+    if (!incremental_ok) {
+        if (m_mempool.IsClusterMode()) {
+            addClusterTxs(nPackagesSelected);
+        } else {
+            addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        }
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -213,7 +228,7 @@ bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost
 bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package) const
 {
     for (CTxMemPool::txiter it : package) {
-        if (!TxAllowedForNamecoin(it->GetTx())) {
+        if (!TxAllowedForNamecoin(*it)) {
             return false;
         }
         if (!IsFinalTx(it->GetTx(), nHeight, m_lock_time_cutoff)) {
@@ -224,53 +239,12 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
 }
 
 bool
-BlockAssembler::TxAllowedForNamecoin (const CTransaction& tx) const
+BlockAssembler::TxAllowedForNamecoin (const CTxMemPoolEntry& entry) const
 {
-  if (!tx.IsNamecoin ())
-    return true;
-
-  bool nameOutFound = false;
-  CNameScript nameOpOut;
-  for (const auto& txOut : tx.vout)
-    {
-      const CNameScript op(txOut.scriptPubKey);
-      if (op.isNameOp ())
-        {
-          nameOutFound = true;
-          nameOpOut = op;
-          break;
-        }
-    }
-
-  if (nameOutFound && nameOpOut.getNameOp () == OP_NAME_FIRSTUPDATE)
-    {
-      bool nameNewFound = false;
-      const auto& coinsTip = m_chainstate.CoinsTip ();
-      for (const auto& txIn : tx.vin)
-        {
-          Coin coin;
-          if (!coinsTip.GetCoin (txIn.prevout, coin))
-            continue;
-
-          const CNameScript op(coin.out.scriptPubKey);
-          if (op.isNameOp () && op.getNameOp () == OP_NAME_NEW)
-            {
-              const int minHeight = coin.nHeight + MIN_FIRSTUPDATE_DEPTH;
-              if (minHeight > nHeight)
-                return false;
-              nameNewFound = true;
-            }
-        }
-
-      /* If the name_new is not only immature but actually unconfirmed, then
-         the GetCoin lookup above fails for it and we never reach the height
-         check.  In this case, nameNewFound is false and we should not yet
-         include the transaction in a mined block.  */
-      if (!nameNewFound)
-        return false;
-    }
-
-  return true;
+  /* For NAME_FIRSTUPDATE's, the entry caches the height at which their
+     NAME_NEW input is mature (or MEMPOOL_HEIGHT if it is not yet confirmed
+     at all).  It is zero for all other transactions.  */
+  return entry.getNameMinHeight () <= static_cast<unsigned> (nHeight);
 }
 
 bool
@@ -503,6 +477,230 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     }
 }
 
+// In cluster mode, each cluster's linearization is already split into chunks
+// of decreasing feerate, each of which only depends on earlier chunks of the
+// same cluster.  Merging the chunk sequences of all clusters by feerate thus
+// gives a valid order without any ancestor bookkeeping.
+void BlockAssembler::addClusterTxs(int& nPackagesSelected)
+{
+    AssertLockHeld(m_mempool.cs);
+
+    // The next chunk to consider for every cluster
+    struct ClusterPos {
+        const std::vector<CTxMemPool::ClusterChunk>* chunks;
+        size_t next;
+    };
+    const auto compare = [](const ClusterPos& a, const ClusterPos& b) {
+        const CTxMemPool::ClusterChunk& chunk_a = (*a.chunks)[a.next];
+        const CTxMemPool::ClusterChunk& chunk_b = (*b.chunks)[b.next];
+        return cluster_linearize::FeerateHigher(chunk_b.fee, chunk_b.size, chunk_a.fee, chunk_a.size);
+    };
+    std::priority_queue<ClusterPos, std::vector<ClusterPos>, decltype(compare)> queue(compare);
+    for (const auto& [cluster_id, cluster] : m_mempool.GetLinearizedClusters()) {
+        queue.push({&cluster.chunks, 0});
+    }
+
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+
+    while (!queue.empty()) {
+        ClusterPos pos = queue.top();
+        queue.pop();
+        const CTxMemPool::ClusterChunk& chunk = (*pos.chunks)[pos.next];
+
+        if (chunk.fee < blockMinFeeRate.GetFee(chunk.size)) {
+            // Everything else we might consider has a lower fee rate
+            return;
+        }
+
+        // The remaining chunks of a cluster may depend on a chunk that
+        // failed, so the whole rest of the cluster is skipped.
+        CTxMemPool::setEntries package(chunk.txs.begin(), chunk.txs.end());
+        int64_t packageSigOpsCost = 0;
+        for (const auto it : chunk.txs) {
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+        if (!TestPackage(chunk.size, packageSigOpsCost)) {
+            ++nConsecutiveFailed;
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockWeight >
+                    nBlockMaxWeight - 4000) {
+                break;
+            }
+            continue;
+        }
+        if (!TestPackageTransactions(package) || !DbLockLimitOk(package)) {
+            continue;
+        }
+        nConsecutiveFailed = 0;
+
+        for (const auto it : chunk.txs) {
+            AddToBlock(it);
+        }
+        ++nPackagesSelected;
+
+        if (++pos.next < pos.chunks->size()) {
+            queue.push(pos);
+        }
+    }
+}
+
+bool BlockAssembler::addIncrementalTxs(const TemplateSelection& selection, int& nPackagesSelected)
+{
+    AssertLockHeld(m_mempool.cs);
+
+    std::vector<CTxMemPool::txiter> previous;
+    previous.reserve(selection.previous.size());
+    for (const auto& tx : selection.previous) {
+        const auto it = m_mempool.mapTx.find(tx->GetHash());
+        if (it == m_mempool.mapTx.end()) {
+            return false;
+        }
+        previous.push_back(it);
+    }
+
+    // The previous selection was valid on the same tip and all of it is still
+    // in the mempool, so it still is a valid (ancestor-closed) selection.
+    for (const auto it : previous) {
+        AddToBlock(it);
+    }
+
+    std::vector<CTxMemPool::txiter> candidates;
+    candidates.reserve(selection.added.size());
+    for (const auto& tx : selection.added) {
+        const auto it = m_mempool.mapTx.find(tx->GetHash());
+        if (it != m_mempool.mapTx.end() && !inBlock.count(it)) {
+            candidates.push_back(it);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](CTxMemPool::txiter a, CTxMemPool::txiter b) {
+        return CompareTxMemPoolEntryByAncestorFee()(*a, *b);
+    });
+
+    for (const auto iter : candidates) {
+        // May have been added already as ancestor of an earlier candidate
+        if (inBlock.count(iter)) continue;
+
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        m_mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        uint64_t packageSize = 0;
+        CAmount packageFees = 0;
+        int64_t packageSigOpsCost = 0;
+        for (const auto it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+
+        if (packageFees < blockMinFeeRate.GetFee(packageSize)) {
+            continue;
+        }
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            continue;
+        }
+        if (!TestPackageTransactions(ancestors) || !DbLockLimitOk(ancestors)) {
+            continue;
+        }
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (const auto it : sortedEntries) {
+            AddToBlock(it);
+        }
+        ++nPackagesSelected;
+    }
+
+    return true;
+}
+
+BlockTemplateBuilder::BlockTemplateBuilder(ChainstateManager& chainman, const CTxMemPool& mempool, std::chrono::seconds rebuild_interval)
+    : m_chainman(chainman),
+      m_mempool(mempool),
+      m_rebuild_interval(rebuild_interval)
+{
+}
+
+void BlockTemplateBuilder::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    // Nothing to extend until the next full rebuild
+    if (m_need_rebuild) return;
+
+    if (m_added.size() >= MAX_TEMPLATE_PENDING_TXS) {
+        m_need_rebuild = true;
+        m_added.clear();
+        return;
+    }
+    m_added.push_back(tx);
+}
+
+void BlockTemplateBuilder::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    LOCK(m_mutex);
+    if (m_need_rebuild) return;
+
+    if (m_selected_txids.count(tx->GetHash())) {
+        m_need_rebuild = true;
+        m_added.clear();
+    }
+}
+
+std::unique_ptr<CBlockTemplate> BlockTemplateBuilder::CreateNewBlock(const CScript& scriptPubKeyIn)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    LOCK2(cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+
+    CChainState& chainstate = m_chainman.ActiveChainstate();
+    const uint256 tip_hash = chainstate.m_chain.Tip()->GetBlockHash();
+    const auto now = GetTime<std::chrono::seconds>();
+    bool full = m_need_rebuild || tip_hash != m_tip_hash || now - m_last_rebuild >= m_rebuild_interval;
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    if (full) {
+        pblocktemplate = BlockAssembler(chainstate, m_mempool, Params()).CreateNewBlock(scriptPubKeyIn);
+    } else {
+        TemplateSelection selection;
+        selection.previous = std::move(m_selected);
+        selection.added = std::move(m_added);
+        bool used_incremental{false};
+        pblocktemplate = BlockAssembler(chainstate, m_mempool, Params()).CreateNewBlock(scriptPubKeyIn, &selection, &used_incremental);
+        // The assembler falls back to a full selection if the previous one is stale.
+        full = !used_incremental;
+    }
+    if (full) {
+        m_last_rebuild = now;
+        ++m_full_rebuilds;
+    } else {
+        ++m_incremental_updates;
+    }
+    if (!pblocktemplate) {
+        m_need_rebuild = true;
+        return nullptr;
+    }
+
+    const auto& vtx = pblocktemplate->block.vtx;
+    m_selected.assign(vtx.begin() + 1, vtx.end());
+    m_selected_txids.clear();
+    for (const auto& tx : m_selected) {
+        m_selected_txids.insert(tx->GetHash());
+    }
+    m_added.clear();
+    m_tip_hash = tip_hash;
+    m_need_rebuild = false;
+
+    LogPrint(BCLog::BENCH, "BlockTemplateBuilder: %s template with %u txs in %.2fms\n",
+             full ? "full" : "incremental", m_selected.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return pblocktemplate;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
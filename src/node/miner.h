@@ -7,11 +7,17 @@
 #define BITCOIN_NODE_MINER_H
 
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <uint256.h>
+#include <validationinterface.h>
 
+#include <chrono>
 #include <memory>
 #include <optional>
+#include <set>
 #include <stdint.h>
+#include <vector>
 
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
@@ -25,6 +31,10 @@ namespace Consensus { struct Params; };
 
 namespace node {
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Maximum age of an incrementally maintained block template before the transaction selection is rebuilt from scratch */
+static constexpr std::chrono::seconds DEFAULT_TEMPLATE_REBUILD_INTERVAL{30};
+/** Maximum number of new mempool transactions to track between templates before forcing a full rebuild */
+static constexpr size_t MAX_TEMPLATE_PENDING_TXS{5000};
 
 struct CBlockTemplate
 {
@@ -124,6 +134,13 @@ struct update_for_parent_inclusion
     CTxMemPool::txiter iter;
 };
 
+/** Transaction selection of a previous block template, and the transactions
+ *  that entered the mempool since it was built. */
+struct TemplateSelection {
+    std::vector<CTransactionRef> previous;
+    std::vector<CTransactionRef> added;
+};
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler
 {
@@ -162,6 +179,12 @@ public:
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    /** Construct a new block template extending the given previous selection
+     *  with the newly added transactions only.  Falls back to the full package
+     *  selection if the previous selection is no longer valid.  If
+     *  used_incremental is given, it is set to whether the previous selection
+     *  was used. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, const TemplateSelection* incremental, bool* used_incremental = nullptr);
 
     inline static std::optional<int64_t> m_last_block_num_txs{};
     inline static std::optional<int64_t> m_last_block_weight{};
@@ -178,6 +201,14 @@ private:
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics). */
     void addPackageTxs(int& nPackagesSelected, int& nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Add transactions by merging the chunks of all mempool clusters in
+      * feerate order.  Only used when the mempool is in cluster mode. */
+    void addClusterTxs(int& nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
+    /** Add all transactions of a previous selection, followed by packages of
+      * the newly added transactions in ancestor feerate order.  Returns false
+      * without modifying the block if a previously selected transaction is
+      * no longer in the mempool. */
+    bool addIncrementalTxs(const TemplateSelection& selection, int& nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -203,12 +234,61 @@ private:
      * Verify if a tx can be added from a Namecoin perspective.  This may not
      * (yet) be the case if it is a NAME_FIRSTUPDATE with a not-yet-mature
      * NAME_NEW.  Those are allowed in the mempool, but not in blocks.
+     * The maturity height is precomputed on the mempool entry.
      */
-    bool TxAllowedForNamecoin(const CTransaction& tx) const;
+    bool TxAllowedForNamecoin(const CTxMemPoolEntry& entry) const;
     /** Check DB lock limit.  */
     bool DbLockLimitOk(const CTxMemPool::setEntries& candidates) const;
 };
 
+/**
+ * Persistent block template builder used by the mining RPCs.  It follows
+ * mempool additions and removals through the validation interface and
+ * produces new templates by extending the transaction selection of the
+ * previous one with the transactions that arrived since, instead of running
+ * the full package selection over the whole mempool each time.
+ *
+ * The selection is rebuilt from scratch when the tip changes, when a selected
+ * transaction leaves the mempool, and at least every rebuild interval, which
+ * bounds the drift from the selection a full rebuild would make (e.g. when
+ * better paying transactions arrive while the block is already full).
+ */
+class BlockTemplateBuilder final : public CValidationInterface
+{
+private:
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    const std::chrono::seconds m_rebuild_interval;
+
+    mutable Mutex m_mutex;
+    //! Tip the previous selection was built on
+    uint256 m_tip_hash GUARDED_BY(m_mutex);
+    //! Transactions of the previous template in block order, excluding the coinbase
+    std::vector<CTransactionRef> m_selected GUARDED_BY(m_mutex);
+    std::set<uint256> m_selected_txids GUARDED_BY(m_mutex);
+    //! Transactions added to the mempool since the previous template
+    std::vector<CTransactionRef> m_added GUARDED_BY(m_mutex);
+    bool m_need_rebuild GUARDED_BY(m_mutex){true};
+    std::chrono::seconds m_last_rebuild GUARDED_BY(m_mutex){0};
+
+    uint64_t m_full_rebuilds GUARDED_BY(m_mutex){0};
+    uint64_t m_incremental_updates GUARDED_BY(m_mutex){0};
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override;
+
+public:
+    explicit BlockTemplateBuilder(ChainstateManager& chainman, const CTxMemPool& mempool,
+                                  std::chrono::seconds rebuild_interval = DEFAULT_TEMPLATE_REBUILD_INTERVAL);
+
+    /** Construct a new block template with coinbase to scriptPubKeyIn */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    uint64_t GetFullRebuilds() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { return WITH_LOCK(m_mutex, return m_full_rebuilds); }
+    uint64_t GetIncrementalUpdates() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { return WITH_LOCK(m_mutex, return m_incremental_updates); }
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
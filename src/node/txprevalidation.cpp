@@ -0,0 +1,217 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txprevalidation.h>
+
+#include <coins.h>
+#include <consensus/tx_check.h>
+#include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <policy/policy.h>
+#include <policy/settings.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+#include <util/syscall_sandbox.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <exception>
+#include <string>
+
+namespace node {
+
+TxPrevalidator::TxPrevalidator(ChainstateManager& chainman, const CTxMemPool& mempool, int num_threads)
+    : m_chainman(chainman), m_mempool(mempool)
+{
+    for (int n = 0; n < num_threads; ++n) {
+        m_worker_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("txprecheck.%i", n));
+            SetSyscallSandboxPolicy(SyscallSandboxPolicy::MESSAGE_HANDLER);
+            ThreadPrevalidate();
+        });
+    }
+}
+
+TxPrevalidator::~TxPrevalidator()
+{
+    Stop();
+}
+
+void TxPrevalidator::Submit(const CDataStream& tx_data)
+{
+    {
+        LOCK(m_mutex);
+        if (m_request_stop || m_queue_bytes + tx_data.size() > MAX_TX_PREVALIDATION_BYTES) return;
+        m_queue.push_back(tx_data);
+        m_queue_bytes += tx_data.size();
+    }
+    m_cond.notify_one();
+}
+
+void TxPrevalidator::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_request_stop = true;
+        m_queue.clear();
+        m_queue_bytes = 0;
+    }
+    m_cond.notify_all();
+    for (std::thread& t : m_worker_threads) {
+        t.join();
+    }
+    m_worker_threads.clear();
+}
+
+void TxPrevalidator::ThreadPrevalidate()
+{
+    while (true) {
+        std::vector<CDataStream> batch;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_request_stop && m_queue.empty()) {
+                m_cond.wait(lock);
+            }
+            if (m_request_stop) return;
+            while (!m_queue.empty() && batch.size() < MAX_TX_PREVALIDATION_BATCH) {
+                m_queue_bytes -= m_queue.front().size();
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+        }
+
+        // The message handler ignores transactions during IBD
+        if (m_chainman.ActiveChainstate().IsInitialBlockDownload()) continue;
+
+        std::vector<CTransactionRef> txs;
+        txs.reserve(batch.size());
+        for (CDataStream& tx_data : batch) {
+            CTransactionRef tx;
+            try {
+                tx_data >> tx;
+            } catch (const std::exception&) {
+                // Malformed, the message handler will deal with it
+                ++m_failed;
+                continue;
+            }
+            txs.push_back(std::move(tx));
+        }
+
+        for (const bool passed : Prevalidate(txs)) {
+            if (passed) {
+                ++m_passed;
+            } else {
+                ++m_failed;
+            }
+        }
+    }
+}
+
+bool TxPrevalidator::Prevalidate(const CTransaction& tx) const
+{
+    return Prevalidate(std::vector<CTransactionRef>{MakeTransactionRef(tx)}).front();
+}
+
+std::vector<bool> TxPrevalidator::Prevalidate(const std::vector<CTransactionRef>& txs) const
+{
+    std::vector<bool> passed(txs.size(), false);
+
+    // Context-free checks first, so that no lock is taken for transactions
+    // failing them.
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < txs.size(); ++i) {
+        const CTransaction& tx = *txs[i];
+        TxValidationState state;
+        if (!CheckTransaction(tx, state) || tx.IsCoinBase()) continue;
+        std::string reason;
+        if (fRequireStandard && !IsStandardTx(tx, reason)) continue;
+        candidates.push_back(i);
+    }
+    if (candidates.empty()) return passed;
+
+    // Copy the spent coins, the fee deltas and the mempool minimum fee for the
+    // whole batch at once, so that the remaining checks can run without
+    // holding any lock.  Coins that were not cached before are uncached
+    // again, as AcceptToMemoryPool does for rejected transactions.
+    CCoinsView dummy;
+    CCoinsViewCache inputs(&dummy);
+    std::vector<CAmount> fee_deltas(txs.size(), 0);
+    std::vector<bool> have_inputs(txs.size(), false);
+    CFeeRate mempool_min_fee;
+    int spend_height{0};
+    {
+        LOCK2(::cs_main, m_mempool.cs);
+        CChainState& chainstate = m_chainman.ActiveChainstate();
+        CCoinsViewCache& coins_tip = chainstate.CoinsTip();
+        CCoinsViewMemPool view(&coins_tip, m_mempool);
+        std::vector<COutPoint> coins_to_uncache;
+        for (const size_t i : candidates) {
+            const CTransaction& tx = *txs[i];
+            if (m_mempool.exists(GenTxid::Wtxid(tx.GetWitnessHash()))) continue;
+            have_inputs[i] = true;
+            for (const CTxIn& txin : tx.vin) {
+                // Shared by several transactions of the batch
+                if (inputs.HaveCoinInCache(txin.prevout)) continue;
+                if (!coins_tip.HaveCoinInCache(txin.prevout)) {
+                    coins_to_uncache.push_back(txin.prevout);
+                }
+                Coin coin;
+                if (!view.GetCoin(txin.prevout, coin)) {
+                    have_inputs[i] = false;
+                    break;
+                }
+                inputs.AddCoin(txin.prevout, std::move(coin), /*possible_overwrite=*/false);
+            }
+            m_mempool.ApplyDelta(tx.GetHash(), fee_deltas[i]);
+        }
+        for (const COutPoint& outpoint : coins_to_uncache) {
+            coins_tip.Uncache(outpoint);
+        }
+        mempool_min_fee = m_mempool.GetMinFee(gArgs.GetIntArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        spend_height = chainstate.m_chain.Height() + 1;
+    }
+
+    // Same flags as used by MemPoolAccept::PreChecks and PolicyScriptChecks
+    constexpr unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS | SCRIPT_VERIFY_NAMES_MEMPOOL;
+
+    for (const size_t i : candidates) {
+        if (!have_inputs[i]) continue;
+        const CTransaction& tx = *txs[i];
+
+        TxValidationState state;
+        CAmount fee;
+        if (!Consensus::CheckTxInputs(tx, state, inputs, spend_height, flags, fee)) continue;
+
+        // The fee checks of MemPoolAccept::PreChecks, so that no time is spent
+        // on the scripts of a transaction that will be rejected anyway.
+        const int64_t vsize{GetVirtualTransactionSize(tx, GetTransactionSigOpCost(tx, inputs, flags))};
+        const CAmount modified_fee{fee + fee_deltas[i]};
+        const CAmount mempool_reject_fee{mempool_min_fee.GetFee(vsize)};
+        if (mempool_reject_fee > 0 && modified_fee < mempool_reject_fee) continue;
+        if (modified_fee < ::minRelayTxFee.GetFee(vsize)) continue;
+
+        std::vector<CTxOut> spent_outputs;
+        spent_outputs.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            spent_outputs.emplace_back(inputs.AccessCoin(txin.prevout).out);
+        }
+        PrecomputedTransactionData txdata;
+        txdata.Init(tx, std::move(spent_outputs));
+
+        // Verify all scripts, storing the valid signatures in the cache.
+        bool scripts_ok{true};
+        for (unsigned int n = 0; n < tx.vin.size() && scripts_ok; ++n) {
+            CScriptCheck check(inputs.AccessCoin(tx.vin[n].prevout).out, tx, n, flags, /*cacheIn=*/true, &txdata);
+            scripts_ok = check();
+        }
+        passed[i] = scripts_ok;
+    }
+
+    return passed;
+}
+
+} // namespace node
@@ -0,0 +1,91 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_TXPREVALIDATION_H
+#define BITCOIN_NODE_TXPREVALIDATION_H
+
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <sync.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+
+class CTxMemPool;
+class ChainstateManager;
+extern RecursiveMutex cs_main;
+
+namespace node {
+
+/** Default for -txprevalidationthreads, 0 disables prevalidation */
+static constexpr int DEFAULT_TX_PREVALIDATION_THREADS{2};
+/** Maximum total size of transactions waiting for prevalidation; more are dropped */
+static constexpr size_t MAX_TX_PREVALIDATION_BYTES{10'000'000};
+/** Maximum number of queued transactions a worker prevalidates under one lock */
+static constexpr size_t MAX_TX_PREVALIDATION_BATCH{16};
+
+/**
+ * Worker pool that runs the expensive parts of mempool acceptance for
+ * relayed transactions ahead of time, in parallel and without holding
+ * cs_main while doing so.
+ *
+ * Transactions are submitted in serialized form as soon as they are received
+ * from the network, before they are queued for the message handler.  Workers
+ * take up to MAX_TX_PREVALIDATION_BATCH of them at a time, deserialize them
+ * and run the context-free checks.  They then take cs_main once for the whole
+ * batch to copy the coins spent, the fee deltas and the mempool minimum fee,
+ * and run the input checks (including the Namecoin rules), the fee checks
+ * and finally the scripts against that copy.  Successfully verified
+ * signatures are stored in the signature cache.
+ *
+ * Nothing is added to the mempool here: AcceptToMemoryPool still runs all of
+ * its checks serially on the message handler thread, including conflicts and
+ * the inputs themselves, but its script checks then mostly hit the signature
+ * cache.  A transaction that fails prevalidation is simply validated in full.
+ */
+class TxPrevalidator
+{
+public:
+    TxPrevalidator(ChainstateManager& chainman, const CTxMemPool& mempool, int num_threads);
+    ~TxPrevalidator();
+
+    /** Queue a serialized transaction.  Dropped if the queue is full. */
+    void Submit(const CDataStream& tx_data) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Run all prevalidation checks for a batch of transactions in the
+     *  calling thread, returning which of them passed. */
+    std::vector<bool> Prevalidate(const std::vector<CTransactionRef>& txs) const LOCKS_EXCLUDED(::cs_main);
+    bool Prevalidate(const CTransaction& tx) const LOCKS_EXCLUDED(::cs_main);
+
+    /** Stop and join the worker threads, discarding queued transactions. */
+    void Stop();
+
+    uint64_t GetPassed() const { return m_passed; }
+    uint64_t GetFailed() const { return m_failed; }
+    size_t GetQueuedBytes() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) { return WITH_LOCK(m_mutex, return m_queue_bytes); }
+
+private:
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<CDataStream> m_queue GUARDED_BY(m_mutex);
+    size_t m_queue_bytes GUARDED_BY(m_mutex){0};
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_worker_threads;
+
+    std::atomic<uint64_t> m_passed{0};
+    std::atomic<uint64_t> m_failed{0};
+
+    void ThreadPrevalidate();
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_TXPREVALIDATION_H
@@ -13,10 +13,16 @@
 #include <util/serfloat.h>
 #include <util/system.h>
 
+#include <algorithm>
+#include <utility>
+
 static const char* FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
 
 static constexpr double INF_FEERATE = 1e99;
 
+/** Client version from which on the estimates file uses the sparse encoding */
+static constexpr int SPARSE_ESTIMATES_VERSION = 239900;
+
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon)
 {
     switch (horizon) {
@@ -44,6 +50,52 @@ struct EncodedDoubleFormatter
     }
 };
 
+/**
+ * Formatter for the per-bucket vectors of the estimates file.  Most buckets
+ * never see a transaction, so only the non-zero entries are written, each
+ * preceded by the number of zero entries skipped since the previous one.
+ */
+struct SparseDoubleVectorFormatter
+{
+    /** Upper bound on the size of vectors read, matching the bucket limit */
+    static constexpr uint64_t MAX_SIZE = 1000;
+
+    template<typename Stream> void Ser(Stream& s, const std::vector<double>& v)
+    {
+        WriteCompactSize(s, v.size());
+        WriteCompactSize(s, std::count_if(v.begin(), v.end(), [](double x) { return x != 0; }));
+        uint64_t skipped = 0;
+        for (const double x : v) {
+            if (x == 0) {
+                ++skipped;
+                continue;
+            }
+            s << VARINT(skipped) << EncodeDouble(x);
+            skipped = 0;
+        }
+    }
+
+    template<typename Stream> void Unser(Stream& s, std::vector<double>& v)
+    {
+        const uint64_t size = ReadCompactSize(s);
+        const uint64_t nonzero = ReadCompactSize(s);
+        if (size > MAX_SIZE || nonzero > size) {
+            throw std::ios_base::failure("Invalid sparse vector");
+        }
+        v.assign(size, 0);
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < nonzero; ++i) {
+            uint64_t skipped, encoded;
+            s >> VARINT(skipped) >> encoded;
+            if (skipped >= size - pos) {
+                throw std::ios_base::failure("Invalid sparse vector");
+            }
+            pos += skipped;
+            v[pos++] = DecodeDouble(encoded);
+        }
+    }
+};
+
 } // namespace
 
 /**
@@ -150,6 +202,7 @@ public:
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
      * variables with this state.
+     * @param nFileVersion the version required to read the file, which selects its encoding
      */
     void Read(CAutoFile& filein, int nFileVersion, size_t numBuckets);
 };
@@ -210,14 +263,16 @@ void TxConfirmStats::Record(int blocksToConfirm, double feerate)
 void TxConfirmStats::UpdateMovingAverages()
 {
     assert(confAvg.size() == failAvg.size());
-    for (unsigned int j = 0; j < buckets.size(); j++) {
-        for (unsigned int i = 0; i < confAvg.size(); i++) {
-            confAvg[i][j] *= decay;
-            failAvg[i][j] *= decay;
-        }
-        m_feerate_avg[j] *= decay;
-        txCtAvg[j] *= decay;
+    // Decay one contiguous vector at a time so that the loops vectorize.
+    const auto decay_all = [d = decay](std::vector<double>& v) {
+        for (double& x : v) x *= d;
+    };
+    for (unsigned int i = 0; i < confAvg.size(); i++) {
+        decay_all(confAvg[i]);
+        decay_all(failAvg[i]);
     }
+    decay_all(m_feerate_avg);
+    decay_all(txCtAvg);
 }
 
 // returns -1 on error conditions
@@ -378,10 +433,20 @@ void TxConfirmStats::Write(CAutoFile& fileout) const
 {
     fileout << Using<EncodedDoubleFormatter>(decay);
     fileout << scale;
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
-    fileout << Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
-    fileout << Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
+    fileout << Using<SparseDoubleVectorFormatter>(m_feerate_avg);
+    fileout << Using<SparseDoubleVectorFormatter>(txCtAvg);
+    fileout << Using<VectorFormatter<SparseDoubleVectorFormatter>>(confAvg);
+    fileout << Using<VectorFormatter<SparseDoubleVectorFormatter>>(failAvg);
+}
+
+template <typename Formatter>
+static void ReadAverages(CAutoFile& filein, std::vector<double>& feerate_avg, std::vector<double>& tx_ct_avg,
+                         std::vector<std::vector<double>>& conf_avg, std::vector<std::vector<double>>& fail_avg)
+{
+    filein >> Using<Formatter>(feerate_avg);
+    filein >> Using<Formatter>(tx_ct_avg);
+    filein >> Using<VectorFormatter<Formatter>>(conf_avg);
+    filein >> Using<VectorFormatter<Formatter>>(fail_avg);
 }
 
 void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets)
@@ -401,15 +466,18 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         throw std::runtime_error("Corrupt estimates file. Scale must be non-zero");
     }
 
-    filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(m_feerate_avg);
+    if (nFileVersion >= SPARSE_ESTIMATES_VERSION) {
+        ReadAverages<SparseDoubleVectorFormatter>(filein, m_feerate_avg, txCtAvg, confAvg, failAvg);
+    } else {
+        ReadAverages<VectorFormatter<EncodedDoubleFormatter>>(filein, m_feerate_avg, txCtAvg, confAvg, failAvg);
+    }
+
     if (m_feerate_avg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in feerate average bucket count");
     }
-    filein >> Using<VectorFormatter<EncodedDoubleFormatter>>(txCtAvg);
     if (txCtAvg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
     }
-    filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(confAvg);
     maxPeriods = confAvg.size();
     maxConfirms = scale * maxPeriods;
 
@@ -422,7 +490,6 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         }
     }
 
-    filein >> Using<VectorFormatter<VectorFormatter<EncodedDoubleFormatter>>>(failAvg);
     if (maxPeriods != failAvg.size()) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in confirms tracked for failures");
     }
@@ -501,6 +568,9 @@ bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
     AssertLockHeld(m_cs_fee_estimator);
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
+        // Transactions that entered the mempool at the current tip are not
+        // counted by any estimate yet
+        if (pos->second.blockHeight != nBestSeenHeight) m_smart_fee_cache.clear();
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
@@ -625,6 +695,7 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     // calls to removeTx (via processBlockTx) correctly calculate age
     // of unconfirmed txs to remove from tracking.
     nBestSeenHeight = nBlockHeight;
+    m_smart_fee_cache.clear();
 
     // Update unconfirmed circular buffer
     feeStats->ClearCurrent(nBlockHeight);
@@ -814,6 +885,26 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
 {
     LOCK(m_cs_fee_estimator);
 
+    // Only cache valid targets so that the cache stays bounded
+    if (confTarget <= 0 || (unsigned int)confTarget > longStats->GetMaxConfirms()) {
+        return _estimateSmartFee(confTarget, feeCalc, conservative);
+    }
+
+    const auto key = std::make_pair(confTarget, conservative);
+    auto it = m_smart_fee_cache.find(key);
+    if (it == m_smart_fee_cache.end()) {
+        FeeCalculation calc;
+        const CFeeRate feerate = _estimateSmartFee(confTarget, &calc, conservative);
+        it = m_smart_fee_cache.emplace(key, std::make_pair(feerate, calc)).first;
+    }
+    if (feeCalc) *feeCalc = it->second.second;
+    return it->second.first;
+}
+
+CFeeRate CBlockPolicyEstimator::_estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+{
+    AssertLockHeld(m_cs_fee_estimator);
+
     if (feeCalc) {
         feeCalc->desiredTarget = confTarget;
         feeCalc->returnedTarget = confTarget;
@@ -902,7 +993,7 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
         LOCK(m_cs_fee_estimator);
-        fileout << 149900; // version required to read: 0.14.99 or later
+        fileout << SPARSE_ESTIMATES_VERSION; // version required to read
         fileout << CLIENT_VERSION; // version that wrote the file
         fileout << nBestSeenHeight;
         if (BlockSpan() > HistoricalBlockSpan()/2) {
@@ -956,9 +1047,9 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             std::unique_ptr<TxConfirmStats> fileFeeStats(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
             std::unique_ptr<TxConfirmStats> fileShortStats(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
             std::unique_ptr<TxConfirmStats> fileLongStats(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
-            fileFeeStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
+            fileFeeStats->Read(filein, nVersionRequired, numBuckets);
+            fileShortStats->Read(filein, nVersionRequired, numBuckets);
+            fileLongStats->Read(filein, nVersionRequired, numBuckets);
 
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
@@ -976,6 +1067,7 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
+            m_smart_fee_cache.clear();
         }
     }
     catch (const std::exception& e) {
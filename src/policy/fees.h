@@ -15,6 +15,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 class CAutoFile;
@@ -266,6 +267,11 @@ private:
     std::vector<double> buckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap GUARDED_BY(m_cs_fee_estimator); // Map of bucket upper-bound to index into all vectors by bucket
 
+    /** Results of estimateSmartFee keyed by (confTarget, conservative).  Only
+     *  new blocks and removal of transactions that entered the mempool before
+     *  the current tip change the estimates, so this is cleared then. */
+    mutable std::map<std::pair<int, bool>, std::pair<CFeeRate, FeeCalculation>> m_smart_fee_cache GUARDED_BY(m_cs_fee_estimator);
+
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
@@ -280,6 +286,10 @@ private:
     /** Calculation of highest target that reasonable estimate can be provided for */
     unsigned int MaxUsableEstimate() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
+    /** estimateSmartFee without the result cache */
+    CFeeRate _estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+        EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+
     /** A non-thread-safe helper for the removeTx function */
     bool _removeTx(const uint256& hash, bool inBlock)
         EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
@@ -54,7 +54,8 @@ void auxMiningCheck(const node::NodeContext& node)
 const CBlock*
 AuxpowMiner::getCurrentBlock (const ChainstateManager& chainman,
                               const CTxMemPool& mempool,
-                              const CScript& scriptPubKey, uint256& target)
+                              const CScript& scriptPubKey, uint256& target,
+                              node::BlockTemplateBuilder* builder)
 {
   AssertLockHeld (cs);
   const CBlock* pblockCur = nullptr;
@@ -79,10 +80,17 @@ AuxpowMiner::getCurrentBlock (const ChainstateManager& chainman,
             curBlocks.clear ();
           }
 
-        /* Create new block with nonce = 0 and extraNonce = 1.  */
-        std::unique_ptr<node::CBlockTemplate> newBlock
-            = BlockAssembler (chainman.ActiveChainstate (), mempool, Params ())
-                .CreateNewBlock (scriptPubKey);
+        /* Create new block with nonce = 0 and extraNonce = 1.  If the node
+           maintains a template builder, use it so that only transactions
+           added since the last template need to be selected.  */
+        std::unique_ptr<node::CBlockTemplate> newBlock;
+        if (builder != nullptr)
+          newBlock = builder->CreateNewBlock (scriptPubKey);
+        else
+          newBlock
+              = BlockAssembler (chainman.ActiveChainstate (), mempool,
+                                Params ())
+                  .CreateNewBlock (scriptPubKey);
         if (newBlock == nullptr)
           throw JSONRPCError (RPC_OUT_OF_MEMORY, "out of memory");
 
@@ -147,7 +155,8 @@ AuxpowMiner::createAuxBlock (const JSONRPCRequest& request,
   const auto& chainman = EnsureChainman (node);
 
   uint256 target;
-  const CBlock* pblock = getCurrentBlock (chainman, mempool, scriptPubKey, target);
+  const CBlock* pblock = getCurrentBlock (chainman, mempool, scriptPubKey,
+                                          target, node.template_builder.get ());
 
   UniValue result(UniValue::VOBJ);
   result.pushKV ("hash", pblock->GetHash ().GetHex ());
@@ -21,6 +21,7 @@
 
 class ChainstateManager;
 namespace node {
+class BlockTemplateBuilder;
 class CBlockTemplate;
 } // namespace node
 
@@ -67,7 +68,8 @@ private:
    */
   const CBlock* getCurrentBlock (const ChainstateManager& chainman,
                                  const CTxMemPool& mempool,
-                                 const CScript& scriptPubKey, uint256& target)
+                                 const CScript& scriptPubKey, uint256& target,
+                                 node::BlockTemplateBuilder* builder = nullptr)
       EXCLUSIVE_LOCKS_REQUIRED (cs);
 
   /**
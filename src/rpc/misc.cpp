@@ -26,6 +26,8 @@
 #include <util/strencodings.h>
 #include <util/syscall_sandbox.h>
 #include <util/system.h>
+#include <util/time.h>
+#include <validationinterface.h>
 
 #include <optional>
 #include <stdint.h>
@@ -496,6 +498,77 @@ static RPCHelpMan mockscheduler()
     };
 }
 
+static RPCHelpMan getschedulerinfo()
+{
+    return RPCHelpMan{"getschedulerinfo",
+        "Returns statistics about the periodic background tasks run by the scheduler, by task name,\n"
+        "and about the queues of validation notifications waiting for each subscriber.\n"
+        "The delay of a task is the time between when it was due and when it started running.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+            {
+                {RPCResult::Type::NUM, "queued", "Number of tasks waiting to run"},
+                {RPCResult::Type::OBJ_DYN, "tasks", "Statistics of the tasks run so far",
+                {
+                    {RPCResult::Type::OBJ, "name", "Name of the task (\"other\" for unnamed tasks)",
+                    {
+                        {RPCResult::Type::NUM, "count", "Number of times the task ran"},
+                        {RPCResult::Type::NUM, "delay_p50", "Median delay in microseconds, rounded up to a power of two"},
+                        {RPCResult::Type::NUM, "delay_p99", "99th percentile delay in microseconds, rounded up to a power of two"},
+                        {RPCResult::Type::NUM, "delay_max", "Largest delay in microseconds"},
+                        {RPCResult::Type::NUM, "runtime_max", "Longest run time in microseconds"},
+                    }},
+                }},
+                {RPCResult::Type::ARR, "validationqueues", "Notification queue of each validation interface subscriber, in registration order",
+                {
+                    {RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::STR, "name", "Name of the subscriber (\"other\" for unnamed subscribers)"},
+                        {RPCResult::Type::NUM, "pending", "Number of notifications waiting to be delivered"},
+                        {RPCResult::Type::NUM, "max_pending", "Largest number of waiting notifications seen"},
+                        {RPCResult::Type::NUM, "processed", "Number of notifications delivered"},
+                    }},
+                }},
+            }},
+        RPCExamples{
+            HelpExampleCli("getschedulerinfo", "")
+            + HelpExampleRpc("getschedulerinfo", "")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const NodeContext& node = EnsureAnyNodeContext(request.context);
+    CHECK_NONFATAL(node.scheduler);
+
+    std::chrono::system_clock::time_point first, last;
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("queued", uint64_t(node.scheduler->getQueueInfo(first, last)));
+    UniValue tasks(UniValue::VOBJ);
+    for (const auto& [name, stats] : node.scheduler->GetTaskStats()) {
+        UniValue task(UniValue::VOBJ);
+        task.pushKV("count", stats.count);
+        task.pushKV("delay_p50", count_microseconds(stats.delay_p50));
+        task.pushKV("delay_p99", count_microseconds(stats.delay_p99));
+        task.pushKV("delay_max", count_microseconds(stats.delay_max));
+        task.pushKV("runtime_max", count_microseconds(stats.runtime_max));
+        tasks.pushKV(name, task);
+    }
+    result.pushKV("tasks", tasks);
+    UniValue queues(UniValue::VARR);
+    for (const ValidationQueueStats& stats : GetMainSignals().GetQueueStats()) {
+        UniValue queue(UniValue::VOBJ);
+        queue.pushKV("name", stats.name);
+        queue.pushKV("pending", uint64_t(stats.pending));
+        queue.pushKV("max_pending", uint64_t(stats.max_pending));
+        queue.pushKV("processed", stats.processed);
+        queues.push_back(queue);
+    }
+    result.pushKV("validationqueues", queues);
+    return result;
+},
+    };
+}
+
 static UniValue RPCLockedMemoryInfo()
 {
     LockedPool::Stats stats = LockedPoolManager::Instance().stats();
@@ -811,6 +884,7 @@ static const CRPCCommand commands[] =
 { //  category              actor (function)
   //  --------------------- ------------------------
     { "control",            &getmemoryinfo,           },
+    { "control",            &getschedulerinfo,        },
     { "control",            &logging,                 },
     { "util",               &validateaddress,         },
     { "util",               &createmultisig,          },
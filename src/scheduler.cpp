@@ -4,15 +4,154 @@
 
 #include <scheduler.h>
 
+#include <crypto/common.h>
 #include <random.h>
+#include <tinyformat.h>
 #include <util/syscall_sandbox.h>
+#include <util/threadnames.h>
 #include <util/time.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <functional>
 #include <utility>
 
-CScheduler::CScheduler()
+TimerWheel::TimerWheel(Clock::time_point now) : m_current_tick(ToTick(now)) {}
+
+uint64_t TimerWheel::ToTick(Clock::time_point t)
+{
+    const auto ticks{std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()) / TICK};
+    return ticks > 0 ? ticks : 0;
+}
+
+TimerWheel::Clock::time_point TimerWheel::FromTick(uint64_t tick)
+{
+    return Clock::time_point{std::chrono::duration_cast<Clock::duration>(tick * TICK)};
+}
+
+void TimerWheel::Place(Task task)
+{
+    const uint64_t tick{ToTick(task.time)};
+    if (tick <= m_current_tick) {
+        m_due.emplace(task.time, std::move(task));
+        return;
+    }
+    // The highest slot index digit in which tick differs from the current tick.
+    const int level = (CountBits(tick ^ m_current_tick) - 1) / SLOT_BITS;
+    if (level >= LEVELS) {
+        m_overflow.emplace(tick, std::move(task));
+        return;
+    }
+    const int slot = (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+    m_slots[level][slot].push_back(std::move(task));
+    m_occupied[level] |= uint64_t{1} << slot;
+}
+
+void TimerWheel::Insert(Task task)
+{
+    Place(std::move(task));
+    ++m_size;
+}
+
+std::optional<uint64_t> TimerWheel::NextExpiry() const
+{
+    std::optional<uint64_t> result;
+    if (!m_overflow.empty()) result = m_overflow.begin()->first;
+    for (int level = 0; level < LEVELS; ++level) {
+        const int shift = level * SLOT_BITS;
+        const int current_slot = (m_current_tick >> shift) & (SLOTS - 1);
+        // Tasks on a level are always in slots after the current one.
+        const uint64_t later = current_slot + 1 < SLOTS ? m_occupied[level] & (~uint64_t{0} << (current_slot + 1)) : 0;
+        if (!later) continue;
+        const uint64_t slot = CountBits(later & -later) - 1;
+        const int block_shift = shift + SLOT_BITS;
+        const uint64_t block_start = block_shift < 64 ? (m_current_tick >> block_shift) << block_shift : 0;
+        const uint64_t expiry = block_start | (slot << shift);
+        if (!result || expiry < *result) result = expiry;
+    }
+    return result;
+}
+
+void TimerWheel::Advance(Clock::time_point now)
+{
+    const uint64_t target{ToTick(now)};
+    while (true) {
+        const std::optional<uint64_t> expiry{NextExpiry()};
+        if (!expiry || *expiry > target) break;
+        m_current_tick = *expiry;
+
+        // Redistribute the slots that start at the new current tick, from the
+        // top down so that tasks can move down several levels at once.
+        for (int level = LEVELS - 1; level >= 0; --level) {
+            const int shift = level * SLOT_BITS;
+            if (m_current_tick & ((uint64_t{1} << shift) - 1)) continue;
+            const int slot = (m_current_tick >> shift) & (SLOTS - 1);
+            if (!(m_occupied[level] & (uint64_t{1} << slot))) continue;
+            std::vector<Task> tasks{std::move(m_slots[level][slot])};
+            m_slots[level][slot].clear();
+            m_occupied[level] &= ~(uint64_t{1} << slot);
+            for (Task& task : tasks) Place(std::move(task));
+        }
+        while (!m_overflow.empty() && m_overflow.begin()->first <= m_current_tick) {
+            Task task{std::move(m_overflow.begin()->second)};
+            m_overflow.erase(m_overflow.begin());
+            m_due.emplace(task.time, std::move(task));
+        }
+    }
+    m_current_tick = std::max(m_current_tick, target);
+}
+
+std::optional<TimerWheel::Task> TimerWheel::PopDue(Clock::time_point now)
+{
+    if (m_due.empty() || m_due.begin()->first > now) return std::nullopt;
+    Task task{std::move(m_due.begin()->second)};
+    m_due.erase(m_due.begin());
+    --m_size;
+    return task;
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::NextWakeup() const
+{
+    std::optional<Clock::time_point> result;
+    if (!m_due.empty()) result = m_due.begin()->first;
+    if (const auto expiry{NextExpiry()}) {
+        const Clock::time_point expiry_time{FromTick(*expiry)};
+        if (!result || expiry_time < *result) result = expiry_time;
+    }
+    return result;
+}
+
+std::vector<TimerWheel::Task> TimerWheel::TakeAll()
+{
+    std::vector<Task> result;
+    result.reserve(m_size);
+    for (auto& [time, task] : m_due) result.push_back(std::move(task));
+    m_due.clear();
+    for (auto& [tick, task] : m_overflow) result.push_back(std::move(task));
+    m_overflow.clear();
+    for (int level = 0; level < LEVELS; ++level) {
+        for (auto& slot : m_slots[level]) {
+            for (Task& task : slot) result.push_back(std::move(task));
+            slot.clear();
+        }
+        m_occupied[level] = 0;
+    }
+    m_size = 0;
+    return result;
+}
+
+void TimerWheel::ForEach(const std::function<void(const Task&)>& f) const
+{
+    for (const auto& [time, task] : m_due) f(task);
+    for (const auto& [tick, task] : m_overflow) f(task);
+    for (const auto& level : m_slots) {
+        for (const auto& slot : level) {
+            for (const Task& task : slot) f(task);
+        }
+    }
+}
+
+CScheduler::CScheduler() : taskQueue(std::chrono::system_clock::now())
 {
 }
 
@@ -41,28 +180,35 @@ void CScheduler::serviceQueue()
 
             // Wait until either there is a new task, or until
             // the time of the first item on the queue:
-
+            std::optional<TimerWheel::Task> task;
             while (!shouldStop() && !taskQueue.empty()) {
-                std::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until(lock, timeToWaitFor) == std::cv_status::timeout) {
-                    break; // Exit loop after timeout, it means we reached the time of the event
-                }
+                const auto now{std::chrono::system_clock::now()};
+                taskQueue.Advance(now);
+                task = taskQueue.PopDue(now);
+                if (task) break;
+                newTaskScheduled.wait_until(lock, *taskQueue.NextWakeup());
             }
 
             // If there are multiple threads, the queue can empty while we're waiting (another
             // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
-                continue;
-
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            if (!task) continue;
 
+            const auto start{std::chrono::system_clock::now()};
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 REVERSE_LOCK(lock);
-                f();
+                task->f();
             }
+            const auto end{std::chrono::system_clock::now()};
+
+            TaskHistory& history{m_task_history[task->name.empty() ? "other" : task->name]};
+            const auto delay{std::max(std::chrono::duration_cast<std::chrono::microseconds>(start - task->time), std::chrono::microseconds{0})};
+            const auto runtime{std::chrono::duration_cast<std::chrono::microseconds>(end - start)};
+            ++history.count;
+            ++history.delay_buckets[std::min<int>(CountBits(delay.count()), TaskHistory::BUCKETS - 1)];
+            history.delay_max = std::max(history.delay_max, delay);
+            history.runtime_max = std::max(history.runtime_max, runtime);
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
@@ -72,11 +218,21 @@ void CScheduler::serviceQueue()
     newTaskScheduled.notify_one();
 }
 
-void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t)
+void CScheduler::StartWorkerThreads(int num_threads)
+{
+    for (int n = 0; n < num_threads; ++n) {
+        m_worker_threads.emplace_back([this, n] {
+            util::ThreadRename(strprintf("scheduler.%i", n));
+            serviceQueue();
+        });
+    }
+}
+
+void CScheduler::schedule(CScheduler::Function f, std::chrono::system_clock::time_point t, std::string name)
 {
     {
         LOCK(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.Insert({t, std::move(f), std::move(name)});
     }
     newTaskScheduled.notify_one();
 }
@@ -88,30 +244,26 @@ void CScheduler::MockForward(std::chrono::seconds delta_seconds)
     {
         LOCK(newTaskMutex);
 
-        // use temp_queue to maintain updated schedule
-        std::multimap<std::chrono::system_clock::time_point, Function> temp_queue;
-
-        for (const auto& element : taskQueue) {
-            temp_queue.emplace_hint(temp_queue.cend(), element.first - delta_seconds, element.second);
+        // reinsert all tasks with their updated schedule
+        for (TimerWheel::Task& task : taskQueue.TakeAll()) {
+            task.time -= delta_seconds;
+            taskQueue.Insert(std::move(task));
         }
-
-        // point taskQueue to temp_queue
-        taskQueue = std::move(temp_queue);
     }
 
     // notify that the taskQueue needs to be processed
     newTaskScheduled.notify_one();
 }
 
-static void Repeat(CScheduler& s, CScheduler::Function f, std::chrono::milliseconds delta)
+static void Repeat(CScheduler& s, CScheduler::Function f, std::chrono::milliseconds delta, const std::string& name)
 {
     f();
-    s.scheduleFromNow([=, &s] { Repeat(s, f, delta); }, delta);
+    s.scheduleFromNow([=, &s] { Repeat(s, f, delta, name); }, delta, name);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, std::chrono::milliseconds delta)
+void CScheduler::scheduleEvery(CScheduler::Function f, std::chrono::milliseconds delta, std::string name)
 {
-    scheduleFromNow([=] { Repeat(*this, f, delta); }, delta);
+    scheduleFromNow([=] { Repeat(*this, f, delta, name); }, delta, name);
 }
 
 size_t CScheduler::getQueueInfo(std::chrono::system_clock::time_point& first,
@@ -120,8 +272,12 @@ size_t CScheduler::getQueueInfo(std::chrono::system_clock::time_point& first,
     LOCK(newTaskMutex);
     size_t result = taskQueue.size();
     if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+        first = std::chrono::system_clock::time_point::max();
+        last = std::chrono::system_clock::time_point::min();
+        taskQueue.ForEach([&](const TimerWheel::Task& task) {
+            first = std::min(first, task.time);
+            last = std::max(last, task.time);
+        });
     }
     return result;
 }
@@ -132,6 +288,34 @@ bool CScheduler::AreThreadsServicingQueue() const
     return nThreadsServicingQueue;
 }
 
+std::map<std::string, CScheduler::TaskStats> CScheduler::GetTaskStats() const
+{
+    // Upper bound of the delay bucket containing the given fraction of tasks
+    const auto percentile = [](const TaskHistory& history, double fraction) {
+        const uint64_t rank = std::max<uint64_t>(1, history.count * fraction);
+        uint64_t seen{0};
+        for (int bucket = 0; bucket < TaskHistory::BUCKETS; ++bucket) {
+            seen += history.delay_buckets[bucket];
+            if (seen >= rank) {
+                return std::min(std::chrono::microseconds{(int64_t{1} << bucket) - 1}, history.delay_max);
+            }
+        }
+        return history.delay_max;
+    };
+
+    std::map<std::string, TaskStats> result;
+    LOCK(newTaskMutex);
+    for (const auto& [name, history] : m_task_history) {
+        TaskStats& stats = result[name];
+        stats.count = history.count;
+        stats.delay_p50 = percentile(history, 0.5);
+        stats.delay_p99 = percentile(history, 0.99);
+        stats.delay_max = history.delay_max;
+        stats.runtime_max = history.runtime_max;
+    }
+    return result;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
 {
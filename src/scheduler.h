@@ -5,14 +5,101 @@
 #ifndef BITCOIN_SCHEDULER_H
 #define BITCOIN_SCHEDULER_H
 
+#include <array>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <map>
+#include <optional>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <sync.h>
 
+/** Default for -schedulerthreads, the number of threads running scheduled tasks */
+static constexpr int DEFAULT_SCHEDULER_THREADS{2};
+/** Maximum for -schedulerthreads */
+static constexpr int MAX_SCHEDULER_THREADS{16};
+
+/**
+ * Hierarchical timing wheel holding the tasks of a CScheduler.
+ *
+ * Time is divided into ticks of TICK. Level 0 has one slot per tick for the
+ * next SLOTS ticks, and each further level has slots covering SLOTS times as
+ * many ticks as the level below. A task is stored on the lowest level on which
+ * its tick and the current tick only differ in the slot index, and moves down
+ * a level each time the current tick reaches the start of its slot. Inserting
+ * and expiring tasks is therefore O(1) regardless of how many are queued.
+ *
+ * Tasks whose tick has been reached move to a due queue ordered by their
+ * exact time, so tasks within a tick still run in time (and then insertion)
+ * order. Not thread-safe; CScheduler guards it with its mutex.
+ */
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::system_clock;
+
+    struct Task {
+        Clock::time_point time;
+        std::function<void()> f;
+        std::string name;
+    };
+
+    explicit TimerWheel(Clock::time_point now);
+
+    void Insert(Task task);
+
+    /** Advance the current tick to now, moving tasks that are due to the due queue */
+    void Advance(Clock::time_point now);
+
+    /** Remove and return the first due task if its time is not after now */
+    std::optional<Task> PopDue(Clock::time_point now);
+
+    /**
+     * Time at which a task may become due: the time of the first due task or
+     * the start of the next occupied slot. Empty if there are no tasks.
+     */
+    std::optional<Clock::time_point> NextWakeup() const;
+
+    /** Remove and return all tasks */
+    std::vector<Task> TakeAll();
+
+    /** Call f for each task, in no particular order */
+    void ForEach(const std::function<void(const Task&)>& f) const;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    static constexpr std::chrono::milliseconds TICK{1};
+    static constexpr int SLOT_BITS{6};
+    static constexpr int SLOTS{1 << SLOT_BITS};
+    //! Six levels of 64 slots cover 2^36 ticks, a bit over two years.
+    static constexpr int LEVELS{6};
+
+    uint64_t m_current_tick;
+    std::array<std::array<std::vector<Task>, SLOTS>, LEVELS> m_slots;
+    //! Bit i of m_occupied[level] is set iff m_slots[level][i] is not empty.
+    std::array<uint64_t, LEVELS> m_occupied{};
+    //! Tasks too far in the future for the wheel, by tick.
+    std::multimap<uint64_t, Task> m_overflow;
+    //! Tasks whose tick has been reached, by exact time.
+    std::multimap<Clock::time_point, Task> m_due;
+    size_t m_size{0};
+
+    static uint64_t ToTick(Clock::time_point t);
+    static Clock::time_point FromTick(uint64_t tick);
+
+    /** Store a task relative to the current tick */
+    void Place(Task task);
+    /** First tick after the current one at which a slot expires */
+    std::optional<uint64_t> NextExpiry() const;
+};
+
 /**
  * Simple class for background tasks that should be run
  * periodically or once "after a while"
@@ -29,6 +116,9 @@
  * t->join();
  * delete t;
  * delete s; // Must be done after thread is interrupted/joined.
+ *
+ * Tasks can be given a name, under which the delay between their scheduled
+ * and actual start time is recorded (see GetTaskStats()).
  */
 class CScheduler
 {
@@ -40,13 +130,23 @@ public:
 
     typedef std::function<void()> Function;
 
+    /** Start delay and run time of the tasks sharing a name */
+    struct TaskStats {
+        uint64_t count{0};
+        //! Percentiles are upper bounds, at power-of-two microsecond resolution.
+        std::chrono::microseconds delay_p50{0};
+        std::chrono::microseconds delay_p99{0};
+        std::chrono::microseconds delay_max{0};
+        std::chrono::microseconds runtime_max{0};
+    };
+
     /** Call func at/after time t */
-    void schedule(Function f, std::chrono::system_clock::time_point t);
+    void schedule(Function f, std::chrono::system_clock::time_point t, std::string name = {});
 
     /** Call f once after the delta has passed */
-    void scheduleFromNow(Function f, std::chrono::milliseconds delta)
+    void scheduleFromNow(Function f, std::chrono::milliseconds delta, std::string name = {})
     {
-        schedule(std::move(f), std::chrono::system_clock::now() + delta);
+        schedule(std::move(f), std::chrono::system_clock::now() + delta, std::move(name));
     }
 
     /**
@@ -55,7 +155,7 @@ public:
      * The timing is not exact: Every time f is finished, it is rescheduled to run again after delta. If you need more
      * accurate scheduling, don't use this method.
      */
-    void scheduleEvery(Function f, std::chrono::milliseconds delta);
+    void scheduleEvery(Function f, std::chrono::milliseconds delta, std::string name = {});
 
     /**
      * Mock the scheduler to fast forward in time.
@@ -69,19 +169,26 @@ public:
      */
     void serviceQueue();
 
+    /**
+     * Start num_threads threads servicing the queue in addition to
+     * m_service_thread, so that a slow task doesn't hold up the others. They
+     * are joined by stop() and StopWhenDrained().
+     */
+    void StartWorkerThreads(int num_threads);
+
     /** Tell any threads running serviceQueue to stop as soon as the current task is done */
     void stop()
     {
         WITH_LOCK(newTaskMutex, stopRequested = true);
         newTaskScheduled.notify_all();
-        if (m_service_thread.joinable()) m_service_thread.join();
+        JoinThreads();
     }
     /** Tell any threads running serviceQueue to stop when there is no work left to be done */
     void StopWhenDrained()
     {
         WITH_LOCK(newTaskMutex, stopWhenEmpty = true);
         newTaskScheduled.notify_all();
-        if (m_service_thread.joinable()) m_service_thread.join();
+        JoinThreads();
     }
 
     /**
@@ -94,14 +201,37 @@ public:
     /** Returns true if there are threads actively running in serviceQueue() */
     bool AreThreadsServicingQueue() const;
 
+    /** Statistics of the tasks run so far, by task name ("other" for unnamed tasks) */
+    std::map<std::string, TaskStats> GetTaskStats() const;
+
 private:
+    /** Start delays in power-of-two microsecond buckets, and the longest run time */
+    struct TaskHistory {
+        static constexpr int BUCKETS{32};
+        uint64_t count{0};
+        std::array<uint64_t, BUCKETS> delay_buckets{};
+        std::chrono::microseconds delay_max{0};
+        std::chrono::microseconds runtime_max{0};
+    };
+
     mutable Mutex newTaskMutex;
     std::condition_variable newTaskScheduled;
-    std::multimap<std::chrono::system_clock::time_point, Function> taskQueue GUARDED_BY(newTaskMutex);
+    TimerWheel taskQueue GUARDED_BY(newTaskMutex);
+    std::map<std::string, TaskHistory> m_task_history GUARDED_BY(newTaskMutex);
+    std::vector<std::thread> m_worker_threads;
     int nThreadsServicingQueue GUARDED_BY(newTaskMutex){0};
     bool stopRequested GUARDED_BY(newTaskMutex){false};
     bool stopWhenEmpty GUARDED_BY(newTaskMutex){false};
     bool shouldStop() const EXCLUSIVE_LOCKS_REQUIRED(newTaskMutex) { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+
+    void JoinThreads()
+    {
+        if (m_service_thread.joinable()) m_service_thread.join();
+        for (std::thread& thread : m_worker_threads) {
+            if (thread.joinable()) thread.join();
+        }
+        m_worker_threads.clear();
+    }
 };
 
 /**
@@ -13,6 +13,7 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
 
@@ -49,6 +50,8 @@ LEAVE_CRITICAL_SECTION(mutex); // no RAII
 //                           //
 ///////////////////////////////
 
+class SharedMutex;
+
 #ifdef DEBUG_LOCKORDER
 template <typename MutexType>
 void EnterCritical(const char* pszName, const char* pszFile, int nLine, MutexType* cs, bool fTry = false);
@@ -57,6 +60,8 @@ void CheckLastCritical(void* cs, std::string& lockname, const char* guardname, c
 std::string LocksHeld();
 template <typename MutexType>
 void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine, MutexType* cs) EXCLUSIVE_LOCKS_REQUIRED(cs);
+//! Held in either shared or exclusive mode.
+void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine, SharedMutex* cs) SHARED_LOCKS_REQUIRED(cs);
 template <typename MutexType>
 void AssertLockNotHeldInternal(const char* pszName, const char* pszFile, int nLine, MutexType* cs) LOCKS_EXCLUDED(cs);
 void DeleteLock(void* cs);
@@ -75,6 +80,7 @@ inline void LeaveCritical() {}
 inline void CheckLastCritical(void* cs, std::string& lockname, const char* guardname, const char* file, int line) {}
 template <typename MutexType>
 inline void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine, MutexType* cs) EXCLUSIVE_LOCKS_REQUIRED(cs) {}
+inline void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine, SharedMutex* cs) SHARED_LOCKS_REQUIRED(cs) {}
 template <typename MutexType>
 void AssertLockNotHeldInternal(const char* pszName, const char* pszFile, int nLine, MutexType* cs) LOCKS_EXCLUDED(cs) {}
 inline void DeleteLock(void* cs) {}
@@ -230,6 +236,61 @@ using DebugLock = UniqueLock<typename std::remove_reference<typename std::remove
 #define TRY_LOCK(cs, name) DebugLock<decltype(cs)> name(cs, #cs, __FILE__, __LINE__, true)
 #define WAIT_LOCK(cs, name) DebugLock<decltype(cs)> name(cs, #cs, __FILE__, __LINE__)
 
+/**
+ * Wrapped std::shared_mutex: supports shared (reader) and exclusive (writer)
+ * locking, but not recursive locking. Lock it with READ_LOCK or WRITE_LOCK,
+ * which take part in lock order checking like LOCK.
+ */
+class LOCKABLE SharedMutex : public std::shared_mutex
+{
+public:
+    ~SharedMutex() {
+        DeleteLock((void*)this);
+    }
+
+#ifdef __clang__
+    //! For negative capabilities in the Clang Thread Safety Analysis.
+    const SharedMutex& operator!() const { return *this; }
+#endif // __clang__
+};
+
+/** Scoped exclusive (writer) lock on a SharedMutex. */
+class SCOPED_LOCKABLE SharedMutexWriteLock : public std::unique_lock<std::shared_mutex>
+{
+public:
+    SharedMutexWriteLock(SharedMutex& cs, const char* pszName, const char* pszFile, int nLine) EXCLUSIVE_LOCK_FUNCTION(cs)
+        : std::unique_lock<std::shared_mutex>(cs, std::defer_lock)
+    {
+        EnterCritical(pszName, pszFile, nLine, &cs);
+        lock();
+    }
+
+    ~SharedMutexWriteLock() UNLOCK_FUNCTION()
+    {
+        if (owns_lock()) LeaveCritical();
+    }
+};
+
+/** Scoped shared (reader) lock on a SharedMutex. */
+class SCOPED_LOCKABLE SharedMutexReadLock : public std::shared_lock<std::shared_mutex>
+{
+public:
+    SharedMutexReadLock(SharedMutex& cs, const char* pszName, const char* pszFile, int nLine) SHARED_LOCK_FUNCTION(cs)
+        : std::shared_lock<std::shared_mutex>(cs, std::defer_lock)
+    {
+        EnterCritical(pszName, pszFile, nLine, &cs);
+        lock();
+    }
+
+    ~SharedMutexReadLock() UNLOCK_FUNCTION()
+    {
+        if (owns_lock()) LeaveCritical();
+    }
+};
+
+#define WRITE_LOCK(cs) SharedMutexWriteLock PASTE2(criticalblock, __COUNTER__)(cs, #cs, __FILE__, __LINE__)
+#define READ_LOCK(cs) SharedMutexReadLock PASTE2(criticalblock, __COUNTER__)(cs, #cs, __FILE__, __LINE__)
+
 #define ENTER_CRITICAL_SECTION(cs)                            \
     {                                                         \
         EnterCritical(#cs, __FILE__, __LINE__, &cs); \
@@ -17,8 +17,11 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
 #include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace std::literals;
 using node::NodeContext;
@@ -960,6 +963,50 @@ BOOST_AUTO_TEST_CASE(load_addrman_corrupted)
     BOOST_CHECK_THROW(ReadFromStream(addrman2, ssPeers2), std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_compact_roundtrip)
+{
+    // Entries from several sources, in both tables, survive a save and load
+    // in the compact format with all their fields.
+    auto addrman = std::make_unique<AddrMan>(EMPTY_ASMAP, DETERMINISTIC, GetCheckRatio(m_node));
+    const int64_t now{GetAdjustedTime()};
+    std::optional<CAddress> probe;
+    for (int source_i = 1; source_i <= 3; ++source_i) {
+        const CNetAddr source{ResolveIP(strprintf("252.%d.1.1", source_i))};
+        for (int i = 1; i <= 20; ++i) {
+            CAddress addr{ResolveService(strprintf("250.%d.%d.1", source_i, i), 8333), ServiceFlags(NODE_NETWORK | NODE_WITNESS)};
+            addr.nTime = now - 600 * i;
+            if (!addrman->Add({addr}, source)) continue; // bucket collision
+            if (i % 5 == 0 && addrman->Good(addr, now - i)) probe = addr;
+            if (i % 3 == 0) addrman->Attempt(addr, /*fCountFailure=*/true, now);
+        }
+    }
+    const size_t total{addrman->size()};
+    BOOST_REQUIRE_GT(total, 40U);
+    BOOST_REQUIRE(probe);
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << *addrman;
+    BOOST_CHECK_EQUAL(uint8_t(stream[0]), 5);      // format
+    BOOST_CHECK_EQUAL(uint8_t(stream[1]), 32 + 5); // lowest compatible
+    const std::string serialized{stream.str()};
+
+    const std::optional<AddressPosition> pos{addrman->FindAddressEntry(*probe)};
+    BOOST_REQUIRE(pos);
+
+    addrman = std::make_unique<AddrMan>(EMPTY_ASMAP, DETERMINISTIC, GetCheckRatio(m_node));
+    stream >> *addrman;
+    BOOST_CHECK_EQUAL(addrman->size(), total);
+    std::optional<AddressPosition> loaded_pos{addrman->FindAddressEntry(*probe)};
+    BOOST_REQUIRE(loaded_pos);
+    BOOST_CHECK(*loaded_pos == *pos);
+
+    // Serializing the loaded addrman gives the same bytes, so every stored
+    // field was preserved.
+    CDataStream reserialized(SER_DISK, CLIENT_VERSION);
+    reserialized << *addrman;
+    BOOST_CHECK(reserialized.str() == serialized);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_update_address)
 {
     // Tests updating nTime via Connected() and nServices via SetServices()
@@ -985,10 +1032,54 @@ BOOST_AUTO_TEST_CASE(addrman_update_address)
     // Updating an addrman entry with the correct port is successful
     addrman->Connected(addr);
     addrman->SetServices(addr, NODE_NETWORK_LIMITED);
+
+    // GetAddr() is served from a snapshot, which only picks up changes that
+    // leave the number of addresses unchanged once it is old enough.
+    std::vector<CAddress> vAddr_cached = addrman->GetAddr(/*max_addresses=*/0, /*max_pct=*/0, /*network=*/std::nullopt);
+    BOOST_CHECK_EQUAL(vAddr_cached.size(), 1U);
+    BOOST_CHECK_EQUAL(vAddr_cached.at(0).nServices, NODE_NONE);
+
+    SetMockTime(GetTime<std::chrono::seconds>() + 2min);
     std::vector<CAddress> vAddr2 = addrman->GetAddr(/*max_addresses=*/0, /*max_pct=*/0, /*network=*/std::nullopt);
     BOOST_CHECK_EQUAL(vAddr2.size(), 1U);
     BOOST_CHECK(vAddr2.at(0).nTime >= start_time + 10000);
     BOOST_CHECK_EQUAL(vAddr2.at(0).nServices, NODE_NETWORK_LIMITED);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_concurrent_access)
+{
+    // Select() and GetAddr() may run while other threads modify addrman.
+    AddrMan addrman{EMPTY_ASMAP, !DETERMINISTIC, GetCheckRatio(m_node)};
+    const CNetAddr source{ResolveIP("252.2.2.2")};
+    std::vector<CAddress> addrs;
+    for (int i = 1; i < 1000; ++i) {
+        CAddress addr{ResolveService(strprintf("250.%d.%d.1", i / 256, i % 256), 8333), NODE_NONE};
+        addr.nTime = GetAdjustedTime();
+        addrs.push_back(addr);
+    }
+    addrman.Add({addrs.begin(), addrs.begin() + 100}, source);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; ++i) {
+        readers.emplace_back([&] {
+            while (!done) {
+                if (!addrman.Select().first.IsValid()) ++failures;
+                if (addrman.GetAddr(/*max_addresses=*/0, /*max_pct=*/23, /*network=*/std::nullopt).empty()) ++failures;
+            }
+        });
+    }
+    addrman.Add(addrs, source);
+    for (size_t i = 0; i < addrs.size(); i += 10) {
+        addrman.Good(addrs[i]);
+        addrman.Attempt(addrs[i + 1], /*fCountFailure=*/true);
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+    BOOST_CHECK_EQUAL(failures, 0);
+
+    BOOST_CHECK_EQUAL(addrman.GetAddr(/*max_addresses=*/0, /*max_pct=*/0, /*network=*/std::nullopt).size(), addrman.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
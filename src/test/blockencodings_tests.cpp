@@ -306,6 +306,56 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ManyTransactionsRoundTripTest)
+{
+    // Block transactions are found among many unrelated mempool and extra pool
+    // transactions, across several batches of short IDs.
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+    block.vtx.resize(1);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 400; i++) {
+        tx.vin[0].prevout.hash = InsecureRand256();
+        txs.push_back(MakeTransactionRef(tx));
+    }
+    // Block transactions 0-99 are in the mempool, 100-119 in the extra pool and
+    // 120-149 are missing. Transactions 150-399 are unrelated.
+    block.vtx.insert(block.vtx.end(), txs.begin(), txs.begin() + 150);
+    std::vector<std::pair<uint256, CTransactionRef>> extra;
+    for (int i = 100; i < 120; i++) {
+        extra.emplace_back(txs[i]->GetWitnessHash(), txs[i]);
+    }
+
+    LOCK2(cs_main, pool.cs);
+    for (int i = 0; i < 400; i++) {
+        if (i < 100 || i >= 150) pool.addUnchecked(entry.FromTx(txs[i]));
+    }
+
+    CBlockHeaderAndShortTxIDs shortIDs(block, true);
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs, extra) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(i), i <= 120);
+    }
+
+    // Repeated short IDs make the compact block unusable.
+    TestHeaderAndShortIDs duplicate(block);
+    duplicate.shorttxids[7] = duplicate.shorttxids[3];
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << duplicate;
+    CBlockHeaderAndShortTxIDs duplicate2;
+    stream >> duplicate2;
+    PartiallyDownloadedBlock partialBlock2(&pool);
+    BOOST_CHECK(partialBlock2.InitData(duplicate2, extra) == READ_STATUS_FAILED);
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -0,0 +1,171 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <fs.h>
+#include <node/blockmap.h>
+#include <node/blockstorage.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <vector>
+
+using node::BlockManager;
+using node::BlockMap;
+
+BOOST_FIXTURE_TEST_SUITE(blockmanager_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockindex_snapshot)
+{
+    LOCK(::cs_main);
+    fs::create_directories(gArgs.GetDataDirNet() / "blocks");
+    const fs::path snapshot_path{gArgs.GetDataDirNet() / "blocks" / "index.snapshot"};
+
+    BlockManager blockman;
+    blockman.m_block_tree_db = std::make_unique<CBlockTreeDB>(1 << 20, /*fMemory=*/true);
+    BOOST_REQUIRE(blockman.LoadBlockIndex(Params().GetConsensus()));
+
+    // A chain of ten blocks with a fork of three blocks starting at height 5.
+    std::vector<CBlockIndex*> blocks;
+    const auto add_block = [&](CBlockIndex* prev) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
+        CBlockIndex* pindex{blockman.InsertBlockIndex(InsecureRand256())};
+        pindex->pprev = prev;
+        pindex->nHeight = prev ? prev->nHeight + 1 : 0;
+        pindex->nChainWork = (prev ? prev->nChainWork : 0) + InsecureRandRange(1000) + 1;
+        pindex->hashMerkleRoot = InsecureRand256();
+        pindex->nStatus = BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        pindex->nFile = 0;
+        pindex->nDataPos = InsecureRand32();
+        pindex->nUndoPos = InsecureRand32();
+        pindex->nVersion = InsecureRand32();
+        pindex->nTime = InsecureRand32();
+        pindex->nBits = InsecureRand32();
+        pindex->nNonce = InsecureRand32();
+        pindex->nTx = 1 + InsecureRandRange(100);
+        blocks.push_back(pindex);
+        return pindex;
+    };
+    CBlockIndex* tip{add_block(nullptr)};
+    CBlockIndex* fork_point{nullptr};
+    for (int i = 1; i < 10; ++i) {
+        tip = add_block(tip);
+        if (i == 5) fork_point = tip;
+    }
+    for (int i = 0; i < 3; ++i) {
+        fork_point = add_block(fork_point);
+    }
+
+    BOOST_REQUIRE(blockman.WriteBlockIndexSnapshot());
+    BOOST_CHECK(fs::exists(snapshot_path));
+
+    // A block manager on the same database loads everything from the snapshot.
+    BlockManager loaded;
+    loaded.m_block_tree_db = std::move(blockman.m_block_tree_db);
+    BOOST_REQUIRE(loaded.LoadBlockIndex(Params().GetConsensus()));
+    BOOST_CHECK(!fs::exists(snapshot_path));
+    BOOST_REQUIRE_EQUAL(loaded.m_block_index.size(), blocks.size());
+    for (const CBlockIndex* block : blocks) {
+        const CBlockIndex* pindex{loaded.LookupBlockIndex(block->GetBlockHash())};
+        BOOST_REQUIRE(pindex);
+        BOOST_CHECK_EQUAL(pindex->nHeight, block->nHeight);
+        BOOST_CHECK(pindex->nChainWork == block->nChainWork);
+        BOOST_CHECK(pindex->hashMerkleRoot == block->hashMerkleRoot);
+        BOOST_CHECK_EQUAL(pindex->nStatus, block->nStatus);
+        BOOST_CHECK_EQUAL(pindex->nFile, block->nFile);
+        BOOST_CHECK_EQUAL(pindex->nDataPos, block->nDataPos);
+        BOOST_CHECK_EQUAL(pindex->nUndoPos, block->nUndoPos);
+        BOOST_CHECK_EQUAL(pindex->nVersion, block->nVersion);
+        BOOST_CHECK_EQUAL(pindex->nTime, block->nTime);
+        BOOST_CHECK_EQUAL(pindex->nBits, block->nBits);
+        BOOST_CHECK_EQUAL(pindex->nNonce, block->nNonce);
+        BOOST_CHECK_EQUAL(pindex->nTx, block->nTx);
+        if (block->pprev) {
+            BOOST_REQUIRE(pindex->pprev);
+            BOOST_CHECK(pindex->pprev->GetBlockHash() == block->pprev->GetBlockHash());
+            BOOST_CHECK(pindex->pskip);
+        } else {
+            BOOST_CHECK(!pindex->pprev);
+        }
+    }
+
+    // The snapshot is used only once.  This database has no block index
+    // entries of its own, so scanning it loads nothing.
+    BOOST_REQUIRE(loaded.WriteBlockIndexSnapshot());
+    {
+        BlockManager once;
+        once.m_block_tree_db = std::move(loaded.m_block_tree_db);
+        BOOST_REQUIRE(once.LoadBlockIndex(Params().GetConsensus()));
+        BOOST_CHECK_EQUAL(once.m_block_index.size(), blocks.size());
+        loaded.m_block_tree_db = std::move(once.m_block_tree_db);
+    }
+    {
+        BlockManager rescanned;
+        rescanned.m_block_tree_db = std::move(loaded.m_block_tree_db);
+        BOOST_REQUIRE(rescanned.LoadBlockIndex(Params().GetConsensus()));
+        BOOST_CHECK(rescanned.m_block_index.empty());
+        loaded.m_block_tree_db = std::move(rescanned.m_block_tree_db);
+    }
+
+    // A snapshot is not used if blocks were stored since it was written.
+    BOOST_REQUIRE(loaded.WriteBlockIndexSnapshot());
+    CBlockFileInfo info;
+    info.AddBlock(/*nHeightIn=*/10, /*nTimeIn=*/0);
+    BOOST_REQUIRE(loaded.m_block_tree_db->WriteBatchSync({{0, &info}}, 0, {}));
+    BlockManager stale;
+    stale.m_block_tree_db = std::move(loaded.m_block_tree_db);
+    BOOST_REQUIRE(stale.LoadBlockIndex(Params().GetConsensus()));
+    BOOST_CHECK(stale.m_block_index.empty());
+}
+
+BOOST_AUTO_TEST_CASE(blockmap)
+{
+    BlockMap map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(uint256::ONE) == map.end());
+
+    // Enough entries to span several chunks and grow the hash table.
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex*> entries;
+    for (int i = 0; i < 10'000; ++i) {
+        hashes.push_back(InsecureRand256());
+        const auto [it, inserted]{map.try_emplace(hashes.back())};
+        BOOST_REQUIRE(inserted);
+        it->second.nHeight = i;
+        entries.push_back(&it->second);
+    }
+    BOOST_CHECK_EQUAL(map.size(), hashes.size());
+
+    // Entries never move, are found by hash and are iterated in insertion order.
+    int height{0};
+    for (const auto& [hash, index] : map) {
+        BOOST_CHECK(hash == hashes[height]);
+        BOOST_CHECK_EQUAL(index.nHeight, height);
+        BOOST_CHECK_EQUAL(&index, entries[height]);
+        ++height;
+    }
+    BOOST_CHECK_EQUAL(height, 10'000);
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        BOOST_CHECK_EQUAL(&map.find(hashes[i])->second, entries[i]);
+        BOOST_CHECK_EQUAL(&map[hashes[i]], entries[i]);
+    }
+    BOOST_CHECK_EQUAL(map.count(hashes[0]), 1U);
+    BOOST_CHECK_EQUAL(map.count(uint256::ONE), 0U);
+
+    // Existing entries are not replaced.
+    BOOST_CHECK(!map.try_emplace(hashes[0]).second);
+    BOOST_CHECK_EQUAL(map.size(), hashes.size());
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(hashes[0]) == map.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <node/miner.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <test/util/setup_common.h>
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+using node::BlockAssembler;
+using node::BlockTemplateBuilder;
+using node::CBlockTemplate;
+using node::TemplateSelection;
+
+BOOST_FIXTURE_TEST_SUITE(blocktemplatebuilder_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(incremental_selection)
+{
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    const CScript dest = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    const auto tx1 = MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, dest, 49 * COIN));
+    const auto tx2 = MakeTransactionRef(CreateValidMempoolTransaction(tx1, 0, 101, coinbaseKey, dest, 48 * COIN));
+
+    // A previous selection that is still in the mempool is extended
+    TemplateSelection selection;
+    selection.previous = {tx1};
+    selection.added = {tx2};
+    bool used_incremental{false};
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    BOOST_CHECK(pblocktemplate = BlockAssembler(m_node.chainman->ActiveChainstate(), *m_node.mempool, Params()).CreateNewBlock(scriptPubKey, &selection, &used_incremental));
+    BOOST_CHECK(used_incremental);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+
+    // A stale one makes the assembler fall back to a full selection
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*tx2, MemPoolRemovalReason::CONFLICT));
+    selection.previous = {tx1, tx2};
+    selection.added = {};
+    BOOST_CHECK(pblocktemplate = BlockAssembler(m_node.chainman->ActiveChainstate(), *m_node.mempool, Params()).CreateNewBlock(scriptPubKey, &selection, &used_incremental));
+    BOOST_CHECK(!used_incremental);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(builder_rebuilds)
+{
+    BlockTemplateBuilder builder(*m_node.chainman, *m_node.mempool);
+    RegisterValidationInterface(&builder);
+
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    const CScript dest = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // The first template is always a full rebuild
+    const auto tx1 = MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, dest, 49 * COIN));
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    BOOST_CHECK(pblocktemplate = builder.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+    BOOST_CHECK_EQUAL(builder.GetFullRebuilds(), 1U);
+    BOOST_CHECK_EQUAL(builder.GetIncrementalUpdates(), 0U);
+
+    // New transactions extend the previous selection
+    const auto tx2 = MakeTransactionRef(CreateValidMempoolTransaction(tx1, 0, 101, coinbaseKey, dest, 48 * COIN));
+    CreateValidMempoolTransaction(tx2, 0, 101, coinbaseKey, dest, 47 * COIN);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(pblocktemplate = builder.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == tx1->GetHash());
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == tx2->GetHash());
+    BOOST_CHECK_EQUAL(builder.GetFullRebuilds(), 1U);
+    BOOST_CHECK_EQUAL(builder.GetIncrementalUpdates(), 1U);
+
+    // Removing a selected transaction forces a full rebuild
+    WITH_LOCK(m_node.mempool->cs, m_node.mempool->removeRecursive(*tx2, MemPoolRemovalReason::CONFLICT));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(pblocktemplate = builder.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2U);
+    BOOST_CHECK_EQUAL(builder.GetFullRebuilds(), 2U);
+    BOOST_CHECK_EQUAL(builder.GetIncrementalUpdates(), 1U);
+
+    // So does a new tip
+    CreateAndProcessBlock({}, scriptPubKey);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(pblocktemplate = builder.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(builder.GetFullRebuilds(), 3U);
+    BOOST_CHECK_EQUAL(builder.GetIncrementalUpdates(), 1U);
+
+    UnregisterValidationInterface(&builder);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,133 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <cluster_linearize.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using namespace cluster_linearize;
+
+BOOST_AUTO_TEST_SUITE(cluster_linearize_tests)
+
+/** Check that every transaction appears exactly once and after its parents. */
+static void CheckTopological(const std::vector<ClusterTx>& cluster, const std::vector<uint32_t>& linearization)
+{
+    BOOST_REQUIRE_EQUAL(linearization.size(), cluster.size());
+    std::vector<int> position(cluster.size(), -1);
+    for (size_t i = 0; i < linearization.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(position[linearization[i]], -1);
+        position[linearization[i]] = i;
+    }
+    for (uint32_t i = 0; i < cluster.size(); ++i) {
+        for (const uint32_t p : cluster[i].parents) {
+            BOOST_CHECK_LT(position[p], position[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(feerate_higher)
+{
+    BOOST_CHECK(FeerateHigher(2, 1, 3, 2));
+    BOOST_CHECK(!FeerateHigher(3, 2, 2, 1));
+    BOOST_CHECK(!FeerateHigher(2, 1, 4, 2));
+    BOOST_CHECK(FeerateHigher(-1, 1, -2, 1));
+    BOOST_CHECK(FeerateHigher(0, 1, -1, 1));
+    // Products beyond 2^53 are compared exactly
+    const CAmount fee{(CAmount{1} << 51) + 1};
+    BOOST_CHECK(FeerateHigher(7 * (CAmount{1} << 51) + 8, 1, fee, 7));
+    BOOST_CHECK(!FeerateHigher(fee, 7, 7 * (CAmount{1} << 51) + 8, 1));
+    BOOST_CHECK(!FeerateHigher(fee * 7, 7, fee, 1));
+}
+
+BOOST_AUTO_TEST_CASE(child_pays_for_parent)
+{
+    const std::vector<ClusterTx> cluster{
+        {100, 100, {}},
+        {1000, 100, {0}},
+    };
+    const auto linearization = Linearize(cluster);
+    CheckTopological(cluster, linearization);
+
+    const auto chunks = ChunkLinearization(cluster, linearization);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 1U);
+    BOOST_CHECK(chunks[0].txs == std::vector<uint32_t>({0, 1}));
+    BOOST_CHECK_EQUAL(chunks[0].fee, 1100);
+    BOOST_CHECK_EQUAL(chunks[0].size, 200);
+}
+
+BOOST_AUTO_TEST_CASE(decreasing_chunks)
+{
+    // A low feerate child is chunked separately from its parent, and an
+    // unrelated transaction is placed between them.
+    const std::vector<ClusterTx> cluster{
+        {1000, 100, {}},
+        {100, 100, {0}},
+        {500, 100, {}},
+    };
+    const auto linearization = Linearize(cluster);
+    BOOST_CHECK(linearization == std::vector<uint32_t>({0, 2, 1}));
+
+    const auto chunks = ChunkLinearization(cluster, linearization);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 3U);
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        BOOST_CHECK(!FeerateHigher(chunks[i].fee, chunks[i].size, chunks[i - 1].fee, chunks[i - 1].size));
+    }
+    BOOST_CHECK(chunks.back().txs == std::vector<uint32_t>({1}));
+}
+
+BOOST_AUTO_TEST_CASE(ancestor_set_selection)
+{
+    // The parent-child pair has a higher combined feerate than the
+    // independent transaction, even though the parent alone has not.
+    const std::vector<ClusterTx> cluster{
+        {1, 1, {}},
+        {10, 1, {0}},
+        {5, 1, {}},
+    };
+    const auto linearization = Linearize(cluster);
+    BOOST_CHECK(linearization == std::vector<uint32_t>({0, 1, 2}));
+
+    const auto chunks = ChunkLinearization(cluster, linearization);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 2U);
+    BOOST_CHECK(chunks[0].txs == std::vector<uint32_t>({0, 1}));
+    BOOST_CHECK(chunks[1].txs == std::vector<uint32_t>({2}));
+}
+
+BOOST_AUTO_TEST_CASE(diamond)
+{
+    // Parents listed after their children must still be linearized first.
+    const std::vector<ClusterTx> cluster{
+        {400, 100, {1, 2}},
+        {100, 100, {3}},
+        {300, 100, {3}},
+        {100, 100, {}},
+    };
+    const auto linearization = Linearize(cluster);
+    CheckTopological(cluster, linearization);
+    BOOST_CHECK_EQUAL(linearization.front(), 3U);
+    BOOST_CHECK_EQUAL(linearization.back(), 0U);
+
+    // The child pays for all of its ancestors.
+    const auto chunks = ChunkLinearization(cluster, linearization);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 1U);
+    BOOST_CHECK_EQUAL(chunks[0].fee, 900);
+}
+
+BOOST_AUTO_TEST_CASE(oversized_cluster)
+{
+    // A chain whose fees increase towards the end: beyond the size limit it
+    // is only ordered topologically, which results in a single chunk.
+    std::vector<ClusterTx> cluster;
+    for (uint32_t i = 0; i <= MAX_CLUSTER_LINEARIZATION_SIZE; ++i) {
+        cluster.push_back({static_cast<CAmount>(i), 100, {}});
+        if (i > 0) cluster.back().parents.push_back(i - 1);
+    }
+    const auto linearization = Linearize(cluster);
+    CheckTopological(cluster, linearization);
+    BOOST_CHECK_EQUAL(ChunkLinearization(cluster, linearization).size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,8 +5,10 @@
 #include <compressor.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
+#include <util/compression.h>
 
 #include <stdint.h>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -134,4 +136,47 @@ BOOST_AUTO_TEST_CASE(compress_script_to_uncompressed_pubkey_id)
     BOOST_CHECK_EQUAL(out[0], 0x04 | (script[65] & 0x01)); // least significant bit (lsb) of last char of pubkey is mapped into out[0]
 }
 
+BOOST_AUTO_TEST_CASE(compress_bytes)
+{
+    const auto check_roundtrip = [](const std::vector<unsigned char>& data) {
+        const std::vector<unsigned char> compressed{CompressBytes(data)};
+        BOOST_CHECK(DecompressBytes(compressed, data.size()) == data);
+        if (!data.empty()) BOOST_CHECK(!DecompressBytes(compressed, data.size() - 1));
+        return compressed.size();
+    };
+
+    BOOST_CHECK_EQUAL(check_roundtrip({}), 1U);
+    BOOST_CHECK_EQUAL(check_roundtrip({'a', 'b', 'c'}), 4U);
+
+    // Random data stays about the same size, repetitions shrink.
+    const std::vector<unsigned char> random{g_insecure_rand_ctx.randbytes(1000)};
+    BOOST_CHECK_LE(check_roundtrip(random), random.size() + 10);
+    std::vector<unsigned char> repeated{random};
+    repeated.insert(repeated.end(), random.begin(), random.end());
+    repeated.insert(repeated.end(), 1000, 'x');
+    BOOST_CHECK_LE(check_roundtrip(repeated), random.size() + 20);
+
+    for (int i = 0; i < 100; ++i) {
+        std::vector<unsigned char> data;
+        while (data.size() < 2000) {
+            if (data.empty() || InsecureRandBool()) {
+                const std::vector<unsigned char> literals{g_insecure_rand_ctx.randbytes(InsecureRandRange(20))};
+                data.insert(data.end(), literals.begin(), literals.end());
+            } else {
+                const size_t start{InsecureRandRange(data.size())};
+                for (size_t j = 0, length = InsecureRandRange(100); j < length; ++j) data.push_back(data[start + j]);
+            }
+        }
+        check_roundtrip(data);
+    }
+
+    // Malformed input is rejected.
+    BOOST_CHECK(!DecompressBytes(std::vector<unsigned char>{}, 100));
+    BOOST_CHECK(!DecompressBytes(std::vector<unsigned char>{5, 'a'}, 100));
+    BOOST_CHECK(!DecompressBytes(std::vector<unsigned char>{1, 'a', 0}, 100));
+    BOOST_CHECK(!DecompressBytes(std::vector<unsigned char>{1, 'a', 0, 2, 0}, 100));
+    BOOST_CHECK(!DecompressBytes(std::vector<unsigned char>{1, 'a', 0, 0, 0}, 100));
+    BOOST_CHECK(DecompressBytes(std::vector<unsigned char>{1, 'a', 0, 1, 0}, 100) == std::vector<unsigned char>(5, 'a'));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
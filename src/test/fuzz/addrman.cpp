@@ -127,7 +127,7 @@ public:
     explicit AddrManDeterministic(std::vector<bool> asmap, FuzzedDataProvider& fuzzed_data_provider)
         : AddrMan{std::move(asmap), /*deterministic=*/true, GetCheckRatio()}
     {
-        WITH_LOCK(m_impl->cs, m_impl->insecure_rand = FastRandomContext{ConsumeUInt256(fuzzed_data_provider)});
+        WITH_LOCK(m_impl->m_rand_mutex, m_impl->insecure_rand = FastRandomContext{ConsumeUInt256(fuzzed_data_provider)});
     }
 
     /**
@@ -139,7 +139,8 @@ public:
      */
     bool operator==(const AddrManDeterministic& other) const
     {
-        LOCK2(m_impl->cs, other.m_impl->cs);
+        READ_LOCK(m_impl->cs);
+        READ_LOCK(other.m_impl->cs);
 
         if (m_impl->mapInfo.size() != other.m_impl->mapInfo.size() || m_impl->nNew != other.m_impl->nNew ||
             m_impl->nTried != other.m_impl->nTried) {
@@ -189,7 +190,7 @@ public:
             return false;
         }
 
-        auto IdsReferToSameAddress = [&](int id, int other_id) EXCLUSIVE_LOCKS_REQUIRED(m_impl->cs, other.m_impl->cs) {
+        auto IdsReferToSameAddress = [&](int id, int other_id) SHARED_LOCKS_REQUIRED(m_impl->cs, other.m_impl->cs) {
             if (id == -1 && other_id == -1) {
                 return true;
             }
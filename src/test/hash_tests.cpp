@@ -145,6 +145,24 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between SipHashUint256 and SipHashUint256Batch, for
+    // batch sizes that do and don't fill the last group of lanes.
+    for (size_t count = 0; count < 11; ++count) {
+        const uint64_t k1 = ctx.rand64();
+        const uint64_t k2 = ctx.rand64();
+        std::vector<uint256> vals(count);
+        std::vector<const uint256*> ptrs(count);
+        for (size_t i = 0; i < count; ++i) {
+            vals[i] = InsecureRand256();
+            ptrs[i] = &vals[i];
+        }
+        std::vector<uint64_t> out(count);
+        SipHashUint256Batch(k1, k2, ptrs.data(), out.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k1, k2, vals[i]));
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,11 +2,18 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <fs.h>
 #include <logging.h>
 #include <logging/timer.h>
 #include <test/util/setup_common.h>
+#include <util/strencodings.h>
+#include <util/string.h>
 
 #include <chrono>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -30,4 +37,71 @@ BOOST_AUTO_TEST_CASE(logging_timer)
     BOOST_CHECK_EQUAL(sec_timer.LogMsg("test secs"), "tests: test secs (1.00s)");
 }
 
+//! Log messages "<thread> <n>" from several threads through an asynchronous logger and return the log file's lines.
+static std::vector<std::string> LogFromThreads(BCLog::Logger& logger, const fs::path& path, int threads, int messages)
+{
+    logger.m_print_to_file = true;
+    logger.m_file_path = path;
+    logger.m_log_timestamps = false;
+    logger.m_async = true;
+    BOOST_REQUIRE(logger.StartLogging());
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < messages; ++i) {
+                logger.LogPrintStr(strprintf("%d %d\n", t, i), __func__, __FILE__, __LINE__);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    logger.StopAsyncWriter();
+    logger.DisconnectTestLogger();
+
+    std::vector<std::string> lines;
+    std::ifstream file{path};
+    for (std::string line; std::getline(file, line);) {
+        if (!line.empty()) lines.push_back(line);
+    }
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE(async_logging_block)
+{
+    BCLog::Logger logger;
+    logger.m_buffer_size = 4;
+    logger.m_overflow_policy = BCLog::OverflowPolicy::BLOCK;
+    const auto lines{LogFromThreads(logger, m_args.GetDataDirBase() / "block.log", 4, 500)};
+
+    // Nothing is lost, and each thread's messages appear in order.
+    BOOST_CHECK_EQUAL(lines.size(), 4U * 500U);
+    std::map<std::string, int> next;
+    for (const auto& line : lines) {
+        const size_t space{line.find(' ')};
+        BOOST_REQUIRE(space != std::string::npos);
+        BOOST_CHECK_EQUAL(line.substr(space + 1), ToString(next[line.substr(0, space)]++));
+    }
+    BOOST_CHECK_EQUAL(logger.GetDroppedMessages(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(async_logging_drop)
+{
+    BCLog::Logger logger;
+    logger.m_buffer_size = 1;
+    logger.m_overflow_policy = BCLog::OverflowPolicy::DROP;
+    const auto lines{LogFromThreads(logger, m_args.GetDataDirBase() / "drop.log", 2, 1000)};
+
+    // Every message is either written or counted as dropped.
+    uint64_t written{0}, reported{0};
+    for (const auto& line : lines) {
+        if (line.rfind("Dropped ", 0) == 0) {
+            reported += LocaleIndependentAtoi<uint64_t>(line.substr(8, line.find(' ', 8) - 8));
+        } else {
+            ++written;
+        }
+    }
+    BOOST_CHECK_EQUAL(reported, logger.GetDroppedMessages());
+    BOOST_CHECK_EQUAL(written + reported, 2U * 1000U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
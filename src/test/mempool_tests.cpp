@@ -786,4 +786,70 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+static CMutableTransaction MakeClusterTestTx(const std::vector<COutPoint>& prevouts, int n_outputs, opcodetype tag)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(prevouts.size());
+    for (size_t i = 0; i < prevouts.size(); ++i) {
+        tx.vin[i].prevout = prevouts[i];
+        tx.vin[i].scriptSig = CScript() << tag;
+    }
+    tx.vout.resize(n_outputs);
+    for (auto& out : tx.vout) {
+        out.scriptPubKey = CScript() << tag << OP_EQUAL;
+        out.nValue = 10 * COIN;
+    }
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterModeTest)
+{
+    CTxMemPool pool(nullptr, 0, /*cluster_mode=*/true);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    const CMutableTransaction tx1 = MakeClusterTestTx({COutPoint(InsecureRand256(), 0)}, 1, OP_1);
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx1));
+    const CMutableTransaction tx2 = MakeClusterTestTx({COutPoint(InsecureRand256(), 0)}, 1, OP_2);
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(tx2));
+    const CMutableTransaction tx3 = MakeClusterTestTx({COutPoint(tx2.GetHash(), 0)}, 1, OP_3);
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(tx3));
+
+    // tx3 pays for tx2, so both end up in a single chunk.
+    BOOST_CHECK_EQUAL(pool.GetLinearizedClusters().size(), 2U);
+    const auto tx3_it = pool.GetIter(tx3.GetHash());
+    BOOST_REQUIRE(tx3_it);
+    const auto& tx3_cluster = pool.GetLinearizedClusters().at((*tx3_it)->m_cluster_id);
+    BOOST_CHECK_EQUAL(tx3_cluster.txs.size(), 2U);
+    BOOST_REQUIRE_EQUAL(tx3_cluster.chunks.size(), 1U);
+    BOOST_CHECK_EQUAL(tx3_cluster.chunks[0].fee, 25000);
+    BOOST_CHECK(tx3_cluster.chunks[0].txs.back() == *tx3_it);
+
+    // A parent with two children forms a single cluster, which splits up
+    // once the parent is mined.
+    const CMutableTransaction tx4 = MakeClusterTestTx({COutPoint(InsecureRand256(), 0)}, 2, OP_4);
+    pool.addUnchecked(entry.Fee(2000LL).FromTx(tx4));
+    const CMutableTransaction tx5 = MakeClusterTestTx({COutPoint(tx4.GetHash(), 0)}, 1, OP_5);
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
+    const CMutableTransaction tx6 = MakeClusterTestTx({COutPoint(tx4.GetHash(), 1)}, 1, OP_6);
+    pool.addUnchecked(entry.Fee(3000LL).FromTx(tx6));
+    BOOST_CHECK_EQUAL(pool.GetLinearizedClusters().size(), 3U);
+
+    pool.removeForBlock({MakeTransactionRef(tx4)}, 1);
+    BOOST_CHECK_EQUAL(pool.GetLinearizedClusters().size(), 4U);
+
+    // Eviction removes the chunk with the lowest feerate first.
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx1.GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx2.GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx3.GetHash())));
+    BOOST_CHECK(!pool.exists(GenTxid::Txid(tx5.GetHash())));
+    BOOST_CHECK(pool.exists(GenTxid::Txid(tx6.GetHash())));
+
+    // Chunks are evicted as a whole until nothing fits anymore.
+    pool.TrimToSize(GetVirtualTransactionSize(CTransaction(tx1)));
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK(pool.GetLinearizedClusters().empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,7 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <versionbits.h>
 
 #include <test/util/setup_common.h>
@@ -909,4 +909,73 @@ BOOST_AUTO_TEST_CASE(initial_advertise_from_version_message)
     TestOnlyResetTimeData();
 }
 
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    RecvBufferPool pool;
+    BOOST_CHECK_EQUAL(pool.PooledBytes(), 0U);
+
+    // Small messages get a buffer of the smallest size class.
+    CDataStream small{pool.Get(100, SER_NETWORK, PROTOCOL_VERSION)};
+    BOOST_CHECK_GE(small.capacity(), RecvBufferPool::SIZE_CLASSES.front());
+    BOOST_CHECK_EQUAL(small.GetVersion(), PROTOCOL_VERSION);
+    pool.Put(std::move(small));
+    BOOST_CHECK_GE(pool.PooledBytes(), RecvBufferPool::SIZE_CLASSES.front());
+
+    // Messages are received into a pooled buffer once one is large enough,
+    // without reallocating it.
+    V1TransportSerializer serializer;
+    V1TransportDeserializer deserializer{Params(), /*node_id=*/0, SER_NETWORK, INIT_PROTO_VERSION, &pool};
+    const auto receive{[&](size_t payload_size) {
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::BLOCK;
+        msg.data.resize(payload_size);
+        for (size_t i = 0; i < payload_size; ++i) msg.data[i] = i % 251;
+        std::vector<unsigned char> header;
+        serializer.prepareForTransport(msg, header);
+        std::vector<uint8_t> wire{header};
+        wire.insert(wire.end(), msg.data.begin(), msg.data.end());
+        Span<const uint8_t> bytes{wire};
+        while (!bytes.empty()) {
+            Span<const uint8_t> chunk{bytes.first(std::min<size_t>(bytes.size(), 0x10000))};
+            while (!chunk.empty()) BOOST_REQUIRE(deserializer.Read(chunk) >= 0);
+            bytes = bytes.subspan(std::min<size_t>(bytes.size(), 0x10000));
+        }
+        BOOST_REQUIRE(deserializer.Complete());
+        bool reject{false};
+        CNetMessage received{deserializer.GetMessage(std::chrono::microseconds{0}, reject)};
+        BOOST_CHECK(!reject);
+        BOOST_CHECK_EQUAL(received.m_recv.size(), payload_size);
+        BOOST_CHECK(std::equal(msg.data.begin(), msg.data.end(), UCharCast(received.m_recv.data())));
+        return received;
+    }};
+
+    CNetMessage first{receive(300000)};
+    const auto* const first_data{first.m_recv.data()};
+    pool.Put(std::move(first.m_recv));
+    BOOST_CHECK_GE(pool.PooledBytes(), 300000U);
+
+    CNetMessage second{receive(250000)};
+    BOOST_CHECK(second.m_recv.data() == first_data);
+    BOOST_CHECK_LT(pool.PooledBytes(), 300000U);
+
+    // Buffers of messages larger than the cap are not kept.
+    const size_t pooled{pool.PooledBytes()};
+    CNetMessage large{receive(2 * RecvBufferPool::MAX_POOLED_CAPACITY)};
+    pool.Put(std::move(large.m_recv));
+    BOOST_CHECK_EQUAL(pool.PooledBytes(), pooled);
+
+    // The pools of all peers together keep a limited amount of memory.
+    const size_t total_before{RecvBufferPool::TotalPooledBytes()};
+    std::vector<std::unique_ptr<RecvBufferPool>> pools;
+    for (size_t i = 0; i < 2 * RecvBufferPool::MAX_TOTAL_POOLED_BYTES / RecvBufferPool::SIZE_CLASSES.back(); ++i) {
+        CDataStream buffer{SER_NETWORK, PROTOCOL_VERSION};
+        buffer.reserve(RecvBufferPool::SIZE_CLASSES.back());
+        pools.emplace_back(std::make_unique<RecvBufferPool>())->Put(std::move(buffer));
+    }
+    BOOST_CHECK_LE(RecvBufferPool::TotalPooledBytes(), RecvBufferPool::MAX_TOTAL_POOLED_BYTES);
+    BOOST_CHECK_GT(RecvBufferPool::TotalPooledBytes() + RecvBufferPool::SIZE_CLASSES.back(), RecvBufferPool::MAX_TOTAL_POOLED_BYTES);
+    pools.clear();
+    BOOST_CHECK_EQUAL(RecvBufferPool::TotalPooledBytes(), total_before);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
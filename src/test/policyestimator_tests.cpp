@@ -178,6 +178,22 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     for (int i = 2; i < 9; i++) { // At 9, the original estimate was already at the bottom (b/c scale = 2)
         BOOST_CHECK(feeEst.estimateFee(i).GetFeePerK() < origFeeEst[i-1] - deltaFee);
     }
+
+    // Repeated smart fee estimates are served from the cache, and the
+    // estimates file restores them exactly.
+    feeEst.Flush();
+    CBlockPolicyEstimator feeEstRead;
+    for (int i = 1; i <= 48; i++) {
+        for (const bool conservative : {false, true}) {
+            FeeCalculation calc, cachedCalc, readCalc;
+            const CFeeRate fee = feeEst.estimateSmartFee(i, &calc, conservative);
+            BOOST_CHECK(feeEst.estimateSmartFee(i, &cachedCalc, conservative) == fee);
+            BOOST_CHECK_EQUAL(cachedCalc.returnedTarget, calc.returnedTarget);
+            BOOST_CHECK(cachedCalc.reason == calc.reason);
+            BOOST_CHECK(feeEstRead.estimateSmartFee(i, &readCalc, conservative) == fee);
+            BOOST_CHECK_EQUAL(readCalc.returnedTarget, calc.returnedTarget);
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,10 +4,12 @@
 
 #include <random.h>
 #include <scheduler.h>
+#include <tinyformat.h>
 #include <util/time.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <mutex>
 #include <thread>
@@ -210,4 +212,64 @@ BOOST_AUTO_TEST_CASE(mockforward)
     BOOST_CHECK(delta > 2*60 && delta < 3*60);
 }
 
+BOOST_AUTO_TEST_CASE(timer_wheel_order)
+{
+    // Tasks spread over every level of the wheel (and beyond) come out in
+    // time order, with ties in insertion order, when time advances in steps
+    // of varying size.
+    const TimerWheel::Clock::time_point start{std::chrono::hours{24 * 365 * 50}};
+    TimerWheel wheel{start};
+    FastRandomContext rng{/*fDeterministic=*/true};
+
+    std::vector<std::pair<TimerWheel::Clock::time_point, int>> expected;
+    for (int i = 0; i < 2000; ++i) {
+        // Delays from zero to about four years, at microsecond resolution.
+        const int magnitude = rng.randrange(48);
+        const auto delay{std::chrono::microseconds{rng.randrange(uint64_t{1} << magnitude)}};
+        const auto time{i % 100 == 0 ? start : start + delay};
+        expected.emplace_back(time, i);
+        wheel.Insert({time, nullptr, strprintf("%d", i)});
+    }
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    BOOST_CHECK_EQUAL(wheel.size(), expected.size());
+
+    std::vector<std::pair<TimerWheel::Clock::time_point, int>> popped;
+    auto now{start};
+    while (!wheel.empty()) {
+        wheel.Advance(now);
+        while (auto task{wheel.PopDue(now)}) {
+            BOOST_CHECK(task->time <= now);
+            popped.emplace_back(task->time, std::stoi(task->name));
+        }
+        const auto wakeup{wheel.NextWakeup()};
+        if (!wakeup) break;
+        BOOST_CHECK(*wakeup > now);
+        // Sometimes oversleep, as a busy scheduler thread would.
+        now = *wakeup + std::chrono::microseconds{rng.randbool() ? 0 : rng.randrange(1000000)};
+    }
+    BOOST_CHECK(wheel.empty());
+    BOOST_CHECK(popped == expected);
+}
+
+BOOST_AUTO_TEST_CASE(task_stats)
+{
+    CScheduler scheduler;
+    int counter{0};
+    for (int i = 0; i < 10; ++i) {
+        scheduler.scheduleFromNow([&counter] { ++counter; }, std::chrono::milliseconds{i}, "named");
+    }
+    scheduler.scheduleFromNow([&counter] { ++counter; }, std::chrono::milliseconds{1});
+
+    scheduler.StartWorkerThreads(2);
+    scheduler.StopWhenDrained();
+    BOOST_CHECK_EQUAL(counter, 11);
+
+    const auto stats{scheduler.GetTaskStats()};
+    BOOST_REQUIRE_EQUAL(stats.size(), 2U);
+    BOOST_CHECK_EQUAL(stats.at("named").count, 10U);
+    BOOST_CHECK_EQUAL(stats.at("other").count, 1U);
+    BOOST_CHECK(stats.at("named").delay_p50 <= stats.at("named").delay_p99);
+    BOOST_CHECK(stats.at("named").delay_p99 <= stats.at("named").delay_max);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -101,6 +101,38 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(potential_deadlock_detected_shared_mutex)
+{
+    #ifdef DEBUG_LOCKORDER
+    bool prev = g_debug_lockorder_abort;
+    g_debug_lockorder_abort = false;
+    #endif
+
+    SharedMutex smutex;
+    Mutex mutex;
+    {
+        READ_LOCK(smutex);
+        LOCK(mutex);
+        AssertLockHeld(smutex);
+    }
+    BOOST_CHECK(LockStackEmpty());
+    bool error_thrown = false;
+    try {
+        LOCK(mutex);
+        WRITE_LOCK(smutex);
+    } catch (const std::logic_error& e) {
+        BOOST_CHECK_EQUAL(e.what(), "potential deadlock detected: smutex -> mutex -> smutex");
+        error_thrown = true;
+    }
+    BOOST_CHECK(LockStackEmpty());
+    #ifdef DEBUG_LOCKORDER
+    BOOST_CHECK(error_thrown);
+    g_debug_lockorder_abort = prev;
+    #else
+    BOOST_CHECK(!error_thrown);
+    #endif
+}
+
 /* Double lock would produce an undefined behavior. Thus, we only do that if
  * DEBUG_LOCKORDER is activated to detect it. We don't want non-DEBUG_LOCKORDER
  * build to produce tests that exhibit known undefined behavior. */
@@ -0,0 +1,161 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txprevalidation.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <version.h>
+
+#include <test/util/setup_common.h>
+#include <test/util/validation.h>
+
+#include <chrono>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+using node::MAX_TX_PREVALIDATION_BYTES;
+using node::TxPrevalidator;
+
+BOOST_FIXTURE_TEST_SUITE(txprevalidation_tests, TestingSetup)
+
+static CMutableTransaction SpendOutput(const COutPoint& prevout)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(prevout);
+    tx.vout.emplace_back(9 * COIN, GetScriptForDestination(WitnessV0ScriptHash(CScript() << OP_TRUE)));
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(prevalidate)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    TxPrevalidator prevalidator(*m_node.chainman, pool, /*num_threads=*/0);
+
+    // An unconfirmed parent with an output anyone can spend and one nobody can.
+    CMutableTransaction parent;
+    parent.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_TRUE);
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_FALSE);
+    {
+        LOCK2(cs_main, pool.cs);
+        TestMemPoolEntryHelper entry;
+        pool.addUnchecked(entry.FromTx(parent));
+    }
+
+    BOOST_CHECK(prevalidator.Prevalidate(CTransaction(SpendOutput(COutPoint(parent.GetHash(), 0)))));
+
+    // Failing scripts, missing inputs and transactions already in the mempool
+    // are all rejected.
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(SpendOutput(COutPoint(parent.GetHash(), 1)))));
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(SpendOutput(COutPoint(InsecureRand256(), 0)))));
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(parent)));
+
+    // So are transactions failing the context-free checks.
+    CMutableTransaction overspend = SpendOutput(COutPoint(parent.GetHash(), 0));
+    overspend.vout[0].nValue = 11 * COIN;
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(overspend)));
+    CMutableTransaction no_outputs = SpendOutput(COutPoint(parent.GetHash(), 0));
+    no_outputs.vout.clear();
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(no_outputs)));
+
+    // Transactions below the minimum relay fee are rejected before their
+    // scripts are checked, unless they were prioritised.
+    CMutableTransaction no_fee = SpendOutput(COutPoint(parent.GetHash(), 0));
+    no_fee.vout[0].nValue = 10 * COIN;
+    BOOST_CHECK(!prevalidator.Prevalidate(CTransaction(no_fee)));
+    pool.PrioritiseTransaction(no_fee.GetHash(), COIN);
+    BOOST_CHECK(prevalidator.Prevalidate(CTransaction(no_fee)));
+}
+
+BOOST_AUTO_TEST_CASE(prevalidate_batch)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    TxPrevalidator prevalidator(*m_node.chainman, pool, /*num_threads=*/0);
+
+    CMutableTransaction parent;
+    parent.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_TRUE);
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_FALSE);
+    {
+        LOCK2(cs_main, pool.cs);
+        TestMemPoolEntryHelper entry;
+        pool.addUnchecked(entry.FromTx(parent));
+    }
+
+    // Transactions of a batch may spend the same coins.
+    CMutableTransaction conflicting = SpendOutput(COutPoint(parent.GetHash(), 0));
+    conflicting.vout[0].nValue = 8 * COIN;
+    const std::vector<CTransactionRef> txs{
+        MakeTransactionRef(SpendOutput(COutPoint(parent.GetHash(), 0))),
+        MakeTransactionRef(SpendOutput(COutPoint(parent.GetHash(), 1))),
+        MakeTransactionRef(conflicting),
+        MakeTransactionRef(SpendOutput(COutPoint(InsecureRand256(), 0))),
+    };
+    const std::vector<bool> expected{true, false, true, false};
+    BOOST_CHECK(prevalidator.Prevalidate(txs) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(queue_bytes)
+{
+    // Without worker threads nothing is taken off the queue.
+    TxPrevalidator prevalidator(*m_node.chainman, *m_node.mempool, /*num_threads=*/0);
+
+    CDataStream tx_data{SER_NETWORK, PROTOCOL_VERSION};
+    tx_data << CTransaction(SpendOutput(COutPoint(InsecureRand256(), 0)));
+    const size_t max_queued{MAX_TX_PREVALIDATION_BYTES / tx_data.size()};
+    for (size_t i = 0; i < max_queued; ++i) {
+        prevalidator.Submit(tx_data);
+    }
+    BOOST_CHECK_EQUAL(prevalidator.GetQueuedBytes(), max_queued * tx_data.size());
+
+    // The queue is bounded by the size of the transactions, not their number.
+    prevalidator.Submit(tx_data);
+    BOOST_CHECK_EQUAL(prevalidator.GetQueuedBytes(), max_queued * tx_data.size());
+
+    prevalidator.Stop();
+    BOOST_CHECK_EQUAL(prevalidator.GetQueuedBytes(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(worker_threads)
+{
+    CTxMemPool& pool = *m_node.mempool;
+    // The workers skip transactions during IBD, like the message handler.
+    TestChainState& chainstate = *static_cast<TestChainState*>(&m_node.chainman->ActiveChainstate());
+    chainstate.JumpOutOfIbd();
+
+    CMutableTransaction parent;
+    parent.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_TRUE);
+    parent.vout.emplace_back(10 * COIN, CScript() << OP_FALSE);
+    {
+        LOCK2(cs_main, pool.cs);
+        TestMemPoolEntryHelper entry;
+        pool.addUnchecked(entry.FromTx(parent));
+    }
+
+    TxPrevalidator prevalidator(*m_node.chainman, pool, /*num_threads=*/2);
+    for (const uint32_t n : {0, 1, 0}) {
+        CDataStream tx_data{SER_NETWORK, PROTOCOL_VERSION};
+        tx_data << CTransaction(SpendOutput(COutPoint(parent.GetHash(), n)));
+        prevalidator.Submit(tx_data);
+    }
+    // Malformed data is counted as failed.
+    prevalidator.Submit(CDataStream{std::vector<unsigned char>{0x01, 0x02}, SER_NETWORK, PROTOCOL_VERSION});
+
+    for (int i = 0; i < 1000 && prevalidator.GetPassed() + prevalidator.GetFailed() < 4; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    BOOST_CHECK_EQUAL(prevalidator.GetPassed(), 2U);
+    BOOST_CHECK_EQUAL(prevalidator.GetFailed(), 2U);
+    BOOST_CHECK_EQUAL(prevalidator.GetQueuedBytes(), 0U);
+
+    prevalidator.Stop();
+    chainstate.ResetIbd();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
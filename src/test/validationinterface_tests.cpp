@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <boost/test/unit_test.hpp>
+#include <chain.h>
 #include <consensus/validation.h>
 #include <primitives/block.h>
 #include <scheduler.h>
@@ -10,6 +11,9 @@
 #include <util/check.h>
 #include <validationinterface.h>
 
+#include <chrono>
+#include <future>
+
 BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
 
 struct TestSubscriberNoop final : public CValidationInterface {
@@ -91,4 +95,112 @@ BOOST_AUTO_TEST_CASE(unregister_all_during_call)
     BOOST_CHECK(destroyed);
 }
 
+class TestMempoolInterface : public CValidationInterface
+{
+public:
+    explicit TestMempoolInterface(std::function<void()> on_tx) : m_on_tx(std::move(on_tx)) {}
+    void TransactionAddedToMempool(const CTransactionRef&, uint64_t) override { m_on_tx(); }
+    std::function<void()> m_on_tx;
+};
+
+// A subscriber blocked in a callback must not delay notifications for other
+// subscribers, while notifications for each subscriber stay in order.
+BOOST_AUTO_TEST_CASE(slow_subscriber_does_not_block_others)
+{
+    std::promise<void> release_slow;
+    std::shared_future<void> released{release_slow.get_future()};
+    std::atomic<int> slow_calls{0};
+    auto slow = std::make_shared<TestMempoolInterface>([&] {
+        released.wait();
+        ++slow_calls;
+    });
+
+    std::promise<void> fast_done;
+    int fast_calls{0};
+    auto fast = std::make_shared<TestMempoolInterface>([&] {
+        if (++fast_calls == 3) fast_done.set_value();
+    });
+
+    RegisterSharedValidationInterface(slow, "slow");
+    RegisterSharedValidationInterface(fast);
+
+    const CTransactionRef tx{MakeTransactionRef(CMutableTransaction{})};
+    for (int i = 0; i < 3; ++i) {
+        GetMainSignals().TransactionAddedToMempool(tx, i);
+    }
+
+    BOOST_CHECK(fast_done.get_future().wait_for(std::chrono::seconds{30}) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(slow_calls, 0);
+    BOOST_CHECK_GE(GetMainSignals().CallbacksPending(), 2U);
+
+    const auto blocked_stats{GetMainSignals().GetQueueStats()};
+    BOOST_REQUIRE_EQUAL(blocked_stats.size(), 2U);
+    BOOST_CHECK_EQUAL(blocked_stats[0].processed, 0U);
+    BOOST_CHECK_EQUAL(blocked_stats[1].pending, 0U);
+
+    release_slow.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow_calls, 3);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+
+    const auto stats{GetMainSignals().GetQueueStats()};
+    BOOST_REQUIRE_EQUAL(stats.size(), 2U);
+    BOOST_CHECK_EQUAL(stats[0].name, "slow");
+    BOOST_CHECK_EQUAL(stats[1].name, "other");
+    BOOST_CHECK_EQUAL(stats[0].processed, 3U + 1U); // including the sync barrier
+    BOOST_CHECK_GE(stats[0].max_pending, 2U);
+
+    UnregisterSharedValidationInterface(slow);
+    UnregisterSharedValidationInterface(fast);
+}
+
+class TestBatchInterface : public CValidationInterface
+{
+public:
+    explicit TestBatchInterface(std::shared_future<void> released) : m_released(std::move(released)) {}
+    void TransactionAddedToMempool(const CTransactionRef&, uint64_t) override { m_released.wait(); }
+    void BlocksConnected(Span<const ConnectedBlock> blocks) override
+    {
+        std::vector<int> heights;
+        for (const ConnectedBlock& connected : blocks) heights.push_back(connected.pindex->nHeight);
+        m_batches.push_back(std::move(heights));
+    }
+    std::shared_future<void> m_released;
+    std::vector<std::vector<int>> m_batches;
+};
+
+// BlockConnected events queued up behind a busy subscriber are delivered in a
+// single BlocksConnected call.
+BOOST_AUTO_TEST_CASE(block_connected_batching)
+{
+    std::promise<void> release;
+    auto sub = std::make_shared<TestBatchInterface>(release.get_future().share());
+    RegisterSharedValidationInterface(sub);
+
+    const CTransactionRef tx{MakeTransactionRef(CMutableTransaction{})};
+    const auto block{std::make_shared<const CBlock>()};
+    std::vector<CBlockIndex> indexes(5);
+    std::vector<uint256> hashes(indexes.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        indexes[i].phashBlock = &hashes[i];
+        indexes[i].nHeight = i;
+        indexes[i].pprev = i > 0 ? &indexes[i - 1] : nullptr;
+    }
+
+    // Block the subscriber, queue two runs of blocks separated by another
+    // notification, then let it catch up.
+    GetMainSignals().TransactionAddedToMempool(tx, 0);
+    for (size_t i = 0; i < 3; ++i) GetMainSignals().BlockConnected(block, &indexes[i]);
+    GetMainSignals().TransactionAddedToMempool(tx, 1);
+    for (size_t i = 3; i < 5; ++i) GetMainSignals().BlockConnected(block, &indexes[i]);
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+
+    BOOST_REQUIRE_EQUAL(sub->m_batches.size(), 2U);
+    BOOST_CHECK(sub->m_batches[0] == std::vector<int>({0, 1, 2}));
+    BOOST_CHECK(sub->m_batches[1] == std::vector<int>({3, 4}));
+
+    UnregisterSharedValidationInterface(sub);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,7 @@ static constexpr uint8_t DB_HEAD_BLOCKS{'H'};
 static constexpr uint8_t DB_FLAG{'F'};
 static constexpr uint8_t DB_REINDEX_FLAG{'R'};
 static constexpr uint8_t DB_LAST_BLOCK{'l'};
+static constexpr uint8_t DB_BLOCK_INDEX_SNAPSHOT{'s'};
 
 // Keys used in previous version that might still be found in the DB:
 static constexpr uint8_t DB_TXINDEX_BLOCK{'T'};
@@ -572,6 +573,21 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::ReadBlockIndexSnapshotId(uint256& id)
+{
+    return Read(DB_BLOCK_INDEX_SNAPSHOT, id);
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshotId(const uint256& id)
+{
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, id, /*fSync=*/true);
+}
+
+bool CBlockTreeDB::EraseBlockIndexSnapshotId()
+{
+    return Erase(DB_BLOCK_INDEX_SNAPSHOT, /*fSync=*/true);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     AssertLockHeld(::cs_main);
@@ -91,6 +91,11 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /** Identifier of the block index snapshot file matching the database,
+     *  if one was written and has not been used yet. */
+    bool ReadBlockIndexSnapshotId(uint256& id);
+    bool WriteBlockIndexSnapshotId(const uint256& id);
+    bool EraseBlockIndexSnapshotId();
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 };
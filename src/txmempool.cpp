@@ -10,6 +10,7 @@
 #include <consensus/consensus.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <names/main.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
@@ -112,6 +113,11 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& tx, CAmount fee,
         }
 
         assert(nameOp.isNameOp());
+
+        /* Registrations are not minable until the maturity of their NAME_NEW
+           input is known, see UpdateNameMinHeight.  */
+        if (isNameRegistration())
+            nameMinHeight = MEMPOOL_HEIGHT;
     }
 }
 
@@ -222,6 +228,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
                 if (!visited(childIter) && !setAlreadyIncluded.count(childHash)) {
                     UpdateChild(it, childIter, true);
                     UpdateParent(childIter, it, true);
+                    if (m_cluster_mode) MergeClusters(it, childIter);
                 }
             }
         } // release epoch guard for UpdateForDescendants
@@ -477,9 +484,9 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
     assert(int(nSigOpCostWithAncestors) >= 0);
 }
 
-CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator, int check_ratio)
+CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator, int check_ratio, bool cluster_mode)
     : m_check_ratio(check_ratio), minerPolicyEstimator(estimator),
-      names(*this)
+      m_cluster_mode(cluster_mode), names(*this)
 {
     _clear(); //lock free clear
 }
@@ -540,6 +547,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     }
     UpdateAncestorsOf(true, newit, setAncestors);
     UpdateEntryForAncestors(newit, setAncestors);
+    if (m_cluster_mode) AddToCluster(newit);
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
@@ -589,6 +597,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     m_total_fee -= it->GetFee();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
+    if (m_cluster_mode) RemoveFromCluster(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
@@ -722,15 +731,185 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
+    UpdateNameRegistrationsForBlock(vtx, nBlockHeight);
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
 }
 
+void CTxMemPool::UpdateNameRegistrationsForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight)
+{
+    AssertLockHeld(cs);
+    for (const auto& tx : vtx) {
+        if (!tx->IsNamecoin()) continue;
+        for (unsigned i = 0; i < tx->vout.size(); ++i) {
+            const CNameScript op(tx->vout[i].scriptPubKey);
+            if (!op.isNameOp() || op.getNameOp() != OP_NAME_NEW) continue;
+
+            const auto itNext = mapNextTx.find(COutPoint(tx->GetHash(), i));
+            if (itNext == mapNextTx.end()) continue;
+            const txiter it = mapTx.find(itNext->second->GetHash());
+            assert(it != mapTx.end());
+            if (!it->isNameRegistration()) continue;
+
+            const unsigned minHeight = nBlockHeight + MIN_FIRSTUPDATE_DEPTH;
+            mapTx.modify(it, [minHeight](CTxMemPoolEntry& e) { e.UpdateNameMinHeight(minHeight); });
+        }
+    }
+}
+
+void CTxMemPool::AddToCluster(txiter it)
+{
+    AssertLockHeld(cs);
+    const uint64_t cluster_id = m_next_cluster_id++;
+    it->m_cluster_id = cluster_id;
+    it->m_cluster_idx = 0;
+    m_clusters[cluster_id].txs.push_back(it);
+    MarkClusterDirty(cluster_id);
+
+    for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+        MergeClusters(it, mapTx.iterator_to(parent));
+    }
+}
+
+void CTxMemPool::RemoveFromCluster(txiter it)
+{
+    AssertLockHeld(cs);
+    const uint64_t cluster_id = it->m_cluster_id;
+    MarkClusterDirty(cluster_id);
+
+    Cluster& cluster = m_clusters.at(cluster_id);
+    assert(cluster.txs[it->m_cluster_idx] == it);
+    cluster.txs[it->m_cluster_idx] = cluster.txs.back();
+    cluster.txs[it->m_cluster_idx]->m_cluster_idx = it->m_cluster_idx;
+    cluster.txs.pop_back();
+    if (cluster.txs.empty()) {
+        m_dirty_clusters.erase(cluster_id);
+        m_clusters.erase(cluster_id);
+    }
+}
+
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    AssertLockHeld(cs);
+    uint64_t into = a->m_cluster_id;
+    uint64_t from = b->m_cluster_id;
+    if (into == from) return;
+    if (m_clusters.at(into).txs.size() < m_clusters.at(from).txs.size()) {
+        std::swap(into, from);
+    }
+    MarkClusterDirty(into);
+    MarkClusterDirty(from);
+
+    Cluster& target = m_clusters.at(into);
+    for (const txiter it : m_clusters.at(from).txs) {
+        it->m_cluster_id = into;
+        it->m_cluster_idx = target.txs.size();
+        target.txs.push_back(it);
+    }
+    m_dirty_clusters.erase(from);
+    m_clusters.erase(from);
+}
+
+void CTxMemPool::MarkClusterDirty(uint64_t cluster_id) const
+{
+    AssertLockHeld(cs);
+    if (!m_dirty_clusters.insert(cluster_id).second) return;
+
+    Cluster& cluster = m_clusters.at(cluster_id);
+    if (!cluster.chunks.empty()) {
+        m_cluster_tails.erase({cluster.chunks.back().fee, cluster.chunks.back().size, cluster_id});
+        cluster.chunks.clear();
+    }
+}
+
+void CTxMemPool::LinearizeDirtyClusters() const
+{
+    AssertLockHeld(cs);
+    assert(m_cluster_mode);
+    while (!m_dirty_clusters.empty()) {
+        const uint64_t cluster_id = *m_dirty_clusters.begin();
+        m_dirty_clusters.erase(m_dirty_clusters.begin());
+
+        // Removals may have disconnected the cluster.  The first connected
+        // component keeps the cluster id, all others get new clusters.
+        const std::vector<txiter> txs = std::move(m_clusters.at(cluster_id).txs);
+        std::vector<uint64_t> components;
+        {
+            WITH_FRESH_EPOCH(m_epoch);
+            for (const txiter root : txs) {
+                if (visited(root)) continue;
+                std::vector<txiter> component{root};
+                for (size_t i = 0; i < component.size(); ++i) {
+                    for (const CTxMemPoolEntry& parent : component[i]->GetMemPoolParentsConst()) {
+                        const txiter parent_it = mapTx.iterator_to(parent);
+                        if (!visited(parent_it)) component.push_back(parent_it);
+                    }
+                    for (const CTxMemPoolEntry& child : component[i]->GetMemPoolChildrenConst()) {
+                        const txiter child_it = mapTx.iterator_to(child);
+                        if (!visited(child_it)) component.push_back(child_it);
+                    }
+                }
+
+                const uint64_t id = components.empty() ? cluster_id : m_next_cluster_id++;
+                Cluster& cluster = m_clusters[id];
+                cluster.txs = std::move(component);
+                for (size_t i = 0; i < cluster.txs.size(); ++i) {
+                    cluster.txs[i]->m_cluster_id = id;
+                    cluster.txs[i]->m_cluster_idx = i;
+                }
+                components.push_back(id);
+            }
+        }
+
+        for (const uint64_t id : components) {
+            LinearizeCluster(id, m_clusters.at(id));
+        }
+    }
+}
+
+void CTxMemPool::LinearizeCluster(uint64_t cluster_id, Cluster& cluster) const
+{
+    AssertLockHeld(cs);
+    std::vector<cluster_linearize::ClusterTx> txs;
+    txs.reserve(cluster.txs.size());
+    for (const txiter it : cluster.txs) {
+        cluster_linearize::ClusterTx tx{it->GetModifiedFee(), static_cast<int64_t>(it->GetTxSize()), {}};
+        for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+            assert(parent.m_cluster_id == cluster_id);
+            tx.parents.push_back(parent.m_cluster_idx);
+        }
+        txs.push_back(std::move(tx));
+    }
+
+    cluster.chunks.clear();
+    for (const auto& chunk : cluster_linearize::ChunkLinearization(txs, cluster_linearize::Linearize(txs))) {
+        ClusterChunk& cluster_chunk = cluster.chunks.emplace_back();
+        cluster_chunk.txs.reserve(chunk.txs.size());
+        for (const uint32_t i : chunk.txs) {
+            cluster_chunk.txs.push_back(cluster.txs[i]);
+        }
+        cluster_chunk.fee = chunk.fee;
+        cluster_chunk.size = chunk.size;
+    }
+    assert(!cluster.chunks.empty());
+    m_cluster_tails.insert({cluster.chunks.back().fee, cluster.chunks.back().size, cluster_id});
+}
+
+const std::map<uint64_t, CTxMemPool::Cluster>& CTxMemPool::GetLinearizedClusters() const
+{
+    AssertLockHeld(cs);
+    LinearizeDirtyClusters();
+    return m_clusters;
+}
+
 void CTxMemPool::_clear()
 {
     mapTx.clear();
     mapNextTx.clear();
     names.clear();
+    m_clusters.clear();
+    m_dirty_clusters.clear();
+    m_cluster_tails.clear();
     totalTxSize = 0;
     m_total_fee = 0;
     cachedInnerUsage = 0;
@@ -853,6 +1032,24 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
 
+    if (m_cluster_mode) {
+        // Every entry is in exactly one cluster, together with its parents.
+        uint64_t cluster_txs = 0;
+        for (const auto& [cluster_id, cluster] : m_clusters) {
+            assert(!cluster.txs.empty());
+            for (size_t i = 0; i < cluster.txs.size(); ++i) {
+                assert(cluster.txs[i]->m_cluster_id == cluster_id);
+                assert(cluster.txs[i]->m_cluster_idx == i);
+                for (const CTxMemPoolEntry& parent : cluster.txs[i]->GetMemPoolParentsConst()) {
+                    assert(parent.m_cluster_id == cluster_id);
+                }
+            }
+            assert((m_dirty_clusters.count(cluster_id) > 0) == cluster.chunks.empty());
+            cluster_txs += cluster.txs.size();
+        }
+        assert(cluster_txs == mapTx.size());
+    }
+
     checkNames(active_coins_tip, spendheight);
 }
 
@@ -979,6 +1176,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             for (txiter descendantIt : setDescendants) {
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
             }
+            if (m_cluster_mode) MarkClusterDirty(it->m_cluster_id);
             ++nTransactionsUpdated;
         }
     }
@@ -1173,19 +1371,30 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        setEntries stage;
+        CFeeRate removed;
+        if (m_cluster_mode) {
+            // The last chunk of a cluster has no descendants outside of it,
+            // so it can be removed on its own.
+            LinearizeDirtyClusters();
+            const ClusterTail& tail = *m_cluster_tails.begin();
+            const ClusterChunk& chunk = m_clusters.at(tail.cluster_id).chunks.back();
+            removed = CFeeRate(chunk.fee, chunk.size);
+            stage.insert(chunk.txs.begin(), chunk.txs.end());
+        } else {
+            indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+            removed = CFeeRate(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+            CalculateDescendants(mapTx.project<0>(it), stage);
+        }
 
         // We set the new mempool min fee to the feerate of the removed set, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
         removed += incrementalRelayFee;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
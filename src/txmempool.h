@@ -14,6 +14,7 @@
 #include <utility>
 #include <vector>
 
+#include <cluster_linearize.h>
 #include <coins.h>
 #include <consensus/amount.h>
 #include <indirectmap.h>
@@ -39,6 +40,8 @@ extern RecursiveMutex cs_main;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
+/** Default for -mempoolclustermode */
+static const bool DEFAULT_MEMPOOL_CLUSTER_MODE{false};
 
 struct LockPoints {
     // Will be set to the blockchain height and median time past
@@ -122,6 +125,14 @@ private:
     /* Cache name operation (if any) performed by this tx.  */
     CNameScript nameOp;
 
+    /**
+     * Earliest block height at which this tx can be mined according to the
+     * Namecoin rules.  This is only relevant for name registrations, whose
+     * NAME_NEW input must have matured; it is MEMPOOL_HEIGHT while that input
+     * is not yet confirmed.  For all other transactions it is zero.
+     */
+    unsigned nameMinHeight{0};
+
 public:
     CTxMemPoolEntry(const CTransactionRef& tx, CAmount fee,
                     int64_t time, unsigned int entry_height,
@@ -149,6 +160,8 @@ public:
     void UpdateFeeDelta(int64_t feeDelta);
     // Update the LockPoints after a reorg
     void UpdateLockPoints(const LockPoints& lp);
+    // Update the minimum height for mining a name registration
+    void UpdateNameMinHeight(unsigned h) { nameMinHeight = h; }
 
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
@@ -191,9 +204,16 @@ public:
     {
         return nameOp.getOpName();
     }
+    inline unsigned
+    getNameMinHeight() const
+    {
+        return nameMinHeight;
+    }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
     mutable Epoch::Marker m_epoch_marker; //!< epoch when last touched, useful for graph algorithms
+    mutable uint64_t m_cluster_id{0}; //!< Cluster this entry belongs to (cluster mode only)
+    mutable size_t m_cluster_idx{0}; //!< Index in its cluster's transactions (cluster mode only)
 };
 
 // extracts a transaction hash from CTxMemPoolEntry or CTransactionRef
@@ -464,6 +484,7 @@ protected:
     const int m_check_ratio; //!< Value n means that 1 times in n we check.
     std::atomic<unsigned int> nTransactionsUpdated{0}; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
     CBlockPolicyEstimator* const minerPolicyEstimator;
+    const bool m_cluster_mode; //!< Whether eviction and mining work on clusters
 
     uint64_t totalTxSize GUARDED_BY(cs);      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     CAmount m_total_fee GUARDED_BY(cs);       //!< sum of all mempool tx's fees (NOT modified fee)
@@ -557,10 +578,50 @@ public:
 
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
+    /** A chunk of a cluster's linearization, mined or evicted as a whole */
+    struct ClusterChunk {
+        std::vector<txiter> txs; //!< In linearization (and thus topological) order
+        CAmount fee{0};          //!< Sum of modified fees
+        int64_t size{0};         //!< Sum of virtual sizes
+    };
+
+    /** A connected component of the mempool's transaction graph */
+    struct Cluster {
+        std::vector<txiter> txs;          //!< Members, in no particular order
+        std::vector<ClusterChunk> chunks; //!< Chunks in decreasing feerate order; stale while the cluster is dirty
+    };
+
     uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
+    /** Feerate of the last chunk of a cluster, which is the first to be evicted */
+    struct ClusterTail {
+        CAmount fee;
+        int64_t size;
+        uint64_t cluster_id;
+    };
+    struct CompareClusterTail {
+        bool operator()(const ClusterTail& a, const ClusterTail& b) const
+        {
+            if (cluster_linearize::FeerateHigher(b.fee, b.size, a.fee, a.size)) return true;
+            if (cluster_linearize::FeerateHigher(a.fee, a.size, b.fee, b.size)) return false;
+            return a.cluster_id < b.cluster_id;
+        }
+    };
+
+    /**
+     * Cluster tracking (only used in cluster mode).  Clusters are merged
+     * eagerly when a transaction connects them, but split and relinearized
+     * lazily the next time their chunks are needed; hence the state is
+     * mutable so that this can happen from const accessors.
+     */
+    mutable std::map<uint64_t, Cluster> m_clusters GUARDED_BY(cs);
+    mutable std::set<uint64_t> m_dirty_clusters GUARDED_BY(cs);
+    //! Tail chunk feerates of all clusters that are not dirty, lowest first
+    mutable std::set<ClusterTail, CompareClusterTail> m_cluster_tails GUARDED_BY(cs);
+    mutable uint64_t m_next_cluster_id GUARDED_BY(cs){1};
+
 
     void UpdateParent(txiter entry, txiter parent, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
     void UpdateChild(txiter entry, txiter child, bool add) EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -602,8 +663,9 @@ public:
      *
      * @param[in] estimator is used to estimate appropriate transaction fees.
      * @param[in] check_ratio is the ratio used to determine how often sanity checks will run.
+     * @param[in] cluster_mode makes eviction and mining work on linearized clusters.
      */
-    explicit CTxMemPool(CBlockPolicyEstimator* estimator = nullptr, int check_ratio = 0);
+    explicit CTxMemPool(CBlockPolicyEstimator* estimator = nullptr, int check_ratio = 0, bool cluster_mode = DEFAULT_MEMPOOL_CLUSTER_MODE);
 
     /**
      * If sanity-checking is turned on, check makes sure the pool is
@@ -756,6 +818,9 @@ public:
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
+      *  In cluster mode, the lowest feerate chunk of any cluster is removed
+      *  first, otherwise the transaction with the lowest descendant score
+      *  together with its descendants.
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -770,6 +835,13 @@ public:
      */
     void GetTransactionAncestry(const uint256& txid, size_t& ancestors, size_t& descendants, size_t* ancestorsize = nullptr, CAmount* ancestorfees = nullptr) const;
 
+    bool IsClusterMode() const { return m_cluster_mode; }
+
+    /** Return all clusters with their chunks brought up to date.  Only
+     *  available in cluster mode; the result is invalidated by any
+     *  modification of the mempool. */
+    const std::map<uint64_t, Cluster>& GetLinearizedClusters() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** @returns true if the mempool is fully loaded */
     bool IsLoaded() const;
 
@@ -938,6 +1010,21 @@ private:
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Update the cached minimum mining height of name registrations whose
+     *  NAME_NEW input has just been confirmed in a block. */
+    void UpdateNameRegistrationsForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Put a new entry into a cluster, merging the clusters of its in-mempool parents. */
+    void AddToCluster(txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Remove an entry from its cluster, which may leave it disconnected. */
+    void RemoveFromCluster(txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Merge the clusters of two entries, moving the smaller into the larger. */
+    void MergeClusters(txiter a, txiter b) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void MarkClusterDirty(uint64_t cluster_id) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Split all dirty clusters into their connected components and recompute their chunks. */
+    void LinearizeDirtyClusters() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Recompute the chunks of a connected cluster. */
+    void LinearizeCluster(uint64_t cluster_id, Cluster& cluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /** Before calling removeUnchecked for a given transaction,
      *  UpdateForRemoveFromMempool must be called on the entire (dependent) set
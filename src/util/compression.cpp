@@ -0,0 +1,106 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/compression.h>
+
+#include <crypto/common.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+/** Repetitions shorter than this are stored as literals */
+constexpr size_t MIN_MATCH{4};
+/** Number of bits of the hash table used to find repetitions */
+constexpr int HASH_BITS{14};
+
+uint32_t HashSequence(const unsigned char* data)
+{
+    return (ReadLE32(data) * uint32_t{2654435761}) >> (32 - HASH_BITS);
+}
+
+void WriteLength(std::vector<unsigned char>& out, uint64_t n)
+{
+    while (n >= 0x80) {
+        out.push_back((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    out.push_back(n);
+}
+
+bool ReadLength(Span<const unsigned char>& in, uint64_t& n)
+{
+    n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in.empty()) return false;
+        const unsigned char byte{in.front()};
+        in = in.subspan(1);
+        n |= uint64_t{byte & 0x7fU} << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::vector<unsigned char> CompressBytes(Span<const unsigned char> data)
+{
+    std::vector<unsigned char> out;
+    out.reserve(data.size() / 2 + 16);
+
+    // Last position (plus one) at which each hashed sequence was seen
+    std::vector<uint32_t> table(size_t{1} << HASH_BITS, 0);
+    size_t literal_start{0};
+    size_t pos{0};
+    while (pos + MIN_MATCH <= data.size()) {
+        const uint32_t hash{HashSequence(data.data() + pos)};
+        const size_t candidate{table[hash]};
+        table[hash] = static_cast<uint32_t>(pos + 1);
+        if (candidate == 0 || std::memcmp(data.data() + candidate - 1, data.data() + pos, MIN_MATCH) != 0) {
+            ++pos;
+            continue;
+        }
+
+        const size_t match_start{candidate - 1};
+        size_t length{MIN_MATCH};
+        while (pos + length < data.size() && data[match_start + length] == data[pos + length]) {
+            ++length;
+        }
+        WriteLength(out, pos - literal_start);
+        out.insert(out.end(), data.begin() + literal_start, data.begin() + pos);
+        WriteLength(out, length - MIN_MATCH);
+        WriteLength(out, pos - match_start);
+        pos += length;
+        literal_start = pos;
+    }
+    WriteLength(out, data.size() - literal_start);
+    out.insert(out.end(), data.begin() + literal_start, data.end());
+
+    return out;
+}
+
+std::optional<std::vector<unsigned char>> DecompressBytes(Span<const unsigned char> data, size_t max_size)
+{
+    std::vector<unsigned char> out;
+    while (true) {
+        uint64_t literals;
+        if (!ReadLength(data, literals) || literals > data.size() || literals > max_size - out.size()) {
+            return std::nullopt;
+        }
+        out.insert(out.end(), data.begin(), data.begin() + literals);
+        data = data.subspan(literals);
+        if (data.empty()) return out;
+
+        uint64_t length, offset;
+        if (!ReadLength(data, length) || !ReadLength(data, offset)) return std::nullopt;
+        if (length > max_size || length + MIN_MATCH > max_size - out.size()) return std::nullopt;
+        if (offset == 0 || offset > out.size()) return std::nullopt;
+        // The referenced data may overlap with the data being copied.
+        const size_t from{out.size() - offset};
+        for (size_t i = 0; i < length + MIN_MATCH; ++i) {
+            out.push_back(out[from + i]);
+        }
+    }
+}
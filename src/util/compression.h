@@ -0,0 +1,30 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_COMPRESSION_H
+#define BITCOIN_UTIL_COMPRESSION_H
+
+#include <span.h>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+/**
+ * Compress data with a simple and fast LZ77 scheme.
+ *
+ * The output is a sequence of literal runs, each of them but the last one
+ * followed by a back reference into the data decompressed so far.  This works
+ * well for data that repeats itself, like the names, values and scripts that
+ * appear several times in the undo data of name operations.
+ */
+std::vector<unsigned char> CompressBytes(Span<const unsigned char> data);
+
+/**
+ * Decompress the output of CompressBytes.  Returns std::nullopt if the input
+ * is malformed or would decompress to more than max_size bytes.
+ */
+std::optional<std::vector<unsigned char>> DecompressBytes(Span<const unsigned char> data, size_t max_size);
+
+#endif // BITCOIN_UTIL_COMPRESSION_H
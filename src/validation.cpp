@@ -21,6 +21,7 @@
 #include <flatfile.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
+#include <index/namehash.h>
 #include <logging.h>
 #include <logging/timer.h>
 #include <names/main.h>
@@ -371,6 +372,14 @@ void CChainState::MaybeUpdateMempoolForReorg(
                 }
             }
         }
+        // The NAME_NEW input of a registration may have been disconnected
+        // or confirmed at a different height; refresh the cached maturity.
+        if (it->isNameRegistration()) {
+            const unsigned name_min_height{NameFirstUpdateMinHeight(tx, view_mempool)};
+            if (name_min_height != it->getNameMinHeight()) {
+                m_mempool->mapTx.modify(it, [name_min_height](CTxMemPoolEntry& e) { e.UpdateNameMinHeight(name_min_height); });
+            }
+        }
         // Transaction is still valid and cached LockPoints are updated.
         return false;
     };
@@ -844,6 +853,11 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
             fSpendsCoinbase, nSigOpsCost, lp));
     ws.m_vsize = entry->GetTxSize();
 
+    /* Cache the height at which a name registration's NAME_NEW input has
+       matured, so that block assembly does not need to look it up.  */
+    if (entry->isNameRegistration())
+        entry->UpdateNameMinHeight(NameFirstUpdateMinHeight(tx, m_view));
+
     if (nSigOpsCost > MAX_STANDARD_TX_SIGOPS_COST)
         return state.Invalid(TxValidationResult::TX_NOT_STANDARD, "bad-txns-too-many-sigops",
                 strprintf("%d", nSigOpsCost));
@@ -1921,14 +1935,45 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+namespace {
+
+/**
+ * Closure representing the context-free proof-of-work check of a block
+ * header, which includes verifying its auxpow.
+ */
+class CHeaderCheck
+{
+private:
+    const CBlockHeader* m_header{nullptr};
+    const Consensus::Params* m_params{nullptr};
+
+public:
+    CHeaderCheck() = default;
+    CHeaderCheck(const CBlockHeader& header, const Consensus::Params& params) : m_header(&header), m_params(&params) {}
+
+    bool operator()() { return CheckProofOfWork(*m_header, *m_params); }
+
+    void swap(CHeaderCheck& check)
+    {
+        std::swap(m_header, check.m_header);
+        std::swap(m_params, check.m_params);
+    }
+};
+
+} // namespace
+
+static CCheckQueue<CHeaderCheck> headercheckqueue(32);
+
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
+    headercheckqueue.StartWorkerThreads(threads_num, "headerch");
 }
 
 void StopScriptCheckWorkerThreads()
 {
     scriptcheckqueue.StopWorkerThreads();
+    headercheckqueue.StopWorkerThreads();
 }
 
 /**
@@ -2320,12 +2365,16 @@ bool CChainState::FlushStateToDisk(
         CoinsCacheSizeState cache_state = GetCoinsCacheSizeState();
         LOCK(m_blockman.cs_LastBlockFile);
         if (fPruneMode && (m_blockman.m_check_for_pruning || nManualPruneHeight > 0) && !fReindex) {
-            // make sure we don't prune above the blockfilterindexes bestblocks
+            // make sure we don't prune above the blockfilterindexes and the
+            // namehash index bestblocks
             // pruning is height-based
             int last_prune = m_chain.Height(); // last height we can prune
             ForEachBlockFilterIndex([&](BlockFilterIndex& index) {
                last_prune = std::max(1, std::min(last_prune, index.GetSummary().best_block_height));
             });
+            if (g_name_hash_index) {
+               last_prune = std::max(1, std::min(last_prune, g_name_hash_index->GetSummary().best_block_height));
+            }
 
             if (nManualPruneHeight > 0) {
                 LOG_TIME_MILLIS_WITH_CATEGORY("find files to prune (manual)", BCLog::BENCH);
@@ -3575,7 +3624,7 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
-bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool check_pow)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3594,7 +3643,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus())) {
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), check_pow)) {
             LogPrint(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -3667,11 +3716,33 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
 bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, BlockValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+
+    // Checking the proof of work is the expensive part of accepting headers,
+    // especially with auxpow.  It does not depend on the chain state, so do it
+    // for all new headers in parallel before taking cs_main.  If any of the
+    // checks fails, all of them are done again serially below so that the
+    // first failure is reported for the right header.
+    bool pow_checked{false};
+    if (g_parallel_script_checks && headers.size() > 1) {
+        std::vector<CHeaderCheck> checks;
+        {
+            LOCK(cs_main);
+            for (const CBlockHeader& header : headers) {
+                if (!m_blockman.LookupBlockIndex(header.GetHash())) {
+                    checks.emplace_back(header, chainparams.GetConsensus());
+                }
+            }
+        }
+        CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+        control.Add(checks);
+        pow_checked = control.Wait();
+    }
+
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            bool accepted{AcceptBlockHeader(header, state, chainparams, &pindex)};
+            bool accepted{AcceptBlockHeader(header, state, chainparams, &pindex, /*check_pow=*/!pow_checked)};
             ActiveChainstate().CheckBlockIndex();
 
             if (!accepted) {
@@ -4253,6 +4324,9 @@ bool ChainstateManager::LoadBlockIndex()
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
+        // The block tree database is empty as well, so the block index
+        // may be snapshotted on shutdown.
+        m_blockman.m_block_index_loaded = true;
         fNameHistory = gArgs.GetBoolArg("-namehistory", false);
         m_blockman.m_block_tree_db->WriteFlag("namehistory", fNameHistory);
     }
@@ -139,9 +139,9 @@ extern const std::vector<std::string> CHECKLEVEL_DOC;
 
 /** Unload database information */
 void UnloadBlockIndex(CTxMemPool* mempool, ChainstateManager& chainman) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
-/** Run instances of script checking worker threads */
+/** Run instances of script checking and header proof-of-work checking worker threads */
 void StartScriptCheckWorkerThreads(int threads_num);
-/** Stop all of the script checking worker threads */
+/** Stop all of the script checking and header proof-of-work checking worker threads */
 void StopScriptCheckWorkerThreads();
 
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
@@ -854,12 +854,15 @@ private:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to m_block_index.
+     * The proof of work is not checked again if check_pow is false, i.e. when the
+     * caller has done so already.
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
         BlockValidationState& state,
         const CChainParams& chainparams,
-        CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        CBlockIndex** ppindex,
+        bool check_pow = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     friend CChainState;
 
 public:
@@ -10,44 +10,239 @@
 #include <logging.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
-#include <scheduler.h>
+#include <tinyformat.h>
+#include <util/syscall_sandbox.h>
+#include <util/thread.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+//! Number of threads delivering queued notifications. Each subscriber's queue
+//! is serviced by at most one of them at a time, so a slow subscriber only
+//! occupies a single thread while the others keep draining their own queues.
+static constexpr int NOTIFICATION_WORKER_THREADS{4};
+//! Maximum number of queued BlockConnected events delivered in one
+//! BlocksConnected call.
+static constexpr size_t MAX_CONNECTED_BLOCKS_BATCH{128};
+
+//! Notifications pending for one subscriber. Callbacks are called with the
+//! subscriber, or with nullptr once the subscriber has been unregistered (so
+//! that queue barriers still run while the notifications themselves are
+//! skipped).
+struct SubscriberQueue {
+    using Callback = std::function<void(CValidationInterface*)>;
+
+    //! A queued notification. BlockConnected events are kept as plain data
+    //! so that consecutive ones can be delivered in one BlocksConnected call;
+    //! everything else is a callback shared by all subscriber queues.
+    struct Entry {
+        ConnectedBlock connected{};
+        std::shared_ptr<const Callback> callback;
+    };
 
-//! The MainSignalsInstance manages a list of shared_ptr<CValidationInterface>
-//! callbacks.
+    Mutex m_mutex;
+    //! Reset when the subscriber is unregistered. Copied before every call, so
+    //! a subscriber can't be destroyed while one of its callbacks is running.
+    std::shared_ptr<CValidationInterface> m_callbacks GUARDED_BY(m_mutex);
+    std::deque<Entry> m_pending GUARDED_BY(m_mutex);
+    //! Whether the queue is waiting for, or being serviced by, a worker.
+    bool m_scheduled GUARDED_BY(m_mutex){false};
+    size_t m_max_pending GUARDED_BY(m_mutex){0};
+    uint64_t m_processed GUARDED_BY(m_mutex){0};
+    const std::string m_name;
+
+    SubscriberQueue(std::shared_ptr<CValidationInterface> callbacks, std::string name)
+        : m_callbacks(std::move(callbacks)), m_name(std::move(name)) {}
+
+    std::shared_ptr<CValidationInterface> GetCallbacks() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        return m_callbacks;
+    }
+};
+
+//! The MainSignalsInstance manages the registered CValidationInterface
+//! callbacks and the notification queue of each of them.
 //!
-//! A std::unordered_map is used to track what callbacks are currently
-//! registered, and a std::list is to used to store the callbacks that are
-//! currently registered as well as any callbacks that are just unregistered
-//! and about to be deleted when they are done executing.
+//! Background notifications are fanned out to one SubscriberQueue per
+//! subscriber and delivered by a small pool of worker threads. Notifications
+//! for the same subscriber are delivered in order, but subscribers don't wait
+//! for each other. Functions passed to CallFunctionInValidationInterfaceQueue
+//! run in order on the same workers once every queue has caught up with them.
+//! None of this runs on the CScheduler, so slow periodic tasks there can't
+//! hold up validation callbacks.
 struct MainSignalsInstance {
 private:
     Mutex m_mutex;
-    //! List entries consist of a callback pointer and reference count. The
-    //! count is equal to the number of current executions of that entry, plus 1
-    //! if it's registered. It cannot be 0 because that would imply it is
-    //! unregistered and also not being executed (so shouldn't exist).
-    struct ListEntry { std::shared_ptr<CValidationInterface> callbacks; int count = 1; };
-    std::list<ListEntry> m_list GUARDED_BY(m_mutex);
-    std::unordered_map<CValidationInterface*, std::list<ListEntry>::iterator> m_map GUARDED_BY(m_mutex);
+    //! Queues of the registered subscribers, in registration order.
+    std::vector<std::shared_ptr<SubscriberQueue>> m_queues GUARDED_BY(m_mutex);
+    std::unordered_map<CValidationInterface*, std::shared_ptr<SubscriberQueue>> m_map GUARDED_BY(m_mutex);
+
+    Mutex m_ready_mutex;
+    std::condition_variable m_ready_cv;
+    //! Queues with pending notifications that no worker is servicing yet.
+    std::deque<std::shared_ptr<SubscriberQueue>> m_ready GUARDED_BY(m_ready_mutex);
+    bool m_stop_workers GUARDED_BY(m_ready_mutex){false};
+    std::vector<std::thread> m_workers;
+
+    //! A function waiting for all subscriber queues to reach it.
+    struct PendingCall {
+        std::function<void()> func;
+        size_t remaining;
+    };
+    Mutex m_calls_mutex;
+    //! Functions are handed to m_calls_queue in the order they were queued,
+    //! even if a later one's queues catch up first.
+    std::deque<std::shared_ptr<PendingCall>> m_calls GUARDED_BY(m_calls_mutex);
+    //! Runs the functions whose queues have caught up, one at a time.
+    const std::shared_ptr<SubscriberQueue> m_calls_queue{std::make_shared<SubscriberQueue>(nullptr, "calls")};
+
+    void Schedule(const std::shared_ptr<SubscriberQueue>& queue, SubscriberQueue::Entry entry)
+    {
+        {
+            LOCK(queue->m_mutex);
+            queue->m_pending.push_back(std::move(entry));
+            queue->m_max_pending = std::max(queue->m_max_pending, queue->m_pending.size());
+            if (queue->m_scheduled) return;
+            queue->m_scheduled = true;
+        }
+        WITH_LOCK(m_ready_mutex, m_ready.push_back(queue));
+        m_ready_cv.notify_one();
+    }
+
+    //! Deliver the oldest notification of a queue taken from m_ready (or the
+    //! run of BlockConnected events at its front), and hand the queue back if
+    //! more are pending.
+    void ProcessOne(const std::shared_ptr<SubscriberQueue>& queue)
+    {
+        std::shared_ptr<const SubscriberQueue::Callback> callback;
+        std::vector<ConnectedBlock> blocks;
+        std::shared_ptr<CValidationInterface> callbacks;
+        {
+            LOCK(queue->m_mutex);
+            auto& pending = queue->m_pending;
+            if (pending.front().callback) {
+                callback = std::move(pending.front().callback);
+                pending.pop_front();
+            } else {
+                while (!pending.empty() && !pending.front().callback && blocks.size() < MAX_CONNECTED_BLOCKS_BATCH) {
+                    blocks.push_back(std::move(pending.front().connected));
+                    pending.pop_front();
+                }
+            }
+            callbacks = queue->m_callbacks;
+        }
+        if (callback) {
+            (*callback)(callbacks.get());
+        } else if (callbacks) {
+            LogPrint(BCLog::VALIDATION, "BlocksConnected: %d blocks up to hash=%s height=%d\n", blocks.size(),
+                     blocks.back().pindex->GetBlockHash().ToString(), blocks.back().pindex->nHeight);
+            callbacks->BlocksConnected(blocks);
+        }
+        callbacks.reset();
+
+        {
+            LOCK(queue->m_mutex);
+            queue->m_processed += callback ? 1 : blocks.size();
+            if (queue->m_pending.empty()) {
+                queue->m_scheduled = false;
+                return;
+            }
+        }
+        WITH_LOCK(m_ready_mutex, m_ready.push_back(queue));
+        m_ready_cv.notify_one();
+    }
+
+    void WorkerThread()
+    {
+        WAIT_LOCK(m_ready_mutex, lock);
+        while (true) {
+            while (!m_stop_workers && m_ready.empty()) {
+                m_ready_cv.wait(lock);
+            }
+            if (m_stop_workers) return;
+            std::shared_ptr<SubscriberQueue> queue = std::move(m_ready.front());
+            m_ready.pop_front();
+            REVERSE_LOCK(lock);
+            ProcessOne(queue);
+        }
+    }
+
+    void CallDone(const std::shared_ptr<PendingCall>& call)
+    {
+        LOCK(m_calls_mutex);
+        --call->remaining;
+        while (!m_calls.empty() && m_calls.front()->remaining == 0) {
+            Schedule(m_calls_queue, {{}, std::make_shared<const SubscriberQueue::Callback>(
+                                             [func = std::move(m_calls.front()->func)](CValidationInterface*) { func(); })});
+            m_calls.pop_front();
+        }
+    }
 
 public:
-    // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
-    SingleThreadedSchedulerClient m_schedulerClient;
+    MainSignalsInstance()
+    {
+        for (int n = 0; n < NOTIFICATION_WORKER_THREADS; ++n) {
+            m_workers.emplace_back([this, name = strprintf("valnotify.%i", n)] {
+                util::TraceThread(name.c_str(), [this] {
+                    SetSyscallSandboxPolicy(SyscallSandboxPolicy::SCHEDULER);
+                    WorkerThread();
+                });
+            });
+        }
+    }
+
+    ~MainSignalsInstance()
+    {
+        StopWorkers();
+    }
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    //! Stop the worker threads after their current notification. Pending
+    //! notifications stay queued until Flush() is called.
+    void StopWorkers()
+    {
+        WITH_LOCK(m_ready_mutex, m_stop_workers = true);
+        m_ready_cv.notify_all();
+        for (std::thread& worker : m_workers) {
+            if (worker.joinable()) worker.join();
+        }
+        m_workers.clear();
+    }
 
-    void Register(std::shared_ptr<CValidationInterface> callbacks)
+    //! Deliver every pending notification and function on the calling thread.
+    //! Must only be called once the workers are stopped.
+    void Flush()
+    {
+        while (true) {
+            std::shared_ptr<SubscriberQueue> queue;
+            {
+                LOCK(m_ready_mutex);
+                if (m_ready.empty()) break;
+                queue = std::move(m_ready.front());
+                m_ready.pop_front();
+            }
+            ProcessOne(queue);
+        }
+    }
+
+    void Register(std::shared_ptr<CValidationInterface> callbacks, std::string name)
     {
         LOCK(m_mutex);
-        auto inserted = m_map.emplace(callbacks.get(), m_list.end());
-        if (inserted.second) inserted.first->second = m_list.emplace(m_list.end());
-        inserted.first->second->callbacks = std::move(callbacks);
+        auto it = m_map.find(callbacks.get());
+        if (it != m_map.end()) {
+            LOCK(it->second->m_mutex);
+            it->second->m_callbacks = std::move(callbacks);
+            return;
+        }
+        auto queue = std::make_shared<SubscriberQueue>(callbacks, name.empty() ? "other" : std::move(name));
+        m_map.emplace(callbacks.get(), queue);
+        m_queues.push_back(std::move(queue));
     }
 
     void Unregister(CValidationInterface* callbacks)
@@ -55,62 +250,142 @@ public:
         LOCK(m_mutex);
         auto it = m_map.find(callbacks);
         if (it != m_map.end()) {
-            if (!--it->second->count) m_list.erase(it->second);
+            WITH_LOCK(it->second->m_mutex, it->second->m_callbacks.reset());
+            m_queues.erase(std::find(m_queues.begin(), m_queues.end(), it->second));
             m_map.erase(it);
         }
     }
 
-    //! Clear unregisters every previously registered callback, erasing every
-    //! map entry. After this call, the list may still contain callbacks that
-    //! are currently executing, but it will be cleared when they are done
-    //! executing.
+    //! Clear unregisters every previously registered callback. Callbacks that
+    //! are currently executing are released when they are done executing.
     void Clear()
     {
         LOCK(m_mutex);
-        for (const auto& entry : m_map) {
-            if (!--entry.second->count) m_list.erase(entry.second);
+        for (const auto& queue : m_queues) {
+            WITH_LOCK(queue->m_mutex, queue->m_callbacks.reset());
         }
+        m_queues.clear();
         m_map.clear();
     }
 
+    //! Call f for every registered subscriber on the calling thread.
     template<typename F> void Iterate(F&& f)
     {
-        WAIT_LOCK(m_mutex, lock);
-        for (auto it = m_list.begin(); it != m_list.end();) {
-            ++it->count;
-            {
-                REVERSE_LOCK(lock);
-                f(*it->callbacks);
-            }
-            it = --it->count ? std::next(it) : m_list.erase(it);
+        const auto queues{WITH_LOCK(m_mutex, return m_queues)};
+        for (const auto& queue : queues) {
+            // Skip subscribers that were unregistered by an earlier callback.
+            if (auto callbacks = queue->GetCallbacks()) f(*callbacks);
+        }
+    }
+
+    //! Queue f for every registered subscriber.
+    void Enqueue(std::function<void(CValidationInterface&)> f)
+    {
+        const auto callback{std::make_shared<const SubscriberQueue::Callback>([f = std::move(f)](CValidationInterface* callbacks) {
+            if (callbacks) f(*callbacks);
+        })};
+        LOCK(m_mutex);
+        for (const auto& queue : m_queues) {
+            Schedule(queue, {{}, callback});
+        }
+    }
+
+    //! Queue a BlockConnected event for every registered subscriber.
+    void EnqueueBlockConnected(const ConnectedBlock& connected)
+    {
+        LOCK(m_mutex);
+        for (const auto& queue : m_queues) {
+            Schedule(queue, {connected, nullptr});
+        }
+    }
+
+    //! Run func on m_calls_queue once every subscriber has received all
+    //! notifications queued before this call.
+    void CallWhenSynced(std::function<void()> func)
+    {
+        LOCK(m_mutex);
+        auto call = std::make_shared<PendingCall>();
+        call->func = std::move(func);
+        // One extra count for this function, released below once every
+        // queue has its barrier.
+        call->remaining = m_queues.size() + 1;
+        WITH_LOCK(m_calls_mutex, m_calls.push_back(call));
+        const auto barrier{std::make_shared<const SubscriberQueue::Callback>([this, call](CValidationInterface*) { CallDone(call); })};
+        for (const auto& queue : m_queues) {
+            Schedule(queue, {{}, barrier});
+        }
+        CallDone(call);
+    }
+
+    //! Largest number of notifications any single subscriber has waiting.
+    size_t MaxPending()
+    {
+        size_t result{WITH_LOCK(m_calls_queue->m_mutex, return m_calls_queue->m_pending.size())};
+        LOCK(m_mutex);
+        for (const auto& queue : m_queues) {
+            LOCK(queue->m_mutex);
+            result = std::max(result, queue->m_pending.size());
+        }
+        return result;
+    }
+
+    std::vector<ValidationQueueStats> GetStats()
+    {
+        std::vector<ValidationQueueStats> result;
+        LOCK(m_mutex);
+        for (const auto& queue : m_queues) {
+            LOCK(queue->m_mutex);
+            result.push_back({queue->m_name, queue->m_pending.size(), queue->m_max_pending, queue->m_processed});
         }
+        return result;
     }
 };
 
+void CValidationInterface::BlocksConnected(Span<const ConnectedBlock> blocks)
+{
+    for (const ConnectedBlock& connected : blocks) {
+        BlockConnected(connected.block, connected.pindex);
+    }
+}
+
 static CMainSignals g_signals;
 
-void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler)
+void CMainSignals::StartBackgroundCallbacks()
 {
     assert(!m_internals);
-    m_internals.reset(new MainSignalsInstance(&scheduler));
+    m_internals.reset(new MainSignalsInstance());
 }
 
-void CMainSignals::UnregisterBackgroundSignalScheduler()
+void CMainSignals::DropBackgroundCallbacks()
 {
     m_internals.reset(nullptr);
 }
 
+void CMainSignals::StopBackgroundWorkers()
+{
+    if (m_internals) {
+        m_internals->StopWorkers();
+    }
+}
+
 void CMainSignals::FlushBackgroundCallbacks()
 {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        m_internals->StopWorkers();
+        m_internals->Flush();
     }
 }
 
 size_t CMainSignals::CallbacksPending()
 {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    return m_internals->MaxPending();
+}
+
+std::vector<ValidationQueueStats> CMainSignals::GetQueueStats()
+{
+    if (!m_internals) return {};
+    return m_internals->GetStats();
 }
 
 CMainSignals& GetMainSignals()
@@ -118,18 +393,18 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, std::string name)
 {
     // Each connection captures the shared_ptr to ensure that each callback is
     // executed before the subscriber is destroyed. For more details see #18338.
-    g_signals.m_internals->Register(std::move(callbacks));
+    g_signals.m_internals->Register(std::move(callbacks), std::move(name));
 }
 
-void RegisterValidationInterface(CValidationInterface* callbacks)
+void RegisterValidationInterface(CValidationInterface* callbacks, std::string name)
 {
     // Create a shared_ptr with a no-op deleter - CValidationInterface lifecycle
     // is managed by the caller.
-    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}});
+    RegisterSharedValidationInterface({callbacks, [](CValidationInterface*){}}, std::move(name));
 }
 
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks)
@@ -154,7 +429,7 @@ void UnregisterAllValidationInterfaces()
 
 void CallFunctionInValidationInterfaceQueue(std::function<void()> func)
 {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    g_signals.m_internals->CallWhenSynced(std::move(func));
 }
 
 void SyncWithValidationInterfaceQueue()
@@ -172,14 +447,14 @@ void SyncWithValidationInterfaceQueue()
 // evaluating arguments when logging is not enabled.
 //
 // NOTE: The lambda captures all local variables by value.
-#define ENQUEUE_AND_LOG_EVENT(event, fmt, name, ...)           \
-    do {                                                       \
-        auto local_name = (name);                              \
-        LOG_EVENT("Enqueuing " fmt, local_name, __VA_ARGS__);  \
-        m_internals->m_schedulerClient.AddToProcessQueue([=] { \
-            LOG_EVENT(fmt, local_name, __VA_ARGS__);           \
-            event();                                           \
-        });                                                    \
+#define ENQUEUE_AND_LOG_EVENT(event, fmt, name, ...)                     \
+    do {                                                                 \
+        auto local_name = (name);                                        \
+        LOG_EVENT("Enqueuing " fmt, local_name, __VA_ARGS__);            \
+        m_internals->Enqueue([=](CValidationInterface& callbacks) {      \
+            LOG_EVENT(fmt, local_name, __VA_ARGS__);                     \
+            event(callbacks);                                            \
+        });                                                              \
     } while (0)
 
 #define LOG_EVENT(fmt, ...) \
@@ -190,8 +465,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    auto event = [pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+    auto event = [pindexNew, pindexFork, fInitialDownload](CValidationInterface& callbacks) {
+        callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: new block hash=%s fork block hash=%s (in IBD=%s)", __func__,
                           pindexNew->GetBlockHash().ToString(),
@@ -200,8 +475,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) {
-    auto event = [tx, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionAddedToMempool(tx, mempool_sequence); });
+    auto event = [tx, mempool_sequence](CValidationInterface& callbacks) {
+        callbacks.TransactionAddedToMempool(tx, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
@@ -209,8 +484,8 @@ void CMainSignals::TransactionAddedToMempool(const CTransactionRef& tx, uint64_t
 }
 
 void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) {
-    auto event = [tx, reason, mempool_sequence, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence); });
+    auto event = [tx, reason, mempool_sequence](CValidationInterface& callbacks) {
+        callbacks.TransactionRemovedFromMempool(tx, reason, mempool_sequence);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: txid=%s wtxid=%s", __func__,
                           tx->GetHash().ToString(),
@@ -218,17 +493,16 @@ void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef& tx, MemP
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockConnected(pblock, pindex); });
-    };
-    ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
-                          pblock->GetHash().ToString(),
-                          pindex->nHeight);
+    // Delivered in batches by the subscriber queues, see BlocksConnected.
+    LOG_EVENT("Enqueuing %s: block hash=%s block height=%d", __func__,
+              pblock->GetHash().ToString(),
+              pindex->nHeight);
+    m_internals->EnqueueBlockConnected({pblock, pindex});
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex* pindex) {
-    auto event = [pblock, pindex, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.BlockDisconnected(pblock, pindex); });
+    auto event = [pblock, pindex](CValidationInterface& callbacks) {
+        callbacks.BlockDisconnected(pblock, pindex);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s block height=%d", __func__,
                           pblock->GetHash().ToString(),
@@ -236,8 +510,8 @@ void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    auto event = [locator, this] {
-        m_internals->Iterate([&](CValidationInterface& callbacks) { callbacks.ChainStateFlushed(locator); });
+    auto event = [locator](CValidationInterface& callbacks) {
+        callbacks.ChainStateFlushed(locator);
     };
     ENQUEUE_AND_LOG_EVENT(event, "%s: block hash=%s", __func__,
                           locator.IsNull() ? "null" : locator.vHave.front().ToString());
@@ -7,10 +7,13 @@
 #define BITCOIN_VALIDATIONINTERFACE_H
 
 #include <primitives/transaction.h> // CTransaction(Ref)
+#include <span.h>
 #include <sync.h>
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 extern RecursiveMutex cs_main;
 class BlockValidationState;
@@ -20,11 +23,16 @@ struct CBlockLocator;
 class CConnman;
 class CValidationInterface;
 class uint256;
-class CScheduler;
 enum class MemPoolRemovalReason;
 
-/** Register subscriber */
-void RegisterValidationInterface(CValidationInterface* callbacks);
+/** A block passed to CValidationInterface::BlocksConnected */
+struct ConnectedBlock {
+    std::shared_ptr<const CBlock> block;
+    const CBlockIndex* pindex;
+};
+
+/** Register subscriber. The name identifies its notification queue in statistics. */
+void RegisterValidationInterface(CValidationInterface* callbacks, std::string name = {});
 /** Unregister subscriber. DEPRECATED. This is not safe to use when the RPC server or main message handler thread is running. */
 void UnregisterValidationInterface(CValidationInterface* callbacks);
 /** Unregister all subscribers */
@@ -35,7 +43,7 @@ void UnregisterAllValidationInterfaces();
 // unregistration is nonblocking and can return before the last notification is
 // processed.
 /** Register subscriber */
-void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
+void RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks, std::string name = {});
 /** Unregister subscriber */
 void UnregisterSharedValidationInterface(std::shared_ptr<CValidationInterface> callbacks);
 
@@ -139,6 +147,17 @@ protected:
      * Called on a background thread.
      */
     virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    /**
+     * Notifies listeners of consecutive BlockConnected events at once, in
+     * connection order. Events that queued up for a subscriber while it was
+     * busy (e.g. during initial block download) are delivered this way, so
+     * that they can be processed and committed in bulk.
+     *
+     * The default implementation calls BlockConnected for each block.
+     *
+     * Called on a background thread.
+     */
+    virtual void BlocksConnected(Span<const ConnectedBlock> blocks);
     /**
      * Notifies listeners of a block being disconnected
      *
@@ -174,28 +193,46 @@ protected:
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
     friend class CMainSignals;
+    friend struct MainSignalsInstance;
     friend class ValidationInterfaceTest;
 };
 
+/** Backlog of one subscriber's background notification queue */
+struct ValidationQueueStats {
+    //! Name given when the subscriber registered
+    std::string name;
+    //! Notifications waiting to be delivered
+    size_t pending{0};
+    //! Largest backlog seen since the subscriber registered
+    size_t max_pending{0};
+    //! Notifications delivered so far
+    uint64_t processed{0};
+};
+
 struct MainSignalsInstance;
 class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>);
+    friend void ::RegisterSharedValidationInterface(std::shared_ptr<CValidationInterface>, std::string);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
 
 public:
-    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
-    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
-    /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
-    void UnregisterBackgroundSignalScheduler();
+    /** Start the threads delivering callbacks which run in the background (may only be called once) */
+    void StartBackgroundCallbacks();
+    /** Stop delivering callbacks which run in the background - these callbacks will now be dropped! */
+    void DropBackgroundCallbacks();
+    /** Stop the threads delivering background callbacks; remaining callbacks stay queued */
+    void StopBackgroundWorkers();
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** Largest number of callbacks pending for any single subscriber */
     size_t CallbacksPending();
+    /** Backlog of each registered subscriber, in registration order */
+    std::vector<ValidationQueueStats> GetQueueStats();
 
 
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
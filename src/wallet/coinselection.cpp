@@ -9,18 +9,60 @@
 #include <util/check.h>
 #include <util/system.h>
 #include <util/moneystr.h>
+#include <util/time.h>
 
 #include <numeric>
 #include <optional>
 
 namespace wallet {
-// Descending order comparator
-struct {
-    bool operator()(const OutputGroup& a, const OutputGroup& b) const
+namespace {
+/**
+ * The OutputGroups an algorithm selects from, with the values its search loop
+ * reads stored in one array each.  Entry i describes groups[m_group_index[i]].
+ * This keeps the loops on a few contiguous arrays instead of the OutputGroups
+ * and their coins, and no OutputGroup has to be copied or moved.
+ */
+struct SelectionCandidates
+{
+    std::vector<CAmount> m_amounts;
+    std::vector<CAmount> m_fees;
+    std::vector<CAmount> m_long_term_fees;
+    std::vector<size_t> m_group_index;
+
+    /** Take the given groups in the given order */
+    SelectionCandidates(const std::vector<OutputGroup>& groups, const std::vector<size_t>& order)
     {
-        return a.GetSelectionAmount() > b.GetSelectionAmount();
+        m_amounts.reserve(order.size());
+        m_fees.reserve(order.size());
+        m_long_term_fees.reserve(order.size());
+        m_group_index.reserve(order.size());
+        for (const size_t i : order) {
+            m_amounts.push_back(groups[i].GetSelectionAmount());
+            m_fees.push_back(groups[i].fee);
+            m_long_term_fees.push_back(groups[i].long_term_fee);
+            m_group_index.push_back(i);
+        }
     }
-} descending;
+
+    size_t Size() const { return m_amounts.size(); }
+};
+
+/** The indexes of the groups, sorted in descending order of selection amount */
+std::vector<size_t> SortDescending(const std::vector<OutputGroup>& groups, std::vector<size_t> indexes)
+{
+    std::sort(indexes.begin(), indexes.end(), [&](size_t a, size_t b) {
+        return groups[a].GetSelectionAmount() > groups[b].GetSelectionAmount();
+    });
+    return indexes;
+}
+
+std::vector<size_t> AllIndexes(const std::vector<OutputGroup>& groups)
+{
+    std::vector<size_t> indexes(groups.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    return indexes;
+}
+} // namespace
 
 /*
  * This is the Branch and Bound Coin Selection algorithm designed by Murch. It searches for an input
@@ -62,9 +104,10 @@ struct {
 
 static const size_t TOTAL_TRIES = 100000;
 
-std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_pool, const CAmount& selection_target, const CAmount& cost_of_change)
+std::optional<SelectionResult> SelectCoinsBnB(const std::vector<OutputGroup>& utxo_pool, const CAmount& selection_target, const CAmount& cost_of_change)
 {
-    SelectionResult result(selection_target);
+    SelectionResult result(selection_target, SelectionAlgorithm::BNB);
+    const int64_t time_start{GetTimeMicros()};
     CAmount curr_value = 0;
 
     std::vector<bool> curr_selection; // select the utxo at this index
@@ -82,19 +125,28 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
     }
 
     // Sort the utxo_pool
-    std::sort(utxo_pool.begin(), utxo_pool.end(), descending);
+    const SelectionCandidates utxos(utxo_pool, SortDescending(utxo_pool, AllIndexes(utxo_pool)));
+    const std::vector<CAmount>& amounts = utxos.m_amounts;
+    const std::vector<CAmount>& fees = utxos.m_fees;
+    const std::vector<CAmount>& long_term_fees = utxos.m_long_term_fees;
+    if (fees.empty()) {
+        return std::nullopt;
+    }
+    const bool is_feerate_high = fees[0] - long_term_fees[0] > 0;
 
     CAmount curr_waste = 0;
     std::vector<bool> best_selection;
+    best_selection.reserve(utxo_pool.size());
     CAmount best_waste = MAX_MONEY;
 
     // Depth First search loop for choosing the UTXOs
-    for (size_t i = 0; i < TOTAL_TRIES; ++i) {
+    size_t curr_try = 0;
+    for (; curr_try < TOTAL_TRIES; ++curr_try) {
         // Conditions for starting a backtrack
         bool backtrack = false;
         if (curr_value + curr_available_value < selection_target ||                // Cannot possibly reach target with the amount remaining in the curr_available_value.
             curr_value > selection_target + cost_of_change ||    // Selected value is out of range, go back and try other branch
-            (curr_waste > best_waste && (utxo_pool.at(0).fee - utxo_pool.at(0).long_term_fee) > 0)) { // Don't select things which we know will be more wasteful if the waste is increasing
+            (curr_waste > best_waste && is_feerate_high)) { // Don't select things which we know will be more wasteful if the waste is increasing
             backtrack = true;
         } else if (curr_value >= selection_target) {       // Selected value is within range
             curr_waste += (curr_value - selection_target); // This is the excess value which is added to the waste for the below comparison
@@ -104,7 +156,6 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
             // explore any more UTXOs to avoid burning money like that.
             if (curr_waste <= best_waste) {
                 best_selection = curr_selection;
-                best_selection.resize(utxo_pool.size());
                 best_waste = curr_waste;
                 if (best_waste == 0) {
                     break;
@@ -119,7 +170,7 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
             // Walk backwards to find the last included UTXO that still needs to have its omission branch traversed.
             while (!curr_selection.empty() && !curr_selection.back()) {
                 curr_selection.pop_back();
-                curr_available_value += utxo_pool.at(curr_selection.size()).GetSelectionAmount();
+                curr_available_value += amounts[curr_selection.size()];
             }
 
             if (curr_selection.empty()) { // We have walked back to the first utxo and no branch is untraversed. All solutions searched
@@ -128,26 +179,26 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
 
             // Output was included on previous iterations, try excluding now.
             curr_selection.back() = false;
-            OutputGroup& utxo = utxo_pool.at(curr_selection.size() - 1);
-            curr_value -= utxo.GetSelectionAmount();
-            curr_waste -= utxo.fee - utxo.long_term_fee;
+            const size_t utxo = curr_selection.size() - 1;
+            curr_value -= amounts[utxo];
+            curr_waste -= fees[utxo] - long_term_fees[utxo];
         } else { // Moving forwards, continuing down this branch
-            OutputGroup& utxo = utxo_pool.at(curr_selection.size());
+            const size_t utxo = curr_selection.size();
 
             // Remove this utxo from the curr_available_value utxo amount
-            curr_available_value -= utxo.GetSelectionAmount();
+            curr_available_value -= amounts[utxo];
 
             // Avoid searching a branch if the previous UTXO has the same value and same waste and was excluded. Since the ratio of fee to
             // long term fee is the same, we only need to check if one of those values match in order to know that the waste is the same.
             if (!curr_selection.empty() && !curr_selection.back() &&
-                utxo.GetSelectionAmount() == utxo_pool.at(curr_selection.size() - 1).GetSelectionAmount() &&
-                utxo.fee == utxo_pool.at(curr_selection.size() - 1).fee) {
+                amounts[utxo] == amounts[utxo - 1] &&
+                fees[utxo] == fees[utxo - 1]) {
                 curr_selection.push_back(false);
             } else {
                 // Inclusion branch first (Largest First Exploration)
                 curr_selection.push_back(true);
-                curr_value += utxo.GetSelectionAmount();
-                curr_waste += utxo.fee - utxo.long_term_fee;
+                curr_value += amounts[utxo];
+                curr_waste += fees[utxo] - long_term_fees[utxo];
             }
         }
     }
@@ -159,56 +210,60 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
 
     // Set output set
     for (size_t i = 0; i < best_selection.size(); ++i) {
-        if (best_selection.at(i)) {
-            result.AddInput(utxo_pool.at(i));
+        if (best_selection[i]) {
+            result.AddInput(utxo_pool[utxos.m_group_index[i]]);
         }
     }
     result.ComputeAndSetWaste(CAmount{0});
     assert(best_waste == result.GetWaste());
+    result.SetStats({std::min(curr_try + 1, TOTAL_TRIES), std::chrono::microseconds{GetTimeMicros() - time_start}});
 
     return result;
 }
 
 std::optional<SelectionResult> SelectCoinsSRD(const std::vector<OutputGroup>& utxo_pool, CAmount target_value)
 {
-    SelectionResult result(target_value);
+    SelectionResult result(target_value, SelectionAlgorithm::SRD);
+    const int64_t time_start{GetTimeMicros()};
 
-    std::vector<size_t> indexes;
-    indexes.resize(utxo_pool.size());
-    std::iota(indexes.begin(), indexes.end(), 0);
+    std::vector<size_t> indexes{AllIndexes(utxo_pool)};
     Shuffle(indexes.begin(), indexes.end(), FastRandomContext());
 
     CAmount selected_eff_value = 0;
-    for (const size_t i : indexes) {
-        const OutputGroup& group = utxo_pool.at(i);
+    for (size_t draw = 0; draw < indexes.size(); ++draw) {
+        const OutputGroup& group = utxo_pool[indexes[draw]];
         Assume(group.GetSelectionAmount() > 0);
         selected_eff_value += group.GetSelectionAmount();
-        result.AddInput(group);
         if (selected_eff_value >= target_value) {
+            for (size_t i = 0; i <= draw; ++i) {
+                result.AddInput(utxo_pool[indexes[i]]);
+            }
+            result.SetStats({draw + 1, std::chrono::microseconds{GetTimeMicros() - time_start}});
             return result;
         }
     }
     return std::nullopt;
 }
 
-static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const CAmount& nTotalLower, const CAmount& nTargetValue,
-                                  std::vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
+static void ApproximateBestSubset(const std::vector<CAmount>& amounts, const CAmount& nTotalLower, const CAmount& nTargetValue,
+                                  std::vector<char>& vfBest, CAmount& nBest, size_t& passes, int iterations = 1000)
 {
     std::vector<char> vfIncluded;
 
-    vfBest.assign(groups.size(), true);
+    vfBest.assign(amounts.size(), true);
     nBest = nTotalLower;
 
     FastRandomContext insecure_rand;
 
     for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++)
     {
-        vfIncluded.assign(groups.size(), false);
+        vfIncluded.assign(amounts.size(), false);
         CAmount nTotal = 0;
         bool fReachedTarget = false;
         for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++)
         {
-            for (unsigned int i = 0; i < groups.size(); i++)
+            ++passes;
+            for (unsigned int i = 0; i < amounts.size(); i++)
             {
                 //The solver here uses a randomized algorithm,
                 //the randomness serves no real security purpose but is just
@@ -218,7 +273,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                 //the selection random.
                 if (nPass == 0 ? insecure_rand.randbool() : !vfIncluded[i])
                 {
-                    nTotal += groups[i].GetSelectionAmount();
+                    nTotal += amounts[i];
                     vfIncluded[i] = true;
                     if (nTotal >= nTargetValue)
                     {
@@ -228,7 +283,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                             nBest = nTotal;
                             vfBest = vfIncluded;
                         }
-                        nTotal -= groups[i].GetSelectionAmount();
+                        nTotal -= amounts[i];
                         vfIncluded[i] = false;
                     }
                 }
@@ -237,75 +292,86 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
     }
 }
 
-std::optional<SelectionResult> KnapsackSolver(std::vector<OutputGroup>& groups, const CAmount& nTargetValue)
+std::optional<SelectionResult> KnapsackSolver(const std::vector<OutputGroup>& groups, const CAmount& nTargetValue)
 {
-    SelectionResult result(nTargetValue);
-
-    // List of values less than target
-    std::optional<OutputGroup> lowest_larger;
-    std::vector<OutputGroup> applicable_groups;
+    SelectionResult result(nTargetValue, SelectionAlgorithm::KNAPSACK);
+    const int64_t time_start{GetTimeMicros()};
+    size_t passes = 0;
+    const auto set_stats = [&] {
+        result.SetStats({passes, std::chrono::microseconds{GetTimeMicros() - time_start}});
+    };
+
+    // Indexes of the groups with values less than target
+    std::optional<size_t> lowest_larger;
+    std::vector<size_t> applicable_groups;
     CAmount nTotalLower = 0;
 
-    Shuffle(groups.begin(), groups.end(), FastRandomContext());
+    std::vector<size_t> indexes{AllIndexes(groups)};
+    Shuffle(indexes.begin(), indexes.end(), FastRandomContext());
 
-    for (const OutputGroup& group : groups) {
-        if (group.GetSelectionAmount() == nTargetValue) {
-            result.AddInput(group);
+    for (const size_t i : indexes) {
+        const CAmount amount = groups[i].GetSelectionAmount();
+        if (amount == nTargetValue) {
+            result.AddInput(groups[i]);
+            set_stats();
             return result;
-        } else if (group.GetSelectionAmount() < nTargetValue + MIN_CHANGE) {
-            applicable_groups.push_back(group);
-            nTotalLower += group.GetSelectionAmount();
-        } else if (!lowest_larger || group.GetSelectionAmount() < lowest_larger->GetSelectionAmount()) {
-            lowest_larger = group;
+        } else if (amount < nTargetValue + MIN_CHANGE) {
+            applicable_groups.push_back(i);
+            nTotalLower += amount;
+        } else if (!lowest_larger || amount < groups[*lowest_larger].GetSelectionAmount()) {
+            lowest_larger = i;
         }
     }
 
     if (nTotalLower == nTargetValue) {
-        for (const auto& group : applicable_groups) {
-            result.AddInput(group);
+        for (const size_t i : applicable_groups) {
+            result.AddInput(groups[i]);
         }
+        set_stats();
         return result;
     }
 
     if (nTotalLower < nTargetValue) {
         if (!lowest_larger) return std::nullopt;
-        result.AddInput(*lowest_larger);
+        result.AddInput(groups[*lowest_larger]);
+        set_stats();
         return result;
     }
 
     // Solve subset sum by stochastic approximation
-    std::sort(applicable_groups.begin(), applicable_groups.end(), descending);
+    const SelectionCandidates applicable(groups, SortDescending(groups, std::move(applicable_groups)));
     std::vector<char> vfBest;
     CAmount nBest;
 
-    ApproximateBestSubset(applicable_groups, nTotalLower, nTargetValue, vfBest, nBest);
+    ApproximateBestSubset(applicable.m_amounts, nTotalLower, nTargetValue, vfBest, nBest, passes);
     if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE) {
-        ApproximateBestSubset(applicable_groups, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
+        ApproximateBestSubset(applicable.m_amounts, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest, passes);
     }
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
     if (lowest_larger &&
-        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || lowest_larger->GetSelectionAmount() <= nBest)) {
-        result.AddInput(*lowest_larger);
+        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || groups[*lowest_larger].GetSelectionAmount() <= nBest)) {
+        result.AddInput(groups[*lowest_larger]);
     } else {
-        for (unsigned int i = 0; i < applicable_groups.size(); i++) {
+        for (unsigned int i = 0; i < applicable.Size(); i++) {
             if (vfBest[i]) {
-                result.AddInput(applicable_groups[i]);
+                result.AddInput(groups[applicable.m_group_index[i]]);
             }
         }
 
         if (LogAcceptCategory(BCLog::SELECTCOINS)) {
             std::string log_message{"Coin selection best subset: "};
-            for (unsigned int i = 0; i < applicable_groups.size(); i++) {
+            for (unsigned int i = 0; i < applicable.Size(); i++) {
                 if (vfBest[i]) {
-                    log_message += strprintf("%s ", FormatMoney(applicable_groups[i].m_value));
+                    log_message += strprintf("%s ", FormatMoney(groups[applicable.m_group_index[i]].m_value));
                 }
             }
             LogPrint(BCLog::SELECTCOINS, "%stotal %s\n", log_message, FormatMoney(nBest));
         }
     }
 
+    set_stats();
     return result;
 }
 
@@ -425,11 +491,24 @@ std::vector<CInputCoin> SelectionResult::GetShuffledInputVector() const
     return coins;
 }
 
-bool SelectionResult::operator<(SelectionResult other) const
+bool SelectionResult::operator<(const SelectionResult& other) const
 {
     Assert(m_waste.has_value());
     Assert(other.m_waste.has_value());
     // As this operator is only used in std::min_element, we want the result that has more inputs when waste are equal.
     return *m_waste < *other.m_waste || (*m_waste == *other.m_waste && m_selected_inputs.size() > other.m_selected_inputs.size());
 }
+
+std::string GetAlgorithmName(const SelectionAlgorithm algo)
+{
+    switch (algo)
+    {
+    case SelectionAlgorithm::BNB: return "bnb";
+    case SelectionAlgorithm::KNAPSACK: return "knapsack";
+    case SelectionAlgorithm::SRD: return "srd";
+    case SelectionAlgorithm::MANUAL: return "manual";
+    // No default case to allow for compiler to warn
+    }
+    assert(false);
+}
 } // namespace wallet
@@ -10,7 +10,9 @@
 #include <primitives/transaction.h>
 #include <random.h>
 
+#include <chrono>
 #include <optional>
+#include <string>
 
 namespace wallet {
 //! target minimum change amount
@@ -200,6 +202,25 @@ struct OutputGroup
  */
 [[nodiscard]] CAmount GetSelectionWaste(const std::set<CInputCoin>& inputs, CAmount change_cost, CAmount target, bool use_effective_value = true);
 
+enum class SelectionAlgorithm : uint8_t
+{
+    BNB = 0,
+    KNAPSACK = 1,
+    SRD = 2,
+    MANUAL = 3,
+};
+
+std::string GetAlgorithmName(const SelectionAlgorithm algo);
+
+/** The work a coin selection algorithm did to find a result. */
+struct SelectionStats
+{
+    /** Search steps: BnB tries, knapsack subset passes or SRD draws */
+    size_t m_iterations{0};
+    /** Time spent in the algorithm */
+    std::chrono::microseconds m_time{0};
+};
+
 struct SelectionResult
 {
 private:
@@ -207,14 +228,18 @@ private:
     std::set<CInputCoin> m_selected_inputs;
     /** The target the algorithm selected for. Note that this may not be equal to the recipient amount as it can include non-input fees */
     const CAmount m_target;
+    /** The algorithm that made this selection */
+    SelectionAlgorithm m_algo;
     /** Whether the input values for calculations should be the effective value (true) or normal value (false) */
     bool m_use_effective{false};
     /** The computed waste */
     std::optional<CAmount> m_waste;
+    /** The work done by the algorithm, for debugging */
+    SelectionStats m_stats;
 
 public:
-    explicit SelectionResult(const CAmount target)
-        : m_target(target) {}
+    explicit SelectionResult(const CAmount target, SelectionAlgorithm algo = SelectionAlgorithm::MANUAL)
+        : m_target(target), m_algo(algo) {}
 
     SelectionResult() = delete;
 
@@ -234,10 +259,14 @@ public:
     /** Get the vector of CInputCoins that will be used to fill in a CTransaction's vin */
     std::vector<CInputCoin> GetShuffledInputVector() const;
 
-    bool operator<(SelectionResult other) const;
+    SelectionAlgorithm GetAlgo() const { return m_algo; }
+    const SelectionStats& GetStats() const { return m_stats; }
+    void SetStats(const SelectionStats& stats) { m_stats = stats; }
+
+    bool operator<(const SelectionResult& other) const;
 };
 
-std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_pool, const CAmount& selection_target, const CAmount& cost_of_change);
+std::optional<SelectionResult> SelectCoinsBnB(const std::vector<OutputGroup>& utxo_pool, const CAmount& selection_target, const CAmount& cost_of_change);
 
 /** Select coins by Single Random Draw. OutputGroups are selected randomly from the eligible
  * outputs until the target is satisfied
@@ -249,7 +278,7 @@ std::optional<SelectionResult> SelectCoinsBnB(std::vector<OutputGroup>& utxo_poo
 std::optional<SelectionResult> SelectCoinsSRD(const std::vector<OutputGroup>& utxo_pool, CAmount target_value);
 
 // Original coin selection algorithm as a fallback
-std::optional<SelectionResult> KnapsackSolver(std::vector<OutputGroup>& groups, const CAmount& nTargetValue);
+std::optional<SelectionResult> KnapsackSolver(const std::vector<OutputGroup>& groups, const CAmount& nTargetValue);
 } // namespace wallet
 
 #endif // BITCOIN_WALLET_COINSELECTION_H
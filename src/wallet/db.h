@@ -29,6 +29,8 @@ private:
     virtual bool WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite=true) = 0;
     virtual bool EraseKey(CDataStream&& key) = 0;
     virtual bool HasKey(CDataStream&& key) = 0;
+    /** Write a record that can be recovered by rescanning. Backends may defer syncing it to disk. */
+    virtual bool WriteKeyNonCritical(CDataStream&& key, CDataStream&& value) { return WriteKey(std::move(key), std::move(value)); }
 
 public:
     explicit DatabaseBatch() {}
@@ -71,6 +73,27 @@ public:
         return WriteKey(std::move(ssKey), std::move(ssValue), fOverwrite);
     }
 
+    /**
+     * Write a record that is not critical for the wallet, because it can be
+     * recovered by rescanning the chain (like transactions and the best block
+     * locator).  Such records may be grouped and synced to disk lazily, but never
+     * after a critical record that was written later.  Existing records are
+     * overwritten.
+     */
+    template <typename K, typename T>
+    bool WriteNonCritical(const K& key, const T& value)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        ssKey << key;
+
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue.reserve(10000);
+        ssValue << value;
+
+        return WriteKeyNonCritical(std::move(ssKey), std::move(ssValue));
+    }
+
     template <typename K>
     bool Erase(const K& key)
     {
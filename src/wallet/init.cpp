@@ -20,6 +20,9 @@
 #include <wallet/bdb.h>
 #endif
 #include <wallet/coincontrol.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 #include <wallet/wallet.h>
 #include <walletinitinterface.h>
 
@@ -88,11 +91,13 @@ void WalletInit::AddWalletOptions(ArgsManager& argsman) const
 #endif
 
 #ifdef USE_SQLITE
+    argsman.AddArg("-walletlazysync", strprintf("Write transactions and other records that can be recovered by rescanning to sqlite wallets in groups of up to %u, without waiting for each group to be synced to disk. Keys and other critical records are always synced immediately. Records lost in a crash are recovered by rescanning (default: %u)", WRITE_GROUP_SIZE, DEFAULT_WALLET_LAZY_SYNC), ArgsManager::ALLOW_ANY, OptionsCategory::WALLET);
     argsman.AddArg("-unsafesqlitesync", "Set SQLite synchronous=OFF to disable waiting for the database to sync to disk. This is unsafe and can cause data loss and corruption. This option is only used by tests to improve their performance (default: false)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::WALLET_DEBUG_TEST);
 #else
-    argsman.AddHiddenArgs({"-unsafesqlitesync"});
+    argsman.AddHiddenArgs({"-unsafesqlitesync", "-walletlazysync"});
 #endif
 
+    argsman.AddArg("-walletcheckbalance", strprintf("Check the cached wallet balances against a full recomputation whenever they are used (default: %u)", DEFAULT_WALLET_CHECK_BALANCE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::WALLET_DEBUG_TEST);
     argsman.AddArg("-walletrejectlongchains", strprintf("Wallet will not create transactions that violate mempool chain limits (default: %u)", DEFAULT_WALLET_REJECT_LONG_CHAINS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::WALLET_DEBUG_TEST);
 
     argsman.AddHiddenArgs({"-zapwallettxes"});
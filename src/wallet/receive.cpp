@@ -10,6 +10,9 @@
 #include <wallet/transaction.h>
 #include <wallet/wallet.h>
 
+#include <cassert>
+#include <tuple>
+
 namespace wallet {
 isminetype InputIsMine(const CWallet& wallet, const CTxIn &txin)
 {
@@ -363,35 +366,98 @@ bool CachedTxIsTrusted(const CWallet& wallet, const CWalletTx& wtx)
     return CachedTxIsTrusted(wallet, wtx, trusted_parents);
 }
 
-Balance GetBalance(const CWallet& wallet, const int min_depth, bool avoid_reuse)
+/** Compute the balance from the credits of all wallet transactions */
+static Balance GetBalanceFromTransactions(const CWallet& wallet, const int min_depth, bool avoid_reuse) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet)
 {
     Balance ret;
     isminefilter reuse_filter = avoid_reuse ? ISMINE_NO : ISMINE_USED;
+    std::set<uint256> trusted_parents;
+    for (const auto& entry : wallet.mapWallet)
     {
-        LOCK(wallet.cs_wallet);
-        std::set<uint256> trusted_parents;
-        for (const auto& entry : wallet.mapWallet)
-        {
-            const CWalletTx& wtx = entry.second;
-            const bool is_trusted{CachedTxIsTrusted(wallet, wtx, trusted_parents)};
+        const CWalletTx& wtx = entry.second;
+        const bool is_trusted{CachedTxIsTrusted(wallet, wtx, trusted_parents)};
+        const int tx_depth{wallet.GetTxDepthInMainChain(wtx)};
+        const CAmount tx_credit_mine{CachedTxGetAvailableCredit(wallet, wtx, /* fUseCache */ false, ISMINE_SPENDABLE | reuse_filter)};
+        const CAmount tx_credit_watchonly{CachedTxGetAvailableCredit(wallet, wtx, /* fUseCache */ false, ISMINE_WATCH_ONLY | reuse_filter)};
+        if (is_trusted && tx_depth >= min_depth) {
+            ret.m_mine_trusted += tx_credit_mine;
+            ret.m_watchonly_trusted += tx_credit_watchonly;
+        }
+        if (!is_trusted && tx_depth == 0 && wtx.InMempool()) {
+            ret.m_mine_untrusted_pending += tx_credit_mine;
+            ret.m_watchonly_untrusted_pending += tx_credit_watchonly;
+        }
+        ret.m_mine_immature += CachedTxGetImmatureCredit(wallet, wtx, /* fUseCache */ false);
+        ret.m_watchonly_immature += CachedTxGetImmatureWatchOnlyCredit(wallet, wtx, /* fUseCache */ false);
+    }
+    return ret;
+}
+
+/** Compute the balance from the wallet's unspent outputs */
+static Balance GetBalanceFromUnspent(const CWallet& wallet, const int min_depth, bool avoid_reuse) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet)
+{
+    Balance ret;
+    const bool allow_used_addresses{!avoid_reuse || !wallet.IsWalletFlagSet(WALLET_FLAG_AVOID_REUSE)};
+    std::set<uint256> trusted_parents;
+    // The outputs of a transaction are next to each other in the set, so the
+    // transaction's state is only looked at once for all of them.
+    const CWalletTx* last_wtx{nullptr};
+    bool is_immature{false};
+    bool is_trusted{false};
+    bool is_pending{false};
+    for (const auto& [outpoint, utxo] : wallet.GetUnspentOutputs()) {
+        if (utxo.is_name) continue;
+        const CWalletTx& wtx = *utxo.wtx;
+        if (&wtx != last_wtx) {
+            last_wtx = &wtx;
             const int tx_depth{wallet.GetTxDepthInMainChain(wtx)};
-            const CAmount tx_credit_mine{CachedTxGetAvailableCredit(wallet, wtx, /* fUseCache */ true, ISMINE_SPENDABLE | reuse_filter)};
-            const CAmount tx_credit_watchonly{CachedTxGetAvailableCredit(wallet, wtx, /* fUseCache */ true, ISMINE_WATCH_ONLY | reuse_filter)};
-            if (is_trusted && tx_depth >= min_depth) {
-                ret.m_mine_trusted += tx_credit_mine;
-                ret.m_watchonly_trusted += tx_credit_watchonly;
-            }
-            if (!is_trusted && tx_depth == 0 && wtx.InMempool()) {
-                ret.m_mine_untrusted_pending += tx_credit_mine;
-                ret.m_watchonly_untrusted_pending += tx_credit_watchonly;
-            }
-            ret.m_mine_immature += CachedTxGetImmatureCredit(wallet, wtx);
-            ret.m_watchonly_immature += CachedTxGetImmatureWatchOnlyCredit(wallet, wtx);
+            const bool immature_coinbase{wallet.IsTxImmatureCoinBase(wtx)};
+            const bool tx_trusted{CachedTxIsTrusted(wallet, wtx, trusted_parents)};
+            // Immature coinbases are never available, only immature in the main chain.
+            is_immature = immature_coinbase && tx_depth > 0;
+            is_trusted = !immature_coinbase && tx_trusted && tx_depth >= min_depth;
+            is_pending = !immature_coinbase && !tx_trusted && tx_depth == 0 && wtx.InMempool();
+        }
+
+        const bool mine{(utxo.ismine & ISMINE_SPENDABLE) != 0};
+        const bool watchonly{(utxo.ismine & ISMINE_WATCH_ONLY) != 0};
+        if (is_immature) {
+            if (mine) ret.m_mine_immature += utxo.value;
+            if (watchonly) ret.m_watchonly_immature += utxo.value;
+            continue;
+        }
+        if (!is_trusted && !is_pending) continue;
+        if (!allow_used_addresses && wallet.IsSpentKey(outpoint.hash, outpoint.n)) continue;
+        if (is_trusted) {
+            if (mine) ret.m_mine_trusted += utxo.value;
+            if (watchonly) ret.m_watchonly_trusted += utxo.value;
+        } else {
+            if (mine) ret.m_mine_untrusted_pending += utxo.value;
+            if (watchonly) ret.m_watchonly_untrusted_pending += utxo.value;
         }
     }
     return ret;
 }
 
+Balance GetBalance(const CWallet& wallet, const int min_depth, bool avoid_reuse)
+{
+    LOCK(wallet.cs_wallet);
+    const std::pair<int, bool> key{min_depth, avoid_reuse};
+    auto it = wallet.m_cached_balances.find(key);
+    if (it == wallet.m_cached_balances.end()) {
+        const Balance balance{GetBalanceFromUnspent(wallet, min_depth, avoid_reuse)};
+        it = wallet.m_cached_balances.emplace(key, balance).first;
+    }
+    if (wallet.m_check_balance) {
+        const auto tie = [](const Balance& b) {
+            return std::tie(b.m_mine_trusted, b.m_mine_untrusted_pending, b.m_mine_immature,
+                            b.m_watchonly_trusted, b.m_watchonly_untrusted_pending, b.m_watchonly_immature);
+        };
+        assert(tie(it->second) == tie(GetBalanceFromTransactions(wallet, min_depth, avoid_reuse)));
+    }
+    return it->second;
+}
+
 std::map<CTxDestination, CAmount> GetAddressBalances(const CWallet& wallet)
 {
     std::map<CTxDestination, CAmount> balances;
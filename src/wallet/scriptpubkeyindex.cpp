@@ -0,0 +1,57 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/scriptpubkeyindex.h>
+
+#include <utility>
+
+namespace wallet {
+/** Number of slots of a table when the first script is inserted */
+static constexpr size_t MIN_SLOTS{1024};
+
+void ScriptPubKeyIndex::Grow()
+{
+    std::vector<Slot> old_slots{std::move(m_slots)};
+    m_slots.assign(old_slots.empty() ? MIN_SLOTS : 2 * old_slots.size(), Slot{});
+    for (const Slot& slot : old_slots) {
+        if (slot.spk_man == nullptr) continue;
+        size_t pos{slot.hash & Mask()};
+        while (m_slots[pos].spk_man != nullptr) pos = (pos + 1) & Mask();
+        m_slots[pos] = slot;
+    }
+}
+
+void ScriptPubKeyIndex::Insert(Span<const unsigned char> script, ScriptPubKeyMan* spk_man)
+{
+    // Keep the load factor at or below one half, so that probe sequences stay short
+    if (2 * (m_size + 1) > m_slots.size()) Grow();
+
+    const uint64_t hash{Hash(script)};
+    size_t pos{hash & Mask()};
+    while (m_slots[pos].spk_man != nullptr) {
+        if (m_slots[pos].hash == hash && m_slots[pos].spk_man == spk_man) return;
+        pos = (pos + 1) & Mask();
+    }
+    m_slots[pos] = Slot{hash, spk_man};
+    ++m_size;
+}
+
+std::vector<ScriptPubKeyMan*> ScriptPubKeyIndex::Find(Span<const unsigned char> script) const
+{
+    std::vector<ScriptPubKeyMan*> result;
+    if (m_size == 0) return result;
+
+    const uint64_t hash{Hash(script)};
+    for (size_t pos{hash & Mask()}; m_slots[pos].spk_man != nullptr; pos = (pos + 1) & Mask()) {
+        if (m_slots[pos].hash == hash) result.push_back(m_slots[pos].spk_man);
+    }
+    return result;
+}
+
+void ScriptPubKeyIndex::Clear()
+{
+    m_slots.clear();
+    m_size = 0;
+}
+} // namespace wallet
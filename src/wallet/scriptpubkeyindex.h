@@ -0,0 +1,57 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_SCRIPTPUBKEYINDEX_H
+#define BITCOIN_WALLET_SCRIPTPUBKEYINDEX_H
+
+#include <span.h>
+#include <util/hasher.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wallet {
+class ScriptPubKeyMan;
+
+/**
+ * Wallet-wide index from scriptPubKeys to the ScriptPubKeyMans that own them.
+ *
+ * This is an open-addressing hash table with linear probing that only keeps a
+ * salted 64-bit hash of each script next to its ScriptPubKeyMan, so that the
+ * common case of looking up a script that is not ours costs one hash and
+ * usually a single cache line.  Matches have to be confirmed with the
+ * ScriptPubKeyMan, which also knows the index the script was derived at.
+ */
+class ScriptPubKeyIndex
+{
+private:
+    struct Slot {
+        uint64_t hash{0};
+        //! nullptr for empty slots
+        ScriptPubKeyMan* spk_man{nullptr};
+    };
+
+    const SaltedSipHasher m_hasher;
+    std::vector<Slot> m_slots;
+    size_t m_size{0};
+
+    uint64_t Hash(Span<const unsigned char> script) const { return m_hasher(script); }
+    size_t Mask() const { return m_slots.size() - 1; }
+    void Grow();
+
+public:
+    /** Add a script owned by spk_man.  Adding the same pair again has no effect. */
+    void Insert(Span<const unsigned char> script, ScriptPubKeyMan* spk_man);
+
+    /** Return the ScriptPubKeyMans that may own script, without duplicates */
+    std::vector<ScriptPubKeyMan*> Find(Span<const unsigned char> script) const;
+
+    void Clear();
+
+    size_t Size() const { return m_size; }
+};
+} // namespace wallet
+
+#endif // BITCOIN_WALLET_SCRIPTPUBKEYINDEX_H
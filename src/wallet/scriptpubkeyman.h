@@ -26,6 +26,8 @@ enum class OutputType;
 struct bilingual_str;
 
 namespace wallet {
+class ScriptPubKeyMan;
+
 // Wallet storage things that ScriptPubKeyMans need in order to be able to store things to the wallet database.
 // It provides access to things that are part of the entire wallet and not specific to a ScriptPubKeyMan such as
 // wallet flags, wallet version, encryption keys, encryption status, and the database itself. This allows a
@@ -44,6 +46,8 @@ public:
     virtual const CKeyingMaterial& GetEncryptionKey() const = 0;
     virtual bool HasEncryptionKeys() const = 0;
     virtual bool IsLocked() const = 0;
+    //! Called with the scriptPubKeys a descriptor ScriptPubKeyMan derived when it was topped up or loaded
+    virtual void TopUpCallback(const std::vector<CScript>& scripts, ScriptPubKeyMan* spk_man) = 0;
 };
 
 //! Default for -keypool
@@ -637,6 +641,10 @@ public:
 
     const WalletDescriptor GetWalletDescriptor() const EXCLUSIVE_LOCKS_REQUIRED(cs_desc_man);
     const std::vector<CScript> GetScriptPubKeys() const;
+    //! The scripts derived at minimum_index or later
+    const std::vector<CScript> GetScriptPubKeys(int32_t minimum_index) const;
+    //! One past the last index that scripts were derived at
+    int32_t GetEndRange() const;
 
     bool GetDescriptorString(std::string& out, const bool priv) const;
 
@@ -12,6 +12,7 @@
 #include <util/fees.h>
 #include <util/moneystr.h>
 #include <util/rbf.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <wallet/coincontrol.h>
 #include <wallet/fees.h>
@@ -101,24 +102,24 @@ void AvailableCoins(const CWallet& wallet, std::vector<COutput>& vCoins, const C
     const bool only_safe = {coinControl ? !coinControl->m_include_unsafe_inputs : true};
 
     std::set<uint256> trusted_parents;
-    for (const auto& entry : wallet.mapWallet)
-    {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
-
+    int nDepth{0};
+    bool safeTx{false};
+    // Determines whether the outputs of wtx may be spent and sets nDepth and
+    // safeTx for them.
+    const auto check_tx = [&](const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet) {
         if (wallet.IsTxImmatureCoinBase(wtx))
-            continue;
+            return false;
 
-        int nDepth = wallet.GetTxDepthInMainChain(wtx);
+        nDepth = wallet.GetTxDepthInMainChain(wtx);
         if (nDepth < 0)
-            continue;
+            return false;
 
         // We should not consider coins which aren't at least in our mempool
         // It's possible for these to be conflicted via ancestors which we may never be able to detect
         if (nDepth == 0 && !wtx.InMempool())
-            continue;
+            return false;
 
-        bool safeTx = CachedTxIsTrusted(wallet, wtx, trusted_parents);
+        safeTx = CachedTxIsTrusted(wallet, wtx, trusted_parents);
 
         // We should not consider coins from transactions that are replacing
         // other transactions.
@@ -152,64 +153,74 @@ void AvailableCoins(const CWallet& wallet, std::vector<COutput>& vCoins, const C
         }
 
         if (only_safe && !safeTx) {
-            continue;
+            return false;
         }
 
-        if (nDepth < min_depth || nDepth > max_depth) {
+        return nDepth >= min_depth && nDepth <= max_depth;
+    };
+
+    // The outputs of a transaction are next to each other in the set, so the
+    // checks that only depend on the transaction are done once for all of them.
+    const CWalletTx* last_wtx{nullptr};
+    bool tx_ok{false};
+    for (const auto& [outpoint, utxo] : wallet.GetUnspentOutputs())
+    {
+        const CWalletTx& wtx = *utxo.wtx;
+        if (&wtx != last_wtx) {
+            last_wtx = &wtx;
+            tx_ok = check_tx(wtx);
+        }
+        if (!tx_ok) {
             continue;
         }
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-            // Only consider selected coins if add_inputs is false
-            if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(COutPoint(entry.first, i))) {
-                continue;
-            }
-
-            if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
-                continue;
-
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
-                continue;
-
-            if (wallet.IsLockedCoin(entry.first, i))
-                continue;
+        // Only consider selected coins if add_inputs is false
+        if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(outpoint)) {
+            continue;
+        }
 
-            if (wallet.IsSpent(wtxid, i))
-                continue;
+        if (utxo.value < nMinimumAmount || utxo.value > nMaximumAmount)
+            continue;
 
-            isminetype mine = wallet.IsMine(wtx.tx->vout[i]);
+        if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(outpoint))
+            continue;
 
-            if (mine == ISMINE_NO) {
-                continue;
-            }
+        if (wallet.IsLockedCoin(outpoint.hash, outpoint.n))
+            continue;
 
-            if (!allow_used_addresses && wallet.IsSpentKey(wtxid, i)) {
-                continue;
-            }
+#ifdef ABORT_ON_FAILED_ASSUME
+        // The unspent set never contains spent outputs. The lookup is too
+        // expensive for this loop outside of debug builds.
+        Assert(!wallet.IsSpent(outpoint.hash, outpoint.n));
+#endif
 
-            std::unique_ptr<SigningProvider> provider = wallet.GetSolvingProvider(wtx.tx->vout[i].scriptPubKey);
+        if (!allow_used_addresses && wallet.IsSpentKey(outpoint.hash, outpoint.n)) {
+            continue;
+        }
 
-            bool solvable = provider ? IsSolvable(*provider, wtx.tx->vout[i].scriptPubKey) : false;
-            bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
-            if (CNameScript::isNameScript(wtx.tx->vout[i].scriptPubKey))
-                spendable = false;
+        const CScript& scriptPubKey = wtx.tx->vout[outpoint.n].scriptPubKey;
+        std::unique_ptr<SigningProvider> provider = wallet.GetSolvingProvider(scriptPubKey);
 
-            vCoins.push_back(COutput(wallet, wtx, i, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
+        bool solvable = provider ? IsSolvable(*provider, scriptPubKey) : false;
+        bool spendable = ((utxo.ismine & ISMINE_SPENDABLE) != ISMINE_NO) || (((utxo.ismine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
+        if (utxo.is_name)
+            spendable = false;
 
-            // Checks the sum amount of all UTXO's.
-            if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += wtx.tx->vout[i].nValue;
+        vCoins.push_back(COutput(wallet, wtx, outpoint.n, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
 
-                if (nTotal >= nMinimumSumAmount) {
-                    return;
-                }
-            }
+        // Checks the sum amount of all UTXO's.
+        if (nMinimumSumAmount != MAX_MONEY) {
+            nTotal += utxo.value;
 
-            // Checks the maximum number of UTXO's.
-            if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            if (nTotal >= nMinimumSumAmount) {
                 return;
             }
         }
+
+        // Checks the maximum number of UTXO's.
+        if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            return;
+        }
     }
 }
 
@@ -307,7 +318,7 @@ std::vector<OutputGroup> GroupOutputs(const CWallet& wallet, const std::vector<C
 
             // Check the OutputGroup's eligibility. Only add the eligible ones.
             if (positive_only && group.GetSelectionAmount() <= 0) continue;
-            if (group.m_outputs.size() > 0 && group.EligibleForSpending(filter)) groups_out.push_back(group);
+            if (group.m_outputs.size() > 0 && group.EligibleForSpending(filter)) groups_out.push_back(std::move(group));
         }
         return groups_out;
     }
@@ -352,12 +363,12 @@ std::vector<OutputGroup> GroupOutputs(const CWallet& wallet, const std::vector<C
     }
 
     // Now we go through the entire map and pull out the OutputGroups
-    for (const auto& spk_and_groups_pair: spk_to_groups_map) {
-        const std::vector<OutputGroup>& groups_per_spk= spk_and_groups_pair.second;
+    for (auto& spk_and_groups_pair: spk_to_groups_map) {
+        std::vector<OutputGroup>& groups_per_spk= spk_and_groups_pair.second;
 
         // Go through the vector backwards. This allows for the first item we deal with being the partial group.
         for (auto group_it = groups_per_spk.rbegin(); group_it != groups_per_spk.rend(); group_it++) {
-            const OutputGroup& group = *group_it;
+            OutputGroup& group = *group_it;
 
             // Don't include partial groups if there are full groups too and we don't want partial groups
             if (group_it == groups_per_spk.rbegin() && groups_per_spk.size() > 1 && !filter.m_include_partial_groups) {
@@ -366,7 +377,7 @@ std::vector<OutputGroup> GroupOutputs(const CWallet& wallet, const std::vector<C
 
             // Check the OutputGroup's eligibility. Only add the eligible ones.
             if (positive_only && group.GetSelectionAmount() <= 0) continue;
-            if (group.m_outputs.size() > 0 && group.EligibleForSpending(filter)) groups_out.push_back(group);
+            if (group.m_outputs.size() > 0 && group.EligibleForSpending(filter)) groups_out.push_back(std::move(group));
         }
     }
 
@@ -382,7 +393,7 @@ std::optional<SelectionResult> AttemptSelection(const CWallet& wallet, const CAm
     // Note that unlike KnapsackSolver, we do not include the fee for creating a change output as BnB will not create a change output.
     std::vector<OutputGroup> positive_groups = GroupOutputs(wallet, coins, coin_selection_params, eligibility_filter, true /* positive_only */);
     if (auto bnb_result{SelectCoinsBnB(positive_groups, nTargetValue, coin_selection_params.m_cost_of_change)}) {
-        results.push_back(*bnb_result);
+        results.push_back(std::move(*bnb_result));
     }
 
     // The knapsack solver has some legacy behavior where it will spend dust outputs. We retain this behavior, so don't filter for positive only here.
@@ -391,7 +402,7 @@ std::optional<SelectionResult> AttemptSelection(const CWallet& wallet, const CAm
     // So we need to include that for KnapsackSolver as well, as we are expecting to create a change output.
     if (auto knapsack_result{KnapsackSolver(all_groups, nTargetValue + coin_selection_params.m_change_fee)}) {
         knapsack_result->ComputeAndSetWaste(coin_selection_params.m_cost_of_change);
-        results.push_back(*knapsack_result);
+        results.push_back(std::move(*knapsack_result));
     }
 
     // We include the minimum final change for SRD as we do want to avoid making really small change.
@@ -399,7 +410,7 @@ std::optional<SelectionResult> AttemptSelection(const CWallet& wallet, const CAm
     const CAmount srd_target = nTargetValue + coin_selection_params.m_change_fee + MIN_FINAL_CHANGE;
     if (auto srd_result{SelectCoinsSRD(positive_groups, srd_target)}) {
         srd_result->ComputeAndSetWaste(coin_selection_params.m_cost_of_change);
-        results.push_back(*srd_result);
+        results.push_back(std::move(*srd_result));
     }
 
     if (results.size() == 0) {
@@ -407,10 +418,18 @@ std::optional<SelectionResult> AttemptSelection(const CWallet& wallet, const CAm
         return std::nullopt;
     }
 
+    if (LogAcceptCategory(BCLog::SELECTCOINS)) {
+        for (const SelectionResult& result : results) {
+            LogPrint(BCLog::SELECTCOINS, "Coin selection %s: %d iterations in %dus, %d inputs, waste %s\n",
+                     GetAlgorithmName(result.GetAlgo()), result.GetStats().m_iterations, count_microseconds(result.GetStats().m_time),
+                     result.GetInputSet().size(), FormatMoney(result.GetWaste()));
+        }
+    }
+
     // Choose the result with the least waste
     // If the waste is the same, choose the one which spends more inputs.
     auto& best_result = *std::min_element(results.begin(), results.end());
-    return best_result;
+    return std::move(best_result);
 }
 
 std::optional<SelectionResult> SelectCoins(const CWallet& wallet, const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, const CCoinControl& coin_control, const CoinSelectionParams& coin_selection_params)
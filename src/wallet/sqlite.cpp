@@ -255,12 +255,37 @@ void SQLiteDatabase::Open()
     // Enable fullfsync for the platforms that use it
     SetPragma(m_db, "fullfsync", "true", "Failed to enable fullfsync");
 
-    if (gArgs.GetBoolArg("-unsafesqlitesync", false)) {
+    if (!m_mock) {
+        // Use a write-ahead log, which needs a single sync per transaction
+        // instead of the several ones of the rollback journal. As we hold an
+        // exclusive lock, SQLite does not need shared memory for the log.
+        sqlite3_stmt* journal_mode_stmt{nullptr};
+        ret = sqlite3_prepare_v2(m_db, "PRAGMA journal_mode = WAL", -1, &journal_mode_stmt, nullptr);
+        if (ret == SQLITE_OK) ret = sqlite3_step(journal_mode_stmt);
+        if (ret != SQLITE_ROW) {
+            sqlite3_finalize(journal_mode_stmt);
+            throw std::runtime_error(strprintf("SQLiteDatabase: Failed to set the journal mode: %s\n", sqlite3_errstr(ret)));
+        }
+        const char* journal_mode{(const char*)sqlite3_column_text(journal_mode_stmt, 0)};
+        if (journal_mode == nullptr || std::string{journal_mode} != "wal") {
+            LogPrintf("SQLiteDatabase: Unable to use a write-ahead log, using journal mode %s\n", journal_mode ? journal_mode : "unknown");
+        }
+        sqlite3_finalize(journal_mode_stmt);
+    }
+
+    m_unsafe_sync = gArgs.GetBoolArg("-unsafesqlitesync", false);
+    if (m_unsafe_sync) {
         // Use normal synchronous mode for the journal
         LogPrintf("WARNING SQLite is configured to not wait for data to be flushed to disk. Data loss and corruption may occur.\n");
         SetPragma(m_db, "synchronous", "OFF", "Failed to set synchronous mode to OFF");
+    } else {
+        // Some builds of SQLite default to synchronous=NORMAL for a write-ahead
+        // log, which does not sync on commit.  Only write groups may use that.
+        SetPragma(m_db, "synchronous", "FULL", "Failed to set synchronous mode to FULL");
     }
 
+    m_lazy_sync = gArgs.GetBoolArg("-walletlazysync", DEFAULT_WALLET_LAZY_SYNC);
+
     // Make the table for our key-value pairs
     // First check that the main table exists
     sqlite3_stmt* check_main_stmt{nullptr};
@@ -301,6 +326,8 @@ void SQLiteDatabase::Open()
 
 bool SQLiteDatabase::Rewrite(const char* skip)
 {
+    // VACUUM can not be run inside a transaction
+    CommitWriteGroup();
     // Rewrite the database using the VACUUM command: https://sqlite.org/lang_vacuum.html
     int ret = sqlite3_exec(m_db, "VACUUM", nullptr, nullptr, nullptr);
     return ret == SQLITE_OK;
@@ -308,6 +335,8 @@ bool SQLiteDatabase::Rewrite(const char* skip)
 
 bool SQLiteDatabase::Backup(const std::string& dest) const
 {
+    CommitWriteGroup();
+
     sqlite3* db_copy;
     int res = sqlite3_open(dest.c_str(), &db_copy);
     if (res != SQLITE_OK) {
@@ -335,6 +364,9 @@ bool SQLiteDatabase::Backup(const std::string& dest) const
 
 void SQLiteDatabase::Close()
 {
+    // Closing the database would roll back the write group
+    CommitWriteGroup();
+
     int res = sqlite3_close(m_db);
     if (res != SQLITE_OK) {
         throw std::runtime_error(strprintf("SQLiteDatabase: Failed to close database: %s\n", sqlite3_errstr(res)));
@@ -348,6 +380,74 @@ std::unique_ptr<DatabaseBatch> SQLiteDatabase::MakeBatch(bool flush_on_close)
     return std::make_unique<SQLiteBatch>(*this);
 }
 
+int SQLiteDatabase::StepInWriteGroup(sqlite3_stmt* stmt)
+{
+    if (!m_lazy_sync) return sqlite3_step(stmt);
+
+    LOCK(m_write_group_mutex);
+    if (m_write_group_size == 0) {
+        // Join a transaction that was started with TxnBegin
+        if (sqlite3_get_autocommit(m_db) == 0) return sqlite3_step(stmt);
+
+        // The synchronous mode can only be changed outside of a transaction.
+        // Writes in the group are made durable by the next sync, which happens
+        // at the latest when a critical record is written or the database is
+        // closed.
+        if (!m_unsafe_sync) sqlite3_exec(m_db, "PRAGMA synchronous = NORMAL", nullptr, nullptr, nullptr);
+        int res = sqlite3_exec(m_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+        if (res != SQLITE_OK) {
+            LogPrintf("SQLiteDatabase: Failed to begin a write group: %s\n", sqlite3_errstr(res));
+            if (!m_unsafe_sync) sqlite3_exec(m_db, "PRAGMA synchronous = FULL", nullptr, nullptr, nullptr);
+            return sqlite3_step(stmt);
+        }
+    }
+
+    int res = sqlite3_step(stmt);
+    if (++m_write_group_size >= WRITE_GROUP_SIZE) CommitWriteGroupLocked();
+    return res;
+}
+
+int SQLiteDatabase::StepAfterWriteGroup(sqlite3_stmt* stmt)
+{
+    LOCK(m_write_group_mutex);
+    CommitWriteGroupLocked();
+    return sqlite3_step(stmt);
+}
+
+bool SQLiteDatabase::CommitWriteGroup() const
+{
+    LOCK(m_write_group_mutex);
+    return CommitWriteGroupLocked();
+}
+
+bool SQLiteDatabase::CommitWriteGroupLocked() const
+{
+    if (m_write_group_size == 0) return true;
+    m_write_group_size = 0;
+
+    bool committed{true};
+    // Some errors roll back the transaction on their own
+    if (sqlite3_get_autocommit(m_db) == 0) {
+        int res = sqlite3_exec(m_db, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
+        if (res != SQLITE_OK) {
+            LogPrintf("SQLiteDatabase: Failed to commit the write group: %s\n", sqlite3_errstr(res));
+            if (sqlite3_get_autocommit(m_db) == 0) sqlite3_exec(m_db, "ROLLBACK TRANSACTION", nullptr, nullptr, nullptr);
+            committed = false;
+        }
+    } else {
+        LogPrintf("SQLiteDatabase: Write group was rolled back\n");
+        committed = false;
+    }
+    if (!m_unsafe_sync) sqlite3_exec(m_db, "PRAGMA synchronous = FULL", nullptr, nullptr, nullptr);
+    return committed;
+}
+
+bool SQLiteDatabase::InWriteGroup() const
+{
+    LOCK(m_write_group_mutex);
+    return m_write_group_size > 0;
+}
+
 SQLiteBatch::SQLiteBatch(SQLiteDatabase& database)
     : m_database(database)
 {
@@ -359,8 +459,9 @@ SQLiteBatch::SQLiteBatch(SQLiteDatabase& database)
 
 void SQLiteBatch::Close()
 {
-    // If m_db is in a transaction (i.e. not in autocommit mode), then abort the transaction in progress
-    if (m_database.m_db && sqlite3_get_autocommit(m_database.m_db) == 0) {
+    // If m_db is in a transaction (i.e. not in autocommit mode) that is not the
+    // write group, then abort the transaction in progress
+    if (m_database.m_db && sqlite3_get_autocommit(m_database.m_db) == 0 && !m_database.InWriteGroup()) {
         if (TxnAbort()) {
             LogPrintf("SQLiteBatch: Batch closed unexpectedly without the transaction being explicitly committed or aborted\n");
         } else {
@@ -415,10 +516,21 @@ bool SQLiteBatch::ReadKey(CDataStream&& key, CDataStream& value)
 }
 
 bool SQLiteBatch::WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite)
+{
+    return ExecWriteStatement(key, value, overwrite, /*critical=*/true);
+}
+
+bool SQLiteBatch::WriteKeyNonCritical(CDataStream&& key, CDataStream&& value)
+{
+    return ExecWriteStatement(key, value, /*overwrite=*/true, /*critical=*/false);
+}
+
+bool SQLiteBatch::ExecWriteStatement(Span<const std::byte> key, Span<const std::byte> value, bool overwrite, bool critical)
 {
     if (!m_database.m_db) return false;
     assert(m_insert_stmt && m_overwrite_stmt);
 
+
     sqlite3_stmt* stmt;
     if (overwrite) {
         stmt = m_overwrite_stmt;
@@ -432,7 +544,7 @@ bool SQLiteBatch::WriteKey(CDataStream&& key, CDataStream&& value, bool overwrit
     if (!BindBlobToStatement(stmt, 2, value, "value")) return false;
 
     // Execute
-    int res = sqlite3_step(stmt);
+    int res = critical ? m_database.StepAfterWriteGroup(stmt) : m_database.StepInWriteGroup(stmt);
     sqlite3_clear_bindings(stmt);
     sqlite3_reset(stmt);
     if (res != SQLITE_DONE) {
@@ -450,7 +562,7 @@ bool SQLiteBatch::EraseKey(CDataStream&& key)
     if (!BindBlobToStatement(m_delete_stmt, 1, key, "key")) return false;
 
     // Execute
-    int res = sqlite3_step(m_delete_stmt);
+    int res = m_database.StepAfterWriteGroup(m_delete_stmt);
     sqlite3_clear_bindings(m_delete_stmt);
     sqlite3_reset(m_delete_stmt);
     if (res != SQLITE_DONE) {
@@ -514,7 +626,9 @@ void SQLiteBatch::CloseCursor()
 
 bool SQLiteBatch::TxnBegin()
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) == 0) return false;
+    if (!m_database.m_db) return false;
+    m_database.CommitWriteGroup();
+    if (sqlite3_get_autocommit(m_database.m_db) == 0) return false;
     int res = sqlite3_exec(m_database.m_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to begin the transaction\n");
@@ -524,7 +638,7 @@ bool SQLiteBatch::TxnBegin()
 
 bool SQLiteBatch::TxnCommit()
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0) return false;
+    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0 || m_database.InWriteGroup()) return false;
     int res = sqlite3_exec(m_database.m_db, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to commit the transaction\n");
@@ -534,7 +648,7 @@ bool SQLiteBatch::TxnCommit()
 
 bool SQLiteBatch::TxnAbort()
 {
-    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0) return false;
+    if (!m_database.m_db || sqlite3_get_autocommit(m_database.m_db) != 0 || m_database.InWriteGroup()) return false;
     int res = sqlite3_exec(m_database.m_db, "ROLLBACK TRANSACTION", nullptr, nullptr, nullptr);
     if (res != SQLITE_OK) {
         LogPrintf("SQLiteBatch: Failed to abort the transaction\n");
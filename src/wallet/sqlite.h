@@ -5,6 +5,8 @@
 #ifndef BITCOIN_WALLET_SQLITE_H
 #define BITCOIN_WALLET_SQLITE_H
 
+#include <span.h>
+#include <sync.h>
 #include <wallet/db.h>
 
 #include <sqlite3.h>
@@ -12,6 +14,10 @@
 struct bilingual_str;
 
 namespace wallet {
+static constexpr bool DEFAULT_WALLET_LAZY_SYNC{false};
+/** Maximum number of non-critical writes that are grouped into one transaction */
+static constexpr unsigned int WRITE_GROUP_SIZE{1000};
+
 class SQLiteDatabase;
 
 /** RAII class that provides access to a WalletDatabase */
@@ -30,8 +36,12 @@ private:
 
     void SetupSQLStatements();
 
+    /** Write a record, either on its own or, for non-critical ones, as part of the write group */
+    bool ExecWriteStatement(Span<const std::byte> key, Span<const std::byte> value, bool overwrite, bool critical);
+
     bool ReadKey(CDataStream&& key, CDataStream& value) override;
     bool WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite = true) override;
+    bool WriteKeyNonCritical(CDataStream&& key, CDataStream&& value) override;
     bool EraseKey(CDataStream&& key) override;
     bool HasKey(CDataStream&& key) override;
 
@@ -63,8 +73,23 @@ private:
 
     const std::string m_file_path;
 
+    /** Whether non-critical records are written in groups without waiting for them to be synced */
+    bool m_lazy_sync{false};
+    /** Whether -unsafesqlitesync is in effect, in which case we never change the synchronous mode */
+    bool m_unsafe_sync{false};
+
+    /**
+     * Number of non-critical writes in the currently open write group.  While
+     * this is nonzero, the transaction open on m_db is the write group rather
+     * than one started through SQLiteBatch::TxnBegin.
+     */
+    mutable Mutex m_write_group_mutex;
+    mutable unsigned int m_write_group_size GUARDED_BY(m_write_group_mutex){0};
+
     void Cleanup() noexcept;
 
+    bool CommitWriteGroupLocked() const EXCLUSIVE_LOCKS_REQUIRED(m_write_group_mutex);
+
 public:
     SQLiteDatabase() = delete;
 
@@ -92,16 +117,20 @@ public:
      */
     bool Backup(const std::string& dest) const override;
 
-    /** No-ops
+    /** Commit the write group, if any
      *
-     * SQLite always flushes everything to the database file after each transaction
+     * SQLite flushes everything to the database file after each transaction
      * (each Read/Write/Erase that we do is its own transaction unless we called
-     * TxnBegin) so there is no need to have Flush or Periodic Flush.
+     * TxnBegin), so the only thing left to flush are non-critical records that
+     * were written in a group with -walletlazysync.
+     */
+    void Flush() override { CommitWriteGroup(); }
+    bool PeriodicFlush() override { return CommitWriteGroup(); }
+
+    /** No-op
      *
      * There is no DB env to reload, so ReloadDbEnv has nothing to do
      */
-    void Flush() override {}
-    bool PeriodicFlush() override { return false; }
     void ReloadDbEnv() override {}
 
     void IncrementUpdateCounter() override { ++nUpdateCounter; }
@@ -112,6 +141,27 @@ public:
     /** Make a SQLiteBatch connected to this database */
     std::unique_ptr<DatabaseBatch> MakeBatch(bool flush_on_close = true) override;
 
+    /**
+     * Execute a prepared write statement as part of the write group, opening
+     * a new group if necessary.  Writes simply join the transaction in progress
+     * if one was started with TxnBegin, and are executed on their own without
+     * -walletlazysync.  Returns the result of sqlite3_step.
+     */
+    int StepInWriteGroup(sqlite3_stmt* stmt) EXCLUSIVE_LOCKS_REQUIRED(!m_write_group_mutex);
+
+    /**
+     * Execute a prepared write statement on its own, after committing the
+     * write group.  This keeps the records that were written before it from
+     * being lost while it is not.  Returns the result of sqlite3_step.
+     */
+    int StepAfterWriteGroup(sqlite3_stmt* stmt) EXCLUSIVE_LOCKS_REQUIRED(!m_write_group_mutex);
+
+    /** Commit the write group if one is open.  Returns false if that failed. */
+    bool CommitWriteGroup() const EXCLUSIVE_LOCKS_REQUIRED(!m_write_group_mutex);
+
+    /** Whether the transaction open on m_db, if any, is the write group */
+    bool InWriteGroup() const EXCLUSIVE_LOCKS_REQUIRED(!m_write_group_mutex);
+
     sqlite3* m_db{nullptr};
 };
 
@@ -186,6 +186,7 @@ BOOST_AUTO_TEST_CASE(bnb_search_test)
 
     // Empty utxo pool
     BOOST_CHECK(!SelectCoinsBnB(GroupCoins(utxo_pool), 1 * CENT, 0.5 * CENT));
+    BOOST_CHECK(!SelectCoinsBnB(GroupCoins(utxo_pool), 0, 0.5 * CENT));
 
     // Add utxos
     add_coin(1 * CENT, 1, utxo_pool);
@@ -807,5 +808,34 @@ BOOST_AUTO_TEST_CASE(waste_test)
     BOOST_CHECK_EQUAL(0, GetSelectionWaste(selection, /* change cost */ 0, new_target));
 }
 
+BOOST_AUTO_TEST_CASE(selection_algorithm_stats)
+{
+    std::vector<CInputCoin> utxo_pool;
+    add_coin(1 * CENT, 1, utxo_pool);
+    add_coin(2 * CENT, 2, utxo_pool);
+    add_coin(3 * CENT, 3, utxo_pool);
+    add_coin(4 * CENT, 4, utxo_pool);
+    const std::vector<OutputGroup> groups{GroupCoins(utxo_pool)};
+
+    const auto bnb_result = SelectCoinsBnB(groups, 5 * CENT, 0.5 * CENT);
+    BOOST_REQUIRE(bnb_result);
+    BOOST_CHECK(bnb_result->GetAlgo() == SelectionAlgorithm::BNB);
+    BOOST_CHECK_GT(bnb_result->GetStats().m_iterations, 0U);
+
+    const auto knapsack_result = KnapsackSolver(groups, 6 * CENT);
+    BOOST_REQUIRE(knapsack_result);
+    BOOST_CHECK(knapsack_result->GetAlgo() == SelectionAlgorithm::KNAPSACK);
+    BOOST_CHECK_EQUAL(knapsack_result->GetSelectedValue(), 6 * CENT);
+
+    const auto srd_result = SelectCoinsSRD(groups, 6 * CENT);
+    BOOST_REQUIRE(srd_result);
+    BOOST_CHECK(srd_result->GetAlgo() == SelectionAlgorithm::SRD);
+    BOOST_CHECK_GT(srd_result->GetStats().m_iterations, 0U);
+
+    BOOST_CHECK_EQUAL(GetAlgorithmName(SelectionAlgorithm::BNB), "bnb");
+    BOOST_CHECK_EQUAL(GetAlgorithmName(SelectionAlgorithm::KNAPSACK), "knapsack");
+    BOOST_CHECK_EQUAL(GetAlgorithmName(SelectionAlgorithm::SRD), "srd");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace wallet
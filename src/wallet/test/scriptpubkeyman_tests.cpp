@@ -3,10 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <key.h>
+#include <script/names.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
+#include <util/translation.h>
 #include <wallet/scriptpubkeyman.h>
 #include <wallet/wallet.h>
+#include <wallet/walletutil.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -39,5 +42,64 @@ BOOST_AUTO_TEST_CASE(CanProvide)
     BOOST_CHECK(keyman.CanProvide(p2sh_script, data));
 }
 
+// Test that the wallet-wide scriptPubKey index agrees with the descriptor
+// ScriptPubKeyMans after they are set up, topped up and loaded.
+BOOST_AUTO_TEST_CASE(DescriptorScriptPubKeyIndex)
+{
+    const fs::path path{m_path_root / "spk_index"};
+    const auto make_wallet = [&](bool create) {
+        DatabaseOptions options;
+        options.require_create = create;
+        options.require_existing = !create;
+        DatabaseStatus status;
+        bilingual_str error;
+        auto database = MakeDatabase(path, options, status, error);
+        BOOST_REQUIRE(database);
+        return std::make_unique<CWallet>(m_node.chain.get(), "", m_args, std::move(database));
+    };
+    const auto check_wallet = [](const CWallet& wallet) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet) {
+        size_t num_scripts{0};
+        for (ScriptPubKeyMan* spk_man : wallet.GetAllScriptPubKeyMans()) {
+            for (const CScript& script : static_cast<DescriptorScriptPubKeyMan*>(spk_man)->GetScriptPubKeys()) {
+                BOOST_CHECK_EQUAL(wallet.IsMine(script), ISMINE_SPENDABLE);
+                BOOST_CHECK(wallet.GetScriptPubKeyMans(script) == std::set<ScriptPubKeyMan*>{spk_man});
+                const CScript name_script{CNameScript::buildNameUpdate(script, {'d', '/', 'x'}, {'v'})};
+                BOOST_CHECK_EQUAL(wallet.IsMine(name_script), ISMINE_SPENDABLE);
+                ++num_scripts;
+            }
+        }
+        BOOST_CHECK(num_scripts > 0);
+        for (int i = 0; i < 100; ++i) {
+            const CScript script{GetScriptForDestination(WitnessV0KeyHash(uint160(g_insecure_rand_ctx.randbytes(20))))};
+            BOOST_CHECK_EQUAL(wallet.IsMine(script), ISMINE_NO);
+            BOOST_CHECK(wallet.GetScriptPubKeyMans(script).empty());
+        }
+        return num_scripts;
+    };
+
+    size_t num_scripts;
+    {
+        auto wallet = make_wallet(/*create=*/true);
+        LOCK(wallet->cs_wallet);
+        wallet->SetWalletFlag(WALLET_FLAG_DESCRIPTORS);
+        wallet->SetupDescriptorScriptPubKeyMans();
+        const size_t initial_scripts{check_wallet(*wallet)};
+
+        // Newly derived scripts are added to the index
+        ScriptPubKeyMan* spk_man{wallet->GetScriptPubKeyMan(OutputType::BECH32, /*internal=*/false)};
+        BOOST_REQUIRE(spk_man);
+        const size_t keypool_size{static_cast<DescriptorScriptPubKeyMan*>(spk_man)->GetScriptPubKeys().size()};
+        BOOST_CHECK(spk_man->TopUp(keypool_size + 10));
+        num_scripts = check_wallet(*wallet);
+        BOOST_CHECK(num_scripts > initial_scripts);
+    }
+
+    // Loading the wallet rebuilds the index from the descriptor caches
+    auto wallet = make_wallet(/*create=*/false);
+    BOOST_CHECK_EQUAL(wallet->LoadWallet(), DBErrors::LOAD_OK);
+    LOCK(wallet->cs_wallet);
+    BOOST_CHECK_EQUAL(check_wallet(*wallet), num_scripts);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace wallet
@@ -2,10 +2,19 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <test/util/setup_common.h>
 #include <clientversion.h>
+#include <fs.h>
 #include <streams.h>
 #include <uint256.h>
+#include <util/system.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 
 #include <boost/test/unit_test.hpp>
 
@@ -27,5 +36,77 @@ BOOST_AUTO_TEST_CASE(walletdb_readkeyvalue)
     BOOST_CHECK_THROW(ssValue >> dummy, std::ios_base::failure);
 }
 
+#ifdef USE_SQLITE
+BOOST_AUTO_TEST_CASE(sqlite_write_group)
+{
+    gArgs.ForceSetArg("-walletlazysync", "1");
+    const fs::path path{m_path_root / "lazy"};
+    const fs::path file{SQLiteDataFile(path)};
+    const auto tx_key{[](int i) { return std::make_pair(std::string{"tx"}, i); }};
+    {
+        SQLiteDatabase db{path, file};
+        auto batch{db.MakeBatch()};
+        BOOST_CHECK(fs::exists(fs::PathFromString(fs::PathToString(file) + "-wal")));
+
+        for (int i = 0; i < 10; ++i) {
+            BOOST_CHECK(batch->WriteNonCritical(tx_key(i), i));
+        }
+        BOOST_CHECK(db.InWriteGroup());
+        int value;
+        BOOST_CHECK(batch->Read(tx_key(5), value));
+        BOOST_CHECK_EQUAL(value, 5);
+        // The write group is not an explicit transaction
+        BOOST_CHECK(!batch->TxnCommit());
+        BOOST_CHECK(db.InWriteGroup());
+
+        // Critical records commit the group before they are written
+        BOOST_CHECK(batch->Write(std::string{"key"}, 1));
+        BOOST_CHECK(!db.InWriteGroup());
+
+        // Non-critical records join explicit transactions
+        BOOST_CHECK(batch->WriteNonCritical(tx_key(10), 10));
+        BOOST_CHECK(batch->TxnBegin());
+        BOOST_CHECK(!db.InWriteGroup());
+        BOOST_CHECK(batch->WriteNonCritical(tx_key(-1), -1));
+        BOOST_CHECK(!db.InWriteGroup());
+        BOOST_CHECK(batch->TxnAbort());
+        BOOST_CHECK(!batch->Exists(tx_key(-1)));
+        BOOST_CHECK(batch->Exists(tx_key(10)));
+
+        // Full groups are committed
+        for (unsigned int i = 0; i < WRITE_GROUP_SIZE; ++i) {
+            BOOST_CHECK(batch->WriteNonCritical(tx_key(i), -static_cast<int>(i)));
+        }
+        BOOST_CHECK(!db.InWriteGroup());
+        BOOST_CHECK(batch->WriteNonCritical(tx_key(0), 42));
+        BOOST_CHECK(db.InWriteGroup());
+
+        // Closing a batch leaves the group open for the next one
+        batch.reset();
+        BOOST_CHECK(db.InWriteGroup());
+        BOOST_CHECK(db.PeriodicFlush());
+        BOOST_CHECK(!db.InWriteGroup());
+        batch = db.MakeBatch();
+        BOOST_CHECK(batch->WriteNonCritical(tx_key(1), 43));
+        BOOST_CHECK(db.InWriteGroup());
+    }
+    {
+        // Closing the database commits the group
+        SQLiteDatabase db{path, file};
+        auto batch{db.MakeBatch()};
+        int value;
+        BOOST_CHECK(batch->Read(tx_key(0), value));
+        BOOST_CHECK_EQUAL(value, 42);
+        BOOST_CHECK(batch->Read(tx_key(1), value));
+        BOOST_CHECK_EQUAL(value, 43);
+        BOOST_CHECK(batch->Read(tx_key(999), value));
+        BOOST_CHECK_EQUAL(value, -999);
+        BOOST_CHECK(batch->Read(std::string{"key"}, value));
+        BOOST_CHECK_EQUAL(value, 1);
+    }
+    gArgs.ForceSetArg("-walletlazysync", "0");
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace wallet
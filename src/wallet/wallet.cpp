@@ -34,6 +34,7 @@
 #include <util/moneystr.h>
 #include <util/rbf.h>
 #include <util/string.h>
+#include <util/thread.h>
 #include <util/translation.h>
 #include <wallet/coincontrol.h>
 #include <wallet/context.h>
@@ -44,7 +45,9 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <optional>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -95,20 +98,6 @@ static void UpdateWalletSetting(interfaces::Chain& chain,
     }
 }
 
-/**
- * Refresh mempool status so the wallet is in an internally consistent state and
- * immediately knows the transaction's status: Whether it can be considered
- * trusted and is eligible to be abandoned ...
- */
-static void RefreshMempoolStatus(CWalletTx& tx, interfaces::Chain& chain)
-{
-    if (chain.isInMempool(tx.GetHash())) {
-        tx.m_state = TxStateInMempool();
-    } else if (tx.state<TxStateInMempool>()) {
-        tx.m_state = TxStateInactive();
-    }
-}
-
 bool AddWallet(WalletContext& context, const std::shared_ptr<CWallet>& wallet)
 {
     LOCK(context.wallets_mutex);
@@ -634,13 +623,66 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+const WalletUTXOs& CWallet::GetUnspentOutputs() const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_unspent_dirty) RebuildUnspent();
+    return m_unspent;
+}
+
+void CWallet::InvalidateUnspent()
+{
+    AssertLockHeld(cs_wallet);
+    m_unspent_dirty = true;
+    m_cached_balances.clear();
+}
+
+void CWallet::RebuildUnspent() const
+{
+    AssertLockHeld(cs_wallet);
+    m_unspent.clear();
+    m_cached_balances.clear();
+    m_unspent_dirty = false;
+    for (const auto& [hash, wtx] : mapWallet) {
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+            UpdateUnspent(wtx, i);
+        }
+    }
+}
+
+void CWallet::UpdateUnspent(const CWalletTx& wtx, unsigned int n) const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_unspent_dirty) return;
+    m_cached_balances.clear();
+
+    const COutPoint outpoint(wtx.GetHash(), n);
+    const CTxOut& txout = wtx.tx->vout[n];
+    const isminetype mine = IsMine(txout);
+    if (mine == ISMINE_NO || IsSpent(outpoint.hash, outpoint.n)) {
+        m_unspent.erase(outpoint);
+        return;
+    }
+    m_unspent[outpoint] = WalletUTXO{&wtx, txout.nValue, mine, CNameScript::isNameScript(txout.scriptPubKey)};
+}
+
+void CWallet::UpdateUnspent(const COutPoint& outpoint) const
+{
+    AssertLockHeld(cs_wallet);
+    const auto it = mapWallet.find(outpoint.hash);
+    if (it != mapWallet.end() && outpoint.n < it->second.tx->vout.size()) {
+        UpdateUnspent(it->second, outpoint.n);
+    }
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid, WalletBatch* batch)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
 
     if (batch) {
         UnlockCoin(outpoint, batch);
-    } else {
+    } else if (IsLockedCoin(outpoint.hash, outpoint.n)) {
+        // Only open a batch when needed, this is called for every input when loading the wallet.
         WalletBatch temp_batch(GetDatabase());
         UnlockCoin(outpoint, &temp_batch);
     }
@@ -840,6 +882,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        InvalidateUnspent();
     }
 }
 
@@ -860,7 +903,7 @@ bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
     wtx.mapValue["replaced_by_txid"] = newHash.ToString();
 
     // Refresh mempool status without waiting for transactionRemovedFromMempool
-    RefreshMempoolStatus(wtx, chain());
+    RefreshMempoolStatus(wtx);
 
     WalletBatch batch(GetDatabase());
 
@@ -993,6 +1036,14 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const TxState& state, const
     // Break debit/credit balance caches:
     wtx.MarkDirty();
 
+    // The outputs may have become ours, and the inputs spent or unspent
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+        UpdateUnspent(wtx, i);
+    }
+    for (const CTxIn& txin : wtx.tx->vin) {
+        UpdateUnspent(txin.prevout);
+    }
+
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -1034,6 +1085,22 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
     if (!fill_wtx(wtx, ins.second)) {
         return false;
     }
+    LoadTxState(wtx, /*new_tx=*/ins.second);
+    return true;
+}
+
+bool CWallet::LoadToWallet(TxMap::node_type tx_node)
+{
+    const auto ins = mapWallet.insert(std::move(tx_node));
+    if (!ins.inserted) {
+        return false;
+    }
+    LoadTxState(ins.position->second, /*new_tx=*/true);
+    return true;
+}
+
+void CWallet::LoadTxState(CWalletTx& wtx, bool new_tx)
+{
     // If wallet doesn't have a chain (e.g when using bitcoin-wallet tool),
     // don't bother to update txn.
     if (HaveChain()) {
@@ -1055,10 +1122,12 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
             lookup_block(conf->conflicting_block_hash, conf->conflicting_block_height, wtx.m_state);
         }
     }
-    if (/* insertion took place */ ins.second) {
+    if (new_tx) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
-    AddToSpends(hash);
+    // Which outputs are ours is only known once all keys and scripts are loaded.
+    InvalidateUnspent();
+    AddToSpends(wtx.GetHash());
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1068,7 +1137,6 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
             }
         }
     }
-    return true;
 }
 
 bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const SyncTxState& state, bool fUpdate, bool rescanning_old_block)
@@ -1144,6 +1212,7 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            UpdateUnspent(txin.prevout);
         }
     }
 }
@@ -1183,6 +1252,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             assert(!wtx.InMempool());
             wtx.m_state = TxStateInactive{/*abandoned=*/true};
             wtx.MarkDirty();
+            m_cached_balances.clear();
             batch.WriteTx(wtx);
             NotifyTransactionChanged(wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -1235,6 +1305,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, int conflicting_height, c
             // Mark transaction as conflicted with this block.
             wtx.m_state = TxStateConflicted{hashBlock, conflicting_height};
             wtx.MarkDirty();
+            m_cached_balances.clear();
             batch.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -1251,6 +1322,26 @@ void CWallet::MarkConflicted(const uint256& hashBlock, int conflicting_height, c
     }
 }
 
+/**
+ * Refresh mempool status so the wallet is in an internally consistent state and
+ * immediately knows the transaction's status: Whether it can be considered
+ * trusted and is eligible to be abandoned ...
+ */
+void CWallet::RefreshMempoolStatus(CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    const bool was_in_mempool{wtx.state<TxStateInMempool>() != nullptr};
+    if (chain().isInMempool(wtx.GetHash())) {
+        wtx.m_state = TxStateInMempool();
+    } else if (was_in_mempool) {
+        wtx.m_state = TxStateInactive();
+    }
+    // Pending balances depend on whether the transaction is in the mempool.
+    if (was_in_mempool != (wtx.state<TxStateInMempool>() != nullptr)) {
+        m_cached_balances.clear();
+    }
+}
+
 void CWallet::SyncTransaction(const CTransactionRef& ptx, const SyncTxState& state, bool update_tx, bool rescanning_old_block)
 {
     if (!AddToWalletIfInvolvingMe(ptx, state, update_tx, rescanning_old_block))
@@ -1268,7 +1359,7 @@ void CWallet::transactionAddedToMempool(const CTransactionRef& tx, uint64_t memp
 
     auto it = mapWallet.find(tx->GetHash());
     if (it != mapWallet.end()) {
-        RefreshMempoolStatus(it->second, chain());
+        RefreshMempoolStatus(it->second);
     }
 }
 
@@ -1276,7 +1367,7 @@ void CWallet::transactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRe
     LOCK(cs_wallet);
     auto it = mapWallet.find(tx->GetHash());
     if (it != mapWallet.end()) {
-        RefreshMempoolStatus(it->second, chain());
+        RefreshMempoolStatus(it->second);
     }
     // Handle transactions that were removed from the mempool because they
     // conflict with transactions in a newly connected block.
@@ -1316,6 +1407,7 @@ void CWallet::blockConnected(const CBlock& block, int height)
 
     m_last_block_processed_height = height;
     m_last_block_processed = block_hash;
+    m_cached_balances.clear();
     for (size_t index = 0; index < block.vtx.size(); index++) {
         SyncTransaction(block.vtx[index], TxStateConfirmed{block_hash, height, static_cast<int>(index)});
         transactionRemovedFromMempool(block.vtx[index], MemPoolRemovalReason::BLOCK, 0 /* mempool_sequence */);
@@ -1333,6 +1425,7 @@ void CWallet::blockDisconnected(const CBlock& block, int height)
     // future with a stickier abandoned state or even removing abandontransaction call.
     m_last_block_processed_height = height - 1;
     m_last_block_processed = block.hashPrevBlock;
+    m_cached_balances.clear();
     for (const CTransactionRef& ptx : block.vtx) {
         SyncTransaction(ptx, TxStateInactive{});
     }
@@ -1417,6 +1510,15 @@ isminetype CWallet::IsMine(const CTxDestination& dest) const
 isminetype CWallet::IsMine(const CScript& script) const
 {
     AssertLockHeld(cs_wallet);
+    if (IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS)) {
+        // Descriptor ScriptPubKeyMans own the address part of name scripts
+        isminetype result = ISMINE_NO;
+        for (ScriptPubKeyMan* spk_man : m_spk_index.Find(CNameScript(script).getAddress())) {
+            result = std::max(result, spk_man->IsMine(script));
+        }
+        return result;
+    }
+
     isminetype result = ISMINE_NO;
     for (const auto& spk_man_pair : m_spk_managers) {
         result = std::max(result, spk_man_pair.second->IsMine(script));
@@ -1490,6 +1592,7 @@ void CWallet::SetWalletFlag(uint64_t flags)
 {
     LOCK(cs_wallet);
     m_wallet_flags |= flags;
+    m_cached_balances.clear();
     if (!WalletBatch(GetDatabase()).WriteWalletFlags(m_wallet_flags))
         throw std::runtime_error(std::string(__func__) + ": writing wallet flags failed");
 }
@@ -1504,6 +1607,7 @@ void CWallet::UnsetWalletFlagWithDB(WalletBatch& batch, uint64_t flag)
 {
     LOCK(cs_wallet);
     m_wallet_flags &= ~flag;
+    m_cached_balances.clear();
     if (!batch.WriteWalletFlags(m_wallet_flags))
         throw std::runtime_error(std::string(__func__) + ": writing wallet flags failed");
 }
@@ -1714,6 +1818,127 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+namespace {
+/** Number of blocks ahead of a rescan whose filters are matched at once */
+constexpr int RESCAN_FILTER_BATCH_SIZE{1000};
+/** Maximum number of threads matching block filters during a rescan */
+constexpr int MAX_RESCAN_FILTER_THREADS{8};
+
+/**
+ * Finds the blocks a rescan of a descriptor wallet can skip, by matching the
+ * wallet's scriptPubKeys against the BIP 157 basic block filters and the
+ * index's filters of the address scripts inside name scripts.  The filters
+ * of the next RESCAN_FILTER_BATCH_SIZE blocks are matched together on several
+ * threads.  Scripts that are derived while the scan finds transactions are
+ * matched against the rest of the batch when it gets there.
+ */
+class FastWalletRescanFilter
+{
+public:
+    explicit FastWalletRescanFilter(const CWallet& wallet) : m_wallet(wallet) {}
+
+    /**
+     * Whether the block may contain wallet transactions, or nullopt if its
+     * filter is not available.
+     */
+    std::optional<bool> MatchesBlock(const uint256& block_hash, int block_height);
+
+private:
+    struct BlockMatch {
+        uint256 block_hash;
+        std::optional<bool> matches;
+        //! Number of m_elements the filter has been matched against
+        size_t num_elements{0};
+    };
+
+    const CWallet& m_wallet;
+    //! End of the derived range of each descriptor when its scripts were added
+    std::map<const DescriptorScriptPubKeyMan*, int32_t> m_end_ranges;
+    //! The scripts to match, in the order they were added
+    std::vector<GCSFilter::Element> m_elements;
+    GCSFilter::ElementSet m_element_set;
+
+    int m_batch_start{0};
+    std::vector<BlockMatch> m_batch;
+
+    void UpdateElements();
+    void MatchBatch(int start_height);
+};
+
+void FastWalletRescanFilter::UpdateElements()
+{
+    for (ScriptPubKeyMan* spk_man : m_wallet.GetAllScriptPubKeyMans()) {
+        const auto desc_spk_man{dynamic_cast<const DescriptorScriptPubKeyMan*>(spk_man)};
+        if (!desc_spk_man) continue;
+        const int32_t end_range{desc_spk_man->GetEndRange()};
+        auto [it, inserted] = m_end_ranges.emplace(desc_spk_man, 0);
+        if (!inserted && it->second == end_range) continue;
+        // A descriptor that was updated derives its scripts again from index 0
+        const int32_t minimum_index{it->second <= end_range ? it->second : 0};
+        for (const CScript& script : desc_spk_man->GetScriptPubKeys(minimum_index)) {
+            GCSFilter::Element element(script.begin(), script.end());
+            if (m_element_set.insert(element).second) m_elements.push_back(std::move(element));
+        }
+        it->second = end_range;
+    }
+}
+
+void FastWalletRescanFilter::MatchBatch(int start_height)
+{
+    interfaces::Chain& chain{m_wallet.chain()};
+    const auto [tip_hash, tip_height] = WITH_LOCK(m_wallet.cs_wallet, return std::make_pair(m_wallet.GetLastBlockHash(), m_wallet.GetLastBlockHeight()));
+
+    m_batch_start = start_height;
+    m_batch.clear();
+    for (int height = start_height; height <= tip_height && height < start_height + RESCAN_FILTER_BATCH_SIZE; ++height) {
+        BlockMatch& match{m_batch.emplace_back()};
+        if (!chain.findAncestorByHeight(tip_hash, height, FoundBlock().hash(match.block_hash))) {
+            m_batch.pop_back();
+            break;
+        }
+    }
+
+    std::atomic<size_t> next_block{0};
+    const auto match_blocks = [&] {
+        for (size_t i = next_block++; i < m_batch.size(); i = next_block++) {
+            m_batch[i].matches = chain.blockFilterMatchesAny(BlockFilterType::BASIC, m_batch[i].block_hash, m_element_set);
+            m_batch[i].num_elements = m_elements.size();
+        }
+    };
+    const int num_threads{std::min({GetNumCores(), MAX_RESCAN_FILTER_THREADS, static_cast<int>(m_batch.size())})};
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back(&util::TraceThread, "rescanfilter", match_blocks);
+    }
+    match_blocks();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+std::optional<bool> FastWalletRescanFilter::MatchesBlock(const uint256& block_hash, int block_height)
+{
+    UpdateElements();
+
+    if (block_height < m_batch_start || block_height >= m_batch_start + static_cast<int>(m_batch.size())) {
+        MatchBatch(block_height);
+    }
+    const size_t pos = block_height - m_batch_start;
+    if (pos >= m_batch.size() || m_batch[pos].block_hash != block_hash) {
+        // The block is past the wallet's tip or was reorged in
+        return m_wallet.chain().blockFilterMatchesAny(BlockFilterType::BASIC, block_hash, m_element_set);
+    }
+
+    BlockMatch& match{m_batch[pos]};
+    if (match.matches == false && match.num_elements < m_elements.size()) {
+        const GCSFilter::ElementSet new_elements(m_elements.begin() + match.num_elements, m_elements.end());
+        match.matches = m_wallet.chain().blockFilterMatchesAny(BlockFilterType::BASIC, block_hash, new_elements);
+        match.num_elements = m_elements.size();
+    }
+    return match.matches;
+}
+} // namespace
+
 /**
  * Scan the block chain (starting in start_block) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1745,7 +1970,15 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     uint256 block_hash = start_block;
     ScanResult result;
 
-    WalletLogPrintf("Rescan started from block %s...\n", start_block.ToString());
+    // With a block filter index, descriptor wallets only read the blocks
+    // whose filters match their scripts
+    std::unique_ptr<FastWalletRescanFilter> fast_rescan_filter;
+    if (IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS) && chain().hasBlockFilterIndex(BlockFilterType::BASIC)) {
+        fast_rescan_filter = std::make_unique<FastWalletRescanFilter>(*this);
+    }
+    int num_blocks_skipped{0};
+
+    WalletLogPrintf("Rescan started from block %s%s...\n", start_block.ToString(), fast_rescan_filter ? " using block filters" : "");
 
     fAbortRescan = false;
     ShowProgress(strprintf("%s " + _("Rescanning…").translated, GetDisplayName()), 0); // show rescan progress in GUI as dialog or on splashscreen, if rescan required on startup (e.g. due to corruption)
@@ -1770,9 +2003,19 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", block_height, progress_current);
         }
 
+        // Skip the block if its filter shows that it has no wallet transactions
+        bool fetch_block{true};
+        if (fast_rescan_filter) {
+            const std::optional<bool> matches_block{fast_rescan_filter->MatchesBlock(block_hash, block_height)};
+            if (matches_block == false) {
+                fetch_block = false;
+                ++num_blocks_skipped;
+            }
+        }
+
         // Read block data
         CBlock block;
-        chain().findBlock(block_hash, FoundBlock().data(block));
+        if (fetch_block) chain().findBlock(block_hash, FoundBlock().data(block));
 
         // Find next block separately from reading data above, because reading
         // is slow and there might be a reorg while it is read.
@@ -1781,7 +2024,15 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         uint256 next_block_hash;
         chain().findBlock(block_hash, FoundBlock().inActiveChain(block_still_active).nextBlock(FoundBlock().inActiveChain(next_block).hash(next_block_hash)));
 
-        if (!block.IsNull()) {
+        if (!fetch_block) {
+            if (!block_still_active) {
+                result.last_failed_block = block_hash;
+                result.status = ScanResult::FAILURE;
+                break;
+            }
+            result.last_scanned_block = block_hash;
+            result.last_scanned_height = block_height;
+        } else if (!block.IsNull()) {
             LOCK(cs_wallet);
             if (!block_still_active) {
                 // Abort scan if current block is no longer active, to prevent
@@ -1834,6 +2085,7 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         result.status = ScanResult::USER_ABORT;
     } else {
         WalletLogPrintf("Rescan completed in %15dms\n", GetTimeMillis() - start_time);
+        if (fast_rescan_filter) WalletLogPrintf("Rescan skipped %d blocks using block filters\n", num_blocks_skipped);
     }
     return result;
 }
@@ -2192,6 +2444,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
 {
     AssertLockHeld(cs_wallet);
     DBErrors nZapSelectTxRet = WalletBatch(GetDatabase()).ZapSelectTx(vHashIn, vHashOut);
+    InvalidateUnspent();
     for (const uint256& hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
@@ -2939,6 +3192,7 @@ std::shared_ptr<CWallet> CWallet::Create(WalletContext& context, const std::stri
     walletInstance->m_confirm_target = args.GetIntArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     walletInstance->m_spend_zero_conf_change = args.GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     walletInstance->m_signal_rbf = args.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
+    walletInstance->m_check_balance = args.GetBoolArg("-walletcheckbalance", DEFAULT_WALLET_CHECK_BALANCE);
 
     walletInstance->WalletLogPrintf("Wallet completed loading in %15dms\n", GetTimeMillis() - nStart);
 
@@ -3301,8 +3555,17 @@ ScriptPubKeyMan* CWallet::GetScriptPubKeyMan(const OutputType& type, bool intern
 
 std::set<ScriptPubKeyMan*> CWallet::GetScriptPubKeyMans(const CScript& script) const
 {
+    AssertLockHeld(cs_wallet);
     std::set<ScriptPubKeyMan*> spk_mans;
     SignatureData sigdata;
+    if (IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS)) {
+        for (ScriptPubKeyMan* spk_man : m_spk_index.Find(CNameScript(script).getAddress())) {
+            if (spk_man->CanProvide(script, sigdata)) {
+                spk_mans.insert(spk_man);
+            }
+        }
+        return spk_mans;
+    }
     for (const auto& spk_man_pair : m_spk_managers) {
         if (spk_man_pair.second->CanProvide(script, sigdata)) {
             spk_mans.insert(spk_man_pair.second.get());
@@ -3367,6 +3630,14 @@ void CWallet::SetupLegacyScriptPubKeyMan()
     m_spk_managers[spk_manager->GetID()] = std::move(spk_manager);
 }
 
+void CWallet::TopUpCallback(const std::vector<CScript>& scripts, ScriptPubKeyMan* spk_man)
+{
+    AssertLockHeld(cs_wallet);
+    for (const CScript& script : scripts) {
+        m_spk_index.Insert(script, spk_man);
+    }
+}
+
 const CKeyingMaterial& CWallet::GetEncryptionKey() const
 {
     return vMasterKey;
@@ -3556,6 +3827,7 @@ std::optional<bool> CWallet::IsInternalScriptPubKeyMan(ScriptPubKeyMan* spk_man)
 ScriptPubKeyMan* CWallet::AddWalletDescriptor(WalletDescriptor& desc, const FlatSigningProvider& signing_provider, const std::string& label, bool internal)
 {
     AssertLockHeld(cs_wallet);
+    InvalidateUnspent();
 
     if (!IsWalletFlagSet(WALLET_FLAG_DESCRIPTORS)) {
         WalletLogPrintf("Cannot add WalletDescriptor to a non-descriptor wallet\n");
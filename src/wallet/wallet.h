@@ -24,6 +24,7 @@
 #include <validationinterface.h>
 #include <wallet/coinselection.h>
 #include <wallet/crypter.h>
+#include <wallet/scriptpubkeyindex.h>
 #include <wallet/scriptpubkeyman.h>
 #include <wallet/transaction.h>
 #include <wallet/walletdb.h>
@@ -98,6 +99,8 @@ static const CAmount WALLET_INCREMENTAL_RELAY_FEE = COIN / 1000;
 static const bool DEFAULT_SPEND_ZEROCONF_CHANGE = true;
 //! Default for -walletrejectlongchains
 static const bool DEFAULT_WALLET_REJECT_LONG_CHAINS = false;
+//! Default for -walletcheckbalance
+static const bool DEFAULT_WALLET_CHECK_BALANCE = false;
 //! -txconfirmtarget default
 static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 //! -walletrbf default
@@ -227,6 +230,26 @@ struct CRecipient
     bool fSubtractFeeFromAmount;
 };
 
+/** An unspent output of a wallet transaction that belongs to the wallet */
+struct WalletUTXO
+{
+    const CWalletTx* wtx;
+    CAmount value;
+    isminetype ismine;
+    //! Whether this is a name output, which is not spent by coin selection
+    bool is_name;
+};
+using WalletUTXOs = std::map<COutPoint, WalletUTXO>;
+
+struct Balance {
+    CAmount m_mine_trusted{0};           //!< Trusted, at depth=GetBalance.min_depth or more
+    CAmount m_mine_untrusted_pending{0}; //!< Untrusted, but in mempool (pending)
+    CAmount m_mine_immature{0};          //!< Immature coinbases in the main chain
+    CAmount m_watchonly_trusted{0};
+    CAmount m_watchonly_untrusted_pending{0};
+    CAmount m_watchonly_immature{0};
+};
+
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
 /**
  * A CWallet maintains a set of transactions and balances, and provides the ability to create new transactions.
@@ -265,6 +288,22 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid, WalletBatch* batch = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid, WalletBatch* batch = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * The wallet's own unspent outputs, so that coin selection does not have
+     * to look at every output of every wallet transaction.  The set is kept
+     * up to date when transactions are added or change their state.  Since
+     * which outputs are ours changes with imported keys and scripts, it is
+     * rebuilt from mapWallet on the next use after MarkDirty().
+     */
+    mutable WalletUTXOs m_unspent GUARDED_BY(cs_wallet);
+    mutable bool m_unspent_dirty GUARDED_BY(cs_wallet){true};
+    void RebuildUnspent() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Add or remove an output from m_unspent according to its current state */
+    void UpdateUnspent(const CWalletTx& wtx, unsigned int n) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void UpdateUnspent(const COutPoint& outpoint) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Rebuild m_unspent on its next use and drop the cached balances */
+    void InvalidateUnspent() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  confirm.block_* should
      * be set when the transaction was known to be included in a block.  When
@@ -289,8 +328,14 @@ private:
     /** Mark a transaction's inputs dirty, thus forcing the outputs to be recomputed */
     void MarkInputsDirty(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** Refresh the mempool state of a wallet transaction, dropping the cached balances if it changed */
+    void RefreshMempoolStatus(CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** Update the state of a transaction loaded from the database and add it to the wallet's indexes */
+    void LoadTxState(CWalletTx& wtx, bool new_tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     void SyncTransaction(const CTransactionRef& tx, const SyncTxState& state, bool update_tx = true, bool rescanning_old_block = false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /** WalletFlags set on this wallet. */
@@ -339,6 +384,9 @@ private:
     // ScriptPubKeyMan::GetID. In many cases it will be the hash of an internal structure
     std::map<uint256, std::unique_ptr<ScriptPubKeyMan>> m_spk_managers;
 
+    //! The scriptPubKeys of all descriptor ScriptPubKeyMans, filled as they are topped up
+    ScriptPubKeyIndex m_spk_index GUARDED_BY(cs_wallet);
+
     /**
      * Catch wallet up to current chain, scanning new blocks, updating the best
      * block locator and m_last_block_processed, and registering for
@@ -393,7 +441,8 @@ public:
 
     /** Map from txid to CWalletTx for all transactions this wallet is
      * interested in, including received and sent transactions. */
-    std::map<uint256, CWalletTx> mapWallet GUARDED_BY(cs_wallet);
+    using TxMap = std::map<uint256, CWalletTx>;
+    TxMap mapWallet GUARDED_BY(cs_wallet);
 
     typedef std::multimap<int64_t, CWalletTx*> TxItems;
     TxItems wtxOrdered;
@@ -454,6 +503,16 @@ public:
 
     bool IsSpent(const uint256& hash, unsigned int n) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** Returns the unspent outputs of wallet transactions that belong to the wallet */
+    const WalletUTXOs& GetUnspentOutputs() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Results of GetBalance by min_depth and avoid_reuse.  They are dropped
+     * whenever the unspent outputs, the state of a transaction or the tip
+     * change, so that polling the balance is cheap.
+     */
+    mutable std::map<std::pair<int, bool>, Balance> m_cached_balances GUARDED_BY(cs_wallet);
+
     // Whether this or any known UTXO with the same single key has been spent.
     bool IsSpentKey(const uint256& hash, unsigned int n) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void SetSpentKeyState(WalletBatch& batch, const uint256& hash, unsigned int n, bool used, std::set<CTxDestination>& tx_destinations) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -518,6 +577,8 @@ public:
 
     CWalletTx* AddToWallet(CTransactionRef tx, const TxState& state, const UpdateWalletTxFn& update_wtx=nullptr, bool fFlushOnClose=true, bool rescanning_old_block = false);
     bool LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Load a transaction that was deserialized into a node extracted from a TxMap
+    bool LoadToWallet(TxMap::node_type tx_node) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void transactionAddedToMempool(const CTransactionRef& tx, uint64_t mempool_sequence) override;
     void blockConnected(const CBlock& block, int height) override;
     void blockDisconnected(const CBlock& block, int height) override;
@@ -608,6 +669,8 @@ public:
      * cannot fund the transaction otherwise. */
     bool m_spend_zero_conf_change{DEFAULT_SPEND_ZEROCONF_CHANGE};
     bool m_signal_rbf{DEFAULT_WALLET_RBF};
+    //! Check cached balances against a full recomputation from mapWallet
+    bool m_check_balance{DEFAULT_WALLET_CHECK_BALANCE};
     bool m_allow_fallback_fee{true}; //!< will be false if -fallbackfee=0
     CFeeRate m_min_fee{DEFAULT_TRANSACTION_MINFEE}; //!< Override with -mintxfee
     /**
@@ -820,7 +883,7 @@ public:
     ScriptPubKeyMan* GetScriptPubKeyMan(const OutputType& type, bool internal) const;
 
     //! Get all the ScriptPubKeyMans for a script
-    std::set<ScriptPubKeyMan*> GetScriptPubKeyMans(const CScript& script) const;
+    std::set<ScriptPubKeyMan*> GetScriptPubKeyMans(const CScript& script) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Get the ScriptPubKeyMan by id
     ScriptPubKeyMan* GetScriptPubKeyMan(const uint256& id) const;
 
@@ -837,6 +900,7 @@ public:
 
     const CKeyingMaterial& GetEncryptionKey() const override;
     bool HasEncryptionKeys() const override;
+    void TopUpCallback(const std::vector<CScript>& scripts, ScriptPubKeyMan* spk_man) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /** Get last block processed height */
     int GetLastBlockHeight() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet)
@@ -857,6 +921,7 @@ public:
         AssertLockHeld(cs_wallet);
         m_last_block_processed_height = block_height;
         m_last_block_processed = block_hash;
+        m_cached_balances.clear();
     };
 
     //! Connect the signals from ScriptPubKeyMans to the signals in CWallet
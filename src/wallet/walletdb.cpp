@@ -13,6 +13,7 @@
 #include <sync.h>
 #include <util/bip32.h>
 #include <util/system.h>
+#include <util/thread.h>
 #include <util/time.h>
 #include <util/translation.h>
 #ifdef USE_BDB
@@ -23,9 +24,14 @@
 #endif
 #include <wallet/wallet.h>
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 
 namespace wallet {
 namespace DBKeys {
@@ -91,7 +97,7 @@ bool WalletBatch::ErasePurpose(const std::string& strAddress)
 
 bool WalletBatch::WriteTx(const CWalletTx& wtx)
 {
-    return WriteIC(std::make_pair(DBKeys::TX, wtx.GetHash()), wtx);
+    return WriteNonCriticalIC(std::make_pair(DBKeys::TX, wtx.GetHash()), wtx);
 }
 
 bool WalletBatch::EraseTx(uint256 hash)
@@ -173,8 +179,8 @@ bool WalletBatch::EraseWatchOnly(const CScript &dest)
 
 bool WalletBatch::WriteBestBlock(const CBlockLocator& locator)
 {
-    WriteIC(DBKeys::BESTBLOCK, CBlockLocator()); // Write empty block locator so versions that require a merkle branch automatically rescan
-    return WriteIC(DBKeys::BESTBLOCK_NOMERKLE, locator);
+    WriteNonCriticalIC(DBKeys::BESTBLOCK, CBlockLocator()); // Write empty block locator so versions that require a merkle branch automatically rescan
+    return WriteNonCriticalIC(DBKeys::BESTBLOCK_NOMERKLE, locator);
 }
 
 bool WalletBatch::ReadBestBlock(CBlockLocator& locator)
@@ -185,7 +191,7 @@ bool WalletBatch::ReadBestBlock(CBlockLocator& locator)
 
 bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
 {
-    return WriteIC(DBKeys::ORDERPOSNEXT, nOrderPosNext);
+    return WriteNonCriticalIC(DBKeys::ORDERPOSNEXT, nOrderPosNext);
 }
 
 bool WalletBatch::ReadPool(int64_t nPool, CKeyPool& keypool)
@@ -308,6 +314,27 @@ bool WalletBatch::EraseQueuedTransaction(const uint256& txid)
     return EraseIC(std::make_pair(DBKeys::QUEUED_TX, txid));
 }
 
+/** Transaction records are deserialized in batches of this many records */
+static constexpr size_t TX_RECORD_BATCH_SIZE{1000};
+/** Maximum number of threads deserializing transaction records */
+static constexpr int MAX_TX_RECORD_THREADS{8};
+/** Maximum number of batches of transaction records read but not yet added to the wallet */
+static constexpr size_t MAX_PENDING_TX_RECORD_BATCHES{16};
+
+/** A transaction record, which is deserialized by TxRecordLoader */
+struct TxRecord {
+    uint256 hash;
+    CDataStream value;
+
+    //! The deserialized transaction, as a node that can be moved into mapWallet
+    CWallet::TxMap::node_type node{};
+    std::string error{};
+    bool upgraded{false};
+    bool unordered{false};
+
+    TxRecord(const uint256& hash_in, CDataStream&& value_in) : hash(hash_in), value(std::move(value_in)) {}
+};
+
 class CWalletScanState {
 public:
     unsigned int nKeys{0};
@@ -324,7 +351,7 @@ public:
     std::map<std::pair<uint256, CKeyID>, CKey> m_descriptor_keys;
     std::map<std::pair<uint256, CKeyID>, std::pair<CPubKey, std::vector<unsigned char>>> m_descriptor_crypt_keys;
     std::map<uint160, CHDChain> m_hd_chains;
-    bool tx_corrupt{false};
+    std::vector<TxRecord> m_tx_records;
 
     CWalletScanState() {
     }
@@ -356,49 +383,9 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         } else if (strType == DBKeys::TX) {
             uint256 hash;
             ssKey >> hash;
-            // LoadToWallet call below creates a new CWalletTx that fill_wtx
-            // callback fills with transaction metadata.
-            auto fill_wtx = [&](CWalletTx& wtx, bool new_tx) {
-                if(!new_tx) {
-                    // There's some corruption here since the tx we just tried to load was already in the wallet.
-                    // We don't consider this type of corruption critical, and can fix it by removing tx data and
-                    // rescanning.
-                    wss.tx_corrupt = true;
-                    return false;
-                }
-                ssValue >> wtx;
-                if (wtx.GetHash() != hash)
-                    return false;
-
-                // Undo serialize changes in 31600
-                if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-                {
-                    if (!ssValue.empty())
-                    {
-                        uint8_t fTmp;
-                        uint8_t fUnused;
-                        std::string unused_string;
-                        ssValue >> fTmp >> fUnused >> unused_string;
-                        strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                           wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                        wtx.fTimeReceivedIsTxTime = fTmp;
-                    }
-                    else
-                    {
-                        strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                        wtx.fTimeReceivedIsTxTime = 0;
-                    }
-                    wss.vWalletUpgrade.push_back(hash);
-                }
-
-                if (wtx.nOrderPos == -1)
-                    wss.fAnyUnordered = true;
-
-                return true;
-            };
-            if (!pwallet->LoadToWallet(hash, fill_wtx)) {
-                return false;
-            }
+            // Deserializing transactions is independent of all other records,
+            // so it is done in parallel by TxRecordLoader.
+            wss.m_tx_records.emplace_back(hash, std::move(ssValue));
         } else if (strType == DBKeys::WATCHS) {
             wss.nWatchKeys++;
             CScript script;
@@ -767,11 +754,201 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+/** Deserialize a transaction record, filling in its node on success */
+static void DecodeTxRecord(TxRecord& record)
+{
+    CWallet::TxMap tx_map;
+    CWalletTx& wtx = tx_map.emplace(std::piecewise_construct, std::forward_as_tuple(record.hash), std::forward_as_tuple(nullptr, TxStateInactive{})).first->second;
+    try {
+        record.value >> wtx;
+        if (wtx.GetHash() != record.hash)
+            return;
+
+        // Undo serialize changes in 31600
+        if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+        {
+            if (!record.value.empty())
+            {
+                uint8_t fTmp;
+                uint8_t fUnused;
+                std::string unused_string;
+                record.value >> fTmp >> fUnused >> unused_string;
+                record.error = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                                         wtx.fTimeReceivedIsTxTime, fTmp, record.hash.ToString());
+                wtx.fTimeReceivedIsTxTime = fTmp;
+            }
+            else
+            {
+                record.error = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, record.hash.ToString());
+                wtx.fTimeReceivedIsTxTime = 0;
+            }
+            record.upgraded = true;
+        }
+
+        record.unordered = wtx.nOrderPos == -1;
+    } catch (const std::exception& e) {
+        record.error = e.what();
+        return;
+    } catch (...) {
+        record.error = "Caught unknown exception in DecodeTxRecord";
+        return;
+    }
+    record.node = tx_map.extract(tx_map.begin());
+}
+
+/**
+ * Deserializes the transaction records collected by ReadKeyValue while the
+ * cursor is still reading, and adds them to the wallet in the order they were
+ * read.  Every full batch of records is handed to worker threads right away,
+ * and decoded batches are added to the wallet as they become ready, so at most
+ * MAX_PENDING_TX_RECORD_BATCHES batches of raw records are held in memory.
+ */
+class TxRecordLoader
+{
+public:
+    TxRecordLoader(CWallet& wallet, CWalletScanState& wss) : m_wallet(wallet), m_wss(wss) {}
+
+    ~TxRecordLoader()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cv.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    /** Take the records collected so far once there is a full batch of them. */
+    void Collect() EXCLUSIVE_LOCKS_REQUIRED(m_wallet.cs_wallet, !m_mutex)
+    {
+        if (m_wss.m_tx_records.size() >= TX_RECORD_BATCH_SIZE) Submit();
+    }
+
+    /**
+     * Add all remaining records to the wallet.
+     *
+     * Returns DBErrors::CORRUPT if a transaction was already in the wallet, and
+     * DBErrors::NEED_RESCAN if a record could not be deserialized.
+     */
+    DBErrors Finish() EXCLUSIVE_LOCKS_REQUIRED(m_wallet.cs_wallet, !m_mutex)
+    {
+        Submit();
+        LoadDecoded(/*max_pending=*/0);
+        return m_result;
+    }
+
+private:
+    struct Batch {
+        std::vector<TxRecord> records;
+        bool decoded{false}; //!< Guarded by m_mutex
+    };
+
+    CWallet& m_wallet;
+    CWalletScanState& m_wss;
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Batches no worker has taken yet
+    std::deque<std::shared_ptr<Batch>> m_todo GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_workers;
+
+    //! Batches not yet added to the wallet, in the order they were read
+    std::deque<std::shared_ptr<Batch>> m_batches;
+    DBErrors m_result{DBErrors::LOAD_OK};
+
+    void WorkerThread() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            while (!m_stop && m_todo.empty()) {
+                m_cv.wait(lock);
+            }
+            if (m_stop) return;
+            const std::shared_ptr<Batch> batch{std::move(m_todo.front())};
+            m_todo.pop_front();
+            {
+                REVERSE_LOCK(lock);
+                for (TxRecord& record : batch->records) {
+                    DecodeTxRecord(record);
+                }
+            }
+            batch->decoded = true;
+            m_cv.notify_all();
+        }
+    }
+
+    void Submit() EXCLUSIVE_LOCKS_REQUIRED(m_wallet.cs_wallet, !m_mutex)
+    {
+        if (m_wss.m_tx_records.empty()) return;
+        auto batch{std::make_shared<Batch>()};
+        batch->records.swap(m_wss.m_tx_records);
+
+        // Start the workers once there is more than a single small batch.
+        if (m_workers.empty() && batch->records.size() >= TX_RECORD_BATCH_SIZE) {
+            const int num_threads{std::min(GetNumCores(), MAX_TX_RECORD_THREADS)};
+            for (int i = 0; i < num_threads - 1; ++i) {
+                m_workers.emplace_back(&util::TraceThread, "txload", [this] { WorkerThread(); });
+            }
+        }
+        if (m_workers.empty()) {
+            for (TxRecord& record : batch->records) {
+                DecodeTxRecord(record);
+            }
+            WITH_LOCK(m_mutex, batch->decoded = true);
+        } else {
+            WITH_LOCK(m_mutex, m_todo.push_back(batch));
+            m_cv.notify_one();
+        }
+        m_batches.push_back(std::move(batch));
+        LoadDecoded(MAX_PENDING_TX_RECORD_BATCHES);
+    }
+
+    /** Add the decoded batches at the front to the wallet, waiting for them while more than max_pending are left. */
+    void LoadDecoded(size_t max_pending) EXCLUSIVE_LOCKS_REQUIRED(m_wallet.cs_wallet, !m_mutex)
+    {
+        while (!m_batches.empty()) {
+            Batch& batch{*m_batches.front()};
+            {
+                WAIT_LOCK(m_mutex, lock);
+                if (!batch.decoded && m_batches.size() <= max_pending) return;
+                while (!batch.decoded) {
+                    m_cv.wait(lock);
+                }
+            }
+            Load(batch);
+            m_batches.pop_front();
+        }
+    }
+
+    void Load(Batch& batch) EXCLUSIVE_LOCKS_REQUIRED(m_wallet.cs_wallet)
+    {
+        for (TxRecord& record : batch.records) {
+            if (!record.error.empty()) {
+                m_wallet.WalletLogPrintf("%s\n", record.error);
+            }
+            if (record.node.empty()) {
+                // Rescan if there is a bad transaction record:
+                if (m_result == DBErrors::LOAD_OK) m_result = DBErrors::NEED_RESCAN;
+                continue;
+            }
+            if (!m_wallet.LoadToWallet(std::move(record.node))) {
+                // There's some corruption here since the tx we just tried to load was already in the wallet.
+                m_wallet.WalletLogPrintf("Error: Corrupt transaction found. This can be fixed by removing transactions from wallet and rescanning.\n");
+                m_result = DBErrors::CORRUPT;
+                continue;
+            }
+            if (record.upgraded) m_wss.vWalletUpgrade.push_back(record.hash);
+            if (record.unordered) m_wss.fAnyUnordered = true;
+        }
+    }
+};
+
 bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, std::string& strType, std::string& strErr, const KeyFilterFn& filter_fn)
 {
     CWalletScanState dummy_wss;
     LOCK(pwallet->cs_wallet);
-    return ReadKeyValue(pwallet, ssKey, ssValue, dummy_wss, strType, strErr, filter_fn);
+    return ReadKeyValue(pwallet, ssKey, ssValue, dummy_wss, strType, strErr, filter_fn) &&
+           TxRecordLoader{*pwallet, dummy_wss}.Finish() == DBErrors::LOAD_OK;
 }
 
 bool WalletBatch::IsKeyType(const std::string& strType)
@@ -788,6 +965,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
     DBErrors result = DBErrors::LOAD_OK;
 
     LOCK(pwallet->cs_wallet);
+    TxRecordLoader tx_loader{*pwallet, wss};
     try {
         int nMinVersion = 0;
         if (m_batch->Read(DBKeys::MINVERSION, nMinVersion)) {
@@ -848,11 +1026,6 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
                 } else if (strType == DBKeys::FLAGS) {
                     // reading the wallet flags can only fail if unknown flags are present
                     result = DBErrors::TOO_NEW;
-                } else if (wss.tx_corrupt) {
-                    pwallet->WalletLogPrintf("Error: Corrupt transaction found. This can be fixed by removing transactions from wallet and rescanning.\n");
-                    // Set tx_corrupt back to false so that the error is only printed once (per corrupt tx)
-                    wss.tx_corrupt = false;
-                    result = DBErrors::CORRUPT;
                 } else {
                     // Leave other errors alone, if we try to fix them we might make things worse.
                     fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
@@ -863,6 +1036,15 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 pwallet->WalletLogPrintf("%s\n", strErr);
+            tx_loader.Collect();
+        }
+
+        const DBErrors tx_result{tx_loader.Finish()};
+        if (tx_result == DBErrors::CORRUPT) {
+            result = DBErrors::CORRUPT;
+        } else if (tx_result == DBErrors::NEED_RESCAN) {
+            fNoncriticalErrors = true;
+            rescan_required = true;
         }
     } catch (...) {
         result = DBErrors::CORRUPT;
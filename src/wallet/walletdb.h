@@ -197,6 +197,19 @@ private:
         return true;
     }
 
+    template <typename K, typename T>
+    bool WriteNonCriticalIC(const K& key, const T& value)
+    {
+        if (!m_batch->WriteNonCritical(key, value)) {
+            return false;
+        }
+        m_database.IncrementUpdateCounter();
+        if (m_database.nUpdateCounter % 1000 == 0) {
+            m_batch->Flush();
+        }
+        return true;
+    }
+
     template <typename K>
     bool EraseIC(const K& key)
     {
@@ -74,6 +74,41 @@ class NameByHashTest (NameTestFramework):
     assert_raises_rpc_error (-8, "must be 32 bytes long",
                              node.name_show, "abcd", {"byHash": "sha256d"})
 
+    # The index works with pruning as well.  Blocks are only pruned once
+    # the index has processed them.
+    self.restart_node (0, extra_args=["-namehashindex", "-namehistory",
+                                      "-prune=1", "-fastprune"])
+    self.generate (node, 500)
+    self.wait_until (
+        lambda: node.getindexinfo ("namehash")["namehash"]["synced"])
+    assert_greater_than (node.pruneblockchain (300), 0)
+    assert_raises_rpc_error (-1, "Block not available (pruned data)",
+                             node.getblock, node.getblockhash (1))
+
+    otherName = "othername"
+    otherHash = hashlib.new ("sha256", otherName.encode ("ascii")).digest ()
+    otherHashHex = hashlib.new ("sha256", otherHash).hexdigest ()
+    new = node.name_new (otherName)
+    self.generate (node, 10)
+    self.firstupdateName (0, otherName, new, "other value")
+    self.generate (node, 5)
+    self.wait_until (
+        lambda: node.getindexinfo ("namehash")["namehash"]["synced"])
+    expiredOptions = dict (byHashOptions, allowExpired=True)
+    res = node.name_show (doubleHashHex, expiredOptions)
+    assert_equal (res["name"], nameHex)
+    res = node.name_show (otherHashHex, byHashOptions)
+    assert_equal (res["name"], otherName.encode ("ascii").hex ())
+    assert_equal (res["value"], "other value")
+
+    # Restarting the pruned node keeps the index usable.
+    self.restart_node (0, extra_args=["-namehashindex", "-namehistory",
+                                      "-prune=1", "-fastprune"])
+    self.wait_until (
+        lambda: node.getindexinfo ("namehash")["namehash"]["synced"])
+    res = node.name_show (doubleHashHex, expiredOptions)
+    assert_equal (res["name"], nameHex)
+
 
 if __name__ == '__main__':
   NameByHashTest ().main ()
@@ -13,7 +13,7 @@ class NameReorgTest (NameTestFramework):
 
   def set_test_params (self):
     self.setup_clean_chain = True
-    self.setup_name_test ([["-namehistory"]])
+    self.setup_name_test ([["-namehistory", "-compressundo"]])
 
   def run_test (self):
     node = self.nodes[0]
@@ -54,6 +54,19 @@ class RpcMiscTest(BitcoinTestFramework):
 
         assert_raises_rpc_error(-8, "unknown mode foobar", node.getmemoryinfo, mode="foobar")
 
+        self.log.info("test getschedulerinfo")
+        node.mockscheduler(60)
+        # The scheduler thread runs the task asynchronously after mockscheduler returns
+        self.wait_until(lambda: node.getschedulerinfo()['tasks'].get('randaddperiodic', {}).get('count', 0) > 0)
+        scheduler = node.getschedulerinfo()
+        assert_greater_than(scheduler['queued'], 0)
+        task = scheduler['tasks']['randaddperiodic']
+        assert_greater_than_or_equal(task['delay_max'], task['delay_p99'])
+        assert_greater_than_or_equal(task['delay_p99'], task['delay_p50'])
+        queues = {queue['name']: queue for queue in scheduler['validationqueues']}
+        assert 'peerman' in queues
+        assert_greater_than_or_equal(queues['peerman']['max_pending'], queues['peerman']['pending'])
+
         self.log.info("test logging rpc and help")
 
         # Test logging RPC returns the expected number of logging categories.
@@ -399,6 +399,8 @@ def write_config(config_path, *, n, chain, extra_config="", disable_autoconnect=
         f.write("shrinkdebugfile=0\n")
         # To improve SQLite wallet performance so that the tests don't timeout, use -unsafesqlitesync
         f.write("unsafesqlitesync=1\n")
+        # Check that the cached wallet balances match a full recomputation
+        f.write("walletcheckbalance=1\n")
         if disable_autoconnect:
             f.write("connect=0\n")
         f.write(extra_config)